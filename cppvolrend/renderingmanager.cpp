@@ -380,6 +380,14 @@ void RenderingManager::CloseFunc ()
 
 void RenderingManager::IdleFunc ()
 {
+  // next timestep of a time-varying dataset, if it is due and decoded
+  if (m_data_mgr.UpdateVolumeSequence())
+  {
+    if (!curr_vol_renderer->UpdateVolumeData())
+      UpdateDataAndResetCurrentVRMode();
+    if (!m_idle_rendering) PostRedisplay();
+  }
+
   if (m_idle_rendering)
   {
 #ifdef ALWAYS_OUTDATE_THE_CURRENT_VR_RENDERER
@@ -404,6 +412,16 @@ void RenderingManager::PostRedisplay ()
 void RenderingManager::UpdateDataAndResetCurrentVRMode ()
 {
   curr_vol_renderer->Init(curr_rdr_parameters.GetScreenWidth(), curr_rdr_parameters.GetScreenHeight());
+  // the renderer used the whole transfer function
+  if (m_data_mgr.GetCurrentTransferFunction())
+    m_data_mgr.GetCurrentTransferFunction()->ClearChanges();
+}
+
+void RenderingManager::UpdateTransferFunction ()
+{
+  if (!curr_vol_renderer->UpdateTransferFunction())
+    UpdateDataAndResetCurrentVRMode();
+  m_data_mgr.GetCurrentTransferFunction()->ClearChanges();
 }
 
 void RenderingManager::SaveScreenshot (std::string filename)
@@ -1081,7 +1099,47 @@ void RenderingManager::SetImGuiInterface ()
                                                         , m_data_mgr.GetCurrentStructuredVolume()->GetScaleY()
                                                         , m_data_mgr.GetCurrentStructuredVolume()->GetScaleZ());
         }
-        
+
+        vis::VolumeSequence* sequence = m_data_mgr.GetCurrentVolumeSequence();
+        if (sequence)
+        {
+          if (ImGui::Button(sequence->IsPlaying() ? "Pause###SequencePlay" : "Play###SequencePlay"))
+          {
+            if (sequence->IsPlaying()) sequence->Pause();
+            else sequence->Play();
+          }
+          ImGui::SameLine();
+          bool looping = sequence->IsLooping();
+          if (ImGui::Checkbox("Loop###SequenceLoop", &looping))
+            sequence->SetLooping(looping);
+
+          float rate = (float)sequence->GetTargetRate();
+          if (ImGui::DragFloat("Timesteps/s###SequenceRate", &rate, 0.1f, 0.1f, 120.0f))
+            sequence->SetTargetRate(rate);
+
+          int timestep = sequence->GetCurrentTimestep();
+          if (ImGui::SliderInt("Timestep###SequenceTimestep", &timestep, 0, sequence->GetNumberOfTimesteps() - 1))
+            sequence->Seek(timestep);
+          ImGui::BulletText("Stalls: %d", sequence->GetNumberOfStalls());
+        }
+
+        ImGui::BulletText("Data Cache: %.1f/%.1f MB, %llu hits, %llu misses",
+          double(m_data_mgr.GetDataCache()->GetUsedBytes()) / (1024.0 * 1024.0),
+          double(m_data_mgr.GetDataCache()->GetBudget()) / (1024.0 * 1024.0),
+          m_data_mgr.GetDataCache()->GetHits(), m_data_mgr.GetDataCache()->GetMisses());
+
+        vis::DatasetCatalogEntry catalog_entry;
+        if (m_data_mgr.GetDatasetCatalog()->GetEntry(m_data_mgr.GetCurrentVolumeName(), &catalog_entry))
+        {
+          ImGui::BulletText("Value Range: %.1f %.1f, %.1f MB", catalog_entry.min_value, catalog_entry.max_value,
+            double(catalog_entry.GetVoxelBytes()) / (1024.0 * 1024.0));
+        }
+        if (m_data_mgr.GetDatasetCatalog()->IsBuilding())
+        {
+          ImGui::BulletText("Indexing datasets... %d/%d", m_data_mgr.GetDatasetCatalog()->GetNumberOfEntries(),
+            m_data_mgr.GetNumberOfStructuredDatasets());
+        }
+
         if (ImGui::CollapsingHeader("Gradient Volume###DataManagerGradientVolume"))
         {
           int gradient_gen_index = m_data_mgr.GetCurrentGradientGenerationTypeID();
@@ -1125,6 +1183,48 @@ void RenderingManager::SetImGuiInterface ()
         m_data_mgr.NextTransferFunction();
         UpdateDataAndResetCurrentVRMode();
       }
+
+      // Control points of 1D transfer functions, each edit only updates the
+      //   data derived from the densities around the edited point
+      vis::TransferFunction1D* tf1d = dynamic_cast<vis::TransferFunction1D*>(m_data_mgr.GetCurrentTransferFunction());
+      if (tf1d && ImGui::TreeNode("Control Points###TF1DControlPoints"))
+      {
+        bool tf_changed = false;
+        for (int i = 0; i < tf1d->GetNumberOfAlphaControlPoints(); i++)
+        {
+          vis::TransferControlPoint cp = tf1d->GetAlphaControlPoint(i);
+          ImGui::PushID(i);
+          ImGui::PushItemWidth(100);
+          bool cp_changed = ImGui::DragFloat("Opacity###TF1DAlpha", &cp.m_color.a, 0.005f, 0.0f, FLT_MAX, "%.3f");
+          ImGui::SameLine();
+          cp_changed |= ImGui::DragInt("Density###TF1DAlphaIsovalue", &cp.m_isoValue, 1.0f, 0, tf1d->GetMaxDensity());
+          ImGui::PopItemWidth();
+          ImGui::PopID();
+          if (cp_changed)
+          {
+            tf1d->SetAlphaControlPoint(i, cp);
+            tf_changed = true;
+          }
+        }
+        for (int i = 0; i < tf1d->GetNumberOfRGBControlPoints(); i++)
+        {
+          vis::TransferControlPoint cp = tf1d->GetRGBControlPoint(i);
+          ImGui::PushID(tf1d->GetNumberOfAlphaControlPoints() + i);
+          ImGui::PushItemWidth(100);
+          bool cp_changed = ImGui::ColorEdit3("Color###TF1DColor", glm::value_ptr(cp.m_color), ImGuiColorEditFlags_NoInputs);
+          ImGui::SameLine();
+          cp_changed |= ImGui::DragInt("Density###TF1DColorIsovalue", &cp.m_isoValue, 1.0f, 0, tf1d->GetMaxDensity());
+          ImGui::PopItemWidth();
+          ImGui::PopID();
+          if (cp_changed)
+          {
+            tf1d->SetRGBControlPoint(i, cp);
+            tf_changed = true;
+          }
+        }
+        if (tf_changed) UpdateTransferFunction();
+        ImGui::TreePop();
+      }
     }
     ImGui::End();
   }
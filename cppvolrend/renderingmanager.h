@@ -66,6 +66,8 @@ public:
 
   // Update the volume renderer with the current volume and transfer function
   void UpdateDataAndResetCurrentVRMode ();
+  // Update the volume renderer after an edit of the current transfer function
+  void UpdateTransferFunction ();
 
   unsigned int GetScreenWidth ()
   {
@@ -69,6 +69,25 @@ bool RayCasting1Pass::Init (int swidth, int sheight)
   return true;
 }
 
+bool RayCasting1Pass::UpdateVolumeData ()
+{
+  // only samples the volume and gradient textures
+  SetOutdated();
+  return IsBuilt();
+}
+
+bool RayCasting1Pass::UpdateTransferFunction ()
+{
+  if (!IsBuilt()) return false;
+
+  // the transfer function texture is the only data derived from it
+  if (m_glsl_transfer_function) delete m_glsl_transfer_function;
+  m_glsl_transfer_function = m_ext_data_manager->GetCurrentTransferFunction()->GenerateTexture_1D_RGBt();
+
+  SetOutdated();
+  return true;
+}
+
 bool RayCasting1Pass::Update (vis::Camera* camera)
 {
   cp_shader_rendering->Bind();
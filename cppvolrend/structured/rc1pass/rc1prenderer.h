@@ -44,6 +44,8 @@ public:
   virtual void ReloadShaders ();
 
   virtual bool Init (int shader_width, int shader_height);
+  virtual bool UpdateVolumeData ();
+  virtual bool UpdateTransferFunction ();
   virtual bool Update (vis::Camera* camera);
   virtual void Redraw ();
   virtual void MultiSampleRedraw ();
@@ -7,8 +7,11 @@
 #include <glm/gtx/norm.hpp>
 
 #include <vis_utils/camera.h>
+#include <vis_utils/compactsummedareatable.h>
 
 #include <volvis_utils/utils.h>
+#include <volvis_utils/volumeview.h>
+#include <file_utils/sha256.h>
 #include <gl_utils/computeshader.h>
 
 #include <random>
@@ -21,6 +24,7 @@ RC1PExtinctionBasedShading::RC1PExtinctionBasedShading ()
   , m_u_step_size(0.5f)
   , m_apply_gradient_shading(false)
   , glsl_sat3d_tex(nullptr)
+  , glsl_sat3d_mean(0.0f)
   , transfer_function_changed(false)
 {
 
@@ -71,6 +75,8 @@ void RC1PExtinctionBasedShading::Clean ()
   DestroyRenderingShaders();
 
   DestroySummedAreaTable();
+  m_sat3d.Clear();
+  m_sat3d_data.reset();
 
   BaseVolumeRenderer::Clean();
 }
@@ -122,6 +128,40 @@ bool RC1PExtinctionBasedShading::Init (int swidth, int sheight)
   return true;
 }
 
+bool RC1PExtinctionBasedShading::UpdateVolumeData ()
+{
+  if (!IsBuilt()) return false;
+
+  // the summed area table is the only product of the voxels
+  DestroySummedAreaTable();
+  glsl_sat3d_tex = GenerateExtinctionSAT3DTex(m_ext_data_manager->GetCurrentStructuredVolume(),
+                                              m_ext_data_manager->GetCurrentTransferFunction());
+
+  SetOutdated();
+  return true;
+}
+
+bool RC1PExtinctionBasedShading::UpdateTransferFunction ()
+{
+  if (!IsBuilt()) return false;
+
+  vis::TransferFunction* tf = m_ext_data_manager->GetCurrentTransferFunction();
+  if (m_glsl_transfer_function) delete m_glsl_transfer_function;
+  m_glsl_transfer_function = tf->GenerateTexture_1D_RGBt();
+
+  // the SAT only depends on the extinction coefficients
+  double nmin, nmax;
+  if (tf->GetDirtyOpacityInterval(&nmin, &nmax)
+   && !UpdateExtinctionSAT3DTex(m_ext_data_manager->GetCurrentStructuredVolume(), tf, nmin, nmax))
+  {
+    DestroySummedAreaTable();
+    glsl_sat3d_tex = GenerateExtinctionSAT3DTex(m_ext_data_manager->GetCurrentStructuredVolume(), tf);
+  }
+
+  SetOutdated();
+  return true;
+}
+
 bool RC1PExtinctionBasedShading::Update (vis::Camera* camera)
 {
   if (m_pre_illum_str_vol.IsActive())
@@ -146,6 +186,8 @@ bool RC1PExtinctionBasedShading::Update (vis::Camera* camera)
     cp_shader_rendering->BindUniform("u_sat_height");
     cp_shader_rendering->SetUniform("u_sat_depth", (int)glsl_sat3d_tex->GetDepth());
     cp_shader_rendering->BindUniform("u_sat_depth");
+    cp_shader_rendering->SetUniform("u_sat_mean", glsl_sat3d_mean);
+    cp_shader_rendering->BindUniform("u_sat_mean");
 
     // Ambient Occlusion
     cp_shader_rendering->SetUniform("AmbOccShells", ambient_occlusion_shells);
@@ -475,6 +517,8 @@ void RC1PExtinctionBasedShading::PreComputeLightCache (vis::Camera* camera)
   // Bind Summed Area Table
   cp_lightcache_shader->SetUniformTexture3D("TexVolumeSAT3D", glsl_sat3d_tex->GetTextureID(), 3);
   cp_lightcache_shader->BindUniform("TexVolumeSAT3D");
+  cp_lightcache_shader->SetUniform("u_sat_mean", glsl_sat3d_mean);
+  cp_lightcache_shader->BindUniform("u_sat_mean");
 
   // Upload volume dimensions
   glm::vec3 volsize(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
@@ -621,7 +665,152 @@ void RC1PExtinctionBasedShading::DestroySummedAreaTable ()
   glsl_sat3d_tex = nullptr;
 }
 
+// Identifies the extinction coefficients of tf: the name alone does not
+//   change if the transfer function is edited
+static std::string GetExtinctionFingerprint (vis::TransferFunction* tf)
+{
+  const int n_samples = 65536;
+  std::vector<double> ext(n_samples);
+  for (int i = 0; i < n_samples; i++)
+    ext[i] = tf->GetExtN(double(i) / double(n_samples - 1));
+  return SHA256::HexDigest(ext.data(), ext.size() * sizeof(double));
+}
+
+// Extinction at the voxel (x, y, z) of the SAT grid, the volume with borders
+//   of zeros
+template<typename View>
+static double GetExtinctionSAT3DValue (const View& view, vis::TransferFunction* tf, int x, int y, int z)
+{
+  // Adding borders to handle precision issues
+  //
+  // 0 0 0 0 0 0     0 S S S S S
+  // 0         0     0         S
+  // 0         0 --> 0         S
+  // 0         0     0         S
+  // 0 0 0 0 0 0     0 0 0 0 0 0
+  //
+  if (x == 0 || y == 0 || z == 0 || x > view.GetWidth() || y > view.GetHeight() || z > view.GetDepth())
+    return 0.0;
+  return tf->GetExtN(view.GetNormalized(x - 1, y - 1, z - 1));
+}
+
+vis::DataCacheKey RC1PExtinctionBasedShading::GetExtinctionSAT3DCacheKey (vis::TransferFunction* tf)
+{
+  // The SAT only depends on the dataset and on the transfer function, the
+  //   revision tells the edits of the transfer function apart
+  return vis::DataCacheKey(m_ext_data_manager->GetCurrentVolumeCacheKey(), "extinction_sat3d_mean", -1,
+                           tf->GetName() + "#" + std::to_string(tf->GetRevision()));
+}
+
 gl::Texture3D* RC1PExtinctionBasedShading::GenerateExtinctionSAT3DTex (vis::StructuredGridVolume* vol, vis::TransferFunction* tf)
+{
+  int sat_w = (vol->GetWidth() + 2);
+  int sat_h = (vol->GetHeight() + 2);
+  int sat_d = (vol->GetDepth() + 2);
+
+  vis::DataCache* cache = m_ext_data_manager->GetDataCache();
+  vis::DataCacheKey key = GetExtinctionSAT3DCacheKey(tf);
+  std::shared_ptr<GLfloat> data_sat = cache->Find<GLfloat>(key);
+  bool generated = false;
+  if (!data_sat)
+  {
+    size_t n_sat = (size_t)sat_w * sat_h * sat_d;
+
+    // then the SAT stored by previous runs
+    vis::DiskCache* disk_cache = m_ext_data_manager->GetDiskCache();
+    bool use_disk_cache = m_ext_data_manager->UseDiskCache();
+    vis::DiskCacheKey disk_key(use_disk_cache ? vol->GetContentHash() : "", "extinction_sat3d_mean",
+                               use_disk_cache ? "tf=" + GetExtinctionFingerprint(tf) : "");
+
+    GLfloat* sat_values = nullptr;
+    if (use_disk_cache)
+      sat_values = disk_cache->LoadArray<GLfloat>(disk_key, n_sat);
+    if (!sat_values)
+    {
+      sat_values = GenerateExtinctionSAT3DData(vol, tf);
+      generated = true;
+      if (use_disk_cache)
+        disk_cache->Store(disk_key, sat_values, sizeof(GLfloat) * n_sat);
+    }
+
+    data_sat = vis::DataCache::MakeArray<GLfloat>(sat_values);
+    cache->Insert(key, data_sat, sizeof(GLfloat) * n_sat);
+  }
+
+  // the kept fixed point SAT is only valid for the data it generated
+  if (!generated && data_sat != m_sat3d_data)
+    m_sat3d.Clear();
+  m_sat3d_data = data_sat;
+  m_sat3d_key = key;
+
+  glsl_sat3d_mean = -data_sat.get()[0];
+
+  gl::Texture3D* tex3d_sat = new gl::Texture3D(sat_w, sat_h, sat_d);
+  tex3d_sat->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+  tex3d_sat->SetData((GLvoid*)data_sat.get(), GL_R32F, GL_RED, GL_FLOAT);
+
+  gl::ExitOnGLError("volrend/utils.cpp - GenerateExtinctionSAT3DTex()");
+  return tex3d_sat;
+}
+
+bool RC1PExtinctionBasedShading::UpdateExtinctionSAT3DTex (vis::StructuredGridVolume* vol, vis::TransferFunction* tf,
+                                                           double nmin, double nmax)
+{
+  if (glsl_sat3d_tex == nullptr || !m_sat3d_data || m_sat3d.GetWidth() == 0)
+    return false;
+
+  int sat_w = (int)m_sat3d.GetWidth();
+  int sat_h = (int)m_sat3d.GetHeight();
+  int sat_d = (int)m_sat3d.GetDepth();
+
+  // tiles with densities in the edited range
+  std::vector<unsigned char> dirty_tiles(m_sat3d.GetNumberOfTiles(), 0);
+  size_t slab_tiles = size_t(m_sat3d.GetNumberOfTilesX()) * size_t(m_sat3d.GetNumberOfTilesY());
+  int first_tz = m_sat3d.GetNumberOfTilesZ();
+  for (size_t t = 0; t < dirty_tiles.size(); t++)
+  {
+    if (m_sat3d_tile_min[t] <= nmax && m_sat3d_tile_max[t] >= nmin)
+    {
+      dirty_tiles[t] = 1;
+      first_tz = std::min(first_tz, int(t / slab_tiles));
+    }
+  }
+
+  if (first_tz < m_sat3d.GetNumberOfTilesZ())
+  {
+    // builds the transfer function table before the threads read it
+    tf->GetExtN(0.0);
+    bool in_range = false;
+    vis::DispatchVolumeView(vol, [&] (const auto& view) {
+      in_range = m_sat3d.Update(dirty_tiles, [&] (int x, int y, int z) -> double {
+        return GetExtinctionSAT3DValue(view, tf, x, y, z);
+      });
+    });
+    // an extinction larger than the range of the fixed point values
+    if (!in_range) return false;
+    // or much smaller: the step of a new table would be at least twice finer
+    double new_max = m_sat3d.GetMaximum();
+    if (new_max > 0.0 && new_max < 0.5 * m_sat3d.GetStep() * double((1 << m_sat3d.GetBits()) - 1))
+      return false;
+
+    // same offset as the whole SAT, so the other slices stay valid
+    int first_z = first_tz * vis::CompactSummedAreaTable3D::TILE_DIM;
+    size_t slice_size = size_t(sat_w) * size_t(sat_h);
+    m_sat3d.GetFloatValues(m_sat3d_data.get(), double(glsl_sat3d_mean), first_z);
+    glsl_sat3d_tex->SetSubData((GLvoid*)(m_sat3d_data.get() + slice_size * first_z),
+                               0, 0, first_z, sat_w, sat_h, sat_d - first_z, GL_RED, GL_FLOAT);
+  }
+
+  // the cached SAT is now the one of the edited transfer function
+  vis::DataCache* cache = m_ext_data_manager->GetDataCache();
+  cache->Erase(m_sat3d_key);
+  m_sat3d_key = GetExtinctionSAT3DCacheKey(tf);
+  cache->Insert(m_sat3d_key, m_sat3d_data, sizeof(GLfloat) * size_t(sat_w) * size_t(sat_h) * size_t(sat_d));
+
+  return true;
+}
+
+GLfloat* RC1PExtinctionBasedShading::GenerateExtinctionSAT3DData (vis::StructuredGridVolume* vol, vis::TransferFunction* tf)
 {
   // 1
    // First, sample the initial "grid" and build SAT
@@ -632,35 +821,60 @@ gl::Texture3D* RC1PExtinctionBasedShading::GenerateExtinctionSAT3DTex (vis::Stru
   double min_value = +9999;
   double max_value = -9999;
 
-  vis::SummedAreaTable3D<double> sat3d(sat_w, sat_h, sat_d);
-  for (int x = 0; x < sat_w; x++)
-  {
-    for (int y = 0; y < sat_h; y++)
+  // builds the transfer function table before the threads read it
+  tf->GetExtN(0.0);
+
+  // tiles of the SAT grid, the voxel (x, y, z) of the volume is in the tile
+  //   of (x + 1, y + 1, z + 1)
+  const int tile_log2 = vis::CompactSummedAreaTable3D::TILE_LOG2;
+  const int tile_dim = vis::CompactSummedAreaTable3D::TILE_DIM;
+  int tiles_x = (sat_w + tile_dim - 1) / tile_dim;
+  int tiles_y = (sat_h + tile_dim - 1) / tile_dim;
+  int tiles_z = (sat_d + tile_dim - 1) / tile_dim;
+  m_sat3d_tile_min.assign(size_t(tiles_x) * size_t(tiles_y) * size_t(tiles_z), 1.0f);
+  m_sat3d_tile_max.assign(m_sat3d_tile_min.size(), 0.0f);
+
+  m_sat3d.Clear();
+  vis::DispatchVolumeView(vol, [&] (const auto& view) {
+    // range of the extinction coefficients, for the fixed point precision,
+    //   and of the densities of each tile, for the transfer function edits
+#pragma omp parallel
     {
-      for (int z = 0; z < sat_d; z++)
+      double l_min_value = +9999;
+      double l_max_value = -9999;
+#pragma omp for
+      for (int tz = 0; tz < tiles_z; tz++)
       {
-        double val;
-        // Adding borders to handle precision issues
-        //
-        // 0 0 0 0 0 0     0 S S S S S
-        // 0         0     0         S
-        // 0         0 --> 0         S
-        // 0         0     0         S
-        // 0 0 0 0 0 0     0 0 0 0 0 0
-        //
-        if (x == 0 || y == 0 || z == 0 || x == sat_w - 1 || y == sat_h - 1 || z == sat_d - 1)
-          val = 0.0f;
-        else
+        for (int z = std::max(tz * tile_dim - 1, 0); z < std::min((tz + 1) * tile_dim - 1, view.GetDepth()); z++)
         {
-          val = tf->GetExtN(vol->GetNormalizedSample(x - 1, y - 1, z - 1));
-          min_value = std::min(min_value, val);
-          max_value = std::max(max_value, val);
+          for (int y = 0; y < view.GetHeight(); y++)
+          {
+            for (int x = 0; x < view.GetWidth(); x++)
+            {
+              double n = view.GetNormalized(x, y, z);
+              size_t t = size_t((x + 1) >> tile_log2)
+                       + size_t(tiles_x) * (size_t((y + 1) >> tile_log2) + size_t(tiles_y) * size_t(tz));
+              m_sat3d_tile_min[t] = std::min(m_sat3d_tile_min[t], float(n));
+              m_sat3d_tile_max[t] = std::max(m_sat3d_tile_max[t], float(n));
+
+              double val = tf->GetExtN(n);
+              l_min_value = std::min(l_min_value, val);
+              l_max_value = std::max(l_max_value, val);
+            }
+          }
         }
-        sat3d.SetValue(val, x, y, z);
+      }
+#pragma omp critical
+      {
+        min_value = std::min(min_value, l_min_value);
+        max_value = std::max(max_value, l_max_value);
       }
     }
-  }
-  sat3d.BuildSAT();
+
+    m_sat3d.Build(sat_w, sat_h, sat_d, [&] (int x, int y, int z) -> double {
+      return GetExtinctionSAT3DValue(view, tf, x, y, z);
+    }, max_value);
+  });
   printf("SAT min %.2lf max %.2lf\n", min_value, max_value);
 
   //for (int x = 0; x < sat_w; x++)
@@ -676,15 +890,15 @@ gl::Texture3D* RC1PExtinctionBasedShading::GenerateExtinctionSAT3DTex (vis::Stru
   //      {
   //        val = tf->GetExtN(vol->GetNormalizedSample(x - 1, y - 1, z - 1));
   //
-  //        double V1 = sat3d.GetValue(x    , y    , z    );
-  //        double V2 = sat3d.GetValue(x - 1, y    , z    );
-  //        double V3 = sat3d.GetValue(x    , y    , z - 1);
-  //        double V4 = sat3d.GetValue(x - 1, y    , z - 1);
+  //        double V1 = m_sat3d.GetValue(x    , y    , z    );
+  //        double V2 = m_sat3d.GetValue(x - 1, y    , z    );
+  //        double V3 = m_sat3d.GetValue(x    , y    , z - 1);
+  //        double V4 = m_sat3d.GetValue(x - 1, y    , z - 1);
   //
-  //        double V5 = sat3d.GetValue(x    , y - 1, z    );
-  //        double V6 = sat3d.GetValue(x - 1, y - 1, z    );
-  //        double V7 = sat3d.GetValue(x    , y - 1, z - 1);
-  //        double V8 = sat3d.GetValue(x - 1, y - 1, z - 1);
+  //        double V5 = m_sat3d.GetValue(x    , y - 1, z    );
+  //        double V6 = m_sat3d.GetValue(x - 1, y - 1, z    );
+  //        double V7 = m_sat3d.GetValue(x    , y - 1, z - 1);
+  //        double V8 = m_sat3d.GetValue(x - 1, y - 1, z - 1);
   //
   //        double val_sat = (V1 - V2 - V3 + V4 - V5 + V6 + V7 - V8);
   //        if (fabs(val_sat - val) > 0.001f)
@@ -697,27 +911,12 @@ gl::Texture3D* RC1PExtinctionBasedShading::GenerateExtinctionSAT3DTex (vis::Stru
   //}
 
   // 2
-  // Then, we must create and generate the 3D texture
-  double* sat_data = sat3d.GetData();
-  GLfloat* data_sat = new GLfloat[sat_w * sat_h * sat_d];
-  for (int x = 0; x < sat_w; x++)
-  {
-    for (int y = 0; y < sat_h; y++)
-    {
-      for (int z = 0; z < sat_d; z++)
-      {
-        int id = x + y * sat_w + z * sat_w * sat_h;
-        data_sat[id] = (GLfloat)sat_data[id];// / double(x * y * z);
-      }
-    }
-  }
-
-  gl::Texture3D* tex3d_sat = new gl::Texture3D(sat_w, sat_h, sat_d);
-  tex3d_sat->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-  tex3d_sat->SetData((GLvoid*)data_sat, GL_R32F, GL_RED, GL_FLOAT);
-
-  delete[] data_sat;
-
-  gl::ExitOnGLError("volrend/utils.cpp - GenerateExtinctionSAT3DTex()");
-  return tex3d_sat;
+  // Then, we must convert it to the format of the 3D texture, minus the
+  //   mean: the float values keep the precision of the large boxes. The
+  //   offset is rounded to the float of the shader uniform, so the slices
+  //   rebuilt by UpdateExtinctionSAT3DTex use exactly the same.
+  GLfloat* data_sat = new GLfloat[size_t(sat_w) * size_t(sat_h) * size_t(sat_d)];
+  m_sat3d.GetFloatValues(data_sat, double(float(m_sat3d.GetMean())));
+
+  return data_sat;
 }
\ No newline at end of file
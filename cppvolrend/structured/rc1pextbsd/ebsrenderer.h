@@ -35,6 +35,8 @@
 
 #include <gl_utils/computeshader.h>
 
+#include <vis_utils/compactsummedareatable.h>
+
 #include "../../volrenderbase.h"
 #include "../../utils/preillumination.h"
 
@@ -57,6 +59,8 @@ public:
   virtual void ReloadShaders ();
 
   virtual bool Init (int shader_width, int shader_height);
+  virtual bool UpdateVolumeData ();
+  virtual bool UpdateTransferFunction ();
   virtual bool Update (vis::Camera* camera);
   virtual void Redraw ();
   virtual void MultiSampleRedraw ();
@@ -81,6 +85,9 @@ protected:
   // Summed Area Table 3D using Extinction Coefficients
   int st_w, st_h, st_d;
   gl::Texture3D* glsl_sat3d_tex;
+  // mean extinction subtracted from the SAT texture, the shaders add it
+  //   back for each box
+  float glsl_sat3d_mean;
 
   // Rendering shaders
   gl::ComputeShader* cp_shader_rendering;
@@ -92,7 +99,25 @@ private:
   void DestroyRenderingShaders ();
   void DestroySummedAreaTable ();
 
+  // Uploads the SAT of the data manager cache, building it on a miss
   gl::Texture3D* GenerateExtinctionSAT3DTex (vis::StructuredGridVolume* vol, vis::TransferFunction* tf);
+  // (w+2)*(h+2)*(d+2) SAT of the extinction coefficients, with zero borders,
+  //   minus mean * (x+1)*(y+1)*(z+1): the first value is -mean
+  GLfloat* GenerateExtinctionSAT3DData (vis::StructuredGridVolume* vol, vis::TransferFunction* tf);
+  // Rebuilds the tiles of the SAT whose densities are in [nmin, nmax] after
+  //   an edit of tf, and uploads the slices after the first of them. False
+  //   if the whole SAT must be generated again.
+  bool UpdateExtinctionSAT3DTex (vis::StructuredGridVolume* vol, vis::TransferFunction* tf, double nmin, double nmax);
+  vis::DataCacheKey GetExtinctionSAT3DCacheKey (vis::TransferFunction* tf);
+
+  // Fixed point SAT of the last GenerateExtinctionSAT3DData, kept for the
+  //   transfer function edits (empty if the texture was loaded from a cache),
+  //   with the range of the normalized densities of each of its tiles
+  vis::CompactSummedAreaTable3D m_sat3d;
+  std::vector<float> m_sat3d_tile_min, m_sat3d_tile_max;
+  // texture data and its data cache entry
+  std::shared_ptr<GLfloat> m_sat3d_data;
+  vis::DataCacheKey m_sat3d_key;
 
   gl::Texture1D* m_glsl_transfer_function;
 
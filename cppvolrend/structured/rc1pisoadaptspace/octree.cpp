@@ -1,7 +1,10 @@
 #include "octree.h"
 
+#include <volvis_utils/volumeview.h>
+
 AABB computeChildBounds(const AABB& parentBounds, int childIndex);
 void setMinMaxVal(vis::StructuredGridVolume* volume, OctreeNode* node, const AABB& bounds);
+void setMinMaxVal(vis::BrickedVolumeFile* bvol, OctreeNode* node, const AABB& bounds);
 glm::vec3 computeOffset(int childIndex, glm::vec3 size);
 
 AABB::AABB(const glm::vec3& minCorner, const glm::vec3& maxCorner) : min(minCorner), max(maxCorner) {}
@@ -54,6 +57,27 @@ void BuildOctree(OctreeNode* node, vis::StructuredGridVolume* volume, int maxDep
 	setMinMaxVal(volume, node, node->bounds);
 }
 
+void BuildOctree(OctreeNode* node, vis::BrickedVolumeFile* bvol, int maxDepth, int currentDepth) {
+
+	// Base case, max depth reached
+	if (currentDepth >= maxDepth) {
+		node->isLeaf = true;
+		return;
+	}
+	currentDepth = currentDepth + 1;
+
+	// Subdivide node
+	node->isLeaf = false;
+	for (size_t i = 0; i < 8; i++) {
+		AABB childBounds = computeChildBounds(node->bounds, i);
+		node->children[i] = new OctreeNode(childBounds);
+		setMinMaxVal(bvol, node->children[i], childBounds);
+		BuildOctree(node->children[i], bvol, maxDepth, currentDepth);
+	}
+
+	setMinMaxVal(bvol, node, node->bounds);
+}
+
 // Compute the child bounds based on its index
 AABB computeChildBounds(const AABB& parentBounds, int childIndex) {
 	glm::vec3 childSize = (parentBounds.max - parentBounds.min + glm::vec3(1, 1, 1)) * 0.5f;
@@ -74,19 +98,43 @@ glm::vec3 computeOffset(int childIndex, glm::vec3 size) {
 void setMinMaxVal(vis::StructuredGridVolume* volume, OctreeNode* node, const AABB& bounds) {
 	float min = 10;
 	float max = -10;
-	for (size_t x = bounds.min.x; x < bounds.max.x; x++) {
-		for (size_t y = bounds.min.y; y < bounds.max.y; y++) {
-			for (size_t z = bounds.min.z; z < bounds.max.z; z++) {
-				float sample = volume->GetNormalizedSample(x, y, z);
-				if (sample < min) min = sample;
-				if (sample > max) max = sample;
+	// Integer voxels in [bounds.min, bounds.max)
+	glm::ivec3 vmin = glm::ivec3(bounds.min);
+	glm::ivec3 vmax = glm::ivec3(glm::ceil(bounds.max));
+	vis::DispatchVolumeView(volume, [&](const auto& view) {
+		// Bounds are only checked if the node crosses the volume border
+		bool inside = vmin.x >= 0 && vmin.y >= 0 && vmin.z >= 0 &&
+		              vmax.x <= view.GetWidth() && vmax.y <= view.GetHeight() && vmax.z <= view.GetDepth();
+		for (int z = vmin.z; z < vmax.z; z++) {
+			for (int y = vmin.y; y < vmax.y; y++) {
+				for (int x = vmin.x; x < vmax.x; x++) {
+					float sample = float(inside ? view.GetNormalized(x, y, z) : view.GetNormalizedOrZero(x, y, z));
+					if (sample < min) min = sample;
+					if (sample > max) max = sample;
+				}
 			}
 		}
-	}
+	});
 	node->minVal = min;
 	node->maxVal = max;
 }
 
+// Find and set min/max values for a node using the per-brick statistics
+void setMinMaxVal(vis::BrickedVolumeFile* bvol, OctreeNode* node, const AABB& bounds) {
+	double vmin, vmax;
+	// Same voxels as the voxel scan, the bounds may end at half voxels
+	bvol->GetRegionMinMax(glm::ivec3(bounds.min), glm::ivec3(glm::ceil(bounds.max)), &vmin, &vmax);
+
+	// Empty region, same values as the voxel scan
+	if (vmin > vmax) {
+		node->minVal = 10;
+		node->maxVal = -10;
+		return;
+	}
+	node->minVal = float(vmin / bvol->GetMaxDensity());
+	node->maxVal = float(vmax / bvol->GetMaxDensity());
+}
+
 
 void FlattenOctree(OctreeNode* node, std::vector<GPUOctreeNode>& flatTree) {
     // Create a GPUOctreeNode to store the current node's data
@@ -2,6 +2,7 @@
 #define OCTREE_H
 
 #include <volvis_utils/utils.h>
+#include <volvis_utils/brickedvolume.h>
 
 // Axis-Aligned Bounding Box
 struct AABB {
@@ -35,6 +36,9 @@ struct OctreeNode {
 
 // Recursively build the octree based on a volume
 void BuildOctree(OctreeNode* node, vis::StructuredGridVolume* volume, int maxDepth, int currentDepth);
+// Same as above, but node min/max values come from the brick metadata of a
+// .bvol file (conservative, no voxel is read)
+void BuildOctree(OctreeNode* node, vis::BrickedVolumeFile* bvol, int maxDepth, int currentDepth);
 
 struct alignas(16) GPUOctreeNode {
     glm::vec3 minBounds;   // 12 bytes
@@ -82,21 +82,57 @@ bool RayCasting1PassIsoAdaptSpace::Init(int swidth, int sheight)
 
   glm::vec3 vol_aabb = vol_resolution * vol_voxelsize;
 
-  // - construct octree
+  // - flattened octrees are kept in the data cache, per dataset and depth
   int octreeDepth = m_u_octree_depth;
-  glm::vec3 minCorner = {0,0,0};
-  glm::vec3 maxCorner = vol_resolution-glm::vec3(1,1,1);
-  AABB bounds(minCorner, maxCorner);
-  OctreeNode root(bounds);
-  std::cout << "Constructing octree (root dim " << vol_resolution.x << "x" << vol_resolution.y << "x" << vol_resolution.z << ")...";
-  BuildOctree(&root,m_ext_data_manager->GetCurrentStructuredVolume(),octreeDepth,0);
-  std::cout << " done" << std::endl;
-
-  // - flatten octree
-  std::cout << "Flattening octree...";
-  std::vector<GPUOctreeNode> flatTree;
-  FlattenOctree(&root, flatTree);
-  std::cout << " done (size=" << flatTree.size() << ")" << std::endl;
+  vis::DataCache* cache = m_ext_data_manager->GetDataCache();
+  vis::DataCacheKey octree_key(m_ext_data_manager->GetCurrentVolumeCacheKey(), "octree_" + std::to_string(octreeDepth));
+  std::shared_ptr<std::vector<GPUOctreeNode>> cached_tree = cache->Find<std::vector<GPUOctreeNode>>(octree_key);
+
+  // - then the disk cache, keyed by the voxels, depth, node layout and source
+  vis::BrickedVolumeFile bvol;
+  std::string vol_name = m_ext_data_manager->GetCurrentStructuredVolume()->GetName();
+  bool from_bvol = vol_name.size() > 5 && vol_name.compare(vol_name.size() - 5, 5, ".bvol") == 0 && bvol.Open(vol_name);
+  vis::DiskCache* disk_cache = m_ext_data_manager->GetDiskCache();
+  bool use_disk_cache = !cached_tree && m_ext_data_manager->UseDiskCache();
+  vis::DiskCacheKey octree_disk_key(use_disk_cache ? m_ext_data_manager->GetCurrentStructuredVolume()->GetContentHash() : "",
+    "octree", "depth=" + std::to_string(octreeDepth) + ";node=" + std::to_string(sizeof(GPUOctreeNode)) + (from_bvol ? ";bvol" : ""), 2);
+  if (use_disk_cache)
+  {
+    std::vector<unsigned char> payload;
+    if (disk_cache->Load(octree_disk_key, &payload) && payload.size() % sizeof(GPUOctreeNode) == 0)
+    {
+      cached_tree = std::make_shared<std::vector<GPUOctreeNode>>(payload.size() / sizeof(GPUOctreeNode));
+      memcpy(cached_tree->data(), payload.data(), payload.size());
+      cache->Insert(octree_key, cached_tree, payload.size());
+    }
+  }
+
+  if (!cached_tree)
+  {
+    // - construct octree
+    glm::vec3 minCorner = {0,0,0};
+    glm::vec3 maxCorner = vol_resolution-glm::vec3(1,1,1);
+    AABB bounds(minCorner, maxCorner);
+    OctreeNode root(bounds);
+    std::cout << "Constructing octree (root dim " << vol_resolution.x << "x" << vol_resolution.y << "x" << vol_resolution.z << ")...";
+    // - bricked volumes already store min/max per brick, so the voxels are not scanned
+    if (from_bvol)
+      BuildOctree(&root,&bvol,octreeDepth,0);
+    else
+      BuildOctree(&root,m_ext_data_manager->GetCurrentStructuredVolume(),octreeDepth,0);
+    std::cout << " done" << std::endl;
+
+    // - flatten octree
+    std::cout << "Flattening octree...";
+    cached_tree = std::make_shared<std::vector<GPUOctreeNode>>();
+    FlattenOctree(&root, *cached_tree);
+    std::cout << " done (size=" << cached_tree->size() << ")" << std::endl;
+
+    cache->Insert(octree_key, cached_tree, cached_tree->size() * sizeof(GPUOctreeNode));
+    if (use_disk_cache)
+      disk_cache->Store(octree_disk_key, cached_tree->data(), cached_tree->size() * sizeof(GPUOctreeNode));
+  }
+  const std::vector<GPUOctreeNode>& flatTree = *cached_tree;
 
   // - print child bounds
 //   for (size_t i = 0; i < 8; i++)
@@ -1,11 +1,14 @@
 #include "preprocessingstages.h"
 
+#include <volvis_utils/volumeview.h>
+
 VCTPreProcessing::VCTPreProcessing ()
 {
   use_glsl_to_precompute_data = false;
 
   glsl_supervoxel_meanstddev = nullptr;
   glsl_preintegration_lookup = nullptr;
+  preint_w = preint_h = 0;
 
   tree_spr_voxel.clear();
 }
@@ -32,7 +35,8 @@ double VCTPreProcessing::GetStdDevFromSuperVoxel (int lvl, int lw, int lh, int l
   return tree_spr_voxel[lvl]->sv_data[x + (y * vw) + (z * vw * vh)].stdv;
 }
 
-void VCTPreProcessing::PreProcessSuperVoxels (vis::StructuredGridVolume* vol)
+void VCTPreProcessing::PreProcessSuperVoxels (vis::StructuredGridVolume* vol, vis::DataCache* cache, std::string dataset,
+                                              vis::DiskCache* disk_cache)
 {
   if (use_glsl_to_precompute_data)
   {
@@ -40,22 +44,59 @@ void VCTPreProcessing::PreProcessSuperVoxels (vis::StructuredGridVolume* vol)
     //maximum_standard_deviation = 255.0;
   }
 
+  std::shared_ptr<SuperVoxelPyramid> pyramid;
+  if (cache) pyramid = cache->Find<SuperVoxelPyramid>(vis::DataCacheKey(dataset, "supervoxels"));
+  if (!pyramid)
+  {
+    bool use_disk_cache = disk_cache && disk_cache->IsEnabled();
+    vis::DiskCacheKey disk_key(use_disk_cache ? vol->GetContentHash() : "", "supervoxels");
+
+    pyramid = std::make_shared<SuperVoxelPyramid>();
+    std::vector<unsigned char> payload;
+    if (!use_disk_cache || !disk_cache->Load(disk_key, &payload) || !pyramid->Deserialize(payload))
+    {
+      pyramid = std::make_shared<SuperVoxelPyramid>();
+      BuildSuperVoxelPyramid(vol, pyramid.get());
+      if (use_disk_cache) disk_cache->Store(disk_key, pyramid->Serialize());
+    }
+    if (cache) cache->Insert(vis::DataCacheKey(dataset, "supervoxels"), pyramid, pyramid->GetSizeBytes());
+  }
+
+  glsl_supervoxel_meanstddev = new gl::Texture3D(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
+  glsl_supervoxel_meanstddev->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, true);
+
+  // Set the data of each mipmap level to then update to glsl shader
+  for (int i = 0; i < pyramid->dims.size(); i++)
+  {
+    glm::ivec3 dim = pyramid->dims[i];
+    glTexImage3D(GL_TEXTURE_3D, i, GL_RG16F, dim.x, dim.y, dim.z, 0, GL_RG, GL_FLOAT, pyramid->mean_stddev[i].data());
+  }
+
+  maximum_standard_deviation = pyramid->max_stddev;
+  printf("Super Voxels Computed! Maximum Standard Deviation %g\n", pyramid->max_stddev);
+}
+
+void VCTPreProcessing::BuildSuperVoxelPyramid (vis::StructuredGridVolume* vol, SuperVoxelPyramid* pyramid)
+{
   int w = vol->GetWidth();
   int h = vol->GetHeight();
   int d = vol->GetDepth();
 
   tree_spr_voxel.push_back(new SuperVoxelLevel(glm::ivec3(w, h, d)));
-  for (int x = 0; x < w; x++)
-  {
-    for (int y = 0; y < h; y++)
+  vis::DispatchVolumeView(vol, [&] (const auto& view) {
+#pragma omp parallel for
+    for (int z = 0; z < d; z++)
     {
-      for (int z = 0; z < d; z++)
+      for (int y = 0; y < h; y++)
       {
-        tree_spr_voxel[0]->sv_data[x + (y * w) + (z * w * h)].mean = vol->GetNormalizedSample(x,y,z) * 255.0;
-        tree_spr_voxel[0]->sv_data[x + (y * w) + (z * w * h)].stdv = 0.0;
+        for (int x = 0; x < w; x++)
+        {
+          tree_spr_voxel[0]->sv_data[x + (y * w) + (z * w * h)].mean = view.GetNormalized(x, y, z) * 255.0;
+          tree_spr_voxel[0]->sv_data[x + (y * w) + (z * w * h)].stdv = 0.0;
+        }
       }
     }
-  }
+  });
 
   double max_stddev = 0.0;
 
@@ -119,29 +160,70 @@ void VCTPreProcessing::PreProcessSuperVoxels (vis::StructuredGridVolume* vol)
     d = d / 2;
   }
 
-  glsl_supervoxel_meanstddev = new gl::Texture3D(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
-  glsl_supervoxel_meanstddev->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, true);
-
-  // Set the data of each mipmap level to then update to glsl shader
+  // Pack each mipmap level as the data of the RG texture
   for (int i = 0; i < mm_level; i++)
   {
     int w = tree_spr_voxel[i]->dim.x;
     int h = tree_spr_voxel[i]->dim.y;
     int d = tree_spr_voxel[i]->dim.z;
-        
-    GLfloat* sdata = new GLfloat[w*h*d * 2];
+
+    pyramid->dims.push_back(tree_spr_voxel[i]->dim);
+    pyramid->mean_stddev.push_back(std::vector<GLfloat>(w*h*d * 2));
+    GLfloat* sdata = pyramid->mean_stddev.back().data();
     for (int v = 0; v < w*h*d; v++)
     {
       sdata[v * 2 + 0] = tree_spr_voxel[i]->sv_data[v].mean;
       sdata[v * 2 + 1] = tree_spr_voxel[i]->sv_data[v].stdv;
     }
+  }
+  pyramid->max_stddev = max_stddev;
+}
+
+std::vector<unsigned char> VCTPreProcessing::SuperVoxelPyramid::Serialize ()
+{
+  uint32_t n_levels = (uint32_t)dims.size();
 
-    glTexImage3D(GL_TEXTURE_3D, i, GL_RG16F, w, h, d, 0, GL_RG, GL_FLOAT, sdata);
-    delete[] sdata;
+  std::vector<unsigned char> payload(sizeof(uint32_t) + sizeof(double));
+  memcpy(&payload[0], &n_levels, sizeof(uint32_t));
+  memcpy(&payload[sizeof(uint32_t)], &max_stddev, sizeof(double));
+  for (int i = 0; i < dims.size(); i++)
+  {
+    size_t offset = payload.size();
+    size_t level_bytes = mean_stddev[i].size() * sizeof(GLfloat);
+    payload.resize(offset + sizeof(glm::ivec3) + level_bytes);
+    memcpy(&payload[offset], &dims[i], sizeof(glm::ivec3));
+    memcpy(&payload[offset + sizeof(glm::ivec3)], mean_stddev[i].data(), level_bytes);
   }
+  return payload;
+}
+
+bool VCTPreProcessing::SuperVoxelPyramid::Deserialize (const std::vector<unsigned char>& payload)
+{
+  dims.clear();
+  mean_stddev.clear();
+
+  uint32_t n_levels = 0;
+  if (payload.size() < sizeof(uint32_t) + sizeof(double)) return false;
+  memcpy(&n_levels, &payload[0], sizeof(uint32_t));
+  memcpy(&max_stddev, &payload[sizeof(uint32_t)], sizeof(double));
 
-  maximum_standard_deviation = max_stddev;
-  printf("Super Voxels Computed! Maximum Standard Deviation %g\n", max_stddev);
+  size_t offset = sizeof(uint32_t) + sizeof(double);
+  for (uint32_t i = 0; i < n_levels; i++)
+  {
+    glm::ivec3 dim;
+    if (payload.size() < offset + sizeof(glm::ivec3)) return false;
+    memcpy(&dim, &payload[offset], sizeof(glm::ivec3));
+    offset += sizeof(glm::ivec3);
+
+    size_t level_bytes = (size_t)dim.x * dim.y * dim.z * 2 * sizeof(GLfloat);
+    if (dim.x <= 0 || dim.y <= 0 || dim.z <= 0 || payload.size() < offset + level_bytes) return false;
+
+    dims.push_back(dim);
+    mean_stddev.push_back(std::vector<GLfloat>((size_t)dim.x * dim.y * dim.z * 2));
+    memcpy(mean_stddev.back().data(), &payload[offset], level_bytes);
+    offset += level_bytes;
+  }
+  return offset == payload.size();
 }
 
 double VCTPreProcessing::GaussianEvaluation (double x, double mean, double stddev)
@@ -182,18 +264,95 @@ void VCTPreProcessing::PreProcessPreIntegrationTable (vis::StructuredGridVolume*
   double dens_val = vol->GetMaxDensity();
   int w = glm::ceil(dens_val);
   int h = glm::ceil(maximum_standard_deviation);
+  // integer densities of OpacityGaussianEvaluation
+  int n_dens = std::min(int(dens_val), w);
+
+  // same sums as OpacityGaussianEvaluation, each opacity looked up once
+  preint_w = w;
+  preint_h = h;
+  preint_opacity.resize(w);
+  for (int i = 0; i < w; i++)
+    preint_opacity[i] = tf->GetOpc(i, int(dens_val));
+  preint_sum_g.assign(size_t(w) * size_t(h), 0.0);
+  preint_sum_w.assign(size_t(w) * size_t(h), 0.0);
+#pragma omp parallel for
+  for (int ih = 1; ih < h; ih++)
+  {
+    for (int iw = 0; iw < w; iw++)
+    {
+      double SumG = 0.0;
+      double SumW = 0.0;
+      for (int i = 0; i < n_dens; i++)
+      {
+        double W = GaussianEvaluation(i, iw, ih);
+        SumG += W * preint_opacity[i];
+        SumW += W;
+      }
+      preint_sum_g[iw + (size_t(ih) * w)] = SumG;
+      preint_sum_w[iw + (size_t(ih) * w)] = SumW;
+    }
+  }
+
+  glsl_preintegration_lookup = new gl::Texture2D(w, h);
+  glsl_preintegration_lookup->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+  SetPreIntegrationTableData();
+}
+
+bool VCTPreProcessing::UpdatePreIntegrationTable (vis::StructuredGridVolume* vol, vis::TransferFunction* tf,
+                                                  double nmin, double nmax)
+{
+  if (glsl_preintegration_lookup == nullptr || preint_opacity.empty()) return false;
 
+  double dens_val = vol->GetMaxDensity();
+  int w = preint_w;
+  int h = preint_h;
+  int n_dens = std::min(int(dens_val), w);
+
+  // densities whose opacity changed, the transfer function interpolates
+  //   between its entries
+  int first = glm::clamp(int(glm::floor(nmin * dens_val)) - 1, 0, w - 1);
+  int last = glm::clamp(int(glm::ceil(nmax * dens_val)) + 1, 0, w - 1);
+  std::vector<double> delta(last - first + 1);
+  for (int i = first; i <= last; i++)
+  {
+    double opc = tf->GetOpc(i, int(dens_val));
+    delta[i - first] = opc - preint_opacity[i];
+    preint_opacity[i] = opc;
+  }
+
+  int last_dens = std::min(last, n_dens - 1);
+#pragma omp parallel for
+  for (int ih = 1; ih < h; ih++)
+  {
+    for (int iw = 0; iw < w; iw++)
+    {
+      double dSumG = 0.0;
+      for (int i = first; i <= last_dens; i++)
+        dSumG += GaussianEvaluation(i, iw, ih) * delta[i - first];
+      preint_sum_g[iw + (size_t(ih) * w)] += dSumG;
+    }
+  }
+
+  SetPreIntegrationTableData();
+  return true;
+}
+
+void VCTPreProcessing::SetPreIntegrationTableData ()
+{
+  int w = preint_w;
+  int h = preint_h;
+
+  // the first row (stddev 0) is the opacity of the mean
   GLfloat* preintegrationvalues = new GLfloat[w * h];
   for (int iw = 0; iw < w; iw++)
   {
     for (int ih = 0; ih < h; ih++)
     {
-      preintegrationvalues[iw + (ih * w)] = (float)OpacityGaussianEvaluation(iw, ih, vol, tf);
+      size_t i = iw + (size_t(ih) * w);
+      preintegrationvalues[i] = (float)(ih == 0 ? preint_opacity[iw] : preint_sum_g[i] / preint_sum_w[i]);
     }
   }
 
-  glsl_preintegration_lookup = new gl::Texture2D(w, h);
-  glsl_preintegration_lookup->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
   glsl_preintegration_lookup->SetData(preintegrationvalues, GL_R16F, GL_RED, GL_FLOAT);
 
   delete[] preintegrationvalues;
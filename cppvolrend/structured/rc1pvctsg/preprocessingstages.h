@@ -20,6 +20,8 @@
 #include <volvis_utils/reader.h>
 #include <volvis_utils/utils.h>
 #include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/datacache.h>
+#include <volvis_utils/diskcache.h>
 
 #include <gl_utils/arrayobject.h>
 #include <gl_utils/bufferobject.h>
@@ -47,6 +49,9 @@ public:
     if (glsl_preintegration_lookup != nullptr)
       delete glsl_preintegration_lookup;
     glsl_preintegration_lookup = nullptr;
+    preint_opacity.clear();
+    preint_sum_g.clear();
+    preint_sum_w.clear();
 
     for (int i = 0; i < tree_spr_voxel.size(); i++)
       delete tree_spr_voxel[i];
@@ -56,12 +61,20 @@ public:
   double GetMeanFromSuperVoxel (int lvl, int lw, int lh, int ld, int vw, int vh, int vd);
   double GetStdDevFromSuperVoxel (int lvl, int lw, int lh, int ld, int vw, int vh, int vd);
 
-  void PreProcessSuperVoxels (vis::StructuredGridVolume* vol);
+  // If cache is given, the packed pyramid is stored as (dataset, "supervoxels")
+  //   and reused by the next renderers built for the same dataset. If
+  //   disk_cache is given, it is also kept between launches.
+  void PreProcessSuperVoxels (vis::StructuredGridVolume* vol, vis::DataCache* cache = nullptr, std::string dataset = "",
+                              vis::DiskCache* disk_cache = nullptr);
 
   double GaussianEvaluation (double x, double mean, double stddev);
   double OpacityGaussianEvaluation (double mean, double stddev, vis::StructuredGridVolume* vol, vis::TransferFunction* tf);
 
   void PreProcessPreIntegrationTable (vis::StructuredGridVolume* vol, vis::TransferFunction* tf);
+  // After an edit of the opacities of tf in the normalized densities
+  //   [nmin, nmax]: only the terms of the changed densities are added again
+  //   to the weighted sums of the table. False if there is no table.
+  bool UpdatePreIntegrationTable (vis::StructuredGridVolume* vol, vis::TransferFunction* tf, double nmin, double nmax);
 
   bool use_glsl_to_precompute_data;
   gl::Texture3D* glsl_supervoxel_meanstddev;
@@ -97,9 +110,41 @@ public:
   };
   std::vector<SuperVoxelLevel*> tree_spr_voxel;
 
+  // Mean and standard deviation of each level, packed as the RG texture data
+  class SuperVoxelPyramid
+  {
+  public:
+    std::vector<glm::ivec3> dims;
+    std::vector<std::vector<GLfloat>> mean_stddev;
+    double max_stddev;
+
+    size_t GetSizeBytes ()
+    {
+      size_t bytes = 0;
+      for (int i = 0; i < mean_stddev.size(); i++)
+        bytes += mean_stddev[i].size() * sizeof(GLfloat);
+      return bytes;
+    }
+
+    // |n_levels max_stddev |for each level: dim.x dim.y dim.z mean_stddev[]
+    std::vector<unsigned char> Serialize ();
+    bool Deserialize (const std::vector<unsigned char>& payload);
+  };
+
 protected:
 
 private:
+  // Builds tree_spr_voxel and packs it into pyramid
+  void BuildSuperVoxelPyramid (vis::StructuredGridVolume* vol, SuperVoxelPyramid* pyramid);
+  // Uploads the pre-integration table from the sums below
+  void SetPreIntegrationTableData ();
+
+  // Opacity of each density, and weighted sum of the opacities and of the
+  //   weights of each entry of the pre-integration table (mean + stddev * w)
+  std::vector<double> preint_opacity;
+  std::vector<double> preint_sum_g;
+  std::vector<double> preint_sum_w;
+  int preint_w, preint_h;
   gl::Texture3D* GLSLPreComputeSuperVoxels();
   gl::Texture2D* GLSLPreComputePreIntegrationTable();
 };
@@ -91,7 +91,10 @@ bool RC1PVoxelConeTracingSGPU::Init (int swidth, int sheight)
   m_glsl_transfer_function = m_ext_data_manager->GetCurrentTransferFunction()->GenerateTexture_1D_RGBt();
 
   // Pre Processing stage to compute supervoxels and preintegration table
-  pre_processing.PreProcessSuperVoxels(m_ext_data_manager->GetCurrentStructuredVolume());
+  pre_processing.PreProcessSuperVoxels(m_ext_data_manager->GetCurrentStructuredVolume(),
+                                       m_ext_data_manager->GetDataCache(),
+                                       m_ext_data_manager->GetCurrentVolumeCacheKey(),
+                                       m_ext_data_manager->UseDiskCache() ? m_ext_data_manager->GetDiskCache() : nullptr);
   pre_processing.PreProcessPreIntegrationTable(m_ext_data_manager->GetCurrentStructuredVolume(), m_ext_data_manager->GetCurrentTransferFunction());
 
   m_pre_illum_str_vol.GenerateLightCacheTexture();
@@ -121,6 +124,24 @@ bool RC1PVoxelConeTracingSGPU::Init (int swidth, int sheight)
   return true;
 }
 
+bool RC1PVoxelConeTracingSGPU::UpdateTransferFunction ()
+{
+  if (!IsBuilt()) return false;
+
+  vis::TransferFunction* tf = m_ext_data_manager->GetCurrentTransferFunction();
+  if (m_glsl_transfer_function) delete m_glsl_transfer_function;
+  m_glsl_transfer_function = tf->GenerateTexture_1D_RGBt();
+
+  // the supervoxels only depend on the volume
+  double nmin, nmax;
+  if (tf->GetDirtyOpacityInterval(&nmin, &nmax)
+   && !pre_processing.UpdatePreIntegrationTable(m_ext_data_manager->GetCurrentStructuredVolume(), tf, nmin, nmax))
+    return false;
+
+  SetOutdated();
+  return true;
+}
+
 bool RC1PVoxelConeTracingSGPU::Update (vis::Camera* camera)
 {
   if (m_pre_illum_str_vol.IsActive())
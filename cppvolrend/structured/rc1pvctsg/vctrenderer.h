@@ -59,6 +59,7 @@ public:
   virtual void ReloadShaders ();
 
   virtual bool Init (int shader_width, int shader_height);
+  virtual bool UpdateTransferFunction ();
   virtual bool Update (vis::Camera* camera);
   virtual void Redraw ();
   virtual void MultiSampleRedraw ();
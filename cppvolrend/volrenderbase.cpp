@@ -83,6 +83,16 @@ void BaseVolumeRenderer::PrepareRender (vis::Camera* camera)
   }
 }
 
+bool BaseVolumeRenderer::UpdateVolumeData ()
+{
+  return false;
+}
+
+bool BaseVolumeRenderer::UpdateTransferFunction ()
+{
+  return false;
+}
+
 void BaseVolumeRenderer::SetOutdated ()
 {
   vr_outdated = true;
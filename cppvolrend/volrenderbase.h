@@ -45,6 +45,13 @@ public:
   virtual void ReloadShaders ();
   
   virtual bool Init (int shader_width, int shader_height) = 0;
+  // The voxels of the current volume changed, but not its size (next
+  //   timestep of a sequence). Returns false if Init must be called again,
+  //   which is the default for renderers with data derived from the voxels.
+  virtual bool UpdateVolumeData ();
+  // The current transfer function was edited, see its dirty intervals.
+  //   Returns false if Init must be called again (default).
+  virtual bool UpdateTransferFunction ();
   virtual bool Update (vis::Camera* camera) = 0;
   virtual void Redraw ();
   virtual void MultiSampleRedraw ();
@@ -0,0 +1,161 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile ()
+#ifdef _WIN32
+  : m_file_handle(INVALID_HANDLE_VALUE)
+  , m_mapping_handle(NULL)
+#else
+  : m_file_descriptor(-1)
+#endif
+  , m_view(nullptr)
+  , m_view_size(0)
+  , m_view_offset(0)
+  , m_data_size(0)
+{
+}
+
+MappedFile::~MappedFile ()
+{
+  Close();
+}
+
+bool MappedFile::Open (std::string filename, size_t offset, size_t length)
+{
+  Close();
+  m_filename = filename;
+
+  size_t file_size = MappedFile::GetFileSize(filename);
+  if (file_size == 0 || offset >= file_size)
+  {
+    std::cout << "MappedFile: invalid file or offset " << filename << std::endl;
+    return false;
+  }
+  if (length == 0) length = file_size - offset;
+  if (offset + length > file_size)
+  {
+    std::cout << "MappedFile: " << file_size << " bytes in file < " << offset + length << " bytes expected." << std::endl;
+    return false;
+  }
+
+#ifdef _WIN32
+  SYSTEM_INFO sys_info;
+  GetSystemInfo(&sys_info);
+  size_t granularity = (size_t)sys_info.dwAllocationGranularity;
+#else
+  size_t granularity = (size_t)sysconf(_SC_PAGE_SIZE);
+#endif
+  size_t aligned_offset = (offset / granularity) * granularity;
+  m_view_offset = offset - aligned_offset;
+  m_view_size = length + m_view_offset;
+
+#ifdef _WIN32
+  m_file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (m_file_handle == INVALID_HANDLE_VALUE)
+  {
+    std::cout << "MappedFile: opening file failed " << filename << std::endl;
+    return false;
+  }
+
+  m_mapping_handle = CreateFileMappingA((HANDLE)m_file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m_mapping_handle == NULL)
+  {
+    std::cout << "MappedFile: CreateFileMapping failed " << filename << std::endl;
+    Close();
+    return false;
+  }
+
+  unsigned long long off64 = (unsigned long long)aligned_offset;
+  m_view = MapViewOfFile((HANDLE)m_mapping_handle, FILE_MAP_READ,
+                         (DWORD)(off64 >> 32), (DWORD)(off64 & 0xFFFFFFFFull), m_view_size);
+  if (m_view == NULL)
+  {
+    std::cout << "MappedFile: MapViewOfFile failed " << filename << std::endl;
+    m_view = nullptr;
+    Close();
+    return false;
+  }
+#else
+  m_file_descriptor = open(filename.c_str(), O_RDONLY);
+  if (m_file_descriptor < 0)
+  {
+    std::cout << "MappedFile: opening file failed " << filename << std::endl;
+    return false;
+  }
+
+  void* view = mmap(nullptr, m_view_size, PROT_READ, MAP_PRIVATE, m_file_descriptor, (off_t)aligned_offset);
+  if (view == MAP_FAILED)
+  {
+    std::cout << "MappedFile: mmap failed " << filename << std::endl;
+    Close();
+    return false;
+  }
+  m_view = view;
+#endif
+
+  m_data_size = length;
+  return true;
+}
+
+void MappedFile::Close ()
+{
+#ifdef _WIN32
+  if (m_view) UnmapViewOfFile(m_view);
+  if (m_mapping_handle) CloseHandle((HANDLE)m_mapping_handle);
+  if (m_file_handle != INVALID_HANDLE_VALUE) CloseHandle((HANDLE)m_file_handle);
+  m_mapping_handle = NULL;
+  m_file_handle = INVALID_HANDLE_VALUE;
+#else
+  if (m_view) munmap(m_view, m_view_size);
+  if (m_file_descriptor >= 0) close(m_file_descriptor);
+  m_file_descriptor = -1;
+#endif
+  m_view = nullptr;
+  m_view_size = 0;
+  m_view_offset = 0;
+  m_data_size = 0;
+}
+
+void* MappedFile::GetData ()
+{
+  if (!m_view) return nullptr;
+  return static_cast<unsigned char*>(m_view) + m_view_offset;
+}
+
+size_t MappedFile::GetSize ()
+{
+  return m_data_size;
+}
+
+bool MappedFile::IsOpen ()
+{
+  return (m_view != nullptr);
+}
+
+size_t MappedFile::GetFileSize (std::string filename)
+{
+#ifdef _WIN32
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &fad)) return 0;
+  return (size_t)(((unsigned long long)fad.nFileSizeHigh << 32) | fad.nFileSizeLow);
+#else
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) return 0;
+  return (size_t)st.st_size;
+#endif
+}
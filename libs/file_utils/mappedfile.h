@@ -0,0 +1,52 @@
+/**
+ * Read-only memory mapped view of a file region.
+ *
+ * The region [offset, offset + length) is mapped directly into the address
+ *   space of the process, so voxels are only paged in from disk when they are
+ *   touched. Writing through the returned pointer is not allowed.
+ *
+ * Windows: CreateFileMapping/MapViewOfFile
+ * POSIX  : mmap
+**/
+#ifndef FILE_UTILS_MAPPED_FILE_H
+#define FILE_UTILS_MAPPED_FILE_H
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+class MappedFile
+{
+public:
+  MappedFile ();
+  ~MappedFile ();
+
+  // length = 0 maps from offset until the end of the file
+  bool Open (std::string filename, size_t offset = 0, size_t length = 0);
+  void Close ();
+
+  void* GetData ();
+  size_t GetSize ();
+  bool IsOpen ();
+
+  static size_t GetFileSize (std::string filename);
+
+private:
+  std::string m_filename;
+
+#ifdef _WIN32
+  void* m_file_handle;
+  void* m_mapping_handle;
+#else
+  int m_file_descriptor;
+#endif
+
+  // Mapped views must start at a multiple of the allocation granularity,
+  //   so the requested offset may be placed inside the view.
+  void* m_view;
+  size_t m_view_size;
+  size_t m_view_offset;
+  size_t m_data_size;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "positionedfile.h"
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Largest request of a single system call (ReadFile takes a DWORD)
+static const size_t MAX_READ_BYTES = size_t(1) << 30;
+
+PositionedFile::PositionedFile ()
+#ifdef _WIN32
+  : m_file_handle(INVALID_HANDLE_VALUE)
+#else
+  : m_file_descriptor(-1)
+#endif
+  , m_file_size(0)
+{
+}
+
+PositionedFile::~PositionedFile ()
+{
+  Close();
+}
+
+bool PositionedFile::Open (std::string filename)
+{
+  Close();
+  m_filename = filename;
+  m_file_size = MappedFile::GetFileSize(filename);
+
+#ifdef _WIN32
+  m_file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (m_file_handle == INVALID_HANDLE_VALUE)
+  {
+    std::cout << "PositionedFile: opening file failed " << filename << std::endl;
+    return false;
+  }
+#else
+  m_file_descriptor = open(filename.c_str(), O_RDONLY);
+  if (m_file_descriptor < 0)
+  {
+    std::cout << "PositionedFile: opening file failed " << filename << std::endl;
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+void PositionedFile::Close ()
+{
+#ifdef _WIN32
+  if (m_file_handle != INVALID_HANDLE_VALUE) CloseHandle((HANDLE)m_file_handle);
+  m_file_handle = INVALID_HANDLE_VALUE;
+#else
+  if (m_file_descriptor >= 0) close(m_file_descriptor);
+  m_file_descriptor = -1;
+#endif
+  m_file_size = 0;
+}
+
+bool PositionedFile::IsOpen ()
+{
+#ifdef _WIN32
+  return (m_file_handle != INVALID_HANDLE_VALUE);
+#else
+  return (m_file_descriptor >= 0);
+#endif
+}
+
+size_t PositionedFile::GetSize ()
+{
+  return m_file_size;
+}
+
+bool PositionedFile::ReadAt (size_t offset, void* data, size_t bytes)
+{
+  if (!IsOpen() || offset + bytes > m_file_size) return false;
+
+  unsigned char* dst = static_cast<unsigned char*>(data);
+  while (bytes > 0)
+  {
+    size_t request = bytes < MAX_READ_BYTES ? bytes : MAX_READ_BYTES;
+    size_t n_read = 0;
+
+#ifdef _WIN32
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    unsigned long long off64 = (unsigned long long)offset;
+    overlapped.Offset = (DWORD)(off64 & 0xFFFFFFFFull);
+    overlapped.OffsetHigh = (DWORD)(off64 >> 32);
+
+    DWORD dw_read = 0;
+    if (!ReadFile((HANDLE)m_file_handle, dst, (DWORD)request, &dw_read, &overlapped))
+      return false;
+    n_read = (size_t)dw_read;
+#else
+    ssize_t r = pread(m_file_descriptor, dst, request, (off_t)offset);
+    if (r < 0) return false;
+    n_read = (size_t)r;
+#endif
+
+    // unexpected end of file
+    if (n_read == 0) return false;
+
+    dst += n_read;
+    offset += n_read;
+    bytes -= n_read;
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+/**
+ * Read-only file accessed with positioned reads.
+ *
+ * ReadAt does not move a shared file pointer, so several threads can read
+ *   different regions of the same file at the same time without locking.
+ *
+ * Windows: ReadFile with an OVERLAPPED offset
+ * POSIX  : pread
+**/
+#ifndef FILE_UTILS_POSITIONED_FILE_H
+#define FILE_UTILS_POSITIONED_FILE_H
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+class PositionedFile
+{
+public:
+  PositionedFile ();
+  ~PositionedFile ();
+
+  bool Open (std::string filename);
+  void Close ();
+  bool IsOpen ();
+
+  size_t GetSize ();
+
+  // Reads bytes from offset into data. Thread safe. False if the file ends
+  //   before offset + bytes.
+  bool ReadAt (size_t offset, void* data, size_t bytes);
+
+private:
+  std::string m_filename;
+
+#ifdef _WIN32
+  void* m_file_handle;
+#else
+  int m_file_descriptor;
+#endif
+
+  size_t m_file_size;
+};
+
+#endif
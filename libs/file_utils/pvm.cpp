@@ -20,22 +20,109 @@
 
 #define DDS_RL (7)
 
+////////////////////////////////////
+// DDSChunkReader class methods
+////////////////////////////////////
+DDSChunkReader::DDSChunkReader (FILE* file, unsigned int chunk_size)
+  : m_file(file)
+  , m_chunk_size(4 * ((chunk_size + 3) / 4))
+  , m_bytes_read(0)
+  , m_finished(false)
+{
+  m_thread = std::thread(&DDSChunkReader::ReadLoop, this);
+}
+
+DDSChunkReader::~DDSChunkReader ()
+{
+  if (m_thread.joinable()) m_thread.join();
+}
+
+bool DDSChunkReader::NextChunk (unsigned char** chunk, unsigned int* size)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this] { return !m_chunks.empty() || m_finished; });
+  if (m_chunks.empty()) return false;
+
+  m_current = std::move(m_chunks.front());
+  m_chunks.pop_front();
+
+  *chunk = m_current.data();
+  *size = (unsigned int)m_current.size();
+  return true;
+}
+
+unsigned int DDSChunkReader::GetBytesRead ()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_bytes_read;
+}
+
+void DDSChunkReader::ReadLoop ()
+{
+  size_t n;
+  do
+  {
+    // zero initialized, so the 4 bytes padding of the last chunk is free
+    std::vector<unsigned char> chunk(m_chunk_size, 0);
+    n = fread(chunk.data(), 1, m_chunk_size, m_file);
+    if (n > 0)
+    {
+      chunk.resize(4 * ((n + 3) / 4));
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_chunks.push_back(std::move(chunk));
+      m_bytes_read += (unsigned int)n;
+      m_cond.notify_one();
+    }
+  } while (n == m_chunk_size);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_finished = true;
+  m_cond.notify_one();
+}
+
 Pvm::Pvm (const char *file_name)
+  : pvm_data(nullptr)
+  , width(0), height(0), depth(0)
+  , scalex(1.0f), scaley(1.0f), scalez(1.0f)
+  , components(0)
 {
   std::string filename(file_name);
 
   DDSV3 ddsloader;
-  unsigned char* raw = ddsloader.readPVMvolume(filename.c_str(),
-                                               &width, &height, &depth,
-                                               &components,
-                                               &scalex, &scaley, &scalez);
-  
+  unsigned int bytes, skip, block;
+  unsigned char* raw = ddsloader.readDDSstream(filename.c_str(), &bytes, &skip, &block);
+  if (raw == NULL)
+  {
+    printf("Error on reading %s\n", filename.c_str());
+    return;
+  }
+
+  // The header is interleaved together with the voxels
+  unsigned int header_bytes = glm::min(bytes, (unsigned int)4096);
+  std::vector<unsigned char> header(header_bytes + 1);
+  for (unsigned int j = 0; j < header_bytes; j++)
+    header[j] = raw[DDSV3::DDS_streamindex(j, bytes, skip, block)];
+  header[header_bytes] = '\0';
+
+  unsigned int offset;
+  if (!ddsloader.readPVMheader(header.data(), header_bytes,
+                               &width, &height, &depth,
+                               &components,
+                               &scalex, &scaley, &scalez, &offset))
+  {
+    printf("Error on reading %s: not a .pvm volume\n", filename.c_str());
+    free(raw);
+    return;
+  }
+  if ((size_t)offset + (size_t)width * height * depth * components > bytes) ERRORMSG();
+
   printf("Sizes: [%d %d %d]\n", width, height, depth);
   printf("Scale: [%.4f %.4f %.4f]\n", scalex, scaley, scalez);
   printf("Components: %d\n", components);
 
-  pvm_data = PostProcessData(raw);
-  
+  pvm_data = PostProcessData(raw, bytes, skip, block, offset);
+
   free(raw);
 }
 
@@ -51,6 +138,13 @@ void* Pvm::GetData ()
   return pvm_data;
 }
 
+void* Pvm::ReleaseData ()
+{
+  void* data = pvm_data;
+  pvm_data = nullptr;
+  return data;
+}
+
 void Pvm::GetDimensions (unsigned int* _width, unsigned int* _height, unsigned int* _depth)
 {
   *_width  = width;
@@ -77,30 +171,39 @@ int Pvm::GetComponents ()
   return components;
 }
 
-void* Pvm::PostProcessData (unsigned char* data)
+void* Pvm::PostProcessData (unsigned char* data, unsigned int bytes,
+                            unsigned int skip, unsigned int block, unsigned int offset)
 {
-  int v_array_size = width * height * depth;
+  size_t slice_size = (size_t)width * (size_t)height;
+  size_t v_array_size = slice_size * depth;
   if(components == 1)
   {
     unsigned char* prc_data = new unsigned char[v_array_size];
-    for (int i = 0; i < width * height * depth; i++)
-      prc_data[i] = data[i];
+    if (skip <= 1)
+    {
+      memcpy(prc_data, data + offset, v_array_size);
+      return prc_data;
+    }
+#pragma omp parallel for
+    for (int z = 0; z < (int)depth; z++)
+    {
+      for (size_t i = z * slice_size; i < (z + 1) * slice_size; i++)
+        prc_data[i] = data[DDSV3::DDS_streamindex(offset + i, bytes, skip, block)];
+    }
     return prc_data;
   }
   else if(components == 2)
   {
     unsigned short* prc_data = new unsigned short[v_array_size];
-    unsigned short vl = 256;
-    for (int i = 0; i < width * height * depth; i++)
+#pragma omp parallel for
+    for (int z = 0; z < (int)depth; z++)
     {
-      unsigned short v1 = data[(i * 2)];
-      unsigned short v2 = data[(i * 2) + 1];
-      
-      prc_data[i] = 
-        //((v2 << 8) | v1)
-        ((v2 * vl) + v1)
-      ;
-      assert(((v2 * vl) + v1) == ((v2 << 8) | v1));
+      for (size_t i = z * slice_size; i < (z + 1) * slice_size; i++)
+      {
+        unsigned short v1 = data[DDSV3::DDS_streamindex(offset + (i * 2), bytes, skip, block)];
+        unsigned short v2 = data[DDSV3::DDS_streamindex(offset + (i * 2) + 1, bytes, skip, block)];
+        prc_data[i] = ((v2 << 8) | v1);
+      }
     }
     return prc_data;
   }
@@ -205,8 +308,6 @@ unsigned char* DDSV3::readPVMvolume (const char* filename,
 
   unsigned char* volume;
 
-  float sx = 1.0f, sy = 1.0f, sz = 1.0f;
-
   unsigned int len1 = 0, len2 = 0, len3 = 0, len4 = 0;
 
   if ((data = readDDSfile(filename, &bytes)) == NULL)
@@ -217,42 +318,13 @@ unsigned char* DDSV3::readPVMvolume (const char* filename,
   if ((data = (unsigned char*)realloc(data, bytes + 1)) == NULL) ERRORMSG();
   data[bytes] = '\0';
 
-  if (strncmp((char*)data, "PVM\n", 4) != 0)
-  {
-    if (strncmp((char*)data, "PVM2\n", 5) == 0) version = 2;
-    else if (strncmp((char*)data, "PVM3\n", 5) == 0) version = 3;
-    else return(NULL);
-
-    ptr = &data[5];
-    if (sscanf_s((char*)ptr, "%d %d %d\n%g %g %g\n", width, height, depth, &sx, &sy, &sz) != 6) ERRORMSG();
-    if (*width < 1 || *height < 1 || *depth < 1 || sx <= 0.0f || sy <= 0.0f || sz <= 0.0f) ERRORMSG();
-    ptr = (unsigned char*)strchr((char*)ptr, '\n') + 1;
-  }
-  else
-  {
-    ptr = &data[4];
-    while (*ptr == '#')
-      while (*ptr++ != '\n');
-
-    if (sscanf_s((char*)ptr, "%d %d %d\n", width, height, depth) != 3) ERRORMSG();
-    if (*width < 1 || *height < 1 || *depth < 1) ERRORMSG();
-  }
-
-  if (scalex != NULL && scaley != NULL && scalez != NULL)
-  {
-    *scalex = sx;
-    *scaley = sy;
-    *scalez = sz;
-  }
-
-  ptr = (unsigned char*)strchr((char*)ptr, '\n') + 1;
-  if (sscanf_s((char *)ptr, "%d\n", &numc) != 1) ERRORMSG();
-  if (numc<1) ERRORMSG();
-
+  unsigned int offset;
+  if (!readPVMheader(data, bytes, width, height, depth, &numc, scalex, scaley, scalez, &offset)) return(NULL);
   if (components != NULL) *components = numc;
   else if (numc != 1) ERRORMSG();
 
-  ptr = (unsigned char*)strchr((char*)ptr, '\n') + 1;
+  if (strncmp((char*)data, "PVM3\n", 5) == 0) version = 3;
+  ptr = data + offset;
   if (version == 3) len1 = strlen((char*)(ptr + (*width)*(*height)*(*depth)*numc)) + 1;
   if (version == 3) len2 = strlen((char*)(ptr + (*width)*(*height)*(*depth)*numc + len1)) + 1;
   if (version == 3) len3 = strlen((char*)(ptr + (*width)*(*height)*(*depth)*numc + len1 + len2)) + 1;
@@ -307,6 +379,57 @@ unsigned char* DDSV3::readPVMvolume (const char* filename,
   return(volume);
 }
 
+// parse the ascii header of a PVM volume
+bool DDSV3::readPVMheader (unsigned char* data, unsigned int bytes,
+                           unsigned int* width, unsigned int* height, unsigned int* depth,
+                           unsigned int* components,
+                           float* scalex, float* scaley, float* scalez,
+                           unsigned int* offset)
+{
+  unsigned char* ptr;
+  unsigned int numc;
+
+  float sx = 1.0f, sy = 1.0f, sz = 1.0f;
+
+  if (bytes<5) return(false);
+
+  if (strncmp((char*)data, "PVM\n", 4) != 0)
+  {
+    if (strncmp((char*)data, "PVM2\n", 5) != 0 && strncmp((char*)data, "PVM3\n", 5) != 0) return(false);
+
+    ptr = &data[5];
+    if (sscanf_s((char*)ptr, "%d %d %d\n%g %g %g\n", width, height, depth, &sx, &sy, &sz) != 6) ERRORMSG();
+    if (*width < 1 || *height < 1 || *depth < 1 || sx <= 0.0f || sy <= 0.0f || sz <= 0.0f) ERRORMSG();
+    ptr = (unsigned char*)strchr((char*)ptr, '\n') + 1;
+  }
+  else
+  {
+    ptr = &data[4];
+    while (*ptr == '#')
+      while (*ptr++ != '\n');
+
+    if (sscanf_s((char*)ptr, "%d %d %d\n", width, height, depth) != 3) ERRORMSG();
+    if (*width < 1 || *height < 1 || *depth < 1) ERRORMSG();
+  }
+
+  if (scalex != NULL && scaley != NULL && scalez != NULL)
+  {
+    *scalex = sx;
+    *scaley = sy;
+    *scalez = sz;
+  }
+
+  ptr = (unsigned char*)strchr((char*)ptr, '\n') + 1;
+  if (sscanf_s((char *)ptr, "%d\n", &numc) != 1) ERRORMSG();
+  if (numc<1) ERRORMSG();
+  *components = numc;
+
+  ptr = (unsigned char*)strchr((char*)ptr, '\n') + 1;
+  *offset = (unsigned int)(ptr - data);
+
+  return(true);
+}
+
 // read a possibly compressed PNM image
 unsigned char* DDSV3::readPNMimage (const char* filename,
                                     unsigned int* width,
@@ -383,28 +506,47 @@ void DDSV3::DDS_decode (unsigned char* chunk, unsigned int size,
                         unsigned char** data, unsigned int* bytes,
                         unsigned int block)
 {
-  unsigned int skip, strip;
-
-  unsigned char *ptr1, *ptr2;
-
-  unsigned int cnt, cnt1, cnt2;
-  int bits, act;
+  unsigned int skip;
 
   DDS_initbuffer();
 
   DDS_clearbits();
   DDS_loadbits(chunk, size);
 
-  skip = DDS_readbits(2) + 1;
+  DDS_decodebits(data, bytes, &skip);
+
+  DDS_interleave(*data, *bytes, skip, block);
+}
+
+// decode the bits of a Differential Data Stream
+void DDSV3::DDS_decodebits (unsigned char** data, unsigned int* bytes, unsigned int* skip)
+{
+  unsigned int strip;
+
+  unsigned char *ptr1, *ptr2;
+
+  unsigned int cnt, cnt1, cnt2, capacity;
+  int bits, act;
+
+  *skip = DDS_readbits(2) + 1;
   strip = DDS_readbits(16) + 1;
 
   ptr1 = ptr2 = NULL;
   cnt = act = 0;
+  capacity = 0;
 
   while ((cnt1 = DDS_readbits(DDS_RL)) != 0)
   {
     bits = DDS_decode(DDS_readbits(3));
 
+    // grow the output geometrically, instead of one block at a time
+    if (cnt + cnt1 > capacity)
+    {
+      capacity = (capacity == 0) ? DDS_BLOCKSIZE : 2 * capacity;
+      if ((ptr1 = (unsigned char*)realloc(ptr1, capacity)) == NULL) MEMERROR();
+      ptr2 = &ptr1[cnt];
+    }
+
     for (cnt2 = 0; cnt2<cnt1; cnt2++)
     {
       if (strip == 1 || cnt <= strip) act += DDS_readbits(bits) - (1 << bits) / 2;
@@ -413,19 +555,6 @@ void DDSV3::DDS_decode (unsigned char* chunk, unsigned int size,
       while (act<0) act += 256;
       while (act>255) act -= 256;
 
-      if ((cnt&(DDS_BLOCKSIZE - 1)) == 0) {
-        if (ptr1 == NULL)
-        {
-          if ((ptr1 = (unsigned char*)malloc(DDS_BLOCKSIZE)) == NULL) MEMERROR();
-          ptr2 = ptr1;
-        }
-        else
-        {
-          if ((ptr1 = (unsigned char*)realloc(ptr1, cnt + DDS_BLOCKSIZE)) == NULL) MEMERROR();
-          ptr2 = &ptr1[cnt];
-        }
-      }
-
       *ptr2++ = act;
       cnt++;
     }
@@ -434,8 +563,6 @@ void DDSV3::DDS_decode (unsigned char* chunk, unsigned int size,
   if (ptr1 != NULL)
     if ((ptr1 = (uint8_t *)realloc(ptr1, cnt)) == NULL) MEMERROR();
 
-  DDS_interleave(ptr1, cnt, skip, block);
-
   *data = ptr1;
   *bytes = cnt;
 }
@@ -570,6 +697,57 @@ unsigned char* DDSV3::readDDSfile (const char *filename, unsigned int *bytes)
   return(data);
 }
 
+// read and decode a Differential Data Stream, overlapping file reads and decoding
+unsigned char* DDSV3::readDDSstream (const char *filename, unsigned int *bytes,
+                                     unsigned int *skip, unsigned int *block)
+{
+  FILE *file;
+  errno_t err;
+
+  char id[8];
+  int version = 0;
+
+  unsigned char *data = NULL;
+
+  if ((err = fopen_s(&file, filename, "rb")) != 0) return(NULL);
+
+  if (fread(id, 1, 8, file) == 8)
+  {
+    if (strncmp(id, DDS_ID, 8) == 0) version = 1;
+    else if (strncmp(id, DDS_ID2, 8) == 0) version = 2;
+  }
+
+  // not compressed
+  if (version == 0)
+  {
+    rewind(file);
+    data = readRAWfiled(file, bytes);
+    fclose(file);
+
+    *skip = 1;
+    *block = 0;
+    return(data);
+  }
+
+  {
+    DDSChunkReader reader(file, DDS_BLOCKSIZE);
+
+    DDS_initbuffer();
+    DDS_clearbits();
+
+    DDS_reader = &reader;
+    DDS_decodebits(&data, bytes, skip);
+    DDS_reader = NULL;
+
+    DDS_clearbits();
+  }
+
+  fclose(file);
+
+  *block = (version == 1) ? 0 : DDS_INTERLEAVE;
+  return(data);
+}
+
 // read from a RAW file
 unsigned char* DDSV3::readRAWfiled (FILE *file, unsigned int *bytes)
 {
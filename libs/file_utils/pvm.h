@@ -82,6 +82,12 @@ APPENDIX (B) PVM VOLUME FORMAT DESCRIPTION
 
 #include <cmath>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 // TODO: ByteOrder
 // Get the scale of the volume
 class Pvm
@@ -103,6 +109,9 @@ public:
   ~Pvm ();
 
   void* GetData ();
+  // Give the ownership of the voxel array (new[] allocated, unsigned char or
+  //   unsigned short) to the caller, avoiding another copy of the volume
+  void* ReleaseData ();
 
   void GetDimensions (unsigned int* width, unsigned int* height, unsigned int* depth);
   void GetScale (double* sx, double* sy, double* sz);
@@ -130,7 +139,10 @@ protected:
 private:
   // TODO: big endian and little endian. Only Big endian right now.
   // TODO: Convertion between data size? 8 -> 16 bits and 16 -> 8 bits.
-  void* PostProcessData (unsigned char* data);
+  // Deinterleave the decoded DDS stream and build the 8/16 bits voxel array
+  //   in a single parallel pass
+  void* PostProcessData (unsigned char* data, unsigned int bytes,
+                         unsigned int skip, unsigned int block, unsigned int offset);
 };
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -147,6 +159,35 @@ private:
 #define MEMERROR() DDSV3::errormsg(__FILE__,__LINE__)
 #define IOERROR() DDSV3::errormsg(__FILE__,__LINE__)
 
+// Reads a file in fixed size chunks on a background thread, so the DDS bit
+//   decoding can start before the whole file is in memory
+class DDSChunkReader
+{
+public:
+  DDSChunkReader (FILE* file, unsigned int chunk_size);
+  ~DDSChunkReader ();
+
+  // Blocks until the next chunk is available. Returns false at the end of the
+  //   file. Chunk sizes are padded with zeros to a multiple of 4 bytes.
+  bool NextChunk (unsigned char** chunk, unsigned int* size);
+
+  unsigned int GetBytesRead ();
+
+private:
+  void ReadLoop ();
+
+  FILE* m_file;
+  unsigned int m_chunk_size;
+  unsigned int m_bytes_read;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<std::vector<unsigned char>> m_chunks;
+  std::vector<unsigned char> m_current;
+  bool m_finished;
+};
+
 
 
 class DDSV3
@@ -170,6 +211,36 @@ public:
                                unsigned int *height,
                                unsigned int *components);
 
+  // Parse a PVM header from data, offset returns the first byte of the voxels.
+  //   Returns false if data does not start with a PVM magic identifier.
+  bool readPVMheader (unsigned char* data, unsigned int bytes,
+                      unsigned int* width, unsigned int* height, unsigned int* depth,
+                      unsigned int* components,
+                      float* scalex, float* scaley, float* scalez,
+                      unsigned int* offset);
+
+  // Read and decode a DDS file while it is being read from disk. The returned
+  //   stream is still interleaved: use DDS_streamindex to locate each byte.
+  //   Uncompressed files are returned as is, with skip = 1.
+  unsigned char* readDDSstream (const char *filename, unsigned int *bytes,
+                                unsigned int *skip, unsigned int *block);
+
+  // Position inside an interleaved stream of the j-th deinterleaved byte
+  static inline size_t DDS_streamindex (size_t j, size_t bytes, size_t skip, size_t block)
+  {
+    if (skip <= 1) return j;
+
+    size_t block_bytes = (block == 0) ? bytes : skip * block;
+    size_t base = (j / block_bytes) * block_bytes;
+    size_t len = (bytes - base < block_bytes) ? bytes - base : block_bytes;
+    size_t r = j - base;
+    size_t i = r % skip;
+
+    // bytes i, i + skip, i + 2*skip... are stored contiguously, after the
+    //   ones of the lower channels
+    return base + i * (len / skip) + ((i < len % skip) ? i : len % skip) + r / skip;
+  }
+
   // helper functions for DDS:
   static inline void errormsg (const char *file, int line)
   {
@@ -257,7 +328,7 @@ public:
     {
       value = DDSV3::DDS_shiftl(DDS_buffer, bits - DDS_bufsize);
 
-      if (DDS_cachepos >= DDS_cachesize) DDS_buffer = 0;
+      if (DDS_cachepos >= DDS_cachesize && !DDS_nextchunk()) DDS_buffer = 0;
       else
       {
         DDS_buffer = *((unsigned int *)&DDS_cache[DDS_cachepos]);
@@ -274,6 +345,16 @@ public:
     return(value);
   }
 
+  // Continue reading bits from the next chunk of the attached stream reader
+  inline bool DDS_nextchunk ()
+  {
+    if (DDS_reader == NULL) return false;
+    DDS_cachepos = 0;
+    if (DDS_reader->NextChunk(&DDS_cache, &DDS_cachesize)) return true;
+    DDS_cachesize = 0;
+    return false;
+  }
+
   inline void DDS_loadbits (unsigned char* data, unsigned int size)
   {
     DDS_cache = data;
@@ -292,6 +373,9 @@ public:
                    unsigned char** data, unsigned int* bytes,
                    unsigned int block = 0);
 
+  // Decode the bits already loaded (or streamed), without interleaving
+  void DDS_decodebits (unsigned char** data, unsigned int* bytes, unsigned int* skip);
+
   void DDS_interleave (unsigned char* data,
                        unsigned int bytes,
                        unsigned int skip,
@@ -315,6 +399,8 @@ public:
   unsigned int DDS_buffer;
   unsigned int DDS_bufsize;
 
+  DDSChunkReader* DDS_reader = NULL;
+
   unsigned short int DDS_INTEL = 1;
 protected:
   const char* DDS_ID = "DDS v3d\n";
@@ -0,0 +1,189 @@
+#include "sha256.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+  const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+  inline uint32_t RotateRight (uint32_t x, int n)
+  {
+    return (x >> n) | (x << (32 - n));
+  }
+}
+
+SHA256::SHA256 ()
+{
+  Reset();
+}
+
+void SHA256::Reset ()
+{
+  m_state[0] = 0x6a09e667; m_state[1] = 0xbb67ae85;
+  m_state[2] = 0x3c6ef372; m_state[3] = 0xa54ff53a;
+  m_state[4] = 0x510e527f; m_state[5] = 0x9b05688c;
+  m_state[6] = 0x1f83d9ab; m_state[7] = 0x5be0cd19;
+  m_block_size = 0;
+  m_total_bytes = 0;
+}
+
+void SHA256::Update (const void* data, size_t bytes)
+{
+  const unsigned char* in = static_cast<const unsigned char*>(data);
+  m_total_bytes += bytes;
+
+  // complete the pending block
+  if (m_block_size > 0)
+  {
+    size_t n = std::min(bytes, 64 - m_block_size);
+    memcpy(m_block + m_block_size, in, n);
+    m_block_size += n;
+    in += n;
+    bytes -= n;
+    if (m_block_size < 64) return;
+    Transform(m_block);
+    m_block_size = 0;
+  }
+
+  // full blocks are hashed straight from the input
+  while (bytes >= 64)
+  {
+    Transform(in);
+    in += 64;
+    bytes -= 64;
+  }
+
+  memcpy(m_block, in, bytes);
+  m_block_size = bytes;
+}
+
+void SHA256::Update (std::string str)
+{
+  Update(str.data(), str.size());
+}
+
+void SHA256::Final (unsigned char* digest)
+{
+  uint64_t total_bits = m_total_bytes * 8;
+
+  unsigned char padding[72] = { 0x80 };
+  size_t pad = (m_block_size < 56) ? (56 - m_block_size) : (120 - m_block_size);
+  for (int i = 0; i < 8; i++)
+    padding[pad + i] = (unsigned char)(total_bits >> (56 - 8 * i));
+  Update(padding, pad + 8);
+
+  for (int i = 0; i < 8; i++)
+  {
+    digest[i * 4 + 0] = (unsigned char)(m_state[i] >> 24);
+    digest[i * 4 + 1] = (unsigned char)(m_state[i] >> 16);
+    digest[i * 4 + 2] = (unsigned char)(m_state[i] >> 8);
+    digest[i * 4 + 3] = (unsigned char)(m_state[i]);
+  }
+}
+
+std::string SHA256::FinalHex ()
+{
+  unsigned char digest[DIGEST_SIZE];
+  Final(digest);
+  return ToHex(digest);
+}
+
+std::string SHA256::HexDigest (const void* data, size_t bytes)
+{
+  SHA256 sha;
+  sha.Update(data, bytes);
+  return sha.FinalHex();
+}
+
+std::string SHA256::HexDigest (std::string str)
+{
+  return HexDigest(str.data(), str.size());
+}
+
+std::string SHA256::ChunkedHexDigest (const void* data, size_t bytes, size_t chunk_size)
+{
+  const unsigned char* in = static_cast<const unsigned char*>(data);
+  int n_chunks = (int)((bytes + chunk_size - 1) / chunk_size);
+
+  std::vector<unsigned char> digests((size_t)n_chunks * DIGEST_SIZE);
+#pragma omp parallel for
+  for (int c = 0; c < n_chunks; c++)
+  {
+    size_t begin = (size_t)c * chunk_size;
+    size_t n = std::min(chunk_size, bytes - begin);
+
+    SHA256 sha;
+    sha.Update(in + begin, n);
+    sha.Final(&digests[(size_t)c * DIGEST_SIZE]);
+  }
+
+  return CombineChunkDigests(digests.data(), (size_t)n_chunks, bytes, chunk_size);
+}
+
+std::string SHA256::CombineChunkDigests (const unsigned char* digests, size_t n_chunks,
+                                         size_t bytes, size_t chunk_size)
+{
+  // the total size and the chunk size are part of the identity
+  SHA256 sha;
+  uint64_t sizes[2] = { (uint64_t)bytes, (uint64_t)chunk_size };
+  sha.Update(sizes, sizeof(sizes));
+  sha.Update(digests, n_chunks * DIGEST_SIZE);
+  return sha.FinalHex();
+}
+
+std::string SHA256::ToHex (const unsigned char* digest)
+{
+  static const char hex[] = "0123456789abcdef";
+  std::string str(DIGEST_SIZE * 2, '0');
+  for (int i = 0; i < DIGEST_SIZE; i++)
+  {
+    str[i * 2 + 0] = hex[digest[i] >> 4];
+    str[i * 2 + 1] = hex[digest[i] & 0xf];
+  }
+  return str;
+}
+
+void SHA256::Transform (const unsigned char* block)
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+  {
+    w[i] = ((uint32_t)block[i * 4 + 0] << 24) | ((uint32_t)block[i * 4 + 1] << 16)
+         | ((uint32_t)block[i * 4 + 2] << 8)  | ((uint32_t)block[i * 4 + 3]);
+  }
+  for (int i = 16; i < 64; i++)
+  {
+    uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+  uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+  for (int i = 0; i < 64; i++)
+  {
+    uint32_t S1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + S1 + ch + SHA256_K[i] + w[i];
+    uint32_t S0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = S0 + maj;
+
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+  m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+}
@@ -0,0 +1,51 @@
+/**
+ * SHA-256 (FIPS 180-4) digest, used to identify file contents and voxel data.
+ *
+ * ChunkedHexDigest hashes large buffers in parallel: each chunk is hashed on
+ *   its own and the digest of the concatenated chunk digests is returned. It
+ *   is a different value than the plain SHA-256 of the buffer, but it is just
+ *   as strong as a content identifier.
+**/
+#ifndef FILE_UTILS_SHA256_H
+#define FILE_UTILS_SHA256_H
+
+#include <cstdint>
+#include <string>
+
+class SHA256
+{
+public:
+  static const size_t DIGEST_SIZE = 32;
+  static const size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+  SHA256 ();
+
+  void Reset ();
+  void Update (const void* data, size_t bytes);
+  void Update (std::string str);
+  // Writes DIGEST_SIZE bytes to digest, the object must be Reset to be reused
+  void Final (unsigned char* digest);
+  std::string FinalHex ();
+
+  static std::string HexDigest (const void* data, size_t bytes);
+  static std::string HexDigest (std::string str);
+  static std::string ChunkedHexDigest (const void* data, size_t bytes,
+                                       size_t chunk_size = DEFAULT_CHUNK_SIZE);
+  // Final step of ChunkedHexDigest, for callers that hash the chunks
+  //   themselves: digests holds the DIGEST_SIZE bytes of each chunk in order
+  static std::string CombineChunkDigests (const unsigned char* digests, size_t n_chunks,
+                                          size_t bytes, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+  static std::string ToHex (const unsigned char* digest);
+
+protected:
+  void Transform (const unsigned char* block);
+
+private:
+  uint32_t m_state[8];
+  unsigned char m_block[64];
+  size_t m_block_size;
+  uint64_t m_total_bytes;
+};
+
+#endif
@@ -93,6 +93,23 @@ namespace gl
     return true;
   }
 
+  bool Texture3D::SetSubData (GLvoid* data, int x, int y, int z, int w, int h, int d, GLenum format, GLenum type)
+  {
+    if (m_textureID == -1)
+      return false;
+
+    gl::ExitOnGLError("gl::Texture3D: Before Texture3D SetSubData\n");
+
+    glBindTexture(GL_TEXTURE_3D, m_textureID);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, x, y, z, w, h, d, format, type, data);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    gl::ExitOnGLError("gl::Texture3D: After Texture3D SetSubData\n");
+    assert(glGetError() == GL_NO_ERROR);
+
+    return true;
+  }
+
   GLuint Texture3D::GetTextureID ()
   {
     return m_textureID;
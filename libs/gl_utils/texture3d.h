@@ -18,6 +18,9 @@ namespace gl
     , GLint wrap_s_param, GLint wrap_t_param, GLint wrap_r_param, bool generatemipmap = false);
 
     bool SetData (GLvoid* data, GLint internalformat, GLenum format, GLenum type);
+    // Replace the region [x, x + w) x [y, y + h) x [z, z + d) of a texture
+    //   whose storage was already allocated by SetData
+    bool SetSubData (GLvoid* data, int x, int y, int z, int w, int h, int d, GLenum format, GLenum type);
 
     GLuint GetTextureID ();
 
@@ -0,0 +1,279 @@
+#include "compactsummedareatable.h"
+
+namespace vis
+{
+  CompactSummedAreaTable3D::CompactSummedAreaTable3D ()
+    : w(0), h(0), d(0)
+    , m_tiles_x(0), m_tiles_y(0), m_tiles_z(0)
+    , m_bits(MAX_BITS), m_step(1.0)
+  {}
+
+  CompactSummedAreaTable3D::~CompactSummedAreaTable3D ()
+  {}
+
+  void CompactSummedAreaTable3D::Clear ()
+  {
+    w = h = d = 0;
+    m_tiles_x = m_tiles_y = m_tiles_z = 0;
+    m_step = 1.0;
+
+    std::vector<Tile>().swap(m_tiles);
+    std::vector<uint16_t>().swap(m_local_16);
+    std::vector<uint32_t>().swap(m_local_32);
+    std::vector<uint32_t>().swap(m_face_xy);
+    std::vector<uint32_t>().swap(m_face_xz);
+    std::vector<uint32_t>().swap(m_face_yz);
+    std::vector<uint64_t>().swap(m_edge_x);
+    std::vector<uint64_t>().swap(m_edge_y);
+    std::vector<uint64_t>().swap(m_edge_z);
+    std::vector<uint64_t>().swap(m_corner);
+  }
+
+  uint64_t CompactSummedAreaTable3D::GetFixedValue (int x, int y, int z) const
+  {
+    if (x < 0 || y < 0 || z < 0 || m_tiles.empty()) return 0;
+
+    if (x >= (int)w) x = w - 1;
+    if (y >= (int)h) y = h - 1;
+    if (z >= (int)d) z = d - 1;
+
+    size_t t = GetTileIndex(x >> TILE_LOG2, y >> TILE_LOG2, z >> TILE_LOG2);
+    int lx = x & (TILE_DIM - 1), ly = y & (TILE_DIM - 1), lz = z & (TILE_DIM - 1);
+
+    size_t t_edge = t * TILE_DIM;
+    size_t t_face = t * TILE_DIM * TILE_DIM;
+    uint64_t sum = m_corner[t]
+                 + m_edge_x[t_edge + lx] + m_edge_y[t_edge + ly] + m_edge_z[t_edge + lz]
+                 + m_face_xy[t_face + ly + lx * TILE_DIM]
+                 + m_face_xz[t_face + lz + lx * TILE_DIM]
+                 + m_face_yz[t_face + lz + ly * TILE_DIM];
+
+    const Tile& tile = m_tiles[t];
+    sum += uint64_t(tile.base) * uint64_t((lx + 1) * (ly + 1) * (lz + 1));
+    int l = lx + TILE_DIM * (ly + TILE_DIM * lz);
+    if (tile.storage == LOCAL_16_BITS)
+      sum += m_local_16[tile.local + l];
+    else if (tile.storage == LOCAL_32_BITS)
+      sum += m_local_32[tile.local + l];
+
+    return sum;
+  }
+
+  double CompactSummedAreaTable3D::GetValue (int x, int y, int z) const
+  {
+    return double(GetFixedValue(x, y, z)) * m_step;
+  }
+
+  uint32_t CompactSummedAreaTable3D::GetFixedVoxel (int x, int y, int z) const
+  {
+    const Tile& tile = m_tiles[GetTileIndex(x >> TILE_LOG2, y >> TILE_LOG2, z >> TILE_LOG2)];
+    if (tile.storage == LOCAL_CONSTANT) return tile.base;
+
+    // the local prefix sums only cover the tile, so the value is their
+    //   difference along x, y and z
+    int lx = x & (TILE_DIM - 1), ly = y & (TILE_DIM - 1), lz = z & (TILE_DIM - 1);
+    auto local = [&] (int ax, int ay, int az) -> uint32_t {
+      if (ax < 0 || ay < 0 || az < 0) return 0;
+      int l = ax + TILE_DIM * (ay + TILE_DIM * az);
+      return tile.storage == LOCAL_16_BITS ? uint32_t(m_local_16[tile.local + l]) : m_local_32[tile.local + l];
+    };
+    // unsigned arithmetic wraps around, the result is exact
+    uint32_t v = local(lx, ly, lz)
+               - local(lx - 1, ly, lz) - local(lx, ly - 1, lz) - local(lx, ly, lz - 1)
+               + local(lx - 1, ly - 1, lz) + local(lx - 1, ly, lz - 1) + local(lx, ly - 1, lz - 1)
+               - local(lx - 1, ly - 1, lz - 1);
+    return tile.base + v;
+  }
+
+  uint64_t CompactSummedAreaTable3D::GetFixedSum (int x0, int y0, int z0, int x1, int y1, int z1) const
+  {
+    // unsigned arithmetic wraps around, the result is exact
+    x0--; y0--; z0--;
+    return GetFixedValue(x1, y1, z1)
+         - GetFixedValue(x0, y1, z1) - GetFixedValue(x1, y0, z1) - GetFixedValue(x1, y1, z0)
+         + GetFixedValue(x0, y0, z1) + GetFixedValue(x0, y1, z0) + GetFixedValue(x1, y0, z0)
+         - GetFixedValue(x0, y0, z0);
+  }
+
+  double CompactSummedAreaTable3D::GetSum (int x0, int y0, int z0, int x1, int y1, int z1) const
+  {
+    return double(GetFixedSum(x0, y0, z0, x1, y1, z1)) * m_step;
+  }
+
+  double CompactSummedAreaTable3D::GetAverage (int x0, int y0, int z0, int x1, int y1, int z1) const
+  {
+    double n = double(x1 - x0 + 1) * double(y1 - y0 + 1) * double(z1 - z0 + 1);
+    if (n <= 0.0) return 0.0;
+    return GetSum(x0, y0, z0, x1, y1, z1) / n;
+  }
+
+  double CompactSummedAreaTable3D::GetTotal () const
+  {
+    return GetValue(w - 1, h - 1, d - 1);
+  }
+
+  double CompactSummedAreaTable3D::GetMean () const
+  {
+    if (m_tiles.empty()) return 0.0;
+    return GetTotal() / (double(w) * double(h) * double(d));
+  }
+
+  double CompactSummedAreaTable3D::GetMaximum () const
+  {
+    uint32_t top = 0;
+    for (size_t t = 0; t < m_tiles.size(); t++)
+      top = std::max(top, m_tiles[t].top);
+    return double(top) * m_step;
+  }
+
+  void CompactSummedAreaTable3D::GetFloatValues (float* values, double offset, int first_z) const
+  {
+    int iw = (int)w, ih = (int)h, id = (int)d;
+#pragma omp parallel for
+    for (int z = std::max(first_z, 0); z < id; z++)
+    {
+      for (int y = 0; y < ih; y++)
+      {
+        float* row = values + size_t(z) * size_t(w) * size_t(h) + size_t(y) * size_t(w);
+        double yz = double(y + 1) * double(z + 1);
+        for (int x = 0; x < iw; x++)
+          row[x] = float(double(GetFixedValue(x, y, z)) * m_step - offset * double(x + 1) * yz);
+      }
+    }
+  }
+
+  size_t CompactSummedAreaTable3D::GetSizeBytes () const
+  {
+    return m_tiles.size() * sizeof(Tile)
+         + m_local_16.size() * sizeof(uint16_t) + m_local_32.size() * sizeof(uint32_t)
+         + (m_face_xy.size() + m_face_xz.size() + m_face_yz.size()) * sizeof(uint32_t)
+         + (m_edge_x.size() + m_edge_y.size() + m_edge_z.size() + m_corner.size()) * sizeof(uint64_t);
+  }
+
+  void CompactSummedAreaTable3D::BuildSlab (int tz, const std::vector<uint32_t>& quantized,
+                                            const std::vector<uint64_t>& planes)
+  {
+    int iw = (int)w, ih = (int)h;
+    size_t plane_size = size_t(w) * size_t(h);
+    int n_slab_tiles = m_tiles_x * m_tiles_y;
+
+    // Sum of [0,x] x [0,y] of the SAT plane pz, clamped like GetFixedValue
+    auto plane_value = [&] (int x, int y, int pz) -> uint64_t {
+      if (x < 0 || y < 0) return 0;
+      if (x >= iw) x = iw - 1;
+      if (y >= ih) y = ih - 1;
+      return planes[plane_size * pz + size_t(y) * w + x];
+    };
+    // Sum of [xa,xb] x [ya,yb] of the plane pz
+    auto rect = [&] (int xa, int xb, int ya, int yb, int pz) -> uint64_t {
+      return plane_value(xb, yb, pz) - plane_value(xa - 1, yb, pz)
+           - plane_value(xb, ya - 1, pz) + plane_value(xa - 1, ya - 1, pz);
+    };
+
+    //////////////////////////////////////////////////////////////
+    // 1 - Base value and local storage of each tile
+#pragma omp parallel for
+    for (int i = 0; i < n_slab_tiles; i++)
+    {
+      int cx = (i % m_tiles_x) * TILE_DIM, cy = (i / m_tiles_x) * TILE_DIM;
+      bool partial = cx + TILE_DIM > iw || cy + TILE_DIM > ih;
+
+      uint32_t base = UINT32_MAX, top = 0;
+      uint64_t total = 0;
+      for (int lz = 0; lz < TILE_DIM; lz++)
+      {
+        for (int y = cy; y < std::min(cy + TILE_DIM, ih); y++)
+        {
+          const uint32_t* q = &quantized[plane_size * lz + size_t(y) * w];
+          for (int x = cx; x < std::min(cx + TILE_DIM, iw); x++)
+          {
+            base = std::min(base, q[x]);
+            top = std::max(top, q[x]);
+            total += q[x];
+          }
+        }
+      }
+      // the voxels out of the grid are zeros
+      if (partial) base = 0;
+
+      Tile& tile = m_tiles[GetTileIndex(i % m_tiles_x, i / m_tiles_x, tz)];
+      tile.base = base;
+      tile.top = top;
+      uint64_t local_max = total - uint64_t(base) * TILE_VOXELS;
+      if (local_max == 0)
+        tile.storage = LOCAL_CONSTANT;
+      else if (local_max <= UINT16_MAX)
+        tile.storage = LOCAL_16_BITS;
+      else
+        tile.storage = LOCAL_32_BITS;
+    }
+
+    size_t first_16 = m_local_16.size(), first_32 = m_local_32.size();
+    for (int i = 0; i < n_slab_tiles; i++)
+    {
+      Tile& tile = m_tiles[GetTileIndex(i % m_tiles_x, i / m_tiles_x, tz)];
+      if (tile.storage == LOCAL_16_BITS)
+      {
+        tile.local = first_16;
+        first_16 += TILE_VOXELS;
+      }
+      else if (tile.storage == LOCAL_32_BITS)
+      {
+        tile.local = first_32;
+        first_32 += TILE_VOXELS;
+      }
+      else
+        tile.local = 0;
+    }
+    m_local_16.resize(first_16);
+    m_local_32.resize(first_32);
+
+    //////////////////////////////////////////////////////////////
+    // 2 - Terms of each tile, from the SAT planes
+#pragma omp parallel for
+    for (int i = 0; i < n_slab_tiles; i++)
+    {
+      int cx = (i % m_tiles_x) * TILE_DIM, cy = (i / m_tiles_x) * TILE_DIM;
+      size_t t = GetTileIndex(i % m_tiles_x, i / m_tiles_x, tz);
+      size_t t_edge = t * TILE_DIM;
+      size_t t_face = t * TILE_DIM * TILE_DIM;
+
+      m_corner[t] = rect(0, cx - 1, 0, cy - 1, 0);
+      for (int l = 0; l < TILE_DIM; l++)
+      {
+        m_edge_x[t_edge + l] = rect(cx, cx + l, 0, cy - 1, 0);
+        m_edge_y[t_edge + l] = rect(0, cx - 1, cy, cy + l, 0);
+        m_edge_z[t_edge + l] = rect(0, cx - 1, 0, cy - 1, l + 1) - m_corner[t];
+      }
+      for (int l0 = 0; l0 < TILE_DIM; l0++)
+      {
+        for (int l1 = 0; l1 < TILE_DIM; l1++)
+        {
+          size_t f = t_face + l1 + l0 * TILE_DIM;
+          m_face_xy[f] = uint32_t(rect(cx, cx + l0, cy, cy + l1, 0));
+          m_face_xz[f] = uint32_t(rect(cx, cx + l0, 0, cy - 1, l1 + 1) - m_edge_x[t_edge + l0]);
+          m_face_yz[f] = uint32_t(rect(0, cx - 1, cy, cy + l0, l1 + 1) - m_edge_y[t_edge + l0]);
+        }
+      }
+
+      const Tile& tile = m_tiles[t];
+      if (tile.storage == LOCAL_CONSTANT) continue;
+      for (int lz = 0; lz < TILE_DIM; lz++)
+      {
+        for (int ly = 0; ly < TILE_DIM; ly++)
+        {
+          for (int lx = 0; lx < TILE_DIM; lx++)
+          {
+            uint64_t local = rect(cx, cx + lx, cy, cy + ly, lz + 1) - m_face_xy[t_face + ly + lx * TILE_DIM]
+                           - uint64_t(tile.base) * uint64_t((lx + 1) * (ly + 1) * (lz + 1));
+            int l = lx + TILE_DIM * (ly + TILE_DIM * lz);
+            if (tile.storage == LOCAL_16_BITS)
+              m_local_16[tile.local + l] = uint16_t(local);
+            else
+              m_local_32[tile.local + l] = uint32_t(local);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,303 @@
+/**
+ * compactsummedareatable.h
+ *
+ * 3D summed area table of non negative values stored in fixed point and in
+ *   tiles, for the tables that are too large (or too imprecise) as a dense
+ *   SummedAreaTable3D<double>/<float>: box sums are exact in fixed point,
+ *   whatever the size of the box and of the volume.
+ *
+ * The values are quantized to integers of up to 16 bits (step = max / qmax).
+ *   The table is split in tiles of 8^3 voxels, and the SAT at c + l, with c
+ *   the first voxel of a tile, is the sum of eight terms: the voxels of
+ *   [0,x] x [0,y] x [0,z] before the tile or inside it along each axis.
+ * . local (inside along x, y and z): prefix sums of the tile, relative to
+ *   the minimum value of the tile. Nothing is stored for constant tiles
+ *   (empty space), 16 bits if the sum fits, 32 bits otherwise
+ * . faces (inside along two axes): 3 * 8^2 per tile, 32 bits
+ * . edges (inside along one axis): 3 * 8 per tile, 64 bits
+ * . corner (before the tile along every axis): 64 bits
+ *
+ * Build streams slabs of 8 slices, so no dense table is allocated. Update
+ *   rebuilds the slabs after the first tile whose values changed, reading
+ *   the new values of the changed tiles only.
+**/
+#ifndef VIS_UTILS_COMPACT_SUMMED_AREA_TABLE_H
+#define VIS_UTILS_COMPACT_SUMMED_AREA_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace vis
+{
+  class CompactSummedAreaTable3D
+  {
+  public:
+    static const int TILE_LOG2 = 3;
+    static const int TILE_DIM = 1 << TILE_LOG2;
+    static const int TILE_VOXELS = TILE_DIM * TILE_DIM * TILE_DIM;
+    static const int MAX_BITS = 16;
+
+    CompactSummedAreaTable3D ();
+    ~CompactSummedAreaTable3D ();
+
+    // value (x, y, z) in [0, max_value] for each voxel of the w * h * d
+    //   grid, called by several threads at once. bits is the fixed point
+    //   precision of the values, lowered for very large grids so the faces
+    //   fit in 32 bits.
+    template<typename ValueFunction>
+    bool Build (unsigned int _w, unsigned int _h, unsigned int _d, ValueFunction&& value,
+                double max_value, int bits = MAX_BITS);
+    // Rebuild the table after the values of some tiles changed, keeping the
+    //   step: value is only called for the voxels of the tiles with
+    //   dirty_tiles[tile index] set (see GetTileIndex). Only the slabs of 8
+    //   slices from the first dirty tile are rebuilt. Returns false if a new
+    //   value is larger than the range of the table (clamped), the table
+    //   should then be built again.
+    template<typename ValueFunction>
+    bool Update (const std::vector<unsigned char>& dirty_tiles, ValueFunction&& value);
+    void Clear ();
+
+    unsigned int GetWidth () const { return w; }
+    unsigned int GetHeight () const { return h; }
+    unsigned int GetDepth () const { return d; }
+    int GetBits () const { return m_bits; }
+    // Value of one fixed point unit
+    double GetStep () const { return m_step; }
+
+    // Sum of [0,x] x [0,y] x [0,z] in fixed point. 0 if a coordinate is
+    //   negative, coordinates past the end are clamped (like the clamp to
+    //   edge of the GL textures).
+    uint64_t GetFixedValue (int x, int y, int z) const;
+    double GetValue (int x, int y, int z) const;
+    // Quantized value of the voxel (x, y, z), inside the grid
+    uint32_t GetFixedVoxel (int x, int y, int z) const;
+
+    // Sum of [x0,x1] x [y0,y1] x [z0,z1]
+    uint64_t GetFixedSum (int x0, int y0, int z0, int x1, int y1, int z1) const;
+    double GetSum (int x0, int y0, int z0, int x1, int y1, int z1) const;
+    double GetAverage (int x0, int y0, int z0, int x1, int y1, int z1) const;
+
+    double GetTotal () const;
+    double GetMean () const;
+    // Largest quantized value of the table, times the step
+    double GetMaximum () const;
+
+    // Dense w * h * d table (x fastest) of GetValue(x, y, z) - offset *
+    //   (x + 1) * (y + 1) * (z + 1). With the mean value as offset the
+    //   magnitude of the values stays close to the deviation from the mean,
+    //   and float tables keep the precision of the large boxes: the offset
+    //   part of a box is offset * number of voxels (also with trilinear
+    //   interpolation, as x * y * z is trilinear).
+    //   Only the slices from first_z are written.
+    void GetFloatValues (float* values, double offset = 0.0, int first_z = 0) const;
+
+    int GetNumberOfTilesX () const { return m_tiles_x; }
+    int GetNumberOfTilesY () const { return m_tiles_y; }
+    int GetNumberOfTilesZ () const { return m_tiles_z; }
+    size_t GetNumberOfTiles () const { return size_t(m_tiles_x) * size_t(m_tiles_y) * size_t(m_tiles_z); }
+    size_t GetTileIndex (int tx, int ty, int tz) const
+    {
+      return size_t(tx) + size_t(m_tiles_x) * (size_t(ty) + size_t(m_tiles_y) * size_t(tz));
+    }
+
+    size_t GetSizeBytes () const;
+
+  private:
+    enum LOCAL_STORAGE
+    {
+      LOCAL_CONSTANT = 0,
+      LOCAL_16_BITS  = 1,
+      LOCAL_32_BITS  = 2,
+    };
+
+    class Tile
+    {
+    public:
+      // minimum and maximum quantized values of the tile
+      uint32_t base;
+      uint32_t top;
+      // LOCAL_STORAGE
+      uint32_t storage;
+      // first element of the tile in m_local_16 or m_local_32
+      size_t local;
+    };
+
+    static uint32_t Quantize (double v, double inv_step, uint32_t qmax)
+    {
+      if (!(v > 0.0)) return 0;
+      double q = v * inv_step + 0.5;
+      return q >= double(qmax) ? qmax : (uint32_t)q;
+    }
+
+    // Slabs from first_tz, reading the values of the dirty tiles (all if
+    //   dirty_tiles is nullptr) and keeping the others. False if a value was
+    //   clamped.
+    template<typename ValueFunction>
+    bool BuildSlabs (int first_tz, const unsigned char* dirty_tiles, ValueFunction&& value);
+    // Tiles of the slab tz, from the quantized values of its slices and the
+    //   SAT planes z = cz - 1 ... cz + TILE_DIM - 1
+    void BuildSlab (int tz, const std::vector<uint32_t>& quantized, const std::vector<uint64_t>& planes);
+
+    unsigned int w, h, d;
+    int m_tiles_x, m_tiles_y, m_tiles_z;
+    int m_bits;
+    double m_step;
+
+    std::vector<Tile> m_tiles;
+    std::vector<uint16_t> m_local_16;
+    std::vector<uint32_t> m_local_32;
+    // TILE_DIM^2 per tile, [l1 + l0 * TILE_DIM] for face_ab (l0 along a)
+    std::vector<uint32_t> m_face_xy, m_face_xz, m_face_yz;
+    // TILE_DIM per tile
+    std::vector<uint64_t> m_edge_x, m_edge_y, m_edge_z;
+    std::vector<uint64_t> m_corner;
+  };
+
+  template<typename ValueFunction>
+  bool CompactSummedAreaTable3D::Build (unsigned int _w, unsigned int _h, unsigned int _d, ValueFunction&& value,
+                                        double max_value, int bits)
+  {
+    Clear();
+    if (_w == 0 || _h == 0 || _d == 0) return false;
+
+    w = _w; h = _h; d = _d;
+    m_tiles_x = int((w + TILE_DIM - 1) >> TILE_LOG2);
+    m_tiles_y = int((h + TILE_DIM - 1) >> TILE_LOG2);
+    m_tiles_z = int((d + TILE_DIM - 1) >> TILE_LOG2);
+
+    // a face sums at most TILE_DIM^2 * max(w, h, d) values
+    uint64_t max_dim = std::max(w, std::max(h, d));
+    m_bits = std::max(1, std::min(bits, int(MAX_BITS)));
+    while (m_bits > 1 && uint64_t(TILE_DIM * TILE_DIM) * max_dim * ((uint64_t(1) << m_bits) - 1) > UINT32_MAX)
+      m_bits--;
+    m_step = max_value > 0.0 ? max_value / double((uint32_t(1) << m_bits) - 1) : 1.0;
+
+    size_t n_tiles = GetNumberOfTiles();
+    m_tiles.resize(n_tiles);
+    m_face_xy.resize(n_tiles * TILE_DIM * TILE_DIM);
+    m_face_xz.resize(n_tiles * TILE_DIM * TILE_DIM);
+    m_face_yz.resize(n_tiles * TILE_DIM * TILE_DIM);
+    m_edge_x.resize(n_tiles * TILE_DIM);
+    m_edge_y.resize(n_tiles * TILE_DIM);
+    m_edge_z.resize(n_tiles * TILE_DIM);
+    m_corner.resize(n_tiles);
+
+    BuildSlabs(0, nullptr, value);
+    return true;
+  }
+
+  template<typename ValueFunction>
+  bool CompactSummedAreaTable3D::Update (const std::vector<unsigned char>& dirty_tiles, ValueFunction&& value)
+  {
+    if (m_tiles.empty() || dirty_tiles.size() != m_tiles.size()) return false;
+
+    int first_tz = m_tiles_z;
+    for (size_t t = 0; t < dirty_tiles.size() && first_tz == m_tiles_z; t++)
+      if (dirty_tiles[t]) first_tz = int(t / (size_t(m_tiles_x) * size_t(m_tiles_y)));
+    if (first_tz == m_tiles_z) return true;
+
+    // The local prefix sums are allocated slab after slab: the ones of the
+    //   slabs being rebuilt are [first_16, end), replaced by the new ones
+    //   appended at the end
+    size_t first_16 = m_local_16.size(), first_32 = m_local_32.size();
+    size_t end_16 = first_16, end_32 = first_32;
+    for (size_t t = GetTileIndex(0, 0, first_tz); t < m_tiles.size(); t++)
+    {
+      if (m_tiles[t].storage == LOCAL_16_BITS) first_16 = std::min(first_16, m_tiles[t].local);
+      else if (m_tiles[t].storage == LOCAL_32_BITS) first_32 = std::min(first_32, m_tiles[t].local);
+    }
+
+    bool in_range = BuildSlabs(first_tz, &dirty_tiles[0], value);
+
+    m_local_16.erase(m_local_16.begin() + first_16, m_local_16.begin() + end_16);
+    m_local_32.erase(m_local_32.begin() + first_32, m_local_32.begin() + end_32);
+    for (size_t t = GetTileIndex(0, 0, first_tz); t < m_tiles.size(); t++)
+    {
+      if (m_tiles[t].storage == LOCAL_16_BITS) m_tiles[t].local -= end_16 - first_16;
+      else if (m_tiles[t].storage == LOCAL_32_BITS) m_tiles[t].local -= end_32 - first_32;
+    }
+
+    return in_range;
+  }
+
+  template<typename ValueFunction>
+  bool CompactSummedAreaTable3D::BuildSlabs (int first_tz, const unsigned char* dirty_tiles, ValueFunction&& value)
+  {
+    uint32_t qmax = (uint32_t(1) << m_bits) - 1;
+    double inv_step = 1.0 / m_step;
+    int in_range = 1;
+
+    // quantized values of the slab, and SAT of the planes z = cz - 1 to
+    //   cz + TILE_DIM - 1 (plane 0 is the last one of the previous slab)
+    size_t plane_size = size_t(w) * size_t(h);
+    std::vector<uint32_t> quantized(plane_size * TILE_DIM);
+    std::vector<uint64_t> planes(plane_size * (TILE_DIM + 1), 0);
+
+    int iw = (int)w, ih = (int)h, id = (int)d;
+    if (first_tz > 0)
+    {
+      int z = first_tz * TILE_DIM - 1;
+#pragma omp parallel for
+      for (int y = 0; y < ih; y++)
+        for (int x = 0; x < iw; x++)
+          planes[size_t(y) * w + x] = GetFixedValue(x, y, z);
+    }
+
+    for (int tz = first_tz; tz < m_tiles_z; tz++)
+    {
+      int cz = tz * TILE_DIM;
+      if (tz > first_tz)
+        std::copy(planes.begin() + plane_size * TILE_DIM, planes.end(), planes.begin());
+
+      // 2D SAT of each slice. Without dirty_tiles every value is new,
+      //   otherwise only the ones of the dirty tiles. Each thread clears its
+      //   own copy of in_range (no min reduction in OpenMP 2.0).
+#pragma omp parallel for reduction(&&: in_range)
+      for (int lz = 0; lz < TILE_DIM; lz++)
+      {
+        uint32_t* q = &quantized[plane_size * lz];
+        uint64_t* p = &planes[plane_size * (lz + 1)];
+        int z = cz + lz;
+        for (int y = 0; y < ih; y++)
+        {
+          uint64_t row_sum = 0;
+          for (int x = 0; x < iw; x++)
+          {
+            size_t i = size_t(x) + size_t(y) * w;
+            if (z >= id)
+              q[i] = 0;
+            else if (!dirty_tiles || dirty_tiles[GetTileIndex(x >> TILE_LOG2, y >> TILE_LOG2, tz)])
+            {
+              double v = value(x, y, z);
+              if (v * inv_step > double(qmax) + 0.5) in_range = 0;
+              q[i] = Quantize(v, inv_step, qmax);
+            }
+            else
+              q[i] = GetFixedVoxel(x, y, z);
+            row_sum += q[i];
+            p[i] = row_sum + (y > 0 ? p[i - w] : 0);
+          }
+        }
+      }
+
+      // then along z
+      for (int lz = 1; lz <= TILE_DIM; lz++)
+      {
+        uint64_t* p = &planes[plane_size * lz];
+        const uint64_t* p_prev = &planes[plane_size * (lz - 1)];
+#pragma omp parallel for
+        for (int y = 0; y < ih; y++)
+          for (size_t i = size_t(y) * w; i < size_t(y + 1) * w; i++)
+            p[i] += p_prev[i];
+      }
+
+      BuildSlab(tz, quantized, planes);
+    }
+
+    return in_range != 0;
+  }
+}
+
+#endif
@@ -175,13 +175,8 @@ namespace vis
     SummedAreaTable3D (unsigned int _w, unsigned int _h, unsigned int _d)
       : w(_w), h(_h), d(_d)
     {
-      data = new T[w*h*d];
+      data = new T[size_t(w) * size_t(h) * size_t(d)]();
       zero = T(0);
-  
-      for (int x = 0; x < w; x++)
-        for (int y = 0; y < h; y++)
-          for (int z = 0; z < d; z++)
-            SetValue((T)zero, x, y, z);
     }
   
     ~SummedAreaTable3D ()
@@ -198,7 +193,7 @@ namespace vis
 
     void SetValue (T val, int x, int y, int z)
     {
-      data[x + (w * y) + (w * h * z)] = val;
+      data[size_t(x) + (size_t(w) * y) + (size_t(w) * h * z)] = val;
     }
   
     T GetValue (int x, int y, int z)
@@ -209,72 +204,52 @@ namespace vis
       if (y >= h) y = h - 1;
       if (z >= d) z = d - 1;
   
-      return data[x + (w * y) + (w * h * z)];
+      return data[size_t(x) + (size_t(w) * y) + (size_t(w) * h * z)];
     }
-    
-    // 2010 - Real-time ambient occlusion and halos with Summed Area Tables
-    // TODO:
-    // . Use #pragma omp parallel for
+
+    // The 3D inclusion-exclusion recurrence is the composition of three 1D
+    //   prefix sums: along x in each row, then along y (row += previous row)
+    //   in each slice, then along z (slice += previous slice). The lines of
+    //   a pass are independent, so each pass is split between the threads,
+    //   and the inner loops run over contiguous rows.
     virtual void BuildSAT ()
     {
-      //////////////////////////////////////////////////////////////
-      // 1 - First Step
-      SetValue(GetValue(0, 0, 0), 0, 0, 0);
-  
-      //////////////////////////////////////////////////////////////
-      // 2 - Second Step
-      for (int x = 1; x < w; x++)
-        SetValue(GetValue(x - 1, 0, 0) + GetValue(x, 0, 0), x, 0, 0);
-      for (int y = 1; y < h; y++)
-        SetValue(GetValue(0, y - 1, 0) + GetValue(0, y, 0), 0, y, 0);
-      for (int z = 1; z < d; z++)
-        SetValue(GetValue(0, 0, z - 1) + GetValue(0, 0, z), 0, 0, z);
-  
-      //////////////////////////////////////////////////////////////
-      // 3 - Third Step
-      for (int x = 1; x < w; x++)
-        for (int z = 1; z < d; z++)
-          SetValue(GetValue(x - 1, 0, z) +
-                   GetValue(x, 0, z - 1) -
-                   GetValue(x - 1, 0, z - 1) +
-                   GetValue(x, 0, z),
-                   x, 0, z);
-      for (int x = 1; x < w; x++)
-        for (int y = 1; y < h; y++)
-          SetValue(GetValue(x - 1, y, 0) +
-                   GetValue(x, y - 1, 0) - 
-                   GetValue(x - 1, y - 1, 0) +
-                   GetValue(x, y, 0),
-                   x, y, 0);
-      for (int y = 1; y < h; y++)
-        for (int z = 1; z < d; z++)
-          SetValue(GetValue(0, y - 1, z) + 
-                   GetValue(0, y, z - 1) - 
-                   GetValue(0, y - 1, z - 1) + 
-                   GetValue(0, y, z),
-                   0, y, z);
+      int iw = (int)w, ih = (int)h, id = (int)d;
+      size_t slice_size = size_t(w) * size_t(h);
 
       //////////////////////////////////////////////////////////////
-      // 4 - Fourth Step
-      for (int x = 1; x < w; x++)
+      // 1 - Along x
+#ifdef USE_OMP
+#pragma omp parallel for
+#endif
+      for (int z = 0; z < id; z++)
       {
-        for (int y = 1; y < h; y++)
+        for (int y = 0; y < ih; y++)
         {
-          for (int z = 1; z < d; z++)
-          {
-            T val = GetValue(x, y, z)
-                  + GetValue(x - 1, y - 1, z - 1)
-                  + GetValue(x, y, z - 1)
-                  + GetValue(x, y - 1, z)
-                  + GetValue(x - 1, y, z)
-                  - GetValue(x - 1, y - 1, z)
-                  - GetValue(x, y - 1, z - 1)
-                  - GetValue(x - 1, y, z - 1);
-  
-            SetValue(val, x, y, z);
-          }
+          T* row = data + size_t(z) * slice_size + size_t(y) * w;
+          for (int x = 1; x < iw; x++)
+            row[x] += row[x - 1];
         }
       }
+
+      //////////////////////////////////////////////////////////////
+      // 2 - Along y
+#ifdef USE_OMP
+#pragma omp parallel for
+#endif
+      for (int z = 0; z < id; z++)
+      {
+        T* slice = data + size_t(z) * slice_size;
+        AccumulateRows(slice, w, h, w);
+      }
+
+      //////////////////////////////////////////////////////////////
+      // 3 - Along z
+#ifdef USE_OMP
+#pragma omp parallel for
+#endif
+      for (int y = 0; y < ih; y++)
+        AccumulateRows(data + size_t(y) * w, w, d, slice_size);
     }
   
     T GetAverage ()
@@ -300,6 +275,18 @@ namespace vis
     T zero;
 
   private:
+    // Prefix sum of n rows of row_size elements, row i at first + i * stride:
+    //   row i += row i - 1
+    static void AccumulateRows (T* first, size_t row_size, unsigned int n, size_t stride)
+    {
+      for (unsigned int i = 1; i < n; i++)
+      {
+        const T* prev = first + size_t(i - 1) * stride;
+        T* row = first + size_t(i) * stride;
+        for (size_t k = 0; k < row_size; k++)
+          row[k] += prev[k];
+      }
+    }
   };
 }
 
@@ -0,0 +1,512 @@
+#include "brickedvolume.h"
+
+#include <volvis_utils/reader.h>
+#include <volvis_utils/voxellayout.h>
+
+#include <cstring>
+#include <iostream>
+
+namespace vis
+{
+  namespace
+  {
+    template<typename T>
+    void WriteValue (std::ofstream& f, T v)
+    {
+      f.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadValue (std::ifstream& f, T* v)
+    {
+      f.read(reinterpret_cast<char*>(v), sizeof(T));
+      return f.good();
+    }
+
+    uint64_t BrickInfoByteSize (uint32_t histogram_bins)
+    {
+      return 2 * sizeof(double) + 2 * sizeof(uint64_t) + histogram_bins * sizeof(uint32_t);
+    }
+
+    uint64_t HeaderByteSize ()
+    {
+      return 4 + sizeof(uint32_t) * 4 + sizeof(double) * 3 + sizeof(uint32_t) * 6;
+    }
+  }
+
+  BrickedVolumeFile::BrickedVolumeFile ()
+    : m_dimensions(0)
+    , m_scale(1.0)
+    , m_data_storage_size(DataStorageSize::UNKNOWN)
+    , m_brick_size(0)
+    , m_number_of_bricks(0)
+    , m_histogram_bins(0)
+  {
+  }
+
+  BrickedVolumeFile::~BrickedVolumeFile ()
+  {
+    Close();
+  }
+
+  bool BrickedVolumeFile::Write (StructuredGridVolume* vol, std::string filepath,
+                                 uint32_t brick_size, uint32_t histogram_bins)
+  {
+    if (!vol || !vol->GetArrayData() || brick_size == 0) return false;
+
+    DataStorageSize dss = vol->GetDataStorageSize();
+    size_t elem_size = GetStorageSizeBytes(dss);
+    if (elem_size == 0)
+    {
+      // bricks are copied as whole voxels, packed 12-bit volumes must be
+      //   converted to 16 bits first
+      printf("BrickedVolumeFile: storage type %u can not be bricked\n", (unsigned int)dss);
+      return false;
+    }
+
+    std::ofstream f(filepath.c_str(), std::ios::binary);
+    if (!f.is_open())
+    {
+      printf("BrickedVolumeFile: error on opening %s\n", filepath.c_str());
+      return false;
+    }
+
+    unsigned int w = vol->GetWidth(), h = vol->GetHeight(), d = vol->GetDepth();
+    glm::uvec3 nb((w + brick_size - 1) / brick_size,
+                  (h + brick_size - 1) / brick_size,
+                  (d + brick_size - 1) / brick_size);
+    unsigned int n_bricks = nb.x * nb.y * nb.z;
+
+    // Header
+    f.write("BVOL", 4);
+    WriteValue<uint32_t>(f, VERSION);
+    WriteValue<uint32_t>(f, w);
+    WriteValue<uint32_t>(f, h);
+    WriteValue<uint32_t>(f, d);
+    WriteValue<double>(f, vol->GetScaleX());
+    WriteValue<double>(f, vol->GetScaleY());
+    WriteValue<double>(f, vol->GetScaleZ());
+    WriteValue<uint32_t>(f, (uint32_t)dss);
+    WriteValue<uint32_t>(f, brick_size);
+    WriteValue<uint32_t>(f, nb.x);
+    WriteValue<uint32_t>(f, nb.y);
+    WriteValue<uint32_t>(f, nb.z);
+    WriteValue<uint32_t>(f, histogram_bins);
+
+    // Reserve the brick table, it is rewritten after the bricks are stored
+    uint64_t table_offset = HeaderByteSize();
+    uint64_t data_offset = table_offset + BrickInfoByteSize(histogram_bins) * n_bricks;
+    std::vector<char> empty_table((size_t)(data_offset - table_offset), 0);
+    f.write(empty_table.data(), empty_table.size());
+
+    double max_density = vol->GetMaxDensity();
+    const unsigned char* voxels = static_cast<const unsigned char*>(vol->GetArrayData());
+    bool linear_layout = vol->GetVoxelLayout() == VoxelLayout::LINEAR;
+
+    std::vector<BrickInfo> bricks(n_bricks);
+    std::vector<unsigned char> brick_data;
+    uint64_t offset = data_offset;
+    for (unsigned int bz = 0; bz < nb.z; bz++)
+    {
+      for (unsigned int by = 0; by < nb.y; by++)
+      {
+        for (unsigned int bx = 0; bx < nb.x; bx++)
+        {
+          BrickInfo& bi = bricks[bx + by * nb.x + bz * nb.x * nb.y];
+          bi.min_value = +std::numeric_limits<double>::max();
+          bi.max_value = -std::numeric_limits<double>::max();
+          bi.histogram.assign(histogram_bins, 0);
+
+          unsigned int x0 = bx * brick_size, x1 = glm::min(x0 + brick_size, w);
+          unsigned int y0 = by * brick_size, y1 = glm::min(y0 + brick_size, h);
+          unsigned int z0 = bz * brick_size, z1 = glm::min(z0 + brick_size, d);
+
+          size_t row_bytes = (x1 - x0) * elem_size;
+          brick_data.resize(row_bytes * (y1 - y0) * (z1 - z0));
+
+          size_t bpos = 0;
+          for (unsigned int z = z0; z < z1; z++)
+          {
+            for (unsigned int y = y0; y < y1; y++)
+            {
+              if (linear_layout)
+              {
+                size_t vid = x0 + (size_t)y * w + (size_t)z * w * h;
+                memcpy(&brick_data[bpos], voxels + vid * elem_size, row_bytes);
+              }
+              else
+              {
+                for (unsigned int x = x0; x < x1; x++)
+                  memcpy(&brick_data[bpos + (x - x0) * elem_size], voxels + vol->GetVoxelIndex(x, y, z) * elem_size, elem_size);
+              }
+              bpos += row_bytes;
+
+              for (unsigned int x = x0; x < x1; x++)
+              {
+                double v = vol->GetAbsoluteSample(x, y, z);
+                bi.min_value = glm::min(bi.min_value, v);
+                bi.max_value = glm::max(bi.max_value, v);
+                if (histogram_bins > 0)
+                {
+                  int bin = (int)((v / max_density) * histogram_bins);
+                  bi.histogram[glm::clamp(bin, 0, (int)histogram_bins - 1)]++;
+                }
+              }
+            }
+          }
+
+          bi.byte_offset = offset;
+          bi.byte_size = brick_data.size();
+          f.write(reinterpret_cast<const char*>(brick_data.data()), brick_data.size());
+          offset += bi.byte_size;
+        }
+      }
+    }
+
+    f.seekp((std::streamoff)table_offset);
+    for (unsigned int i = 0; i < n_bricks; i++)
+    {
+      WriteValue<double>(f, bricks[i].min_value);
+      WriteValue<double>(f, bricks[i].max_value);
+      WriteValue<uint64_t>(f, bricks[i].byte_offset);
+      WriteValue<uint64_t>(f, bricks[i].byte_size);
+      for (uint32_t b = 0; b < histogram_bins; b++)
+        WriteValue<uint32_t>(f, bricks[i].histogram[b]);
+    }
+
+    bool ok = f.good();
+    f.close();
+
+    printf("BrickedVolumeFile: %s written with %d bricks of %d^3\n", filepath.c_str(), n_bricks, brick_size);
+    return ok;
+  }
+
+  bool BrickedVolumeFile::Convert (std::string input_filepath, std::string output_filepath, uint32_t brick_size)
+  {
+    VolumeReader vr;
+    StructuredGridVolume* vol = vr.ReadStructuredVolume(input_filepath);
+    if (!vol) return false;
+
+    bool ret = BrickedVolumeFile::Write(vol, output_filepath, brick_size);
+    delete vol;
+
+    return ret;
+  }
+
+  bool BrickedVolumeFile::Open (std::string filepath)
+  {
+    Close();
+
+    m_file.open(filepath.c_str(), std::ios::binary);
+    if (!m_file.is_open())
+    {
+      printf("BrickedVolumeFile: error on opening %s\n", filepath.c_str());
+      return false;
+    }
+    m_filepath = filepath;
+
+    char magic[4];
+    m_file.read(magic, 4);
+    uint32_t version = 0, dss = 0;
+    if (!m_file.good() || strncmp(magic, "BVOL", 4) != 0
+     || !ReadValue(m_file, &version) || version != VERSION)
+    {
+      printf("BrickedVolumeFile: %s is not a valid .bvol file\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    bool ok = ReadValue(m_file, &m_dimensions.x)
+           && ReadValue(m_file, &m_dimensions.y)
+           && ReadValue(m_file, &m_dimensions.z)
+           && ReadValue(m_file, &m_scale.x)
+           && ReadValue(m_file, &m_scale.y)
+           && ReadValue(m_file, &m_scale.z)
+           && ReadValue(m_file, &dss)
+           && ReadValue(m_file, &m_brick_size)
+           && ReadValue(m_file, &m_number_of_bricks.x)
+           && ReadValue(m_file, &m_number_of_bricks.y)
+           && ReadValue(m_file, &m_number_of_bricks.z)
+           && ReadValue(m_file, &m_histogram_bins);
+    m_data_storage_size = (DataStorageSize)dss;
+
+    if (!ok || m_brick_size == 0 || GetStorageSizeBytes(m_data_storage_size) == 0)
+    {
+      printf("BrickedVolumeFile: corrupted header at %s\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    // A corrupt header must not allocate more than the file holds: the
+    //   bricks cover the dimensions and the brick table fits in the file
+    std::streampos header_end = m_file.tellg();
+    m_file.seekg(0, std::ios::end);
+    uint64_t file_size = (uint64_t)m_file.tellg();
+    m_file.seekg(header_end);
+
+    glm::u64vec3 expected_bricks = (glm::u64vec3(m_dimensions) + uint64_t(m_brick_size - 1)) / uint64_t(m_brick_size);
+    uint64_t table_bytes = file_size > HeaderByteSize() ? file_size - HeaderByteSize() : 0;
+    uint64_t max_bricks = table_bytes / BrickInfoByteSize(0);
+    ok = m_dimensions.x > 0 && m_dimensions.y > 0 && m_dimensions.z > 0
+      && glm::u64vec3(m_number_of_bricks) == expected_bricks
+      && uint64_t(m_histogram_bins) <= table_bytes / sizeof(uint32_t)
+      && expected_bricks.x <= max_bricks
+      && expected_bricks.y <= max_bricks / expected_bricks.x
+      && expected_bricks.z <= max_bricks / (expected_bricks.x * expected_bricks.y);
+    uint64_t n_bricks = ok ? expected_bricks.x * expected_bricks.y * expected_bricks.z : 0;
+    ok = ok && n_bricks <= UINT32_MAX && n_bricks <= table_bytes / BrickInfoByteSize(m_histogram_bins);
+    if (!ok)
+    {
+      printf("BrickedVolumeFile: corrupted header at %s\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    size_t elem_size = GetStorageSizeBytes(m_data_storage_size);
+    m_bricks.resize((size_t)n_bricks);
+    for (unsigned int i = 0; i < n_bricks && ok; i++)
+    {
+      BrickInfo& bi = m_bricks[i];
+      ok = ReadValue(m_file, &bi.min_value)
+        && ReadValue(m_file, &bi.max_value)
+        && ReadValue(m_file, &bi.byte_offset)
+        && ReadValue(m_file, &bi.byte_size);
+      bi.histogram.resize(m_histogram_bins);
+      for (uint32_t b = 0; b < m_histogram_bins && ok; b++)
+        ok = ReadValue(m_file, &bi.histogram[b]);
+
+      // the voxels of the brick, inside the file
+      glm::u64vec3 bd = glm::u64vec3(GetBrickDimensions(i));
+      ok = ok && bi.byte_size == bd.x * bd.y * bd.z * elem_size
+         && bi.byte_offset <= file_size && bi.byte_size <= file_size - bi.byte_offset;
+    }
+
+    if (!ok)
+    {
+      printf("BrickedVolumeFile: corrupted brick table at %s\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void BrickedVolumeFile::Close ()
+  {
+    if (m_file.is_open()) m_file.close();
+    m_file.clear();
+    m_bricks.clear();
+    m_filepath.clear();
+  }
+
+  bool BrickedVolumeFile::IsOpen ()
+  {
+    return m_file.is_open();
+  }
+
+  glm::uvec3 BrickedVolumeFile::GetDimensions ()
+  {
+    return m_dimensions;
+  }
+
+  glm::dvec3 BrickedVolumeFile::GetScale ()
+  {
+    return m_scale;
+  }
+
+  DataStorageSize BrickedVolumeFile::GetDataStorageSize ()
+  {
+    return m_data_storage_size;
+  }
+
+  double BrickedVolumeFile::GetMaxDensity ()
+  {
+    if (m_data_storage_size == DataStorageSize::_8_BITS)
+      return (256.0 - 1.0);
+    else if (m_data_storage_size == DataStorageSize::_16_BITS)
+      return (65536.0 - 1.0);
+    return 1.0;
+  }
+
+  uint32_t BrickedVolumeFile::GetBrickSize ()
+  {
+    return m_brick_size;
+  }
+
+  glm::uvec3 BrickedVolumeFile::GetNumberOfBricks ()
+  {
+    return m_number_of_bricks;
+  }
+
+  unsigned int BrickedVolumeFile::GetBrickIndex (unsigned int bx, unsigned int by, unsigned int bz)
+  {
+    return bx + by * m_number_of_bricks.x + bz * m_number_of_bricks.x * m_number_of_bricks.y;
+  }
+
+  BrickedVolumeFile::BrickInfo& BrickedVolumeFile::GetBrickInfo (unsigned int brick_id)
+  {
+    return m_bricks[brick_id];
+  }
+
+  glm::uvec3 BrickedVolumeFile::GetBrickOrigin (unsigned int brick_id)
+  {
+    unsigned int bx = brick_id % m_number_of_bricks.x;
+    unsigned int by = (brick_id / m_number_of_bricks.x) % m_number_of_bricks.y;
+    unsigned int bz = brick_id / (m_number_of_bricks.x * m_number_of_bricks.y);
+    return glm::uvec3(bx, by, bz) * m_brick_size;
+  }
+
+  glm::uvec3 BrickedVolumeFile::GetBrickDimensions (unsigned int brick_id)
+  {
+    glm::uvec3 o = GetBrickOrigin(brick_id);
+    return glm::min(o + glm::uvec3(m_brick_size), m_dimensions) - o;
+  }
+
+  void BrickedVolumeFile::GetRegionMinMax (glm::ivec3 rmin, glm::ivec3 rmax, double* vmin, double* vmax)
+  {
+    rmin = glm::clamp(rmin, glm::ivec3(0), glm::ivec3(m_dimensions));
+    rmax = glm::clamp(rmax, glm::ivec3(0), glm::ivec3(m_dimensions));
+
+    *vmin = +std::numeric_limits<double>::max();
+    *vmax = -std::numeric_limits<double>::max();
+    if (rmin.x >= rmax.x || rmin.y >= rmax.y || rmin.z >= rmax.z) return;
+
+    glm::ivec3 bmin = rmin / (int)m_brick_size;
+    glm::ivec3 bmax = (rmax - 1) / (int)m_brick_size;
+    for (int bz = bmin.z; bz <= bmax.z; bz++)
+    {
+      for (int by = bmin.y; by <= bmax.y; by++)
+      {
+        for (int bx = bmin.x; bx <= bmax.x; bx++)
+        {
+          BrickInfo& bi = m_bricks[GetBrickIndex(bx, by, bz)];
+          *vmin = glm::min(*vmin, bi.min_value);
+          *vmax = glm::max(*vmax, bi.max_value);
+        }
+      }
+    }
+  }
+
+  bool BrickedVolumeFile::IsBrickTransparent (unsigned int brick_id, TransferFunction* tf)
+  {
+    BrickInfo& bi = m_bricks[brick_id];
+    double max_density = GetMaxDensity();
+
+    // integer data: evaluate each density inside the brick range
+    if (m_data_storage_size == DataStorageSize::_8_BITS || m_data_storage_size == DataStorageSize::_16_BITS)
+    {
+      for (int v = (int)bi.min_value; v <= (int)bi.max_value; v++)
+        if (tf->GetOpc(v, max_density) != 0.0f) return false;
+      return true;
+    }
+
+    // normalized data: sample the brick range
+    const int n_samples = 256;
+    for (int i = 0; i <= n_samples; i++)
+    {
+      double v = bi.min_value + (bi.max_value - bi.min_value) * (double(i) / double(n_samples));
+      if (tf->GetOpcN(v) != 0.0f) return false;
+    }
+    return true;
+  }
+
+  StructuredGridVolume* BrickedVolumeFile::Load ()
+  {
+    return LoadBricks(glm::ivec3(0), glm::ivec3(m_dimensions), 0, nullptr);
+  }
+
+  StructuredGridVolume* BrickedVolumeFile::LoadRegion (glm::ivec3 rmin, glm::ivec3 rmax, int lod)
+  {
+    return LoadBricks(rmin, rmax, lod, nullptr);
+  }
+
+  StructuredGridVolume* BrickedVolumeFile::LoadVisibleBricks (TransferFunction* tf)
+  {
+    return LoadBricks(glm::ivec3(0), glm::ivec3(m_dimensions), 0, tf);
+  }
+
+  bool BrickedVolumeFile::ReadBrick (unsigned int brick_id, std::vector<unsigned char>& brick_data)
+  {
+    BrickInfo& bi = m_bricks[brick_id];
+    brick_data.resize((size_t)bi.byte_size);
+
+    m_file.clear();
+    m_file.seekg((std::streamoff)bi.byte_offset);
+    m_file.read(reinterpret_cast<char*>(brick_data.data()), (std::streamsize)bi.byte_size);
+    return m_file.good();
+  }
+
+  StructuredGridVolume* BrickedVolumeFile::LoadBricks (glm::ivec3 rmin, glm::ivec3 rmax, int lod, TransferFunction* tf)
+  {
+    if (!IsOpen()) return nullptr;
+
+    rmin = glm::clamp(rmin, glm::ivec3(0), glm::ivec3(m_dimensions));
+    rmax = glm::clamp(rmax, glm::ivec3(0), glm::ivec3(m_dimensions));
+    if (rmin.x >= rmax.x || rmin.y >= rmax.y || rmin.z >= rmax.z) return nullptr;
+
+    int step = 1 << glm::max(lod, 0);
+    glm::ivec3 odim = (rmax - rmin + (step - 1)) / step;
+
+    size_t elem_size = GetStorageSizeBytes(m_data_storage_size);
+    unsigned char* out = static_cast<unsigned char*>(
+      AllocateVoxelArray(m_data_storage_size, (size_t)odim.x * (size_t)odim.y * (size_t)odim.z));
+
+    glm::ivec3 bmin = rmin / (int)m_brick_size;
+    glm::ivec3 bmax = (rmax - 1) / (int)m_brick_size;
+
+    int loaded_bricks = 0, skipped_bricks = 0;
+    std::vector<unsigned char> brick_data;
+    for (int bz = bmin.z; bz <= bmax.z; bz++)
+    {
+      for (int by = bmin.y; by <= bmax.y; by++)
+      {
+        for (int bx = bmin.x; bx <= bmax.x; bx++)
+        {
+          unsigned int brick_id = GetBrickIndex(bx, by, bz);
+          if (tf && IsBrickTransparent(brick_id, tf))
+          {
+            skipped_bricks++;
+            continue;
+          }
+
+          if (!ReadBrick(brick_id, brick_data))
+          {
+            printf("BrickedVolumeFile: error on reading brick %d\n", brick_id);
+            continue;
+          }
+          loaded_bricks++;
+
+          glm::ivec3 bo = glm::ivec3(GetBrickOrigin(brick_id));
+          glm::ivec3 bd = glm::ivec3(GetBrickDimensions(brick_id));
+
+          // first voxel inside the brick that lies on the lod grid
+          glm::ivec3 vmin = glm::max(bo, rmin);
+          vmin = rmin + ((vmin - rmin + (step - 1)) / step) * step;
+          glm::ivec3 vmax = glm::min(bo + bd, rmax);
+
+          for (int z = vmin.z; z < vmax.z; z += step)
+          {
+            for (int y = vmin.y; y < vmax.y; y += step)
+            {
+              for (int x = vmin.x; x < vmax.x; x += step)
+              {
+                size_t src = (size_t)(x - bo.x) + (size_t)(y - bo.y) * bd.x + (size_t)(z - bo.z) * bd.x * bd.y;
+                size_t dst = (size_t)((x - rmin.x) / step)
+                           + (size_t)((y - rmin.y) / step) * odim.x
+                           + (size_t)((z - rmin.z) / step) * odim.x * odim.y;
+                memcpy(out + dst * elem_size, &brick_data[src * elem_size], elem_size);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    StructuredGridVolume* vol = new StructuredGridVolume(m_filepath, odim.x, odim.y, odim.z);
+    vol->SetScale(m_scale.x * step, m_scale.y * step, m_scale.z * step);
+    vol->SetArrayData(out, m_data_storage_size);
+
+    printf("BrickedVolumeFile: %d bricks loaded, %d transparent bricks skipped\n", loaded_bricks, skipped_bricks);
+    return vol;
+  }
+}
@@ -0,0 +1,116 @@
+/**
+ * Bricked volume container (.bvol)
+ *
+ * Voxels are split into fixed-size bricks (e.g. 64^3) stored contiguously
+ *   on disk, each one with a small metadata record: min/max value, a
+ *   histogram summary and its byte offset. The metadata is read when the file
+ *   is opened, so regions, LODs or only the non-transparent bricks can be
+ *   loaded without touching the rest of the file.
+ *
+ * Format (little endian, fields written one by one):
+ * |"BVOL" version
+ * |width height depth
+ * |scalex scaley scalez
+ * |data_storage_size brick_size bricks_x bricks_y bricks_z histogram_bins
+ * |for each brick: min max byte_offset byte_size histogram[histogram_bins]
+ * |brick data (x fastest inside each brick, clipped at the volume border)
+**/
+#ifndef VOL_VIS_UTILS_BRICKED_VOLUME_H
+#define VOL_VIS_UTILS_BRICKED_VOLUME_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/transferfunction.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vis
+{
+  class BrickedVolumeFile
+  {
+  public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t DEFAULT_BRICK_SIZE = 64;
+    static const uint32_t DEFAULT_HISTOGRAM_BINS = 16;
+
+    class BrickInfo
+    {
+    public:
+      // absolute values, in the range of the storage type
+      double min_value;
+      double max_value;
+      uint64_t byte_offset;
+      uint64_t byte_size;
+      std::vector<uint32_t> histogram;
+    };
+
+    BrickedVolumeFile ();
+    ~BrickedVolumeFile ();
+
+    // Write vol as a bricked volume file
+    static bool Write (StructuredGridVolume* vol, std::string filepath,
+                       uint32_t brick_size = DEFAULT_BRICK_SIZE,
+                       uint32_t histogram_bins = DEFAULT_HISTOGRAM_BINS);
+    // Read any volume supported by VolumeReader and write it as .bvol
+    static bool Convert (std::string input_filepath, std::string output_filepath,
+                         uint32_t brick_size = DEFAULT_BRICK_SIZE);
+
+    // Read only the header and the brick metadata
+    bool Open (std::string filepath);
+    void Close ();
+    bool IsOpen ();
+
+    glm::uvec3 GetDimensions ();
+    glm::dvec3 GetScale ();
+    DataStorageSize GetDataStorageSize ();
+    double GetMaxDensity ();
+
+    uint32_t GetBrickSize ();
+    glm::uvec3 GetNumberOfBricks ();
+    unsigned int GetBrickIndex (unsigned int bx, unsigned int by, unsigned int bz);
+    BrickInfo& GetBrickInfo (unsigned int brick_id);
+    glm::uvec3 GetBrickOrigin (unsigned int brick_id);
+    glm::uvec3 GetBrickDimensions (unsigned int brick_id);
+
+    // Conservative min/max of the voxels inside [rmin, rmax) (voxel coords),
+    //   evaluated only with the brick metadata.
+    void GetRegionMinMax (glm::ivec3 rmin, glm::ivec3 rmax, double* vmin, double* vmax);
+    // True if every voxel in the brick maps to zero opacity (transfer functions
+    //   without opacity evaluation are never considered transparent)
+    bool IsBrickTransparent (unsigned int brick_id, TransferFunction* tf);
+
+    // Load the full volume
+    StructuredGridVolume* Load ();
+    // Load the region [rmin, rmax), keeping one of each 2^lod voxels
+    StructuredGridVolume* LoadRegion (glm::ivec3 rmin, glm::ivec3 rmax, int lod = 0);
+    // Load the full volume, skipping (zero-filled) bricks that are
+    //   completely transparent under tf
+    StructuredGridVolume* LoadVisibleBricks (TransferFunction* tf);
+
+    // Raw voxels of one brick (x fastest, GetBrickDimensions). Not thread
+    //   safe: concurrent readers must serialize the calls.
+    bool ReadBrick (unsigned int brick_id, std::vector<unsigned char>& brick_data);
+
+  protected:
+    StructuredGridVolume* LoadBricks (glm::ivec3 rmin, glm::ivec3 rmax, int lod, TransferFunction* tf);
+
+  private:
+    std::string m_filepath;
+    std::ifstream m_file;
+
+    glm::uvec3 m_dimensions;
+    glm::dvec3 m_scale;
+    DataStorageSize m_data_storage_size;
+    uint32_t m_brick_size;
+    glm::uvec3 m_number_of_bricks;
+    uint32_t m_histogram_bins;
+
+    std::vector<BrickInfo> m_bricks;
+  };
+}
+
+#endif
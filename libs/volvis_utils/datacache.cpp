@@ -0,0 +1,182 @@
+/**
+ * datacache.cpp
+**/
+#include "datacache.h"
+
+#include <cstdio>
+
+namespace vis
+{
+  DataCache::DataCache (size_t budget_bytes)
+    : m_budget_bytes(budget_bytes)
+    , m_used_bytes(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_evictions(0)
+  {
+  }
+
+  DataCache::~DataCache ()
+  {
+    Clear();
+  }
+
+  bool DataCache::Contains (const DataCacheKey& key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.find(key) != m_entries.end();
+  }
+
+  void DataCache::Erase (const DataCacheKey& key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<DataCacheKey, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end()) return;
+
+    m_used_bytes -= it->second.bytes;
+    m_lru.erase(it->second.lru);
+    m_entries.erase(it);
+  }
+
+  void DataCache::EraseDataset (std::string dataset)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<DataCacheKey, Entry>::iterator it = m_entries.begin();
+    while (it != m_entries.end())
+    {
+      if (it->first.dataset == dataset)
+      {
+        m_used_bytes -= it->second.bytes;
+        m_lru.erase(it->second.lru);
+        it = m_entries.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  void DataCache::Clear ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_used_bytes = 0;
+  }
+
+  void DataCache::SetBudget (size_t budget_bytes)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget_bytes = budget_bytes;
+    EvictToBudget();
+  }
+
+  size_t DataCache::GetBudget ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget_bytes;
+  }
+
+  size_t DataCache::GetUsedBytes ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used_bytes;
+  }
+
+  size_t DataCache::GetNumberOfEntries ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  unsigned long long DataCache::GetHits ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+  }
+
+  unsigned long long DataCache::GetMisses ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+  }
+
+  unsigned long long DataCache::GetEvictions ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_evictions;
+  }
+
+  void DataCache::ResetCounters ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+  }
+
+  void DataCache::PrintStatistics ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    printf("DataCache: %d entries, %.1f/%.1f MB, %llu hits, %llu misses, %llu evictions\n",
+      (int)m_entries.size(), double(m_used_bytes) / (1024.0 * 1024.0), double(m_budget_bytes) / (1024.0 * 1024.0),
+      m_hits, m_misses, m_evictions);
+  }
+
+  std::shared_ptr<void> DataCache::FindEntry (const DataCacheKey& key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<DataCacheKey, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+    {
+      m_misses++;
+      return nullptr;
+    }
+
+    m_hits++;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return it->second.data;
+  }
+
+  bool DataCache::InsertEntry (const DataCacheKey& key, std::shared_ptr<void> data, size_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<DataCacheKey, Entry>::iterator it = m_entries.find(key);
+    if (it != m_entries.end())
+    {
+      m_used_bytes -= it->second.bytes;
+      m_lru.erase(it->second.lru);
+      m_entries.erase(it);
+    }
+
+    if (!data || bytes > m_budget_bytes) return false;
+
+    m_lru.push_front(key);
+
+    Entry& entry = m_entries[key];
+    entry.data = data;
+    entry.bytes = bytes;
+    entry.lru = m_lru.begin();
+    m_used_bytes += bytes;
+
+    EvictToBudget();
+    return true;
+  }
+
+  void DataCache::EvictToBudget ()
+  {
+    while (m_used_bytes > m_budget_bytes && !m_lru.empty())
+    {
+      std::map<DataCacheKey, Entry>::iterator it = m_entries.find(m_lru.back());
+      m_used_bytes -= it->second.bytes;
+      m_entries.erase(it);
+      m_lru.pop_back();
+      m_evictions++;
+    }
+  }
+}
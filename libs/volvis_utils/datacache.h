@@ -0,0 +1,125 @@
+/**
+ * datacache.h
+ *
+ * Memory budgeted LRU cache of volumes and of the CPU products derived from
+ *   them (staging arrays, gradients, summed area tables, octrees...).
+ *
+ * Entries are keyed by (dataset, product, gradient type, transfer function)
+ *   and stored as shared pointers: an evicted entry is only released when
+ *   its last user drops it. Find<T> must be called with the same T used in
+ *   Insert<T>.
+**/
+#ifndef VOL_VIS_UTILS_DATA_CACHE_H
+#define VOL_VIS_UTILS_DATA_CACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace vis
+{
+  class DataCacheKey
+  {
+  public:
+    DataCacheKey (std::string _dataset = "", std::string _product = "",
+                  int _gradient_type = -1, std::string _transfer_function = "")
+      : dataset(_dataset), product(_product)
+      , gradient_type(_gradient_type), transfer_function(_transfer_function)
+    {}
+
+    bool operator< (const DataCacheKey& k) const
+    {
+      return std::tie(dataset, product, gradient_type, transfer_function)
+           < std::tie(k.dataset, k.product, k.gradient_type, k.transfer_function);
+    }
+
+    std::string dataset;
+    std::string product;
+    // -1 if the product does not depend on the gradient
+    int gradient_type;
+    // empty if the product does not depend on the transfer function
+    std::string transfer_function;
+  };
+
+  class DataCache
+  {
+  public:
+    static const size_t DEFAULT_BUDGET_BYTES = size_t(2) << 30;
+
+    DataCache (size_t budget_bytes = DEFAULT_BUDGET_BYTES);
+    ~DataCache ();
+
+    // Returns nullptr on a miss
+    template<typename T>
+    std::shared_ptr<T> Find (const DataCacheKey& key)
+    {
+      return std::static_pointer_cast<T>(FindEntry(key));
+    }
+
+    // Returns false if data is larger than the whole budget (not stored)
+    template<typename T>
+    bool Insert (const DataCacheKey& key, std::shared_ptr<T> data, size_t bytes)
+    {
+      return InsertEntry(key, std::static_pointer_cast<void>(data), bytes);
+    }
+
+    // Shared pointer that releases a new[] allocated array
+    template<typename T>
+    static std::shared_ptr<T> MakeArray (T* data)
+    {
+      return std::shared_ptr<T>(data, std::default_delete<T[]>());
+    }
+
+    // Does not change the LRU order nor the hit/miss counters
+    bool Contains (const DataCacheKey& key);
+
+    void Erase (const DataCacheKey& key);
+    void EraseDataset (std::string dataset);
+    void Clear ();
+
+    void SetBudget (size_t budget_bytes);
+    size_t GetBudget ();
+    size_t GetUsedBytes ();
+    size_t GetNumberOfEntries ();
+
+    unsigned long long GetHits ();
+    unsigned long long GetMisses ();
+    unsigned long long GetEvictions ();
+    void ResetCounters ();
+
+    void PrintStatistics ();
+
+  protected:
+    std::shared_ptr<void> FindEntry (const DataCacheKey& key);
+    bool InsertEntry (const DataCacheKey& key, std::shared_ptr<void> data, size_t bytes);
+    // Must be called with m_mutex locked
+    void EvictToBudget ();
+
+  private:
+    class Entry
+    {
+    public:
+      std::shared_ptr<void> data;
+      size_t bytes;
+      std::list<DataCacheKey>::iterator lru;
+    };
+
+    // front: most recently used
+    std::list<DataCacheKey> m_lru;
+    std::map<DataCacheKey, Entry> m_entries;
+
+    size_t m_budget_bytes;
+    size_t m_used_bytes;
+
+    unsigned long long m_hits;
+    unsigned long long m_misses;
+    unsigned long long m_evictions;
+
+    std::mutex m_mutex;
+  };
+}
+
+#endif
@@ -39,10 +39,13 @@ namespace vis
     ui_dataset_names.clear();
     ui_transferf_names.clear();
 #endif
+    SetPrefetchEnabled(true);
   }
 
   DataManager::~DataManager ()
   {
+    m_prefetcher.reset();
+
     DeleteVolumeData();
     DeleteTransferFunctionData();
   }
@@ -50,6 +53,7 @@ namespace vis
   void DataManager::SetPathToData (std::string s_path_to_data)
   {
     m_path_to_data = s_path_to_data;
+    m_disk_cache.SetDirectory(m_path_to_data + ".cache/");
   }
 
   vis::GRID_VOLUME_DATA_TYPE DataManager::GetInputVolumeDataType ()
@@ -68,6 +72,8 @@ namespace vis
 
   void DataManager::ReadData ()
   {
+    if (m_prefetcher) m_prefetcher->Clear();
+
 #ifdef USE_DATA_PROVIDER
     m_data_provider->ClearStructuredGridFileList();
     m_data_provider->ClearTransferFunctionFileList();
@@ -92,6 +98,7 @@ namespace vis
 
     if (curr_vol_data_type == vis::GRID_VOLUME_DATA_TYPE::STRUCTURED)
     {
+      RefreshDatasetCatalog();
       GenerateStructuredVolumeTexture();
     }
 
@@ -207,9 +214,13 @@ namespace vis
   ////////////////////////////////////////////////////////////////////////
   void DataManager::DeleteVolumeData ()
   {
-    if (curr_vr_volume) delete curr_vr_volume;
+    // the volume itself stays in the data cache
+    curr_vr_volume_ref.reset();
     curr_vr_volume = nullptr;
 
+    m_sequence_timestep_data.reset();
+    m_volume_sequence.reset();
+
     if (curr_gl_tex_structured_volume) delete curr_gl_tex_structured_volume;
     curr_gl_tex_structured_volume = nullptr;
 
@@ -310,34 +321,377 @@ namespace vis
 
   bool DataManager::GenerateStructuredVolumeTexture ()
   {
-    // Read Volume
+    if (IsVolumeSequencePath(GetStructuredDatasetFilePath(GetCurrentVolumeIndex())))
+      return GenerateVolumeSequenceTexture();
+
+    std::string dataset = GetStructuredDatasetCacheKey(GetCurrentVolumeIndex());
+
+    // Read Volume: use the cached or the prefetched dataset if there is one
+    std::shared_ptr<vis::StructuredGridVolume> volume = m_data_cache.Find<vis::StructuredGridVolume>(DataCacheKey(dataset, "volume"));
+    std::shared_ptr<GLfloat> scalar_values = m_data_cache.Find<GLfloat>(DataCacheKey(dataset, "scalar_values"));
+    if (!volume || !scalar_values)
+    {
+      PreparedVolume* prepared = nullptr;
+      if (m_prefetcher) prepared = m_prefetcher->Take(GetCurrentVolumeIndex());
+      if (!prepared) prepared = MakeStructuredVolumeLoadJob(GetCurrentVolumeIndex())();
+      if (!prepared) return false;
+
+      size_t n_voxels = (size_t)prepared->volume->GetWidth() * prepared->volume->GetHeight() * prepared->volume->GetDepth();
+
+      volume = std::shared_ptr<vis::StructuredGridVolume>(prepared->volume);
+      m_data_cache.Insert(DataCacheKey(dataset, "volume"), volume,
+        GetStorageArrayBytes(volume->GetDataStorageSize(), n_voxels));
+
+      scalar_values = DataCache::MakeArray<GLfloat>(prepared->scalar_values);
+      m_data_cache.Insert(DataCacheKey(dataset, "scalar_values"), scalar_values, n_voxels * sizeof(GLfloat));
+
+      if (prepared->gradient_values)
+      {
+        m_data_cache.Insert(DataCacheKey(dataset, "gradient", (int)prepared->gradient_type),
+          DataCache::MakeArray<glm::vec3>(prepared->gradient_values), n_voxels * sizeof(glm::vec3));
+      }
+
+      prepared->volume = nullptr;
+      prepared->scalar_values = nullptr;
+      prepared->gradient_values = nullptr;
+      delete prepared;
+    }
+
+    curr_vr_volume_ref = volume;
+    curr_vr_volume = volume.get();
+
+    // Generate Volume Texture, only the upload is left to do here
+    curr_gl_tex_structured_volume = vis::GenerateRTextureFromData(scalar_values.get(),
+      curr_vr_volume->GetWidth(), curr_vr_volume->GetHeight(), curr_vr_volume->GetDepth());
+
+    // Generate gradient, if enabled
+    GenerateStructuredGradientTexture();
+
+    PrefetchNeighbourVolumes();
+
+    return true;
+  }
+
+  VolumePrefetcher::LoadJob DataManager::MakeStructuredVolumeLoadJob (int index)
+  {
+    STRUCTURED_GRADIENT_TYPE sgt = curr_gradient_comp_model;
+    DiskCache* disk_cache = &m_disk_cache;
 #ifdef USE_DATA_PROVIDER
-    curr_vr_volume = m_data_provider->LoadStructuredGrid(GetCurrentVolumeIndex());
+    DataProvider* data_provider = m_data_provider.get();
+    return [data_provider, index, sgt, disk_cache] () -> PreparedVolume* {
+      return DataManager::PrepareStructuredVolume(data_provider->LoadStructuredGrid(index), index, sgt, disk_cache);
+    };
 #else
-    vis::VolumeReader vr;
-    curr_vr_volume = vr.ReadStructuredVolume(stored_structured_datasets[GetCurrentVolumeIndex()].path);
-    curr_vr_volume->SetName(stored_structured_datasets[GetCurrentVolumeIndex()].name); 
+    DataReference ref = stored_structured_datasets[index];
+    return [ref, index, sgt, disk_cache] () -> PreparedVolume* {
+      vis::VolumeReader vr;
+      vis::StructuredGridVolume* vol = vr.ReadStructuredVolume(ref.path);
+      if (vol) vol->SetName(ref.name);
+      return DataManager::PrepareStructuredVolume(vol, index, sgt, disk_cache);
+    };
 #endif
+  }
 
-    // Generate Volume Texture
-    curr_gl_tex_structured_volume = vis::GenerateRTexture(curr_vr_volume, 0, 0, 0, curr_vr_volume->GetWidth(),
-      curr_vr_volume->GetHeight(), curr_vr_volume->GetDepth());
+  PreparedVolume* DataManager::PrepareStructuredVolume (vis::StructuredGridVolume* vol, int index,
+                                                        STRUCTURED_GRADIENT_TYPE sgt, DiskCache* disk_cache)
+  {
+    if (!vol) return nullptr;
+
+    PreparedVolume* prepared = new PreparedVolume();
+    prepared->index = index;
+    prepared->gradient_type = sgt;
+    prepared->volume = vol;
+
+    prepared->scalar_values = vis::GenerateRTextureData(vol);
+
+    // Hash the voxels here, so the renderers can look up their disk cache
+    //   entries without paying for it on the GL thread
+    if (disk_cache && disk_cache->IsEnabled())
+      vol->GetContentHash();
+
+    // The compute shader gradient needs the GL thread
+    prepared->gradient_values = GenerateStructuredGradientData(vol, sgt, disk_cache);
+
+    return prepared;
+  }
+
+  bool DataManager::IsVolumeSequencePath (std::string filepath)
+  {
+    std::string extension = filepath.substr(filepath.find_last_of('.') + 1);
+    return extension.compare("tvol") == 0 || extension.compare("tseq") == 0;
+  }
+
+  bool DataManager::GenerateVolumeSequenceTexture ()
+  {
+    m_volume_sequence = std::make_unique<VolumeSequence>();
+    m_volume_sequence->SetPrepareFunction(MakeVolumeSequencePrepareFunction());
+    if (!m_volume_sequence->Open(GetStructuredDatasetFilePath(GetCurrentVolumeIndex())))
+    {
+      m_volume_sequence.reset();
+      return false;
+    }
+
+    std::shared_ptr<PreparedVolume> timestep_data = m_volume_sequence->GetCurrentTimestepData();
+    if (!timestep_data)
+    {
+      m_volume_sequence.reset();
+      return false;
+    }
+    SetCurrentSequenceTimestep(timestep_data);
+
+    curr_gl_tex_structured_volume = vis::GenerateRTextureFromData(timestep_data->scalar_values,
+      curr_vr_volume->GetWidth(), curr_vr_volume->GetHeight(), curr_vr_volume->GetDepth());
 
-    // Generate gradient, if enabled
     GenerateStructuredGradientTexture();
 
     return true;
   }
 
-  bool DataManager::GenerateStructuredGradientTexture ()
+  VolumeSequence::PrepareFunction DataManager::MakeVolumeSequencePrepareFunction ()
+  {
+    STRUCTURED_GRADIENT_TYPE sgt = curr_gradient_comp_model;
+    std::string name = GetCurrentVolumeName();
+    // the timesteps are not kept in the disk cache either
+    return [sgt, name] (vis::StructuredGridVolume* vol, int timestep) -> PreparedVolume* {
+      vol->SetName(name + " [" + std::to_string(timestep) + "]");
+      return DataManager::PrepareStructuredVolume(vol, timestep, sgt, nullptr);
+    };
+  }
+
+  void DataManager::SetCurrentSequenceTimestep (std::shared_ptr<PreparedVolume> timestep_data)
+  {
+    m_sequence_timestep_data = timestep_data;
+    // the volume lives as long as the prepared timestep
+    curr_vr_volume_ref = std::shared_ptr<vis::StructuredGridVolume>(timestep_data, timestep_data->volume);
+    curr_vr_volume = timestep_data->volume;
+  }
+
+  glm::vec3* DataManager::GetSequenceTimestepGradientData ()
+  {
+    PreparedVolume* timestep_data = m_sequence_timestep_data.get();
+    if (!timestep_data->gradient_values || timestep_data->gradient_type != curr_gradient_comp_model)
+    {
+      if (timestep_data->gradient_values) delete[] timestep_data->gradient_values;
+      timestep_data->gradient_values = GenerateStructuredGradientData(curr_vr_volume, curr_gradient_comp_model, nullptr);
+      timestep_data->gradient_type = curr_gradient_comp_model;
+    }
+    return timestep_data->gradient_values;
+  }
+
+  vis::VolumeSequence* DataManager::GetCurrentVolumeSequence ()
   {
-    if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::SOBEL_FELDMAN_FILTER)
+    return m_volume_sequence.get();
+  }
+
+  bool DataManager::UpdateVolumeSequence ()
+  {
+    if (!m_volume_sequence || !m_volume_sequence->Update()) return false;
+
+    std::shared_ptr<PreparedVolume> timestep_data = m_volume_sequence->GetCurrentTimestepData();
+    if (!timestep_data) return false;
+
+    vis::StructuredGridVolume* vol = timestep_data->volume;
+    bool same_size = curr_gl_tex_structured_volume
+      && curr_gl_tex_structured_volume->GetWidth() == vol->GetWidth()
+      && curr_gl_tex_structured_volume->GetHeight() == vol->GetHeight()
+      && curr_gl_tex_structured_volume->GetDepth() == vol->GetDepth();
+    SetCurrentSequenceTimestep(timestep_data);
+
+    // same texture ids, so the renderers do not have to rebind them
+    if (same_size)
+    {
+      vis::UpdateRTextureData(curr_gl_tex_structured_volume, timestep_data->scalar_values);
+    }
+    else
+    {
+      if (curr_gl_tex_structured_volume) delete curr_gl_tex_structured_volume;
+      curr_gl_tex_structured_volume = vis::GenerateRTextureFromData(timestep_data->scalar_values,
+        vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
+    }
+
+    if (same_size && curr_gl_tex_structured_gradient
+     && IsCPUGradientType(curr_gradient_comp_model))
     {
-      curr_gl_tex_structured_gradient = vis::GenerateSobelFeldmanGradientTexture(curr_vr_volume);
+      vis::UpdateGradientTextureData(curr_gl_tex_structured_gradient, GetSequenceTimestepGradientData());
     }
-    else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
+    else
+    {
+      DeleteGradientData();
+      GenerateStructuredGradientTexture();
+    }
+
+    return true;
+  }
+
+  bool DataManager::IsCPUGradientType (STRUCTURED_GRADIENT_TYPE sgt)
+  {
+    return sgt == STRUCTURED_GRADIENT_TYPE::SOBEL_FELDMAN_FILTER
+        || sgt == STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN
+        || sgt == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES;
+  }
+
+  glm::vec3* DataManager::GenerateStructuredGradientData (vis::StructuredGridVolume* vol,
+                                                          STRUCTURED_GRADIENT_TYPE sgt, DiskCache* disk_cache)
+  {
+    if (!IsCPUGradientType(sgt))
+      return nullptr;
+
+    size_t n_voxels = (size_t)vol->GetWidth() * vol->GetHeight() * vol->GetDepth();
+    bool use_disk_cache = disk_cache && disk_cache->IsEnabled();
+
+    DiskCacheKey key(use_disk_cache ? vol->GetContentHash() : "", "gradient", "type=" + std::to_string((int)sgt));
+    glm::vec3* gradient_values = nullptr;
+    if (use_disk_cache)
+      gradient_values = disk_cache->LoadArray<glm::vec3>(key, n_voxels);
+
+    if (!gradient_values)
     {
-      curr_gl_tex_structured_gradient = vis::GenerateGradientTexture(curr_vr_volume);
+      if (sgt == STRUCTURED_GRADIENT_TYPE::SOBEL_FELDMAN_FILTER)
+        gradient_values = vis::GenerateSobelFeldmanGradientData(vol);
+      else if (sgt == STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN)
+        gradient_values = vis::GenerateSeparableSobelFeldmanGradientData(vol);
+      else
+        gradient_values = vis::GenerateGradientData(vol);
+
+      if (use_disk_cache)
+        disk_cache->Store(key, gradient_values, n_voxels * sizeof(glm::vec3));
+    }
+    return gradient_values;
+  }
+
+  void DataManager::PrefetchNeighbourVolumes ()
+  {
+    if (!m_prefetcher) return;
+
+    std::vector<int> neighbours;
+    if (GetCurrentVolumeIndex() - 1 >= 0)
+      neighbours.push_back(GetCurrentVolumeIndex() - 1);
+    if (GetCurrentVolumeIndex() + 1 < GetNumberOfStructuredDatasets())
+      neighbours.push_back(GetCurrentVolumeIndex() + 1);
+
+    // sequences are decoded by their own thread when they are opened
+    for (int i = (int)neighbours.size() - 1; i >= 0; i--)
+      if (IsVolumeSequencePath(GetStructuredDatasetFilePath(neighbours[i])))
+        neighbours.erase(neighbours.begin() + i);
+
+    // already cached datasets do not need to be read again
+    for (int i = (int)neighbours.size() - 1; i >= 0; i--)
+    {
+      std::string dataset = GetStructuredDatasetCacheKey(neighbours[i]);
+      if (m_data_cache.Contains(DataCacheKey(dataset, "volume"))
+       && m_data_cache.Contains(DataCacheKey(dataset, "scalar_values")))
+        neighbours.erase(neighbours.begin() + i);
+    }
+
+    m_prefetcher->Retain(neighbours);
+    for (int i = 0; i < neighbours.size(); i++)
+      m_prefetcher->Request(neighbours[i], MakeStructuredVolumeLoadJob(neighbours[i]));
+  }
+
+  std::string DataManager::GetStructuredDatasetCacheKey (int index)
+  {
+#ifdef USE_DATA_PROVIDER
+    return m_data_provider->GetStructuredGridNameList()[index];
+#else
+    return stored_structured_datasets[index].path;
+#endif
+  }
+
+  std::string DataManager::GetStructuredDatasetFilePath (int index)
+  {
+#ifdef USE_DATA_PROVIDER
+    return m_data_provider->GetStructuredGridFilePath(index);
+#else
+    return stored_structured_datasets[index].path;
+#endif
+  }
+
+  vis::DataCache* DataManager::GetDataCache ()
+  {
+    return &m_data_cache;
+  }
+
+  vis::DiskCache* DataManager::GetDiskCache ()
+  {
+    return &m_disk_cache;
+  }
+
+  bool DataManager::UseDiskCache ()
+  {
+    return m_disk_cache.IsEnabled() && !m_volume_sequence;
+  }
+
+  vis::DatasetCatalog* DataManager::GetDatasetCatalog ()
+  {
+    return &m_dataset_catalog;
+  }
+
+  void DataManager::RefreshDatasetCatalog ()
+  {
+    std::vector<DatasetCatalogSource> sources;
+#ifdef USE_DATA_PROVIDER
+    DataProvider* data_provider = m_data_provider.get();
+    for (int i = 0; i < m_data_provider->GetNumberOfStructuredGrids(); i++)
+    {
+      sources.push_back(DatasetCatalogSource(m_data_provider->GetStructuredGridNameList()[i],
+        m_data_provider->GetStructuredGridFilePath(i),
+        [data_provider, i] () -> vis::StructuredGridVolume* { return data_provider->LoadStructuredGrid(i); }));
+    }
+#else
+    for (int i = 0; i < stored_structured_datasets.size(); i++)
+      sources.push_back(DatasetCatalogSource(stored_structured_datasets[i].name, stored_structured_datasets[i].path));
+#endif
+
+    m_dataset_catalog.SetIndexFilePath(m_path_to_data + "volume_list.catalog");
+    m_dataset_catalog.Load();
+    m_dataset_catalog.Refresh(sources);
+  }
+
+  std::string DataManager::GetCurrentVolumeCacheKey ()
+  {
+    // products of a timestep must not be reused by the others
+    if (m_volume_sequence)
+      return GetStructuredDatasetCacheKey(GetCurrentVolumeIndex()) + "#" + std::to_string(m_volume_sequence->GetCurrentTimestep());
+    return GetStructuredDatasetCacheKey(GetCurrentVolumeIndex());
+  }
+
+  void DataManager::SetPrefetchEnabled (bool enabled)
+  {
+    if (enabled && !m_prefetcher)
+      m_prefetcher = std::make_unique<VolumePrefetcher>(2);
+    else if (!enabled)
+      m_prefetcher.reset();
+  }
+
+  bool DataManager::IsPrefetchEnabled ()
+  {
+    return (m_prefetcher != nullptr);
+  }
+
+  bool DataManager::GenerateStructuredGradientTexture ()
+  {
+    if (IsCPUGradientType(curr_gradient_comp_model))
+    {
+      if (m_volume_sequence)
+      {
+        curr_gl_tex_structured_gradient = vis::GenerateGradientTextureFromData(GetSequenceTimestepGradientData(),
+          curr_vr_volume->GetWidth(), curr_vr_volume->GetHeight(), curr_vr_volume->GetDepth());
+        return true;
+      }
+
+      DataCacheKey key(GetCurrentVolumeCacheKey(), "gradient", (int)curr_gradient_comp_model);
+      std::shared_ptr<glm::vec3> gradient_values = m_data_cache.Find<glm::vec3>(key);
+      if (!gradient_values)
+      {
+        gradient_values = DataCache::MakeArray<glm::vec3>(
+          GenerateStructuredGradientData(curr_vr_volume, curr_gradient_comp_model, &m_disk_cache));
+
+        m_data_cache.Insert(key, gradient_values, sizeof(glm::vec3) *
+          (size_t)curr_vr_volume->GetWidth() * curr_vr_volume->GetHeight() * curr_vr_volume->GetDepth());
+      }
+
+      curr_gl_tex_structured_gradient = vis::GenerateGradientTextureFromData(gradient_values.get(),
+        curr_vr_volume->GetWidth(), curr_vr_volume->GetHeight(), curr_vr_volume->GetDepth());
     }
     else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL)
     {
@@ -498,6 +852,10 @@ namespace vis
   
   bool DataManager::UpdateStructuredGradientTexture ()
   {
+    // timesteps decoded from now on are prepared with the new gradient type
+    if (m_volume_sequence)
+      m_volume_sequence->SetPrepareFunction(MakeVolumeSequencePrepareFunction());
+
     DeleteGradientData();
     return GenerateStructuredGradientTexture();
   }
@@ -510,18 +868,22 @@ namespace vis
       {
         return 0;
       }
-      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
+      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN)
       {
         return 1;
       }
-      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL)
+      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
       {
         return 2;
       }
-      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::NONE_GRADIENT)
+      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL)
       {
         return 3;
       }
+      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::NONE_GRADIENT)
+      {
+        return 4;
+      }
     }
     return -1;
   }
@@ -532,12 +894,14 @@ namespace vis
     {
       if (sgt == STRUCTURED_GRADIENT_TYPE::SOBEL_FELDMAN_FILTER)
         return 0;
-      else if (sgt == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
+      else if (sgt == STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN)
         return 1;
-      else if (sgt == STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL)
+      else if (sgt == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
         return 2;
-      else
+      else if (sgt == STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL)
         return 3;
+      else
+        return 4;
     }
     return -1;
   }
@@ -550,8 +914,10 @@ namespace vis
       if (idx == 0)
         sgt = STRUCTURED_GRADIENT_TYPE::SOBEL_FELDMAN_FILTER;
       else if (idx == 1)
-        sgt = STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES;
+        sgt = STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN;
       else if (idx == 2)
+        sgt = STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES;
+      else if (idx == 3)
         sgt = STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL;
     }
 
@@ -569,6 +935,10 @@ namespace vis
       {
         return "Sobel-Feldman";
       }
+      else if (sgt == STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN)
+      {
+        return "Sobel-Feldman (Separable)";
+      }
       else if (sgt == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
       {
         return "Finite Diferences";
@@ -589,6 +959,10 @@ namespace vis
       {
         return "Sobel-Feldman";
       }
+      else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN)
+      {
+        return "Sobel-Feldman (Separable)";
+      }
       else if (curr_gradient_comp_model == STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES)
       {
         return "Finite Diferences";
@@ -605,6 +979,7 @@ namespace vis
   {
     std::vector<std::string> vlist;
     vlist.push_back(GetGradientName(STRUCTURED_GRADIENT_TYPE::SOBEL_FELDMAN_FILTER));
+    vlist.push_back(GetGradientName(STRUCTURED_GRADIENT_TYPE::SEPARABLE_SOBEL_FELDMAN));
     vlist.push_back(GetGradientName(STRUCTURED_GRADIENT_TYPE::FINITE_DIFERENCES));
     vlist.push_back(GetGradientName(STRUCTURED_GRADIENT_TYPE::COMPUTE_SHADER_SOBEL));
     vlist.push_back(GetGradientName(STRUCTURED_GRADIENT_TYPE::NONE_GRADIENT));
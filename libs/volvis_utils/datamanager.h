@@ -17,6 +17,10 @@
  * <path to file 5 from "path to resources"> <name of file 5 to be displayed in UI>
  * ... until eof
  *
+ * A path to a .tvol file or a .tseq list of timestep files is a time-varying
+ *   dataset: its timesteps are decoded in background and UpdateVolumeSequence
+ *   replaces the contents of the volume and gradient textures.
+ *
  * Leonardo Quatrin Campagnolo
  * . campagnolo.lq@gmail.com
 **/
@@ -24,6 +28,7 @@
 #define VOL_VIS_UTILS_DATA_MANAGER_H
 
 #include <iostream>
+#include <memory>
 
 #include <volvis_utils/dataprovider.h>
 #include <volvis_utils/gridvolume.h>
@@ -31,6 +36,11 @@
 #include <volvis_utils/unstructuredgridvolume.h>
 #include <volvis_utils/transferfunction.h>
 #include <volvis_utils/reader.h>
+#include <volvis_utils/volumeprefetcher.h>
+#include <volvis_utils/volumesequence.h>
+#include <volvis_utils/datacache.h>
+#include <volvis_utils/diskcache.h>
+#include <volvis_utils/datasetcatalog.h>
 
 #include <gl_utils/texture3d.h>
 #include <gl_utils/texture1d.h>
@@ -65,7 +75,9 @@ namespace vis
       SOBEL_FELDMAN_FILTER = 0,
       FINITE_DIFERENCES    = 1,
       COMPUTE_SHADER_SOBEL = 2,
-      NONE_GRADIENT        = 3
+      NONE_GRADIENT        = 3,
+      // same gradients as SOBEL_FELDMAN_FILTER, separable passes
+      SEPARABLE_SOBEL_FELDMAN = 4
     };
 
     DataManager ();
@@ -103,6 +115,30 @@ namespace vis
     bool SetVolume (std::string name);
     bool SetCurrentInputVolume (int id);
 
+    // Read and preprocess the previous and next datasets on worker threads,
+    //   so switching to them only has to upload the textures
+    void SetPrefetchEnabled (bool enabled);
+    bool IsPrefetchEnabled ();
+
+    // Volumes and derived CPU products of the visited datasets. Renderers may
+    //   store their own products using GetCurrentVolumeCacheKey as dataset.
+    vis::DataCache* GetDataCache ();
+    std::string GetCurrentVolumeCacheKey ();
+    // Preprocessing results kept between launches, in <path to data>/.cache/
+    vis::DiskCache* GetDiskCache ();
+    // False while a time-varying dataset is played: its timesteps are not
+    //   kept in the disk cache, neither are the products derived from them
+    bool UseDiskCache ();
+    // Metadata, statistics and thumbnails of the structured datasets, built
+    //   in background by ReadData and kept in <path to data>/volume_list.catalog
+    vis::DatasetCatalog* GetDatasetCatalog ();
+
+    // nullptr if the current dataset is not time-varying
+    vis::VolumeSequence* GetCurrentVolumeSequence ();
+    // Advance the playback of the current sequence and upload the new
+    //   timestep (GL thread only). Returns true if the volume changed.
+    bool UpdateVolumeSequence ();
+
     bool PreviousTransferFunction ();
     bool NextTransferFunction ();
     bool SetTransferFunction (std::string name);
@@ -131,6 +167,30 @@ namespace vis
     bool GenerateStructuredVolumeTexture ();
     bool GenerateStructuredGradientTexture ();
 
+    // Job that reads dataset index and builds its CPU data (no GL calls)
+    VolumePrefetcher::LoadJob MakeStructuredVolumeLoadJob (int index);
+    static PreparedVolume* PrepareStructuredVolume (vis::StructuredGridVolume* vol, int index,
+                                                    STRUCTURED_GRADIENT_TYPE sgt, DiskCache* disk_cache);
+    // Gradient types computed on the CPU (SOBEL_FELDMAN_FILTER,
+    //   SEPARABLE_SOBEL_FELDMAN, FINITE_DIFERENCES)
+    static bool IsCPUGradientType (STRUCTURED_GRADIENT_TYPE sgt);
+    // CPU gradients read from the disk cache or computed and stored in it.
+    //   Safe to call from worker threads.
+    static glm::vec3* GenerateStructuredGradientData (vis::StructuredGridVolume* vol,
+                                                      STRUCTURED_GRADIENT_TYPE sgt, DiskCache* disk_cache);
+    void PrefetchNeighbourVolumes ();
+    std::string GetStructuredDatasetCacheKey (int index);
+    std::string GetStructuredDatasetFilePath (int index);
+    void RefreshDatasetCatalog ();
+
+    static bool IsVolumeSequencePath (std::string filepath);
+    bool GenerateVolumeSequenceTexture ();
+    VolumeSequence::PrepareFunction MakeVolumeSequencePrepareFunction ();
+    void SetCurrentSequenceTimestep (std::shared_ptr<PreparedVolume> timestep_data);
+    // gradients of the current timestep for curr_gradient_comp_model,
+    //   computed here if the decoder prepared another type
+    glm::vec3* GetSequenceTimestepGradientData ();
+
     // Compute Shaders doesn't support rgb textures, so
     //  we bind 3 r textures, set the data in the shader,
     //  then we group into a single array and set into a
@@ -142,6 +202,8 @@ namespace vis
 
     // structured datasets
     vis::StructuredGridVolume* curr_vr_volume;
+    // keeps curr_vr_volume alive if it is evicted from the cache
+    std::shared_ptr<vis::StructuredGridVolume> curr_vr_volume_ref;
     gl::Texture3D* curr_gl_tex_structured_volume;
 
     // unstructured datasets
@@ -168,6 +230,18 @@ namespace vis
     std::vector<std::string> ui_dataset_names;
     std::vector<std::string> ui_transferf_names;
 #endif
+
+    vis::DataCache m_data_cache;
+    vis::DiskCache m_disk_cache;
+    // its worker may use m_data_provider, so it must be destroyed first
+    vis::DatasetCatalog m_dataset_catalog;
+
+    // time-varying dataset, timesteps are not stored in the data cache
+    std::unique_ptr<VolumeSequence> m_volume_sequence;
+    std::shared_ptr<PreparedVolume> m_sequence_timestep_data;
+
+    // declared last: its workers must stop before the lists are destroyed
+    std::unique_ptr<VolumePrefetcher> m_prefetcher;
   private:
 
   };
@@ -131,6 +131,38 @@ namespace vis
     return m_uiname_list_structured_grid;
   }
 
+  std::string DataProvider::GetStructuredGridFilePath (unsigned int id)
+  {
+    if (m_file_list_structured_grid_type == DATA_PROVIDER_FILE_TYPE_EXT::NO_EXTENSION) {
+      std::string str_file = m_path_list_structured_grid + m_file_list_structured_grid;
+
+      std::ifstream f_open_file(str_file);
+      if (!f_open_file.is_open()) return "";
+
+      int volume_id = 0;
+      while (!f_open_file.eof()) {
+        std::string line;
+        std::getline(f_open_file, line);
+        if (volume_id == id) {
+          int start_path = line.find_first_of("<") + 1;
+          int end_path = line.find_first_of(">");
+
+          return m_path_list_structured_grid + "/" + line.substr(start_path, end_path - start_path);
+        }
+        volume_id++;
+      }
+    }
+    else if (m_file_list_structured_grid_type == DATA_PROVIDER_FILE_TYPE_EXT::CSV) {
+      std::vector<std::string> values;
+      GetCSVStructuredGridTags(values, id);
+
+      std::pair<bool, std::string> str_source = m_csv_str_grid->GetTagValue(values, "Source");
+      std::pair<bool, std::string> str_file = m_csv_str_grid->GetTagValue(values, "File");
+      return m_path_list_structured_grid + "/" + str_source.second + "/" + str_file.second;
+    }
+    return "";
+  }
+
   vis::StructuredGridVolume* DataProvider::LoadStructuredGrid (unsigned int id)
   {
     vis::StructuredGridVolume* sg = nullptr;
@@ -23,6 +23,8 @@ namespace vis
     int GetNumberOfStructuredGrids ();
     int FindStructuredGridName (std::string name);
     std::vector<std::string>& GetStructuredGridNameList ();
+    // Path of the file read by LoadStructuredGrid (id)
+    std::string GetStructuredGridFilePath (unsigned int id);
 
     // Load Structured Grid
     vis::StructuredGridVolume* LoadStructuredGrid (unsigned int id);
@@ -0,0 +1,456 @@
+/**
+ * datasetcatalog.cpp
+**/
+#include "datasetcatalog.h"
+
+#include <volvis_utils/reader.h>
+#include <volvis_utils/volumestatistics.h>
+#include <file_utils/mappedfile.h>
+#include <file_utils/sha256.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace vis
+{
+  static const char DATASET_CATALOG_MAGIC[4] = { 'V', 'C', 'A', 'T' };
+
+  template<typename T>
+  static void WriteValue (std::ofstream& file, T value)
+  {
+    file.write((const char*)&value, sizeof(T));
+  }
+
+  template<typename T>
+  static bool ReadValue (std::ifstream& file, T* value)
+  {
+    file.read((char*)value, sizeof(T));
+    return file.good();
+  }
+
+  static void WriteString (std::ofstream& file, const std::string& str)
+  {
+    WriteValue<uint32_t>(file, (uint32_t)str.size());
+    file.write(str.data(), str.size());
+  }
+
+  static bool ReadString (std::ifstream& file, std::string* str)
+  {
+    uint32_t length = 0;
+    if (!ReadValue(file, &length) || length > (1u << 16)) return false;
+    str->assign(length, '\0');
+    if (length > 0) file.read(&(*str)[0], length);
+    return file.good();
+  }
+
+  DatasetCatalogEntry::DatasetCatalogEntry ()
+    : file_time(0)
+    , file_size(0)
+    , dimensions(0)
+    , spacing(1.0)
+    , data_storage_size(DataStorageSize::UNKNOWN)
+    , min_value(0.0)
+    , max_value(0.0)
+    , thumbnail_size(0)
+  {
+  }
+
+  size_t DatasetCatalogEntry::GetVoxelBytes () const
+  {
+    return GetStorageArrayBytes(data_storage_size, size_t(dimensions.x) * size_t(dimensions.y) * size_t(dimensions.z));
+  }
+
+  DatasetCatalog::DatasetCatalog ()
+    : m_busy(false)
+    , m_stop(false)
+  {
+    m_worker = std::thread(&DatasetCatalog::WorkerLoop, this);
+  }
+
+  DatasetCatalog::~DatasetCatalog ()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+      m_jobs.clear();
+    }
+    m_cond_jobs.notify_all();
+    m_cond_idle.notify_all();
+
+    // the worker finishes the entry it is building before leaving
+    if (m_worker.joinable()) m_worker.join();
+  }
+
+  void DatasetCatalog::SetIndexFilePath (std::string filepath)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_index_filepath = filepath;
+  }
+
+  std::string DatasetCatalog::GetIndexFilePath ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_index_filepath;
+  }
+
+  bool DatasetCatalog::Load ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+
+    std::ifstream file(m_index_filepath, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t n_entries = 0;
+    file.read(magic, 4);
+    if (!file.good() || memcmp(magic, DATASET_CATALOG_MAGIC, 4) != 0
+      || !ReadValue(file, &version) || version != VERSION || !ReadValue(file, &n_entries))
+    {
+      printf("DatasetCatalog: invalid index %s\n", m_index_filepath.c_str());
+      return false;
+    }
+
+    for (uint32_t i = 0; i < n_entries; i++)
+    {
+      DatasetCatalogEntry entry;
+      uint32_t dss = 0, n_bins = 0;
+      bool valid = ReadString(file, &entry.name) && ReadString(file, &entry.filepath)
+        && ReadValue(file, &entry.file_time) && ReadValue(file, &entry.file_size)
+        && ReadValue(file, &entry.dimensions.x) && ReadValue(file, &entry.dimensions.y) && ReadValue(file, &entry.dimensions.z)
+        && ReadValue(file, &entry.spacing.x) && ReadValue(file, &entry.spacing.y) && ReadValue(file, &entry.spacing.z)
+        && ReadValue(file, &dss) && ReadValue(file, &entry.min_value) && ReadValue(file, &entry.max_value)
+        && ReadValue(file, &n_bins) && n_bins == HISTOGRAM_BINS;
+
+      if (valid)
+      {
+        entry.data_storage_size = (DataStorageSize)dss;
+        entry.histogram.resize(n_bins);
+        file.read((char*)entry.histogram.data(), n_bins * sizeof(uint32_t));
+        valid = file.good() && ReadString(file, &entry.content_hash)
+          && ReadValue(file, &entry.thumbnail_size.x) && ReadValue(file, &entry.thumbnail_size.y)
+          && entry.thumbnail_size.x <= THUMBNAIL_SIZE && entry.thumbnail_size.y <= THUMBNAIL_SIZE;
+      }
+
+      if (valid)
+      {
+        entry.thumbnail.resize(size_t(entry.thumbnail_size.x) * size_t(entry.thumbnail_size.y));
+        if (!entry.thumbnail.empty()) file.read((char*)entry.thumbnail.data(), entry.thumbnail.size());
+        valid = file.good();
+      }
+
+      if (!valid)
+      {
+        printf("DatasetCatalog: truncated index %s\n", m_index_filepath.c_str());
+        m_entries.clear();
+        return false;
+      }
+      m_entries[entry.name] = entry;
+    }
+
+    return true;
+  }
+
+  bool DatasetCatalog::Save ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return WriteIndex();
+  }
+
+  void DatasetCatalog::Refresh (const std::vector<DatasetCatalogSource>& sources)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.clear();
+      m_sources.clear();
+      for (size_t i = 0; i < sources.size(); i++)
+        m_sources[sources[i].name] = sources[i];
+
+      bool removed = false;
+      for (std::map<std::string, DatasetCatalogEntry>::iterator it = m_entries.begin(); it != m_entries.end();)
+      {
+        if (m_sources.count(it->first) == 0)
+        {
+          it = m_entries.erase(it);
+          removed = true;
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      if (removed) WriteIndex();
+
+      for (size_t i = 0; i < sources.size(); i++)
+      {
+        int64_t file_time = 0;
+        uint64_t file_size = 0;
+        bool exists = GetFileStatus(sources[i].filepath, &file_time, &file_size);
+
+        std::map<std::string, DatasetCatalogEntry>::iterator it = m_entries.find(sources[i].name);
+        if (it != m_entries.end() && exists && it->second.filepath == sources[i].filepath
+          && it->second.file_time == file_time && it->second.file_size == file_size)
+          continue;
+
+        m_jobs.push_back(sources[i]);
+      }
+
+      if (m_jobs.empty()) return;
+      printf("DatasetCatalog: %d of %d datasets to index\n", (int)m_jobs.size(), (int)sources.size());
+    }
+    m_cond_jobs.notify_one();
+  }
+
+  bool DatasetCatalog::IsBuilding ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_busy || !m_jobs.empty();
+  }
+
+  void DatasetCatalog::Wait ()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond_idle.wait(lock, [this] { return m_stop || (!m_busy && m_jobs.empty()); });
+  }
+
+  int DatasetCatalog::GetNumberOfEntries ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (int)m_entries.size();
+  }
+
+  bool DatasetCatalog::GetEntry (std::string name, DatasetCatalogEntry* entry)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::string, DatasetCatalogEntry>::iterator it = m_entries.find(name);
+    if (it == m_entries.end()) return false;
+    *entry = it->second;
+    return true;
+  }
+
+  std::vector<DatasetCatalogEntry> DatasetCatalog::GetEntries ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<DatasetCatalogEntry> entries;
+    for (std::map<std::string, DatasetCatalogEntry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+      entries.push_back(it->second);
+    return entries;
+  }
+
+  void DatasetCatalog::BuildEntry (StructuredGridVolume* vol, DatasetCatalogEntry* entry)
+  {
+    int w = (int)vol->GetWidth(), h = (int)vol->GetHeight(), d = (int)vol->GetDepth();
+    entry->dimensions = glm::uvec3(w, h, d);
+    entry->spacing = glm::dvec3(vol->GetScaleX(), vol->GetScaleY(), vol->GetScaleZ());
+    entry->data_storage_size = vol->GetDataStorageSize();
+
+    // thumbnail keeps the aspect ratio of the xy plane
+    double t_scale = std::min(1.0, double(THUMBNAIL_SIZE) / double(std::max(w, h)));
+    int tw = std::max(1, (int)std::ceil(w * t_scale));
+    int th = std::max(1, (int)std::ceil(h * t_scale));
+    std::vector<int> tx(w), ty(h);
+    for (int x = 0; x < w; x++) tx[x] = std::min(tw - 1, (int)(x * t_scale));
+    for (int y = 0; y < h; y++) ty[y] = std::min(th - 1, (int)(y * t_scale));
+
+    // range, histogram and content hash in one pass, cached on the volume
+    const VolumeStatistics* statistics = vol->GetStatistics(HISTOGRAM_BINS);
+    entry->min_value = statistics ? statistics->GetMin() : 0.0;
+    entry->max_value = statistics ? statistics->GetMax() : 0.0;
+    entry->histogram.assign(HISTOGRAM_BINS, 0);
+    if (statistics)
+      for (int i = 0; i < HISTOGRAM_BINS; i++) entry->histogram[i] = (uint32_t)statistics->GetHistogram()[i];
+
+    double max_density = vol->GetMaxDensity();
+    if (max_density <= 0.0) max_density = 1.0;
+    std::vector<double> mip(size_t(tw) * size_t(th), 0.0);
+
+#pragma omp parallel
+    {
+      std::vector<double> l_mip(mip.size(), 0.0);
+
+#pragma omp for nowait
+      for (int z = 0; z < d; z++)
+      {
+        for (int y = 0; y < h; y++)
+        {
+          double* mip_row = l_mip.data() + size_t(ty[y]) * size_t(tw);
+          for (int x = 0; x < w; x++)
+          {
+            double normalized = vol->GetAbsoluteSample(x, y, z) / max_density;
+            mip_row[tx[x]] = std::max(mip_row[tx[x]], normalized);
+          }
+        }
+      }
+
+#pragma omp critical
+      {
+        for (size_t i = 0; i < mip.size(); i++) mip[i] = std::max(mip[i], l_mip[i]);
+      }
+    }
+
+    entry->thumbnail_size = glm::uvec2(tw, th);
+    entry->thumbnail.resize(mip.size());
+    for (size_t i = 0; i < mip.size(); i++)
+      entry->thumbnail[i] = (unsigned char)(std::max(0.0, std::min(1.0, mip[i])) * 255.0 + 0.5);
+
+    // volumes without voxel array (out-of-core) are identified by their file
+    entry->content_hash = vol->GetContentHash();
+    if (entry->content_hash.empty() && !entry->filepath.empty())
+    {
+      MappedFile mapped_file;
+      if (mapped_file.Open(entry->filepath))
+        entry->content_hash = SHA256::ChunkedHexDigest(mapped_file.GetData(), mapped_file.GetSize());
+    }
+  }
+
+  bool DatasetCatalog::GetFileStatus (std::string filepath, int64_t* file_time, uint64_t* file_size)
+  {
+    std::error_code ec;
+    std::filesystem::file_time_type ftime = std::filesystem::last_write_time(filepath, ec);
+    if (ec) return false;
+    uintmax_t fsize = std::filesystem::file_size(filepath, ec);
+    if (ec) return false;
+
+    *file_time = (int64_t)ftime.time_since_epoch().count();
+    *file_size = (uint64_t)fsize;
+    return true;
+  }
+
+  void DatasetCatalog::WorkerLoop ()
+  {
+    while (true)
+    {
+      DatasetCatalogSource source;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_jobs.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+        if (m_stop) return;
+
+        source = m_jobs.front();
+        m_jobs.pop_front();
+        m_busy = true;
+      }
+
+      DatasetCatalogEntry entry;
+      entry.name = source.name;
+      entry.filepath = source.filepath;
+      bool exists = GetFileStatus(source.filepath, &entry.file_time, &entry.file_size);
+
+      StructuredGridVolume* vol = nullptr;
+      if (source.load)
+      {
+        vol = source.load();
+      }
+      else
+      {
+        vis::VolumeReader vr;
+        vol = vr.ReadStructuredVolume(source.filepath);
+      }
+
+      if (vol)
+      {
+        BuildEntry(vol, &entry);
+        delete vol;
+      }
+      else
+      {
+        printf("DatasetCatalog: could not load %s\n", source.name.c_str());
+      }
+
+      // the file may have been replaced while it was read
+      int64_t file_time = 0;
+      uint64_t file_size = 0;
+      bool unchanged = GetFileStatus(source.filepath, &file_time, &file_size) == exists
+        && file_time == entry.file_time && file_size == entry.file_size;
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy = false;
+
+        // the dataset may have been removed or changed while it was loaded
+        std::map<std::string, DatasetCatalogSource>::iterator it = m_sources.find(source.name);
+        if (it != m_sources.end() && it->second.filepath == source.filepath)
+        {
+          if (!unchanged)
+          {
+            // rescanned, unless a Refresh already scheduled it again
+            bool scheduled = false;
+            for (size_t i = 0; i < m_jobs.size() && !scheduled; i++)
+              scheduled = m_jobs[i].name == source.name;
+            if (!scheduled) m_jobs.push_back(it->second);
+          }
+          else if (vol)
+          {
+            m_entries[entry.name] = entry;
+            WriteIndex();
+          }
+        }
+        if (m_jobs.empty()) m_cond_idle.notify_all();
+      }
+    }
+  }
+
+  bool DatasetCatalog::WriteIndex ()
+  {
+    if (m_index_filepath.empty()) return false;
+
+    // write to a temporary file first, so readers never see partial indices
+    std::string tmp_filepath = m_index_filepath + ".tmp";
+    {
+      std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+      if (!file.is_open())
+      {
+        printf("DatasetCatalog: could not write %s\n", tmp_filepath.c_str());
+        return false;
+      }
+
+      file.write(DATASET_CATALOG_MAGIC, 4);
+      WriteValue<uint32_t>(file, VERSION);
+      WriteValue<uint32_t>(file, (uint32_t)m_entries.size());
+      for (std::map<std::string, DatasetCatalogEntry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+      {
+        const DatasetCatalogEntry& entry = it->second;
+        WriteString(file, entry.name);
+        WriteString(file, entry.filepath);
+        WriteValue(file, entry.file_time);
+        WriteValue(file, entry.file_size);
+        WriteValue(file, entry.dimensions.x);
+        WriteValue(file, entry.dimensions.y);
+        WriteValue(file, entry.dimensions.z);
+        WriteValue(file, entry.spacing.x);
+        WriteValue(file, entry.spacing.y);
+        WriteValue(file, entry.spacing.z);
+        WriteValue<uint32_t>(file, (uint32_t)entry.data_storage_size);
+        WriteValue(file, entry.min_value);
+        WriteValue(file, entry.max_value);
+        WriteValue<uint32_t>(file, (uint32_t)entry.histogram.size());
+        file.write((const char*)entry.histogram.data(), entry.histogram.size() * sizeof(uint32_t));
+        WriteString(file, entry.content_hash);
+        WriteValue(file, entry.thumbnail_size.x);
+        WriteValue(file, entry.thumbnail_size.y);
+        file.write((const char*)entry.thumbnail.data(), entry.thumbnail.size());
+      }
+
+      if (!file.good())
+      {
+        printf("DatasetCatalog: could not write %s\n", tmp_filepath.c_str());
+        return false;
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_filepath, m_index_filepath, ec);
+    if (ec)
+    {
+      std::filesystem::remove(tmp_filepath, ec);
+      return false;
+    }
+    return true;
+  }
+}
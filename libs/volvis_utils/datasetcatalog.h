@@ -0,0 +1,148 @@
+/**
+ * datasetcatalog.h
+ *
+ * Index of the structured datasets of a data folder, with what the UI and
+ *   batch tools need to pick datasets, transfer function ranges and memory
+ *   budgets without loading them: dimensions, spacing, storage type, value
+ *   range, histogram, content hash and a small MIP thumbnail.
+ *
+ * Entries are built on a background thread and persisted in an index file
+ *   (e.g. <path to data>/volume_list.catalog, next to volume_list.csv). On
+ *   Refresh, only the datasets whose file modification time or size changed
+ *   since the index was written are loaded again.
+ *
+ * Index format (little endian, fields written one by one):
+ * |"VCAT" version number_of_entries
+ * |for each entry: name filepath file_time file_size
+ * |                width height depth spacingx spacingy spacingz
+ * |                data_storage_size min_value max_value
+ * |                HISTOGRAM_BINS bins content_hash
+ * |                thumbnail_width thumbnail_height thumbnail (8 bits)
+ * |strings are written as length + characters
+**/
+#ifndef VOL_VIS_UTILS_DATASET_CATALOG_H
+#define VOL_VIS_UTILS_DATASET_CATALOG_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vis
+{
+  class DatasetCatalogEntry
+  {
+  public:
+    DatasetCatalogEntry ();
+
+    // Bytes of the voxel array once loaded
+    size_t GetVoxelBytes () const;
+
+    std::string name;
+    std::string filepath;
+    // state of filepath when the entry was built
+    int64_t file_time;
+    uint64_t file_size;
+
+    glm::uvec3 dimensions;
+    glm::dvec3 spacing;
+    DataStorageSize data_storage_size;
+
+    // absolute sample values
+    double min_value;
+    double max_value;
+    // HISTOGRAM_BINS bins of the normalized samples in [0, 1]
+    std::vector<uint32_t> histogram;
+
+    std::string content_hash;
+
+    // maximum intensity projection along z, 8 bits, x fastest
+    glm::uvec2 thumbnail_size;
+    std::vector<unsigned char> thumbnail;
+  };
+
+  // Dataset to be indexed
+  class DatasetCatalogSource
+  {
+  public:
+    // Must copy everything it needs: it runs on the catalog thread
+    typedef std::function<StructuredGridVolume*()> LoadFunction;
+
+    DatasetCatalogSource (std::string _name = "", std::string _filepath = "", LoadFunction _load = nullptr)
+      : name(_name), filepath(_filepath), load(_load)
+    {}
+
+    std::string name;
+    // file checked for modifications
+    std::string filepath;
+    // if empty, filepath is read with VolumeReader
+    LoadFunction load;
+  };
+
+  class DatasetCatalog
+  {
+  public:
+    static const uint32_t VERSION = 1;
+    static const int HISTOGRAM_BINS = 256;
+    static const unsigned int THUMBNAIL_SIZE = 64;
+
+    DatasetCatalog ();
+    ~DatasetCatalog ();
+
+    void SetIndexFilePath (std::string filepath);
+    std::string GetIndexFilePath ();
+
+    // Read the entries of the index file, replacing the current ones
+    bool Load ();
+    bool Save ();
+
+    // Set the indexed datasets: entries of datasets not in sources are
+    //   dropped, and the new or modified ones are rebuilt in background
+    void Refresh (const std::vector<DatasetCatalogSource>& sources);
+
+    bool IsBuilding ();
+    // Block until every scheduled entry is built
+    void Wait ();
+
+    int GetNumberOfEntries ();
+    // Copy of the entry of the dataset name, false if it is not built yet
+    bool GetEntry (std::string name, DatasetCatalogEntry* entry);
+    std::vector<DatasetCatalogEntry> GetEntries ();
+
+    // Fill the volume dependent fields of entry in a single parallel pass
+    static void BuildEntry (StructuredGridVolume* vol, DatasetCatalogEntry* entry);
+    static bool GetFileStatus (std::string filepath, int64_t* file_time, uint64_t* file_size);
+
+  protected:
+    void WorkerLoop ();
+    // Must be called with m_mutex locked
+    bool WriteIndex ();
+
+  private:
+    std::string m_index_filepath;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond_jobs;
+    std::condition_variable m_cond_idle;
+
+    std::map<std::string, DatasetCatalogEntry> m_entries;
+    // datasets of the last Refresh, by name
+    std::map<std::string, DatasetCatalogSource> m_sources;
+    std::deque<DatasetCatalogSource> m_jobs;
+    bool m_busy;
+    bool m_stop;
+
+    std::thread m_worker;
+  };
+}
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * diskcache.cpp
+**/
+#include "diskcache.h"
+
+#include <file_utils/sha256.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace vis
+{
+  static const char DISK_CACHE_MAGIC[4] = { 'V', 'C', 'C', 'H' };
+  static const char* DISK_CACHE_EXTENSION = ".vcache";
+
+  std::string DiskCacheKey::GetDescription () const
+  {
+    return content_hash + "|" + product + "|" + parameters + "|" + std::to_string(product_version);
+  }
+
+  std::string DiskCacheKey::GetFileName () const
+  {
+    return SHA256::HexDigest(GetDescription()) + DISK_CACHE_EXTENSION;
+  }
+
+  DiskCache::DiskCache (std::string directory)
+    : m_enabled(true)
+  {
+    SetDirectory(directory);
+  }
+
+  DiskCache::~DiskCache ()
+  {
+  }
+
+  void DiskCache::SetDirectory (std::string directory)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = directory;
+    if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+      m_directory += "/";
+  }
+
+  std::string DiskCache::GetDirectory ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_directory;
+  }
+
+  void DiskCache::SetEnabled (bool enabled)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_enabled = enabled;
+  }
+
+  bool DiskCache::IsEnabled ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_enabled && !m_directory.empty();
+  }
+
+  bool DiskCache::Store (const DiskCacheKey& key, const void* data, size_t bytes)
+  {
+    if (!IsEnabled() || key.content_hash.empty()) return false;
+
+    std::string payload_digest = SHA256::ChunkedHexDigest(data, bytes);
+    std::string description = key.GetDescription();
+    std::string filepath = GetFilePath(key);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+
+    // write to a temporary file first, so readers never see partial entries
+    std::string tmp_filepath = filepath + ".tmp";
+    {
+      std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+      if (!file.is_open())
+      {
+        printf("DiskCache: could not write %s\n", tmp_filepath.c_str());
+        return false;
+      }
+
+      uint32_t version = FORMAT_VERSION;
+      uint32_t description_length = (uint32_t)description.size();
+      uint64_t payload_bytes = (uint64_t)bytes;
+
+      file.write(DISK_CACHE_MAGIC, 4);
+      file.write((const char*)&version, sizeof(uint32_t));
+      file.write((const char*)&description_length, sizeof(uint32_t));
+      file.write(description.data(), description.size());
+      file.write((const char*)&payload_bytes, sizeof(uint64_t));
+      file.write(payload_digest.data(), payload_digest.size());
+      file.write((const char*)data, bytes);
+
+      if (!file.good())
+      {
+        printf("DiskCache: could not write %s\n", tmp_filepath.c_str());
+        file.close();
+        std::filesystem::remove(tmp_filepath, ec);
+        return false;
+      }
+    }
+
+    std::filesystem::rename(tmp_filepath, filepath, ec);
+    if (ec)
+    {
+      std::filesystem::remove(tmp_filepath, ec);
+      return false;
+    }
+    return true;
+  }
+
+  bool DiskCache::Store (const DiskCacheKey& key, const std::vector<unsigned char>& payload)
+  {
+    return Store(key, payload.data(), payload.size());
+  }
+
+  bool DiskCache::Load (const DiskCacheKey& key, void* data, size_t bytes)
+  {
+    if (!IsEnabled() || key.content_hash.empty()) return false;
+
+    std::ifstream file;
+    uint64_t payload_bytes;
+    std::string payload_digest;
+    if (!OpenEntry(key, file, &payload_bytes, &payload_digest)) return false;
+
+    if (payload_bytes != (uint64_t)bytes)
+    {
+      printf("DiskCache: %s has %llu bytes, expected %llu\n", key.product.c_str(),
+        (unsigned long long)payload_bytes, (unsigned long long)bytes);
+      file.close();
+      Erase(key);
+      return false;
+    }
+
+    file.read((char*)data, bytes);
+    bool read_ok = file.gcount() == (std::streamsize)bytes;
+    file.close();
+
+    return read_ok && ValidatePayload(key, data, bytes, payload_digest);
+  }
+
+  bool DiskCache::Load (const DiskCacheKey& key, std::vector<unsigned char>* payload)
+  {
+    if (!IsEnabled() || key.content_hash.empty()) return false;
+
+    std::ifstream file;
+    uint64_t payload_bytes;
+    std::string payload_digest;
+    if (!OpenEntry(key, file, &payload_bytes, &payload_digest)) return false;
+
+    payload->resize((size_t)payload_bytes);
+    file.read((char*)payload->data(), payload->size());
+    bool read_ok = file.gcount() == (std::streamsize)payload->size();
+    file.close();
+
+    if (read_ok && ValidatePayload(key, payload->data(), payload->size(), payload_digest))
+      return true;
+
+    payload->clear();
+    return false;
+  }
+
+  void DiskCache::Erase (const DiskCacheKey& key)
+  {
+    std::string filepath = GetFilePath(key);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::error_code ec;
+    std::filesystem::remove(filepath, ec);
+  }
+
+  std::string DiskCache::GetFilePath (const DiskCacheKey& key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_directory + key.GetFileName();
+  }
+
+  bool DiskCache::OpenEntry (const DiskCacheKey& key, std::ifstream& file,
+                             uint64_t* payload_bytes, std::string* payload_digest)
+  {
+    file.open(GetFilePath(key), std::ios::binary);
+    if (!file.is_open()) return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t description_length = 0;
+    file.read(magic, 4);
+    file.read((char*)&version, sizeof(uint32_t));
+    file.read((char*)&description_length, sizeof(uint32_t));
+
+    bool valid = file.good() && memcmp(magic, DISK_CACHE_MAGIC, 4) == 0 && version == FORMAT_VERSION;
+
+    std::string description = key.GetDescription();
+    if (valid && description_length == description.size())
+    {
+      std::string stored_description(description_length, '\0');
+      file.read(&stored_description[0], description_length);
+      valid = file.good() && stored_description == description;
+    }
+    else
+    {
+      valid = false;
+    }
+
+    if (valid)
+    {
+      payload_digest->assign(2 * SHA256::DIGEST_SIZE, '\0');
+      file.read((char*)payload_bytes, sizeof(uint64_t));
+      file.read(&(*payload_digest)[0], payload_digest->size());
+      valid = file.good();
+
+      // the rest of the file must be exactly the payload (truncated writes)
+      if (valid)
+      {
+        std::streamoff payload_begin = file.tellg();
+        file.seekg(0, std::ios::end);
+        valid = (uint64_t)(file.tellg() - payload_begin) == *payload_bytes;
+        file.seekg(payload_begin);
+      }
+    }
+
+    if (!valid)
+    {
+      printf("DiskCache: discarding invalid entry %s\n", key.GetFileName().c_str());
+      file.close();
+      Erase(key);
+    }
+    return valid;
+  }
+
+  bool DiskCache::ValidatePayload (const DiskCacheKey& key, const void* data, size_t bytes,
+                                   std::string payload_digest)
+  {
+    if (SHA256::ChunkedHexDigest(data, bytes) == payload_digest) return true;
+
+    printf("DiskCache: corrupted entry %s\n", key.GetFileName().c_str());
+    Erase(key);
+    return false;
+  }
+}
@@ -0,0 +1,104 @@
+/**
+ * diskcache.h
+ *
+ * Persistent cache of preprocessing results (gradients, summed area tables,
+ *   super voxel pyramids, flattened octrees...), stored in a directory so they
+ *   survive between launches.
+ *
+ * Entries are content addressed: the key is made of the content hash of the
+ *   volume (StructuredGridVolume::GetContentHash), the product name and the
+ *   parameters that produced it. The file name is the SHA-256 of the key.
+ *
+ * File format (native endianness):
+ * |"VCCH" format_version
+ * |key_length key (the full key, compared on load)
+ * |payload_bytes payload_digest (64 hex chars, SHA256::ChunkedHexDigest)
+ * |payload
+ *
+ * Entries that do not validate (other version, key, size or digest) are
+ *   deleted and reported as misses.
+**/
+#ifndef VOL_VIS_UTILS_DISK_CACHE_H
+#define VOL_VIS_UTILS_DISK_CACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vis
+{
+  class DiskCacheKey
+  {
+  public:
+    // product_version must be increased when the layout or the algorithm
+    //   that produces the product changes
+    DiskCacheKey (std::string _content_hash, std::string _product,
+                  std::string _parameters = "", uint32_t _product_version = 1)
+      : content_hash(_content_hash), product(_product)
+      , parameters(_parameters), product_version(_product_version)
+    {}
+
+    std::string GetDescription () const;
+    std::string GetFileName () const;
+
+    std::string content_hash;
+    std::string product;
+    std::string parameters;
+    uint32_t product_version;
+  };
+
+  class DiskCache
+  {
+  public:
+    static const uint32_t FORMAT_VERSION = 1;
+
+    // An empty directory disables the cache
+    DiskCache (std::string directory = "");
+    ~DiskCache ();
+
+    void SetDirectory (std::string directory);
+    std::string GetDirectory ();
+    void SetEnabled (bool enabled);
+    bool IsEnabled ();
+
+    bool Store (const DiskCacheKey& key, const void* data, size_t bytes);
+    bool Store (const DiskCacheKey& key, const std::vector<unsigned char>& payload);
+
+    // Reads the payload into data, which must have exactly bytes bytes
+    bool Load (const DiskCacheKey& key, void* data, size_t bytes);
+    bool Load (const DiskCacheKey& key, std::vector<unsigned char>* payload);
+
+    // Returns a new[] allocated array, or nullptr on a miss
+    template<typename T>
+    T* LoadArray (const DiskCacheKey& key, size_t count)
+    {
+      if (!IsEnabled()) return nullptr;
+      T* data = new T[count];
+      if (Load(key, data, count * sizeof(T))) return data;
+      delete[] data;
+      return nullptr;
+    }
+
+    void Erase (const DiskCacheKey& key);
+
+  protected:
+    std::string GetFilePath (const DiskCacheKey& key);
+    // Opens the entry of key and validates its header
+    bool OpenEntry (const DiskCacheKey& key, std::ifstream& file,
+                    uint64_t* payload_bytes, std::string* payload_digest);
+    // Validates the payload digest, deleting the entry if it does not match
+    bool ValidatePayload (const DiskCacheKey& key, const void* data, size_t bytes,
+                          std::string payload_digest);
+
+  private:
+    std::string m_directory;
+    bool m_enabled;
+
+    // serializes writes, readers only see complete (renamed) files
+    std::mutex m_mutex;
+  };
+}
+
+#endif
@@ -95,6 +95,23 @@ private:
 
     return m[r][c];
   }
+  // Index i of a sequence of size n using reflection at boundaries
+  static inline int reflect(int i, int n) {
+    return i < 0 ? reflect(-i - 1, n) : i >= n ? reflect(2 * n - i - 1, n) : i;
+  }
+  // Apply k's digital filter to the lines of f: count lines of size n,
+  //   sample i of line l at f[l * line_stride + i * stride]
+  template<typename Kernel>
+  static void filter_lines(const Kernel& k, float* f, int n, size_t stride, int count, size_t line_stride,
+                           std::vector<float>& line) {
+    for (int l = 0; l < count; l++) {
+      float* p = f + l * line_stride;
+      line.resize(n);
+      for (int i = 0; i < n; i++) line[i] = p[i * stride];
+      k.digital_filter(line);
+      for (int i = 0; i < n; i++) p[i * stride] = line[i];
+    }
+  }
   // Advance to next sample
   inline bool advance(int& i, int& j, double& u, double inv_s) {
     ++i; u += inv_s;
@@ -136,6 +153,124 @@ public:
     k.digital_filter(g); // Apply kernels associated digital filter
     return g;
   }
+  // Weights of IntuitiveDownSample from n to m samples: sample j of g is
+  //   the sum of weight[e] * f[index[e]] for e in [offset[j], offset[j + 1]),
+  //   indices already reflected at boundaries. Identity when n == m.
+  template<typename Kernel>
+  static void DownSampleWeights (int n, int m, const Kernel& k, std::vector<int>& offset,
+                                 std::vector<int>& index, std::vector<float>& weight) {
+    assert(m <= n); // Ensure we are downsampling
+    offset.assign(1, 0); index.clear(); weight.clear();
+    if (n == m) {
+      for (int j = 0; j < m; j++) {
+        index.push_back(j); weight.push_back(1.f); offset.push_back(j + 1);
+      }
+      return;
+    }
+    const float s = float(m) / n; // Scale factor
+    const float kr = .5f * float(k.support());
+    const bool should_normalize = (n % m != 0);
+    for (int j = 0; j < m; j++) {
+      float x = (j + .5f) / m; // Position in domain [0,1] of both f and g
+      int il = int(ceil((x - kr / m) * n - .5f)); // Leftmost sample under kernel
+      int ir = int(floor((x + kr / m) * n - .5f)); // Rightmost sample under kernel
+      size_t first = weight.size();
+      double sumw = 0.;
+      for (int i = il; i <= ir; i++) {
+        float w = k((x - (i + .5f) / n) * m); // Weight for sample
+        index.push_back(reflect(i, n)); weight.push_back(w); sumw += w;
+      }
+      float scale = should_normalize ? float(k.integral() / sumw) : s;
+      for (size_t e = first; e < weight.size(); e++) weight[e] *= scale;
+      offset.push_back(int(weight.size()));
+    }
+  }
+  // IntuitiveDownSample applied to the three axes of a volume of size n
+  //   (x fastest) into g, of size m <= n. read_row(y, z, row) writes the
+  //   n.x samples of row (y, z) of the input, it is called concurrently.
+  //   Each slice is downsampled in x and y into a buffer of m.x * m.y * n.z
+  //   samples, then the slices are combined in z. Axes where m == n are
+  //   copied. digital_filter = false skips the kernel's digital filter, for
+  //   kernels that have none.
+  template<typename Kernel, typename ReadRow>
+  static void DownSample3D (const ReadRow& read_row, glm::ivec3 n, float* g, glm::ivec3 m, const Kernel& k,
+                            bool digital_filter) {
+    assert(m.x <= n.x && m.y <= n.y && m.z <= n.z); // Ensure we are downsampling
+    std::vector<int> offset[3], index[3];
+    std::vector<float> weight[3];
+    for (int a = 0; a < 3; a++)
+      DownSampleWeights(n[a], m[a], k, offset[a], index[a], weight[a]);
+
+    const size_t m_slice = size_t(m.x) * size_t(m.y);
+    std::vector<float> xy(m_slice * size_t(n.z));
+
+#pragma omp parallel
+    {
+      std::vector<float> row(n.x), x_slice(size_t(m.x) * size_t(n.y)), line;
+#pragma omp for schedule(dynamic)
+      for (int z = 0; z < n.z; z++) {
+        // x: rows of the input slice into x_slice
+        for (int y = 0; y < n.y; y++) {
+          read_row(y, z, row.data());
+          float* dst = x_slice.data() + size_t(y) * m.x;
+          for (int j = 0; j < m.x; j++) {
+            float sum = 0.f;
+            for (int e = offset[0][j]; e < offset[0][j + 1]; e++)
+              sum += weight[0][e] * row[index[0][e]];
+            dst[j] = sum;
+          }
+        }
+        if (digital_filter && m.x != n.x)
+          filter_lines(k, x_slice.data(), m.x, 1, n.y, size_t(m.x), line);
+
+        // y: weighted sums of rows of x_slice
+        float* xy_slice = xy.data() + size_t(z) * m_slice;
+        for (int j = 0; j < m.y; j++) {
+          float* dst = xy_slice + size_t(j) * m.x;
+          std::fill(dst, dst + m.x, 0.f);
+          for (int e = offset[1][j]; e < offset[1][j + 1]; e++) {
+            const float w = weight[1][e];
+            const float* src = x_slice.data() + size_t(index[1][e]) * m.x;
+            for (int x = 0; x < m.x; x++) dst[x] += w * src[x];
+          }
+        }
+        if (digital_filter && m.y != n.y)
+          filter_lines(k, xy_slice, m.y, size_t(m.x), m.x, 1, line);
+      }
+    }
+
+    // z: weighted sums of the slices of xy
+#pragma omp parallel for schedule(dynamic)
+    for (int j = 0; j < m.z; j++) {
+      float* dst = g + size_t(j) * m_slice;
+      std::fill(dst, dst + m_slice, 0.f);
+      for (int e = offset[2][j]; e < offset[2][j + 1]; e++) {
+        const float w = weight[2][e];
+        const float* src = xy.data() + size_t(index[2][e]) * m_slice;
+        for (size_t i = 0; i < m_slice; i++) dst[i] += w * src[i];
+      }
+    }
+
+    if (digital_filter && m.z != n.z) {
+      // z lines of each xz plane, transposed so the reads stay contiguous
+#pragma omp parallel
+      {
+        std::vector<float> xz(size_t(m.x) * size_t(m.z)), line;
+#pragma omp for schedule(dynamic)
+        for (int y = 0; y < m.y; y++) {
+          for (int z = 0; z < m.z; z++) {
+            const float* src = g + size_t(z) * m_slice + size_t(y) * m.x;
+            for (int x = 0; x < m.x; x++) xz[size_t(x) * m.z + z] = src[x];
+          }
+          filter_lines(k, xz.data(), m.z, 1, m.x, size_t(m.z), line);
+          for (int z = 0; z < m.z; z++) {
+            float* dst = g + size_t(z) * m_slice + size_t(y) * m.x;
+            for (int x = 0; x < m.x; x++) dst[x] = xz[size_t(x) * m.z + z];
+          }
+        }
+      }
+    }
+  }
   template<typename Kernel>
   std::vector<float> IncrementalDownSample (std::vector<float> f, int m, Kernel& k) {
     const int n = f.size();
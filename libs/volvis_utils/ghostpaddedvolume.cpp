@@ -0,0 +1,186 @@
+#include "ghostpaddedvolume.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace vis
+{
+  template<typename T>
+  static void FillGhostPadded (StructuredGridVolume* vol, typename VoxelTraits<T>::Storage* voxels, const std::vector<int> src[3])
+  {
+    typedef typename VoxelTraits<T>::Value Value;
+    int pw = (int)src[0].size(), ph = (int)src[1].size(), pd = (int)src[2].size();
+    const int* sx = src[0].data();
+    const int* sy = src[1].data();
+    const int* sz = src[2].data();
+
+    DispatchVolumeView(vol, [&] (const auto& view) {
+#pragma omp parallel for
+      for (int z = 0; z < pd; z++)
+      {
+        for (int y = 0; y < ph; y++)
+        {
+          size_t row = size_t(y) * pw + size_t(z) * pw * ph;
+          if (sz[z] < 0 || sy[y] < 0)
+          {
+            for (int x = 0; x < pw; x++) VoxelTraits<T>::Store(voxels, row + x, Value(0));
+            continue;
+          }
+          for (int x = 0; x < pw; x++)
+            VoxelTraits<T>::Store(voxels, row + x, sx[x] < 0 ? Value(0) : Value(view.Get(sx[x], sy[y], sz[z])));
+        }
+      }
+    });
+  }
+
+  GhostPaddedVolume::GhostPaddedVolume ()
+    : m_ghost_width(0)
+    , m_ghost_fill(GhostFill::GHOST_ZERO)
+    , m_origin(0)
+    , m_size(0)
+    , m_data_storage_size(DataStorageSize::UNKNOWN)
+    , m_max_density(0.0)
+    , m_voxel_values(nullptr)
+  {}
+
+  GhostPaddedVolume::~GhostPaddedVolume ()
+  {
+    Clear();
+  }
+
+  bool GhostPaddedVolume::Build (StructuredGridVolume* vol, int ghost_width, GhostFill fill,
+                                 glm::ivec3 origin, glm::ivec3 size)
+  {
+    Clear();
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN || ghost_width < 0) return false;
+
+    glm::ivec3 dim((int)vol->GetWidth(), (int)vol->GetHeight(), (int)vol->GetDepth());
+    for (int a = 0; a < 3; a++)
+      if (size[a] == 0) size[a] = dim[a] - origin[a];
+
+    if (glm::any(glm::lessThan(origin, glm::ivec3(0))) || glm::any(glm::lessThanEqual(size, glm::ivec3(0)))
+     || glm::any(glm::greaterThan(origin + size, dim)))
+    {
+      printf("GhostPaddedVolume: region out of the volume\n");
+      return false;
+    }
+
+    // source coordinate of each padded voxel, per axis
+    std::vector<int> src[3];
+    for (int a = 0; a < 3; a++)
+    {
+      src[a].resize(size[a] + 2 * ghost_width);
+      for (int i = 0; i < (int)src[a].size(); i++)
+        src[a][i] = GetGhostSourceCoordinate(origin[a] - ghost_width + i, dim[a], fill);
+    }
+
+    DataStorageSize dss = vol->GetDataStorageSize();
+    size_t n_voxels = src[0].size() * src[1].size() * src[2].size();
+    void* voxels = nullptr;
+    if (dss == DataStorageSize::_12_BITS_PACKED)
+    {
+      // rows may split packed pairs between threads: fill 16-bit values
+      //   and pack them
+      unsigned short* voxels_16 = new unsigned short[n_voxels];
+      FillGhostPadded<unsigned short>(vol, voxels_16, src);
+      voxels = ConvertVoxelStorage(voxels_16, DataStorageSize::_16_BITS, dss, n_voxels);
+      delete[] voxels_16;
+    }
+    else
+    {
+      voxels = AllocateVoxelArray(dss, n_voxels);
+      if (voxels)
+      {
+        DispatchVoxelType(dss, [&] (auto t) {
+          typedef decltype(t) T;
+          FillGhostPadded<T>(vol, static_cast<typename VoxelTraits<T>::Storage*>(voxels), src);
+        });
+      }
+    }
+    if (!voxels) return false;
+
+    m_ghost_width = ghost_width;
+    m_ghost_fill = fill;
+    m_origin = origin;
+    m_size = size;
+    m_data_storage_size = dss;
+    m_max_density = vol->GetMaxDensity();
+    m_voxel_values = voxels;
+    return true;
+  }
+
+  void GhostPaddedVolume::Clear ()
+  {
+    DeleteVoxelArray(m_voxel_values, m_data_storage_size);
+    m_voxel_values = nullptr;
+    m_data_storage_size = DataStorageSize::UNKNOWN;
+    m_size = glm::ivec3(0);
+  }
+
+  int GhostPaddedVolume::GetGhostWidth () const
+  {
+    return m_ghost_width;
+  }
+
+  GhostFill GhostPaddedVolume::GetGhostFill () const
+  {
+    return m_ghost_fill;
+  }
+
+  glm::ivec3 GhostPaddedVolume::GetOrigin () const
+  {
+    return m_origin;
+  }
+
+  glm::ivec3 GhostPaddedVolume::GetSize () const
+  {
+    return m_size;
+  }
+
+  glm::ivec3 GhostPaddedVolume::GetPaddedSize () const
+  {
+    return m_size + glm::ivec3(2 * m_ghost_width);
+  }
+
+  DataStorageSize GhostPaddedVolume::GetDataStorageSize () const
+  {
+    return m_data_storage_size;
+  }
+
+  double GhostPaddedVolume::GetMaxDensity () const
+  {
+    return m_max_density;
+  }
+
+  const void* GhostPaddedVolume::GetArrayData () const
+  {
+    return m_voxel_values;
+  }
+
+  size_t GhostPaddedVolume::GetSizeBytes () const
+  {
+    if (!m_voxel_values) return 0;
+    glm::ivec3 p = GetPaddedSize();
+    return GetStorageArrayBytes(m_data_storage_size, size_t(p.x) * size_t(p.y) * size_t(p.z));
+  }
+
+  int GhostPaddedVolume::GetGhostSourceCoordinate (int c, int n, GhostFill fill)
+  {
+    if (c >= 0 && c < n) return c;
+
+    if (fill == GhostFill::GHOST_CLAMP)
+    {
+      return c < 0 ? 0 : n - 1;
+    }
+    else if (fill == GhostFill::GHOST_MIRROR)
+    {
+      if (n == 1) return 0;
+      // reflection has period 2 * (n - 1)
+      int period = 2 * (n - 1);
+      int m = c % period;
+      if (m < 0) m += period;
+      return m < n ? m : period - m;
+    }
+    return -1;
+  }
+}
@@ -0,0 +1,96 @@
+/**
+ * ghostpaddedvolume.h
+ *
+ * Copy of a region of a StructuredGridVolume surrounded by ghost voxels, so
+ *   stencils of radius <= ghost width read their neighbours without bounds
+ *   checks on the interior and at the borders alike.
+ *
+ * Ghost voxels inside the volume are copied from it: for a brick of a larger
+ *   volume, the halo comes from the neighbour bricks. Ghost voxels outside
+ *   the volume are filled by the GhostFill policy:
+ *
+ * . GHOST_ZERO   : 0, same as GetNormalizedSample out of the volume
+ * . GHOST_CLAMP  : value of the nearest border voxel
+ * . GHOST_MIRROR : reflection about the border voxel (-1 -> 1, -2 -> 2)
+ *
+ * The voxels are stored linearly, x fastest, in the storage type of the
+ *   source volume. DispatchGhostPaddedView calls a kernel with a
+ *   VolumeView<T, PaddedVoxelIndexer>, that accepts coordinates in
+ *   [-ghost width, size + ghost width).
+**/
+#ifndef VOL_VIS_UTILS_GHOST_PADDED_VOLUME_H
+#define VOL_VIS_UTILS_GHOST_PADDED_VOLUME_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/volumeview.h>
+
+#include <glm/glm.hpp>
+
+namespace vis
+{
+  enum GhostFill : unsigned int
+  {
+    GHOST_ZERO   = 0,
+    GHOST_CLAMP  = 1,
+    GHOST_MIRROR = 2,
+  };
+
+  class GhostPaddedVolume
+  {
+  public:
+    GhostPaddedVolume ();
+    ~GhostPaddedVolume ();
+
+    // Copy the region [origin, origin + size) of vol and ghost_width voxels
+    //   around it. A size of 0 along an axis takes the volume up to its end.
+    bool Build (StructuredGridVolume* vol, int ghost_width, GhostFill fill,
+                glm::ivec3 origin = glm::ivec3(0), glm::ivec3 size = glm::ivec3(0));
+    void Clear ();
+
+    int GetGhostWidth () const;
+    GhostFill GetGhostFill () const;
+    // Region of the volume, without ghost voxels
+    glm::ivec3 GetOrigin () const;
+    glm::ivec3 GetSize () const;
+    glm::ivec3 GetPaddedSize () const;
+
+    DataStorageSize GetDataStorageSize () const;
+    double GetMaxDensity () const;
+    const void* GetArrayData () const;
+    size_t GetSizeBytes () const;
+
+    // Source coordinate along one axis of dimension n for the coordinate c,
+    //   -1 if the ghost voxel is zero
+    static int GetGhostSourceCoordinate (int c, int n, GhostFill fill);
+
+  private:
+    int m_ghost_width;
+    GhostFill m_ghost_fill;
+    glm::ivec3 m_origin;
+    glm::ivec3 m_size;
+
+    DataStorageSize m_data_storage_size;
+    double m_max_density;
+    void* m_voxel_values;
+  };
+
+  // Calls kernel (const View&) once with the VolumeView of the padded voxels,
+  //   coordinates relative to the region origin. Returns false if empty.
+  template<typename Kernel>
+  bool DispatchGhostPaddedView (const GhostPaddedVolume& padded, Kernel&& kernel)
+  {
+    const void* data = padded.GetArrayData();
+    if (!data) return false;
+
+    glm::ivec3 s = padded.GetSize();
+    int g = padded.GetGhostWidth();
+    PaddedVoxelIndexer indexer(s.x, s.y, s.z, g);
+    return DispatchVoxelType(padded.GetDataStorageSize(), [&] (auto t) {
+      typedef decltype(t) T;
+      kernel(VolumeView<T, PaddedVoxelIndexer>(static_cast<const typename VoxelTraits<T>::Storage*>(data),
+                                               s.x, s.y, s.z, indexer, g));
+    });
+  }
+}
+
+#endif
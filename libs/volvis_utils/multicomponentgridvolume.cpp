@@ -0,0 +1,222 @@
+#include "multicomponentgridvolume.h"
+#include "voxellayout.h"
+#include "voxelformats.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace vis
+{
+  /////////////////////
+  // Public Methods  //
+  /////////////////////
+  MultiComponentGridVolume::MultiComponentGridVolume (std::string vname, unsigned int width, unsigned int height, unsigned int depth)
+    : GridVolume(vname)
+    , m_width(width)
+    , m_height(height)
+    , m_depth(depth)
+    , m_scalex(1.0)
+    , m_scaley(1.0)
+    , m_scalez(1.0)
+    , m_grid_center(glm::dvec3(0.0))
+  {}
+
+  MultiComponentGridVolume::~MultiComponentGridVolume ()
+  {
+    DestroyData();
+  }
+
+  unsigned int MultiComponentGridVolume::GetWidth ()
+  {
+    return m_width;
+  }
+
+  unsigned int MultiComponentGridVolume::GetHeight ()
+  {
+    return m_height;
+  }
+
+  unsigned int MultiComponentGridVolume::GetDepth ()
+  {
+    return m_depth;
+  }
+
+  size_t MultiComponentGridVolume::GetNumberOfVoxels ()
+  {
+    return size_t(m_width) * size_t(m_height) * size_t(m_depth);
+  }
+
+  glm::dvec3 MultiComponentGridVolume::GetScale ()
+  {
+    return glm::dvec3(m_scalex, m_scaley, m_scalez);
+  }
+
+  void MultiComponentGridVolume::SetScale (double sx, double sy, double sz)
+  {
+    m_scalex = sx;
+    m_scaley = sy;
+    m_scalez = sz;
+  }
+
+  glm::dvec3 MultiComponentGridVolume::GetGridCenterPoint ()
+  {
+    return m_grid_center;
+  }
+
+  glm::dvec3 MultiComponentGridVolume::GetGridBBoxMin ()
+  {
+    return m_grid_center - GetScale() * glm::dvec3(m_width, m_height, m_depth) * 0.5;
+  }
+
+  glm::dvec3 MultiComponentGridVolume::GetGridBBoxMax ()
+  {
+    return m_grid_center + GetScale() * glm::dvec3(m_width, m_height, m_depth) * 0.5;
+  }
+
+  int MultiComponentGridVolume::AddChannel (std::string name, DataStorageSize dss)
+  {
+    void* voxels = AllocateVoxelArray(dss, GetNumberOfVoxels());
+    if (!voxels) return -1;
+    return AddChannel(name, voxels, dss);
+  }
+
+  int MultiComponentGridVolume::AddChannel (std::string name, void* voxels, DataStorageSize dss)
+  {
+    Channel channel;
+    channel.name = name;
+    channel.data_storage_size = dss;
+    channel.voxel_values = voxels;
+    m_channels.push_back(channel);
+    return (int)m_channels.size() - 1;
+  }
+
+  int MultiComponentGridVolume::AddChannel (std::string name, StructuredGridVolume* vol)
+  {
+    if (!vol || !vol->GetArrayData() || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN)
+      return -1;
+    if (vol->GetWidth() != m_width || vol->GetHeight() != m_height || vol->GetDepth() != m_depth)
+    {
+      printf("MultiComponentGridVolume: channel \"%s\" has different dimensions\n", name.c_str());
+      return -1;
+    }
+
+    DataStorageSize dss = vol->GetDataStorageSize();
+    void* voxels = nullptr;
+    if (vol->GetVoxelLayoutTable())
+    {
+      VoxelLayoutTable linear(VoxelLayout::LINEAR, m_width, m_height, m_depth);
+      voxels = ConvertVoxelLayout(vol->GetArrayData(), dss, *vol->GetVoxelLayoutTable(), linear);
+    }
+    else
+    {
+      voxels = AllocateVoxelArray(dss, GetNumberOfVoxels());
+      if (voxels)
+        memcpy(voxels, vol->GetArrayData(), GetStorageArrayBytes(dss, GetNumberOfVoxels()));
+    }
+    if (!voxels) return -1;
+
+    return AddChannel(name, voxels, dss);
+  }
+
+  int MultiComponentGridVolume::GetNumberOfChannels ()
+  {
+    return (int)m_channels.size();
+  }
+
+  int MultiComponentGridVolume::FindChannel (std::string name)
+  {
+    for (int c = 0; c < GetNumberOfChannels(); c++)
+      if (m_channels[c].name == name) return c;
+    return -1;
+  }
+
+  std::string MultiComponentGridVolume::GetChannelName (int channel)
+  {
+    return m_channels[channel].name;
+  }
+
+  DataStorageSize MultiComponentGridVolume::GetChannelDataStorageSize (int channel)
+  {
+    return m_channels[channel].data_storage_size;
+  }
+
+  void* MultiComponentGridVolume::GetChannelData (int channel)
+  {
+    return m_channels[channel].voxel_values;
+  }
+
+  void* MultiComponentGridVolume::ReleaseChannelData (int channel)
+  {
+    void* voxels = m_channels[channel].voxel_values;
+    m_channels[channel].voxel_values = nullptr;
+    return voxels;
+  }
+
+  size_t MultiComponentGridVolume::GetSizeBytes ()
+  {
+    size_t bytes = 0;
+    for (size_t c = 0; c < m_channels.size(); c++)
+      if (m_channels[c].voxel_values)
+        bytes += GetStorageArrayBytes(m_channels[c].data_storage_size, GetNumberOfVoxels());
+    return bytes;
+  }
+
+  double MultiComponentGridVolume::GetNormalizedSample (int channel, int x, int y, int z)
+  {
+    const Channel& c = m_channels[channel];
+    if (!c.voxel_values || IsOutOfBoundary(x, y, z)) return 0.0;
+
+    size_t i = size_t(x) + size_t(y) * m_width + size_t(z) * m_width * m_height;
+    double value = 0.0;
+    DispatchVoxelType(c.data_storage_size, [&] (auto t) {
+      typedef decltype(t) T;
+      value = double(VoxelTraits<T>::Load(static_cast<const typename VoxelTraits<T>::Storage*>(c.voxel_values), i))
+            / VoxelTraits<T>::MAX_DENSITY;
+    });
+    return value;
+  }
+
+  double MultiComponentGridVolume::GetAbsoluteSample (int channel, int x, int y, int z)
+  {
+    const Channel& c = m_channels[channel];
+    if (!c.voxel_values || IsOutOfBoundary(x, y, z)) return 0.0;
+
+    size_t i = size_t(x) + size_t(y) * m_width + size_t(z) * m_width * m_height;
+    double value = 0.0;
+    DispatchVoxelType(c.data_storage_size, [&] (auto t) {
+      typedef decltype(t) T;
+      value = double(VoxelTraits<T>::Load(static_cast<const typename VoxelTraits<T>::Storage*>(c.voxel_values), i));
+    });
+    return value;
+  }
+
+  StructuredGridVolume* MultiComponentGridVolume::ExtractChannel (int channel)
+  {
+    const Channel& c = m_channels[channel];
+    if (!c.voxel_values) return nullptr;
+
+    void* voxels = AllocateVoxelArray(c.data_storage_size, GetNumberOfVoxels());
+    if (!voxels) return nullptr;
+    memcpy(voxels, c.voxel_values, GetStorageArrayBytes(c.data_storage_size, GetNumberOfVoxels()));
+
+    StructuredGridVolume* vol = new StructuredGridVolume(GetName() + "_" + c.name, m_width, m_height, m_depth);
+    vol->SetScale(m_scalex, m_scaley, m_scalez);
+    vol->SetArrayData(voxels, c.data_storage_size);
+    return vol;
+  }
+
+  /////////////////////
+  // Private Methods //
+  /////////////////////
+  void MultiComponentGridVolume::DestroyData ()
+  {
+    for (size_t c = 0; c < m_channels.size(); c++)
+      DeleteVoxelArray(m_channels[c].voxel_values, m_channels[c].data_storage_size);
+    m_channels.clear();
+  }
+
+  bool MultiComponentGridVolume::IsOutOfBoundary (int x, int y, int z)
+  {
+    return (x < 0 || y < 0 || z < 0 || x >= (int)m_width || y >= (int)m_height || z >= (int)m_depth);
+  }
+}
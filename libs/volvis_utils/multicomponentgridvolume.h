@@ -0,0 +1,115 @@
+/**
+ * multicomponentgridvolume.h
+ *
+ * Structured grid with several values per voxel: gradients, vector fields
+ *   of simulations, co-registered modalities of a scan (CT + MRI, ...).
+ *
+ * The components are stored as a structure of arrays: each channel has its
+ *   own linear voxel array (x fastest) and its own DataStorageSize, so a
+ *   float vector field takes 12 bytes per voxel and an 8-bit mask next to a
+ *   16-bit scan takes 3, and a kernel that reads one channel streams only
+ *   that channel. Channel values are read like the ones of
+ *   StructuredGridVolume, DispatchChannelView gives the typed view of a
+ *   channel (volumeview.h) to the preprocessing kernels.
+**/
+#ifndef VOL_VIS_UTILS_MULTI_COMPONENT_GRID_VOLUME_H
+#define VOL_VIS_UTILS_MULTI_COMPONENT_GRID_VOLUME_H
+
+#include <volvis_utils/gridvolume.h>
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/volumeview.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace vis
+{
+  class MultiComponentGridVolume : public GridVolume
+  {
+  public:
+    MultiComponentGridVolume (std::string    name = "Unknown",
+                              unsigned int width  = 0,
+                              unsigned int height = 0,
+                              unsigned int depth  = 0);
+    virtual ~MultiComponentGridVolume ();
+
+    unsigned int GetWidth ();
+    unsigned int GetHeight ();
+    unsigned int GetDepth ();
+    size_t GetNumberOfVoxels ();
+
+    glm::dvec3 GetScale ();
+    void SetScale (double sx, double sy, double sz);
+
+    virtual glm::dvec3 GetGridCenterPoint ();
+    virtual glm::dvec3 GetGridBBoxMin ();
+    virtual glm::dvec3 GetGridBBoxMax ();
+
+    // Add a zero-initialized channel, returns its index
+    int AddChannel (std::string name, DataStorageSize dss);
+    // Takes ownership of voxels, allocated as AllocateVoxelArray, in the
+    //   linear layout
+    int AddChannel (std::string name, void* voxels, DataStorageSize dss);
+    // Copy of the voxels of a scalar volume of the same dimensions, in its
+    //   storage type. Returns -1 if the dimensions differ or vol has no data.
+    int AddChannel (std::string name, StructuredGridVolume* vol);
+
+    int GetNumberOfChannels ();
+    // -1 if there is no channel with this name
+    int FindChannel (std::string name);
+    std::string GetChannelName (int channel);
+    DataStorageSize GetChannelDataStorageSize (int channel);
+    void* GetChannelData (int channel);
+    // The caller takes ownership of the voxel array of the channel (release
+    //   it with DeleteVoxelArray), the channel is left without data
+    void* ReleaseChannelData (int channel);
+    // Bytes of all voxel arrays
+    size_t GetSizeBytes ();
+
+    // 0 outside the volume, see StructuredGridVolume::GetNormalizedSample
+    double GetNormalizedSample (int channel, int x, int y, int z);
+    double GetAbsoluteSample (int channel, int x, int y, int z);
+
+    // New scalar volume with a copy of the channel
+    StructuredGridVolume* ExtractChannel (int channel);
+
+  protected:
+    virtual void DestroyData ();
+
+  private:
+    struct Channel
+    {
+      std::string name;
+      DataStorageSize data_storage_size;
+      void* voxel_values;
+    };
+
+    bool IsOutOfBoundary (int x, int y, int z);
+
+    unsigned int m_width, m_height, m_depth;
+    double m_scalex, m_scaley, m_scalez;
+    glm::dvec3 m_grid_center;
+
+    std::vector<Channel> m_channels;
+  };
+
+  // Calls kernel (const View&) with the VolumeView of a channel, see
+  //   DispatchVolumeView. Returns false if the channel has no data.
+  template<typename Kernel>
+  bool DispatchChannelView (MultiComponentGridVolume* vol, int channel, Kernel&& kernel)
+  {
+    if (!vol || channel < 0 || channel >= vol->GetNumberOfChannels()) return false;
+
+    const void* data = vol->GetChannelData(channel);
+    if (!data) return false;
+
+    int w = (int)vol->GetWidth(), h = (int)vol->GetHeight(), d = (int)vol->GetDepth();
+    return DispatchVoxelType(vol->GetChannelDataStorageSize(channel), [&] (auto t) {
+      DispatchVolumeViewLayout<decltype(t)>(data, w, h, d, nullptr, kernel);
+    });
+  }
+}
+
+#endif
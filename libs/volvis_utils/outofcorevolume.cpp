@@ -0,0 +1,299 @@
+#include "outofcorevolume.h"
+#include "voxelformats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace vis
+{
+  static std::atomic<unsigned long long> s_next_volume_serial(1);
+
+  OutOfCoreStructuredGridVolume* OutOfCoreStructuredGridVolume::Open (std::string filepath, size_t cache_bytes)
+  {
+    glm::uvec3 dimensions;
+    {
+      BrickedVolumeFile probe;
+      if (!probe.Open(filepath)) return nullptr;
+      dimensions = probe.GetDimensions();
+    }
+
+    OutOfCoreStructuredGridVolume* vol = new OutOfCoreStructuredGridVolume(filepath, dimensions, cache_bytes);
+    if (!vol->m_bvol.IsOpen())
+    {
+      delete vol;
+      return nullptr;
+    }
+
+    glm::dvec3 scale = vol->m_bvol.GetScale();
+    vol->SetScale(scale.x, scale.y, scale.z);
+    // no voxel array, only the storage type
+    vol->SetArrayData(nullptr, vol->m_bvol.GetDataStorageSize());
+    return vol;
+  }
+
+  OutOfCoreStructuredGridVolume::OutOfCoreStructuredGridVolume (std::string filepath, glm::uvec3 dimensions, size_t cache_bytes)
+    : StructuredGridVolume(filepath, dimensions.x, dimensions.y, dimensions.z)
+    , m_serial(s_next_volume_serial++)
+    , m_budget_bytes(cache_bytes)
+    , m_resident_bytes(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_prefetches(0)
+    , m_prefetch_enabled(true)
+    , m_stop(false)
+  {
+    m_bvol.Open(filepath);
+    m_prefetch_thread = std::thread(&OutOfCoreStructuredGridVolume::PrefetchLoop, this);
+  }
+
+  OutOfCoreStructuredGridVolume::~OutOfCoreStructuredGridVolume ()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+      m_prefetch_queue.clear();
+    }
+    m_cond_prefetch.notify_all();
+    if (m_prefetch_thread.joinable()) m_prefetch_thread.join();
+  }
+
+  double OutOfCoreStructuredGridVolume::GetNormalizedSample (int x, int y, int z)
+  {
+    if (GetDataStorageSize() == DataStorageSize::UNKNOWN || IsOutOfBoundary(x, y, z))
+      return 0.0;
+
+    if (GetDataStorageSize() == DataStorageSize::_8_BITS)
+      return GetVoxel(x, y, z) / (256.0 - 1.0);
+    else if (GetDataStorageSize() == DataStorageSize::_16_BITS)
+      return GetVoxel(x, y, z) / (65536.0 - 1.0);
+    return GetVoxel(x, y, z);
+  }
+
+  double OutOfCoreStructuredGridVolume::GetAbsoluteSample (int x, int y, int z)
+  {
+    if (GetDataStorageSize() == DataStorageSize::UNKNOWN || IsOutOfBoundary(x, y, z))
+      return 0.0;
+
+    return GetVoxel(x, y, z);
+  }
+
+  void OutOfCoreStructuredGridVolume::SetCacheBudget (size_t cache_bytes)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget_bytes = cache_bytes;
+    EvictToBudget();
+  }
+
+  size_t OutOfCoreStructuredGridVolume::GetCacheBudget ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget_bytes;
+  }
+
+  size_t OutOfCoreStructuredGridVolume::GetResidentBytes ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_resident_bytes;
+  }
+
+  void OutOfCoreStructuredGridVolume::SetPrefetchEnabled (bool enabled)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prefetch_enabled = enabled;
+    if (!enabled) m_prefetch_queue.clear();
+  }
+
+  bool OutOfCoreStructuredGridVolume::IsPrefetchEnabled ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_prefetch_enabled;
+  }
+
+  unsigned long long OutOfCoreStructuredGridVolume::GetBrickHits ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+  }
+
+  unsigned long long OutOfCoreStructuredGridVolume::GetBrickMisses ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+  }
+
+  unsigned long long OutOfCoreStructuredGridVolume::GetBrickPrefetches ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_prefetches;
+  }
+
+  void OutOfCoreStructuredGridVolume::PrintStatistics ()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    printf("OutOfCoreStructuredGridVolume: %d bricks, %.1f/%.1f MB, %llu hits, %llu misses, %llu prefetched\n",
+      (int)m_bricks.size(), double(m_resident_bytes) / (1024.0 * 1024.0), double(m_budget_bytes) / (1024.0 * 1024.0),
+      m_hits, m_misses, m_prefetches);
+  }
+
+  BrickedVolumeFile* OutOfCoreStructuredGridVolume::GetBrickedVolumeFile ()
+  {
+    return &m_bvol;
+  }
+
+  double OutOfCoreStructuredGridVolume::GetVoxel (int x, int y, int z)
+  {
+    // last brick used by this thread, checked without locking
+    static thread_local unsigned long long tl_owner = 0;
+    static thread_local unsigned int tl_brick_id = 0;
+    static thread_local std::shared_ptr<const Brick> tl_brick;
+
+    unsigned int bs = m_bvol.GetBrickSize();
+    unsigned int brick_id = m_bvol.GetBrickIndex(x / bs, y / bs, z / bs);
+    if (tl_owner != m_serial || tl_brick_id != brick_id || !tl_brick)
+    {
+      int previous_brick = (tl_owner == m_serial) ? (int)tl_brick_id : -1;
+      tl_brick = GetBrick(brick_id);
+      tl_owner = m_serial;
+      tl_brick_id = brick_id;
+      if (previous_brick >= 0) DetectStride(previous_brick, brick_id);
+    }
+
+    const Brick* brick = tl_brick.get();
+    if (!brick) return 0.0;
+
+    size_t id = (size_t)(x - brick->origin.x)
+              + (size_t)(y - brick->origin.y) * brick->dimensions.x
+              + (size_t)(z - brick->origin.z) * brick->dimensions.x * brick->dimensions.y;
+
+    const unsigned char* data = brick->data.data();
+    switch (GetDataStorageSize())
+    {
+    case DataStorageSize::_8_BITS:
+      return (double)data[id];
+    case DataStorageSize::_16_BITS:
+      return (double)reinterpret_cast<const unsigned short*>(data)[id];
+    case DataStorageSize::_NORMALIZED_F:
+      return (double)reinterpret_cast<const float*>(data)[id];
+    case DataStorageSize::_NORMALIZED_D:
+      return reinterpret_cast<const double*>(data)[id];
+    case DataStorageSize::_HALF_F:
+      return (double)HalfToFloat(reinterpret_cast<const unsigned short*>(data)[id]);
+    default:
+      return 0.0;
+    }
+  }
+
+  std::shared_ptr<const OutOfCoreStructuredGridVolume::Brick> OutOfCoreStructuredGridVolume::GetBrick (unsigned int brick_id, bool prefetch)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+      std::unordered_map<unsigned int, Entry>::iterator it = m_bricks.find(brick_id);
+      if (it != m_bricks.end())
+      {
+        if (!prefetch) m_hits++;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        return it->second.brick;
+      }
+      // another thread is already reading it
+      if (m_loading.count(brick_id) == 0) break;
+      if (prefetch) return nullptr;
+      m_cond_loaded.wait(lock);
+    }
+
+    if (prefetch) m_prefetches++;
+    else m_misses++;
+    m_loading.insert(brick_id);
+    lock.unlock();
+
+    std::shared_ptr<const Brick> brick = ReadBrick(brick_id);
+
+    lock.lock();
+    m_loading.erase(brick_id);
+    if (brick)
+    {
+      m_lru.push_front(brick_id);
+      Entry& entry = m_bricks[brick_id];
+      entry.brick = brick;
+      entry.lru = m_lru.begin();
+      m_resident_bytes += brick->data.size();
+      EvictToBudget();
+    }
+    m_cond_loaded.notify_all();
+    return brick;
+  }
+
+  std::shared_ptr<const OutOfCoreStructuredGridVolume::Brick> OutOfCoreStructuredGridVolume::ReadBrick (unsigned int brick_id)
+  {
+    std::shared_ptr<Brick> brick = std::make_shared<Brick>();
+    brick->origin = m_bvol.GetBrickOrigin(brick_id);
+    brick->dimensions = m_bvol.GetBrickDimensions(brick_id);
+
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+    if (!m_bvol.ReadBrick(brick_id, brick->data))
+    {
+      printf("OutOfCoreStructuredGridVolume: error on reading brick %d\n", brick_id);
+      return nullptr;
+    }
+    return brick;
+  }
+
+  void OutOfCoreStructuredGridVolume::EvictToBudget ()
+  {
+    // the most recent brick is kept even if it alone exceeds the budget
+    while (m_resident_bytes > m_budget_bytes && m_lru.size() > 1)
+    {
+      std::unordered_map<unsigned int, Entry>::iterator it = m_bricks.find(m_lru.back());
+      m_resident_bytes -= it->second.brick->data.size();
+      m_bricks.erase(it);
+      m_lru.pop_back();
+    }
+  }
+
+  void OutOfCoreStructuredGridVolume::DetectStride (int previous_brick, unsigned int brick_id)
+  {
+    glm::uvec3 nb = m_bvol.GetNumberOfBricks();
+    glm::ivec3 prev((int)(previous_brick % nb.x), (int)((previous_brick / nb.x) % nb.y), (int)(previous_brick / (nb.x * nb.y)));
+    glm::ivec3 curr((int)(brick_id % nb.x), (int)((brick_id / nb.x) % nb.y), (int)(brick_id / (nb.x * nb.y)));
+
+    // only unit steps along a single axis are followed
+    glm::ivec3 step = curr - prev;
+    if (glm::abs(step.x) + glm::abs(step.y) + glm::abs(step.z) != 1) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_prefetch_enabled) return;
+
+    bool queued = false;
+    for (int k = 1; k <= PREFETCH_DISTANCE; k++)
+    {
+      glm::ivec3 next = curr + step * k;
+      if (glm::any(glm::lessThan(next, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(next, glm::ivec3(nb))))
+        break;
+
+      unsigned int next_id = m_bvol.GetBrickIndex(next.x, next.y, next.z);
+      if (m_bricks.count(next_id) || m_loading.count(next_id)) continue;
+      if (std::find(m_prefetch_queue.begin(), m_prefetch_queue.end(), next_id) != m_prefetch_queue.end()) continue;
+
+      m_prefetch_queue.push_back(next_id);
+      queued = true;
+    }
+    if (queued) m_cond_prefetch.notify_one();
+  }
+
+  void OutOfCoreStructuredGridVolume::PrefetchLoop ()
+  {
+    while (true)
+    {
+      unsigned int brick_id;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_prefetch.wait(lock, [this] { return m_stop || !m_prefetch_queue.empty(); });
+        if (m_stop) return;
+        brick_id = m_prefetch_queue.front();
+        m_prefetch_queue.pop_front();
+      }
+      GetBrick(brick_id, true);
+    }
+  }
+}
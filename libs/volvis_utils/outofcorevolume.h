@@ -0,0 +1,123 @@
+/**
+ * Out-of-core structured grid volume
+ *
+ * Samples are served from a bounded LRU cache of bricks read on demand from
+ *   a bricked volume file (.bvol, see brickedvolume.h), so volumes larger
+ *   than the memory can be used by every CPU consumer that goes through
+ *   GetNormalizedSample/GetAbsoluteSample (gradients, interpolated samples,
+ *   octrees, summed area tables...). GetArrayData returns nullptr.
+ *
+ * Each thread keeps its last brick, so consecutive samples inside a brick do
+ *   not lock. When the misses of a thread walk the bricks with a constant step
+ *   along one of the axes, the next bricks in that direction are read ahead by
+ *   a background thread.
+ *
+ * Huge .raw files can be converted with BrickedVolumeFile::Convert: the raw
+ *   data is memory mapped, so its pages are only read while being bricked.
+**/
+#ifndef VOL_VIS_UTILS_OUT_OF_CORE_VOLUME_H
+#define VOL_VIS_UTILS_OUT_OF_CORE_VOLUME_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/brickedvolume.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vis
+{
+  class OutOfCoreStructuredGridVolume : public StructuredGridVolume
+  {
+  public:
+    static const size_t DEFAULT_CACHE_BYTES = size_t(512) << 20;
+    static const int PREFETCH_DISTANCE = 2;
+
+    // Returns nullptr if filepath is not a valid .bvol file
+    static OutOfCoreStructuredGridVolume* Open (std::string filepath, size_t cache_bytes = DEFAULT_CACHE_BYTES);
+    virtual ~OutOfCoreStructuredGridVolume ();
+
+    virtual double GetNormalizedSample (int x, int y, int z);
+    virtual double GetAbsoluteSample (int x, int y, int z);
+
+    void SetCacheBudget (size_t cache_bytes);
+    size_t GetCacheBudget ();
+    size_t GetResidentBytes ();
+
+    void SetPrefetchEnabled (bool enabled);
+    bool IsPrefetchEnabled ();
+
+    unsigned long long GetBrickHits ();
+    unsigned long long GetBrickMisses ();
+    unsigned long long GetBrickPrefetches ();
+    void PrintStatistics ();
+
+    BrickedVolumeFile* GetBrickedVolumeFile ();
+
+  protected:
+    class Brick
+    {
+    public:
+      glm::uvec3 origin;
+      glm::uvec3 dimensions;
+      std::vector<unsigned char> data;
+    };
+
+    OutOfCoreStructuredGridVolume (std::string filepath, glm::uvec3 dimensions, size_t cache_bytes);
+
+    // Absolute value of voxel (x, y, z), which must be inside the volume
+    double GetVoxel (int x, int y, int z);
+
+    // Cached brick, read (and possibly evicted others) on a miss
+    std::shared_ptr<const Brick> GetBrick (unsigned int brick_id, bool prefetch = false);
+    std::shared_ptr<const Brick> ReadBrick (unsigned int brick_id);
+    // Must be called with m_mutex locked
+    void EvictToBudget ();
+
+    // Queue the next bricks if brick_id follows previous_miss along an axis
+    void DetectStride (int previous_miss, unsigned int brick_id);
+    void PrefetchLoop ();
+
+  private:
+    class Entry
+    {
+    public:
+      std::shared_ptr<const Brick> brick;
+      std::list<unsigned int>::iterator lru;
+    };
+
+    BrickedVolumeFile m_bvol;
+    std::mutex m_file_mutex;
+
+    // unique per instance, identifies the owner of the per thread last brick
+    unsigned long long m_serial;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond_loaded;
+    std::unordered_map<unsigned int, Entry> m_bricks;
+    // front: most recently used
+    std::list<unsigned int> m_lru;
+    // bricks being read by some thread
+    std::set<unsigned int> m_loading;
+    size_t m_budget_bytes;
+    size_t m_resident_bytes;
+
+    unsigned long long m_hits;
+    unsigned long long m_misses;
+    unsigned long long m_prefetches;
+
+    bool m_prefetch_enabled;
+    bool m_stop;
+    std::deque<unsigned int> m_prefetch_queue;
+    std::condition_variable m_cond_prefetch;
+    std::thread m_prefetch_thread;
+  };
+}
+
+#endif
@@ -7,15 +7,26 @@
 #include <file_utils/pvm.h>
 #include <file_utils/pvm_old.h>
 #include <file_utils/rawloader.h>
+#include <file_utils/mappedfile.h>
+#include <file_utils/positionedfile.h>
 
 #include <fstream>
 #include <array>
 
 #include <volvis_utils/transferfunction1d.h>
+#include <volvis_utils/brickedvolume.h>
+#include <volvis_utils/outofcorevolume.h>
+#include <volvis_utils/volumesequencefile.h>
+#include <volvis_utils/syntheticvolume.h>
+#include <volvis_utils/voxelformats.h>
 
 namespace vis
 {
   VolumeReader::VolumeReader ()
+    : m_use_memory_mapping(true)
+    , m_out_of_core_threshold(size_t(4) << 30)
+    , m_pack_12_bit_data(false)
+    , m_half_float_data(false)
   {
 
   }
@@ -45,6 +56,9 @@ namespace vis
     else if (extension.compare("syn") == 0) {
       ret = readsyn(filepath);
     }
+    else if (extension.compare("synb") == 0) {
+      ret = readsynb(filepath);
+    }
     else if (extension.compare("nrrd") == 0) {
       ret = readnrrd(filepath);
     }
@@ -54,12 +68,119 @@ namespace vis
     else if (extension.compare("dat") == 0) {
       ret = readdat(filepath);
     }
+    else if (extension.compare("bvol") == 0) {
+      ret = readbvol(filepath);
+    }
+    else if (extension.compare("tvol") == 0) {
+      ret = readtvol(filepath);
+    }
 
+    if (ret) ApplyStorageConversions(ret);
     return ret;
   }
 
+  StructuredGridVolume* VolumeReader::ReadStructuredVolumeRegion (std::string filepath, glm::ivec3 rmin,
+                                                                  glm::ivec3 rmax, glm::ivec3 stride)
+  {
+    int found = filepath.find_last_of('.');
+    std::string extension = filepath.substr(size_t(found + 1));
+
+    printf(". Reading Structured Grid Volume Region... ");
+    RawVolumeHeader header;
+    bool valid_header = false;
+    if (extension.compare("raw") == 0) {
+      valid_header = readrawheader(filepath, &header);
+    }
+    else if (extension.compare("nrrd") == 0 || extension.compare("nhrd") == 0) {
+      valid_header = readnrrdheader(filepath, &header);
+    }
+    else if (extension.compare("dat") == 0) {
+      valid_header = readdatheader(filepath, &header);
+    }
+    else {
+      printf("Error -> Regions can only be read from .raw, .dat and .nrrd files\n");
+      return nullptr;
+    }
+
+    if (!valid_header)
+    {
+      printf("Error -> Could not read header of %s\n", filepath.c_str());
+      return nullptr;
+    }
+
+    StructuredGridVolume* sg_ret = ReadRawRegion(header, rmin, rmax, stride);
+    if (sg_ret)
+    {
+      sg_ret->SetName(filepath);
+      ApplyStorageConversions(sg_ret);
+    }
+    return sg_ret;
+  }
+
+  void VolumeReader::SetUseMemoryMapping (bool use_mmap)
+  {
+    m_use_memory_mapping = use_mmap;
+  }
+
+  bool VolumeReader::GetUseMemoryMapping ()
+  {
+    return m_use_memory_mapping;
+  }
+
+  void VolumeReader::SetOutOfCoreThreshold (size_t threshold_bytes)
+  {
+    m_out_of_core_threshold = threshold_bytes;
+  }
+
+  size_t VolumeReader::GetOutOfCoreThreshold ()
+  {
+    return m_out_of_core_threshold;
+  }
+
+  void VolumeReader::SetPack12BitData (bool pack)
+  {
+    m_pack_12_bit_data = pack;
+  }
+
+  bool VolumeReader::GetPack12BitData ()
+  {
+    return m_pack_12_bit_data;
+  }
+
+  void VolumeReader::SetHalfFloatData (bool half)
+  {
+    m_half_float_data = half;
+  }
+
+  bool VolumeReader::GetHalfFloatData ()
+  {
+    return m_half_float_data;
+  }
+
+  void VolumeReader::ApplyStorageConversions (StructuredGridVolume* sg)
+  {
+    // out-of-core volumes have no voxel array to convert
+    if (!sg->GetArrayData()) return;
+
+    DataStorageSize dss = sg->GetDataStorageSize();
+    if (m_pack_12_bit_data && dss == DataStorageSize::_16_BITS
+     && FitsInPacked12Bits(static_cast<const unsigned short*>(sg->GetArrayData()), sg->GetVoxelArraySize()))
+    {
+      if (sg->ConvertDataStorageSize(DataStorageSize::_12_BITS_PACKED))
+        printf("  - Storage         : packed 12 bits\n");
+    }
+    else if (m_half_float_data && (dss == DataStorageSize::_NORMALIZED_F || dss == DataStorageSize::_NORMALIZED_D))
+    {
+      if (sg->ConvertDataStorageSize(DataStorageSize::_HALF_F))
+        printf("  - Storage         : half float\n");
+    }
+  }
+
   void VolumeReader::SetArrayDataFromRawFile (std::string filepath, StructuredGridVolume* sg, int bytes_per_value)
   {
+    if (m_use_memory_mapping && SetMappedArrayDataFromRawFile(filepath, sg, bytes_per_value))
+      return;
+
     int fw = sg->GetWidth(), fh = sg->GetHeight(), fd = sg->GetDepth();
 
     IRAWLoader rawLoader = IRAWLoader(filepath, bytes_per_value, fw * fh * fd, bytes_per_value);
@@ -96,6 +217,127 @@ namespace vis
     sg->SetArrayData(scalar_values, data_tp);
   }
 
+  bool VolumeReader::SetMappedArrayDataFromRawFile (std::string filepath, StructuredGridVolume* sg, int bytes_per_value)
+  {
+    vis::DataStorageSize data_tp = vis::GetStorageSizeType(bytes_per_value);
+    if (data_tp != vis::DataStorageSize::_8_BITS && data_tp != vis::DataStorageSize::_16_BITS)
+      return false;
+
+    size_t n_bytes = (size_t)sg->GetWidth() * (size_t)sg->GetHeight() * (size_t)sg->GetDepth() * (size_t)bytes_per_value;
+
+    MappedFile* mapped_file = new MappedFile();
+    if (!mapped_file->Open(filepath, 0, n_bytes))
+    {
+      delete mapped_file;
+      return false;
+    }
+
+    // We won't delete the mapped file, because it will be stored at structured grid volume...
+    sg->SetMappedArrayData(mapped_file, data_tp);
+    printf("  - Memory Mapped   : %zu bytes\n", n_bytes);
+
+    return true;
+  }
+
+  StructuredGridVolume* VolumeReader::ReadRawRegion (const RawVolumeHeader& header, glm::ivec3 rmin,
+                                                     glm::ivec3 rmax, glm::ivec3 stride)
+  {
+    printf("Started  -> Read Volume Region From %s\n", header.data_filepath.c_str());
+
+    vis::DataStorageSize data_tp = vis::GetStorageSizeType(header.bytes_per_value);
+    if (data_tp != vis::DataStorageSize::_8_BITS && data_tp != vis::DataStorageSize::_16_BITS)
+    {
+      printf("Finished -> Unsupported %d bytes per value\n", header.bytes_per_value);
+      return nullptr;
+    }
+
+    glm::ivec3 dim = header.dimensions;
+    if (rmax == glm::ivec3(0)) rmax = dim;
+    rmin = glm::clamp(rmin, glm::ivec3(0), dim);
+    rmax = glm::clamp(rmax, rmin, dim);
+    stride = glm::max(stride, glm::ivec3(1));
+
+    glm::ivec3 out = (rmax - rmin + stride - 1) / stride;
+    if (out.x == 0 || out.y == 0 || out.z == 0)
+    {
+      printf("Finished -> Empty region\n");
+      return nullptr;
+    }
+
+    size_t bpv = (size_t)header.bytes_per_value;
+    PositionedFile file;
+    if (!file.Open(header.data_filepath)
+      || file.GetSize() < size_t(dim.x) * size_t(dim.y) * size_t(dim.z) * bpv)
+    {
+      printf("Finished -> Error on opening data file\n");
+      return nullptr;
+    }
+
+    void* scalar_values = vis::AllocateVoxelArray(data_tp, size_t(out.x) * size_t(out.y) * size_t(out.z));
+    unsigned char* voxels = static_cast<unsigned char*>(scalar_values);
+
+    StructuredGridVolume* sg_ret = new StructuredGridVolume(header.name, out.x, out.y, out.z);
+    sg_ret->SetScale(header.scale.x * stride.x, header.scale.y * stride.y, header.scale.z * stride.z);
+    sg_ret->SetArrayData(scalar_values, data_tp);
+
+    // Rows of a slice are contiguous in the file if whole rows are read
+    //   without skipping: read them at once
+    int rows_per_read = (stride.x == 1 && stride.y == 1 && rmin.x == 0 && rmax.x == dim.x) ? out.y : 1;
+    int reads_per_slice = out.y / rows_per_read;
+    // Bytes from the first to the last voxel kept in a row
+    size_t row_span = (size_t(out.x - 1) * size_t(stride.x) + 1) * bpv;
+
+    int failed = 0;
+#pragma omp parallel
+    {
+      std::vector<unsigned char> row;
+      if (stride.x > 1) row.resize(row_span);
+
+#pragma omp for schedule(dynamic)
+      for (int k = 0; k < out.z * reads_per_slice; k++)
+      {
+        int oz = k / reads_per_slice;
+        int oy = (k % reads_per_slice) * rows_per_read;
+        size_t z = size_t(rmin.z) + size_t(oz) * size_t(stride.z);
+        size_t y = size_t(rmin.y) + size_t(oy) * size_t(stride.y);
+
+        size_t file_offset = ((z * size_t(dim.y) + y) * size_t(dim.x) + size_t(rmin.x)) * bpv;
+        unsigned char* dst = voxels + (size_t(oz) * size_t(out.y) + size_t(oy)) * size_t(out.x) * bpv;
+
+        bool ok;
+        if (stride.x == 1)
+        {
+          ok = file.ReadAt(file_offset, dst, row_span * size_t(rows_per_read));
+        }
+        else
+        {
+          ok = file.ReadAt(file_offset, row.data(), row_span);
+          for (int ox = 0; ox < out.x && ok; ox++)
+            memcpy(dst + size_t(ox) * bpv, row.data() + size_t(ox) * size_t(stride.x) * bpv, bpv);
+        }
+        if (!ok)
+        {
+#pragma omp atomic write
+          failed = 1;
+        }
+      }
+    }
+
+    if (failed)
+    {
+      printf("Finished -> Error on reading data file\n");
+      delete sg_ret;
+      return nullptr;
+    }
+
+    printf("  - Region          : [%d, %d, %d] - [%d, %d, %d], stride [%d, %d, %d]\n",
+      rmin.x, rmin.y, rmin.z, rmax.x, rmax.y, rmax.z, stride.x, stride.y, stride.z);
+    printf("  - Volume Size     : [%d, %d, %d]\n", out.x, out.y, out.z);
+    printf("Finished -> Read Volume Region\n");
+
+    return sg_ret;
+  }
+
   StructuredGridVolume* VolumeReader::readpvm (std::string filename)
   {
     StructuredGridVolume* ret = nullptr;
@@ -107,6 +349,11 @@ namespace vis
     double scalex, scaley, scalez;
 
     Pvm fpvm(filename.c_str());
+    if (fpvm.GetData() == nullptr)
+    {
+      printf("Finished -> Error on opening .pvm file\n");
+      return nullptr;
+    }
 
     fpvm.GetDimensions(&width, &height, &depth);
     components = fpvm.GetComponents();
@@ -114,33 +361,14 @@ namespace vis
 
     assert(components > 0);
 
-    vis::DataStorageSize data_tp;
-    void* scalar_values = nullptr;
-
-    // GLubyte - 8 bits
+    // The decoded voxels are already stored as GLubyte (8 bits) or
+    //   GLushort (16 bits), so the array is moved to the volume as is
+    vis::DataStorageSize data_tp = vis::DataStorageSize::UNKNOWN;
     if (components == 1)
-    {
       data_tp = vis::DataStorageSize::_8_BITS;
-    
-      scalar_values = new unsigned char[width * height * depth];
-      unsigned char* u_sv = static_cast<unsigned char*>(scalar_values);
-
-      unsigned char* vol_data = static_cast<unsigned char*>(fpvm.GetData());
-      for (int i = 0; i < width * height * depth; i++)
-        u_sv[i] = (unsigned char)vol_data[i];
-    }
-    // GLushort - 16 bits
     else if (components == 2)
-    {
       data_tp = vis::DataStorageSize::_16_BITS;
-      
-      scalar_values = new unsigned short[width * height * depth];
-      unsigned short* u_sv = static_cast<unsigned short*>(scalar_values);
-
-      unsigned short* vol_data = static_cast<unsigned short*>(fpvm.GetData());
-      for (int i = 0; i < width * height * depth; i++)
-        u_sv[i] = (unsigned short)vol_data[i];
-    }
+    void* scalar_values = fpvm.ReleaseData();
 
     ret = new StructuredGridVolume(filename, width, height, depth);
     ret->SetScale(scalex, scaley, scalez);
@@ -165,53 +393,25 @@ namespace vis
     printf("Started  -> Read Volume From .raw File\n");
     printf("  - File .raw Path: %s\n", filepath.c_str());
 
-    std::ifstream iffile(filepath.c_str());
-    if (iffile.is_open())
+    RawVolumeHeader header;
+    if (!readrawheader(filepath, &header))
     {
-      int foundinit = filepath.find_last_of('\\');
-      std::string filename = filepath.substr(foundinit + 1);
-      printf("  - File .raw: %s\n", filename.c_str());
-
-      int foundfp = filename.find_last_of('.');
-      filename = filename.substr(0, foundfp);
-
-      int foundsizes = filename.find_last_of('.');
-      std::string t_filesizes = filename.substr(foundsizes + 1, filename.size() - foundsizes);
-
-      filename = filename.substr(0, filename.find_last_of('.'));
-
-      int foundbytesize = filename.find_last_of('.');
-      std::string t_filebytesize = filename.substr(foundbytesize + 1, filename.size() - foundbytesize);
-
-      int fw, fh, fd;
-      int bytes_per_value;
-
-      // Read the Volume Sizes
-      int foundd = t_filesizes.find_last_of('x');
-      fd = atoi(t_filesizes.substr(foundd + 1, t_filesizes.size() - foundd).c_str());
-
-      t_filesizes = t_filesizes.substr(0, t_filesizes.find_last_of('x'));
-
-      int foundh = t_filesizes.find_last_of('x');
-      fh = atoi(t_filesizes.substr(foundh + 1, t_filesizes.size() - foundh).c_str());
-
-      t_filesizes = t_filesizes.substr(0, t_filesizes.find_last_of('x'));
-
-      int foundw = t_filesizes.find_last_of('x');
-      fw = atoi(t_filesizes.substr(foundw + 1, t_filesizes.size() - foundw).c_str());
+      printf("Finished -> Error on opening .raw file\n");
+      return nullptr;
+    }
 
-      // Byte Size
-      bytes_per_value = atoi(t_filebytesize.c_str());
+    int fw = header.dimensions.x, fh = header.dimensions.y, fd = header.dimensions.z;
+    int bytes_per_value = header.bytes_per_value;
 
-      sg_ret = new StructuredGridVolume(filename, fw, fh, fd);
-      sg_ret->SetScale(1.0, 1.0, 1.0);
-      sg_ret->SetName(filepath);
+    sg_ret = new StructuredGridVolume(header.name, fw, fh, fd);
+    sg_ret->SetScale(1.0, 1.0, 1.0);
+    sg_ret->SetName(filepath);
 
-      SetArrayDataFromRawFile(filepath, sg_ret, bytes_per_value);
+    SetArrayDataFromRawFile(filepath, sg_ret, bytes_per_value);
 
-      printf("  - Volume Name     : %s\n", filepath.c_str());
-      printf("  - Volume Size     : [%d, %d, %d]\n", fw, fh, fd);
-      printf("  - Volume Byte Size: %d\n", bytes_per_value);
+    printf("  - Volume Name     : %s\n", filepath.c_str());
+    printf("  - Volume Size     : [%d, %d, %d]\n", fw, fh, fd);
+    printf("  - Volume Byte Size: %d\n", bytes_per_value);
 
     //   AABB volumeBox = AABB(glm::vec3(0, 0, 0), glm::vec3(fw-1, fh-1, fd-1));
     //   OctreeNode node = OctreeNode(volumeBox);
@@ -243,16 +443,57 @@ namespace vis
 	//   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, octreeSSBO);
 	//   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-      iffile.close();
-      printf("Finished -> Read Volume From .raw File\n");
-    }
-    else {
-      printf("Finished -> Error on opening .raw file\n");
-    }
+    printf("Finished -> Read Volume From .raw File\n");
 
     return sg_ret;
   }
 
+  bool VolumeReader::readrawheader (std::string filepath, RawVolumeHeader* header)
+  {
+    std::ifstream iffile(filepath.c_str());
+    if (!iffile.is_open()) return false;
+    iffile.close();
+
+    int foundinit = filepath.find_last_of('\\');
+    std::string filename = filepath.substr(foundinit + 1);
+    printf("  - File .raw: %s\n", filename.c_str());
+
+    int foundfp = filename.find_last_of('.');
+    filename = filename.substr(0, foundfp);
+
+    int foundsizes = filename.find_last_of('.');
+    std::string t_filesizes = filename.substr(foundsizes + 1, filename.size() - foundsizes);
+
+    filename = filename.substr(0, filename.find_last_of('.'));
+
+    int foundbytesize = filename.find_last_of('.');
+    std::string t_filebytesize = filename.substr(foundbytesize + 1, filename.size() - foundbytesize);
+
+    int fw, fh, fd;
+
+    // Read the Volume Sizes
+    int foundd = t_filesizes.find_last_of('x');
+    fd = atoi(t_filesizes.substr(foundd + 1, t_filesizes.size() - foundd).c_str());
+
+    t_filesizes = t_filesizes.substr(0, t_filesizes.find_last_of('x'));
+
+    int foundh = t_filesizes.find_last_of('x');
+    fh = atoi(t_filesizes.substr(foundh + 1, t_filesizes.size() - foundh).c_str());
+
+    t_filesizes = t_filesizes.substr(0, t_filesizes.find_last_of('x'));
+
+    int foundw = t_filesizes.find_last_of('x');
+    fw = atoi(t_filesizes.substr(foundw + 1, t_filesizes.size() - foundw).c_str());
+
+    header->name = filename;
+    header->data_filepath = filepath;
+    header->dimensions = glm::ivec3(fw, fh, fd);
+    header->scale = glm::dvec3(1.0);
+    // Byte Size
+    header->bytes_per_value = atoi(t_filebytesize.c_str());
+    return true;
+  }
+
   StructuredGridVolume* VolumeReader::readpvmold (std::string filename)
   {
     StructuredGridVolume* ret = nullptr;
@@ -406,6 +647,22 @@ namespace vis
     printf("Started  -> Read Volume From .nrrd File\n");
     printf("  - File .nrrd Path: %s\n", filepath.c_str());
 
+    RawVolumeHeader header;
+    if (readnrrdheader(filepath, &header)) {
+      sg_ret = new StructuredGridVolume(header.name, header.dimensions.x, header.dimensions.y, header.dimensions.z);
+      sg_ret->SetScale(header.scale.x, header.scale.y, header.scale.z);
+
+      SetArrayDataFromRawFile(header.data_filepath, sg_ret, header.bytes_per_value);
+    }
+    else {
+      printf("Finished -> Error on opening .nrrd file\n");
+    }
+
+    return sg_ret;
+  }
+
+  bool VolumeReader::readnrrdheader (std::string filepath, RawVolumeHeader* header)
+  {
     std::string path = filepath;
     std::string name = filepath;
     int t1 = filepath.find_last_of('\\');
@@ -417,7 +674,8 @@ namespace vis
     }
 
     std::ifstream iffile(filepath.c_str());
-    if (iffile.is_open()) {
+    if (!iffile.is_open()) return false;
+    {
       std::string version;
       std::getline(iffile, version);
 
@@ -497,11 +755,6 @@ namespace vis
       }
       iffile.close();
 
-      sg_ret = new StructuredGridVolume(name, resolution.x, resolution.y, resolution.z);
-      sg_ret->SetScale(slicethickness.x, slicethickness.y, slicethickness.z);
-
-      std::string volume_data_array_file = path + "/" + data_file;
-
       int bytes_per_value = 1;
       if ((int)type.find("uint8") > -1) {
         bytes_per_value = sizeof(unsigned char);
@@ -510,13 +763,13 @@ namespace vis
         bytes_per_value = sizeof(unsigned short);
       }
 
-      SetArrayDataFromRawFile(volume_data_array_file, sg_ret, bytes_per_value);
-    }
-    else {
-      printf("Finished -> Error on opening .nrrd file\n");
+      header->name = name;
+      header->data_filepath = path + "/" + data_file;
+      header->dimensions = resolution;
+      header->scale = glm::dvec3(slicethickness);
+      header->bytes_per_value = bytes_per_value;
     }
-
-    return sg_ret;
+    return true;
   }
 
   StructuredGridVolume* VolumeReader::readnhrd (std::string filepath)
@@ -531,8 +784,25 @@ namespace vis
     printf("Started  -> Read Volume From .dat File\n");
     printf("  - File .dat Path: %s\n", filepath.c_str());
 
+    RawVolumeHeader header;
+    if (readdatheader(filepath, &header)) {
+      sg_ret = new StructuredGridVolume(header.name, header.dimensions.x, header.dimensions.y, header.dimensions.z);
+      sg_ret->SetScale(header.scale.x, header.scale.y, header.scale.z);
+
+      SetArrayDataFromRawFile(header.data_filepath, sg_ret, header.bytes_per_value);
+    }
+    else {
+      printf("Finished -> Error on opening .dat file\n");
+    }
+
+    return sg_ret;
+  }
+
+  bool VolumeReader::readdatheader (std::string filepath, RawVolumeHeader* header)
+  {
     std::ifstream iffile(filepath.c_str());
-    if (iffile.is_open()) {
+    if (!iffile.is_open()) return false;
+    {
       std::string path = filepath;
       std::string name = filepath;
       int t1 = filepath.find_last_of('\\');
@@ -634,11 +904,6 @@ namespace vis
       }
       iffile.close();
 
-      sg_ret = new StructuredGridVolume(name, resolution.x, resolution.y, resolution.z);
-      sg_ret->SetScale(slicethickness.x, slicethickness.y, slicethickness.z);
-      
-      std::string volume_data_array_file = path + "/" + objectfilename;
-
       int bytes_per_value = 1;
       if ((int)format.find("UCHAR") > -1) {       // 8 bits
         bytes_per_value = sizeof(unsigned char);
@@ -647,12 +912,88 @@ namespace vis
         bytes_per_value = sizeof(unsigned short);
       }
 
-      SetArrayDataFromRawFile(volume_data_array_file, sg_ret, bytes_per_value);
+      header->name = name;
+      header->data_filepath = path + "/" + objectfilename;
+      header->dimensions = resolution;
+      header->scale = glm::dvec3(slicethickness);
+      header->bytes_per_value = bytes_per_value;
     }
-    else {
-      printf("Finished -> Error on opening .dat file\n");
+    return true;
+  }
+
+  StructuredGridVolume* VolumeReader::readbvol (std::string filepath)
+  {
+    printf("Started  -> Read Volume From .bvol File\n");
+    printf("  - File .bvol Path: %s\n", filepath.c_str());
+
+    BrickedVolumeFile bvol;
+    if (!bvol.Open(filepath))
+    {
+      printf("Finished -> Error on opening .bvol file\n");
+      return nullptr;
+    }
+
+    glm::uvec3 dim = bvol.GetDimensions();
+    size_t voxel_bytes = size_t(dim.x) * size_t(dim.y) * size_t(dim.z) * GetStorageSizeBytes(bvol.GetDataStorageSize());
+
+    StructuredGridVolume* sg_ret = nullptr;
+    if (m_out_of_core_threshold > 0 && voxel_bytes > m_out_of_core_threshold)
+    {
+      printf("  - Out-of-core: %.1f MB of voxels\n", double(voxel_bytes) / (1024.0 * 1024.0));
+      bvol.Close();
+      sg_ret = OutOfCoreStructuredGridVolume::Open(filepath);
+    }
+    else
+    {
+      sg_ret = bvol.Load();
+    }
+    if (sg_ret) sg_ret->SetName(filepath);
+
+    printf("Finished -> Read Volume From .bvol File\n");
+    return sg_ret;
+  }
+
+  StructuredGridVolume* VolumeReader::readtvol (std::string filepath)
+  {
+    printf("Started  -> Read Volume From .tvol File\n");
+    printf("  - File .tvol Path: %s\n", filepath.c_str());
+
+    VolumeSequenceFile tvol;
+    if (!tvol.Open(filepath))
+    {
+      printf("Finished -> Error on opening .tvol file\n");
+      return nullptr;
+    }
+    printf("  - Timesteps      : %d\n", tvol.GetNumberOfTimesteps());
+
+    StructuredGridVolume* sg_ret = tvol.LoadTimestep(0);
+    if (sg_ret) sg_ret->SetName(filepath);
+
+    printf("Finished -> Read Volume From .tvol File\n");
+    return sg_ret;
+  }
+
+
+  StructuredGridVolume* VolumeReader::readsynb (std::string filepath)
+  {
+    printf("Started  -> Read Volume From .synb File\n");
+    printf("  - File .synb Path: %s\n", filepath.c_str());
+
+    SyntheticVolumeGenerator generator;
+    if (!generator.Read(filepath))
+    {
+      printf("Finished -> Error on opening .synb file\n");
+      return nullptr;
+    }
+
+    StructuredGridVolume* sg_ret = generator.Generate(filepath);
+    if (sg_ret)
+    {
+      printf("  - Volume Size     : [%d, %d, %d]\n", sg_ret->GetWidth(), sg_ret->GetHeight(), sg_ret->GetDepth());
+      printf("  - Number of Shapes: %d\n", (int)generator.GetShapes().size());
     }
 
+    printf("Finished -> Read Volume From .synb File\n");
     return sg_ret;
   }
 
@@ -3,6 +3,8 @@
  * - VolumeReader:
  *  .pvm
  *  .raw
+ *  .bvol (out-of-core above a size threshold)
+ *  .tvol (first timestep, see volumesequence.h for playback)
  *
  * - TransferFunctionReader:
  *  .tf1d
@@ -21,6 +23,18 @@
 
 namespace vis
 {
+  // Layout of a volume whose voxels are stored uncompressed, x fastest, in a
+  //   data file (.raw, or the file referenced by a .dat/.nrrd header)
+  class RawVolumeHeader
+  {
+  public:
+    std::string name;
+    std::string data_filepath;
+    glm::ivec3 dimensions;
+    glm::dvec3 scale;
+    int bytes_per_value;
+  };
+
   class VolumeReader
   {
   public:
@@ -29,6 +43,35 @@ namespace vis
 
     StructuredGridVolume* ReadStructuredVolume (std::string filepath);
 
+    // Reads the voxels [rmin, rmax) of a .raw/.dat/.nrrd volume, keeping
+    //   one voxel every stride along each axis (e.g. stride 4 for a 1/4
+    //   resolution preview). rmax = (0, 0, 0) reads until the end of each axis.
+    //   Only the requested rows are read from the data file, with positioned
+    //   reads issued from multiple threads. The scale is multiplied by stride.
+    StructuredGridVolume* ReadStructuredVolumeRegion (std::string filepath, glm::ivec3 rmin,
+                                                      glm::ivec3 rmax = glm::ivec3(0),
+                                                      glm::ivec3 stride = glm::ivec3(1));
+
+    // If enabled, .raw data files are memory mapped instead of copied to
+    //   the heap: the volume only pays page faults on the touched voxels.
+    void SetUseMemoryMapping (bool use_mmap);
+    bool GetUseMemoryMapping ();
+
+    // .bvol files whose voxels take more than threshold bytes are opened as
+    //   OutOfCoreStructuredGridVolume (see outofcorevolume.h). 0 disables it.
+    void SetOutOfCoreThreshold (size_t threshold_bytes);
+    size_t GetOutOfCoreThreshold ();
+
+    // Compact storage of the volumes read (see voxelformats.h), disabled by
+    //   default. Memory mapped voxels are copied to the converted array.
+    // . 16-bit volumes whose values fit in 12 bits are packed, the absolute
+    //   values are kept and normalized by 4095
+    void SetPack12BitData (bool pack);
+    bool GetPack12BitData ();
+    // . float and double volumes are stored as half floats
+    void SetHalfFloatData (bool half);
+    bool GetHalfFloatData ();
+
     void SetArrayDataFromRawFile (std::string filepath, StructuredGridVolume* sg, int bytes_per_value);
 
   protected:
@@ -36,6 +79,8 @@ namespace vis
     StructuredGridVolume* readpvmold (std::string filename);
     StructuredGridVolume* readraw (std::string filepath);
     StructuredGridVolume* readsyn (std::string filepath);
+    // Procedural description, see syntheticvolume.h
+    StructuredGridVolume* readsynb (std::string filepath);
     /**
      * http://teem.sourceforge.net/nrrd/format.html
      * -------------------------------------------
@@ -63,11 +108,29 @@ namespace vis
     StructuredGridVolume* readnhrd (std::string filepath);
     // File structure from zurich datasets
     StructuredGridVolume* readdat (std::string filepath);
+    // Bricked volume container, see brickedvolume.h
+    StructuredGridVolume* readbvol (std::string filepath);
+    // Time-varying volume container, see volumesequencefile.h
+    StructuredGridVolume* readtvol (std::string filepath);
+
+    bool readrawheader (std::string filepath, RawVolumeHeader* header);
+    bool readnrrdheader (std::string filepath, RawVolumeHeader* header);
+    bool readdatheader (std::string filepath, RawVolumeHeader* header);
+
+    StructuredGridVolume* ReadRawRegion (const RawVolumeHeader& header, glm::ivec3 rmin,
+                                         glm::ivec3 rmax, glm::ivec3 stride);
 
     UnstructuredGridVolume* readunsvol (std::string filepath);
 
-  private:
+    bool SetMappedArrayDataFromRawFile (std::string filepath, StructuredGridVolume* sg, int bytes_per_value);
+
+    void ApplyStorageConversions (StructuredGridVolume* sg);
 
+  private:
+    bool m_use_memory_mapping;
+    size_t m_out_of_core_threshold;
+    bool m_pack_12_bit_data;
+    bool m_half_float_data;
   };
 
   class TransferFunctionReader
@@ -0,0 +1,790 @@
+#include "sparsegridvolume.h"
+#include "volumeview.h"
+#include "voxelformats.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace vis
+{
+  // Cell states of FromDense
+  static const unsigned char CELL_EMPTY = 0;
+  static const unsigned char CELL_TILE  = 1;
+  static const unsigned char CELL_LEAF  = 2;
+
+  static int CountBits (uint64_t v)
+  {
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+  }
+
+  // Absolute value v stored in an array of T, rounded and clamped like
+  //   ConvertVoxelStorage for the integer types
+  template<typename T>
+  static inline void StoreAbsolute (typename VoxelTraits<T>::Storage* data, size_t i, double v)
+  {
+    typedef typename VoxelTraits<T>::Value Value;
+    if (std::is_integral<Value>::value)
+      v = v > 0.0 ? std::min(std::floor(v + 0.5), VoxelTraits<T>::MAX_DENSITY) : 0.0;
+    VoxelTraits<T>::Store(data, i, Value(v));
+  }
+
+  template<typename T>
+  static inline double LoadAbsolute (const void* data, size_t i)
+  {
+    return double(VoxelTraits<T>::Load(static_cast<const typename VoxelTraits<T>::Storage*>(data), i));
+  }
+
+  int SparseGridVolume::Leaf::GetNumberOfActiveVoxels () const
+  {
+    int n = 0;
+    for (int w = 0; w < LEAF_VOXELS / 64; w++)
+      n += CountBits(active[w]);
+    return n;
+  }
+
+  /////////////////////
+  // Public Methods  //
+  /////////////////////
+  SparseGridVolume::SparseGridVolume (std::string vname, unsigned int width, unsigned int height, unsigned int depth,
+                                      DataStorageSize dss, int n_components, double background)
+    : GridVolume(vname)
+    , m_width(width)
+    , m_height(height)
+    , m_depth(depth)
+    , m_scalex(1.0)
+    , m_scaley(1.0)
+    , m_scalez(1.0)
+    , m_grid_center(glm::dvec3(0.0))
+    , m_data_storage_size(dss)
+    , m_n_components(std::max(n_components, 1))
+    , m_background(background)
+  {
+    const int node_voxels = 1 << NODE_VOXEL_LOG2;
+    m_root_dim = glm::ivec3((width + node_voxels - 1) / node_voxels,
+                            (height + node_voxels - 1) / node_voxels,
+                            (depth + node_voxels - 1) / node_voxels);
+    m_nodes.assign(size_t(m_root_dim.x) * m_root_dim.y * m_root_dim.z, nullptr);
+  }
+
+  SparseGridVolume::~SparseGridVolume ()
+  {
+    DestroyData();
+  }
+
+  SparseGridVolume* SparseGridVolume::FromDense (StructuredGridVolume* vol, double background,
+                                                 double tolerance, bool make_tiles)
+  {
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN) return nullptr;
+
+    DataStorageSize dss = vol->GetDataStorageSize();
+    SparseGridVolume* sparse = new SparseGridVolume(vol->GetName(), vol->GetWidth(), vol->GetHeight(),
+                                                    vol->GetDepth(), dss, 1, background);
+    sparse->SetScale(vol->GetScaleX(), vol->GetScaleY(), vol->GetScaleZ());
+
+    int w = (int)vol->GetWidth(), h = (int)vol->GetHeight(), d = (int)vol->GetDepth();
+    int cw = (w + LEAF_DIM - 1) / LEAF_DIM, ch = (h + LEAF_DIM - 1) / LEAF_DIM, cd = (d + LEAF_DIM - 1) / LEAF_DIM;
+    size_t n_cells = size_t(cw) * ch * cd;
+
+    // cells are classified in parallel, then inserted in cell order so the
+    //   leaf indices do not depend on the scheduling
+    std::vector<unsigned char> state(n_cells, CELL_EMPTY);
+    std::vector<Leaf*> leaves(n_cells, nullptr);
+    std::vector<double> tile_values(n_cells, 0.0);
+
+    DispatchVolumeView(vol, [&] (const auto& view) {
+      DispatchVoxelType(dss, [&] (auto t) {
+        typedef decltype(t) T;
+#pragma omp parallel for schedule(dynamic)
+        for (int cz = 0; cz < cd; cz++)
+        {
+          double values[LEAF_VOXELS];
+          for (int cy = 0; cy < ch; cy++)
+          {
+            for (int cx = 0; cx < cw; cx++)
+            {
+              glm::ivec3 origin(cx * LEAF_DIM, cy * LEAF_DIM, cz * LEAF_DIM);
+              uint64_t active[LEAF_VOXELS / 64] = { 0 };
+              int n_active = 0;
+              bool uniform = true;
+              for (int i = 0; i < LEAF_VOXELS; i++)
+              {
+                int x = origin.x + (i & (LEAF_DIM - 1));
+                int y = origin.y + ((i >> LEAF_LOG2) & (LEAF_DIM - 1));
+                int z = origin.z + (i >> (2 * LEAF_LOG2));
+                if (x >= w || y >= h || z >= d)
+                {
+                  uniform = false;
+                  values[i] = background;
+                  continue;
+                }
+                values[i] = view.GetAbsolute(x, y, z);
+                if (std::abs(values[i] - background) > tolerance)
+                {
+                  active[i >> 6] |= (uint64_t(1) << (i & 63));
+                  n_active++;
+                }
+                else
+                {
+                  values[i] = background;
+                }
+                if (values[i] != values[0]) uniform = false;
+              }
+              if (n_active == 0) continue;
+
+              size_t c = size_t(cx) + size_t(cy) * cw + size_t(cz) * cw * ch;
+              if (make_tiles && uniform && n_active == LEAF_VOXELS)
+              {
+                state[c] = CELL_TILE;
+                tile_values[c] = values[0];
+                continue;
+              }
+
+              Leaf* leaf = new Leaf();
+              leaf->origin = origin;
+              memcpy(leaf->active, active, sizeof(active));
+              leaf->values = AllocateVoxelArray(dss, LEAF_VOXELS);
+              leaf->min_value = DBL_MAX;
+              leaf->max_value = -DBL_MAX;
+              typename VoxelTraits<T>::Storage* data = static_cast<typename VoxelTraits<T>::Storage*>(leaf->values);
+              for (int i = 0; i < LEAF_VOXELS; i++)
+              {
+                StoreAbsolute<T>(data, i, values[i]);
+                if (leaf->IsActive(i))
+                {
+                  double v = LoadAbsolute<T>(data, i);
+                  leaf->min_value = std::min(leaf->min_value, v);
+                  leaf->max_value = std::max(leaf->max_value, v);
+                }
+              }
+              state[c] = CELL_LEAF;
+              leaves[c] = leaf;
+            }
+          }
+        }
+      });
+    });
+
+    for (size_t c = 0; c < n_cells; c++)
+    {
+      if (state[c] == CELL_TILE)
+      {
+        glm::ivec3 origin(int(c % cw) * LEAF_DIM, int((c / cw) % ch) * LEAF_DIM, int(c / (size_t(cw) * ch)) * LEAF_DIM);
+        sparse->AddTile(origin, &tile_values[c]);
+      }
+      else if (state[c] == CELL_LEAF)
+      {
+        Leaf* leaf = leaves[c];
+        Node* node = sparse->GetOrCreateNode(leaf->origin.x, leaf->origin.y, leaf->origin.z);
+        node->leaves[GetCellIndex(leaf->origin.x, leaf->origin.y, leaf->origin.z)] = (int)sparse->m_leaves.size();
+        sparse->m_leaves.push_back(leaf);
+        node->min_value = std::min(node->min_value, leaf->min_value);
+        node->max_value = std::max(node->max_value, leaf->max_value);
+      }
+    }
+
+    return sparse;
+  }
+
+  StructuredGridVolume* SparseGridVolume::ToDense (int component)
+  {
+    size_t n_voxels = size_t(m_width) * m_height * m_depth;
+    void* voxels = AllocateVoxelArray(m_data_storage_size, n_voxels);
+    if (!voxels) return nullptr;
+
+    int w = (int)m_width, h = (int)m_height, d = (int)m_depth;
+    // packed 12 bit voxels share bytes with their neighbour in the array
+    bool parallel = m_data_storage_size != DataStorageSize::_12_BITS_PACKED;
+
+    DispatchVoxelType(m_data_storage_size, [&] (auto t) {
+      typedef decltype(t) T;
+      typename VoxelTraits<T>::Storage* data = static_cast<typename VoxelTraits<T>::Storage*>(voxels);
+
+      if (m_background != 0.0)
+      {
+#pragma omp parallel for if(parallel)
+        for (int z = 0; z < d; z++)
+          for (size_t i = size_t(z) * w * h; i < size_t(z + 1) * w * h; i++)
+            StoreAbsolute<T>(data, i, m_background);
+      }
+
+      int n_leaves = (int)m_leaves.size();
+#pragma omp parallel for if(parallel)
+      for (int l = 0; l < n_leaves; l++)
+      {
+        const Leaf* leaf = m_leaves[l];
+        for (int i = 0; i < LEAF_VOXELS; i++)
+        {
+          int x = leaf->origin.x + (i & (LEAF_DIM - 1));
+          int y = leaf->origin.y + ((i >> LEAF_LOG2) & (LEAF_DIM - 1));
+          int z = leaf->origin.z + (i >> (2 * LEAF_LOG2));
+          if (x >= w || y >= h || z >= d) continue;
+          StoreAbsolute<T>(data, size_t(x) + size_t(y) * w + size_t(z) * w * h,
+                           LoadAbsolute<T>(leaf->values, size_t(i) * m_n_components + component));
+        }
+      }
+
+      ForEachActiveTile([&] (glm::ivec3 origin, const double* values) {
+        for (int z = origin.z; z < origin.z + LEAF_DIM; z++)
+          for (int y = origin.y; y < origin.y + LEAF_DIM; y++)
+            for (int x = origin.x; x < origin.x + LEAF_DIM; x++)
+              StoreAbsolute<T>(data, size_t(x) + size_t(y) * w + size_t(z) * w * h, values[component]);
+      });
+    });
+
+    StructuredGridVolume* vol = new StructuredGridVolume(GetName(), m_width, m_height, m_depth);
+    vol->SetScale(m_scalex, m_scaley, m_scalez);
+    vol->SetArrayData(voxels, m_data_storage_size);
+    return vol;
+  }
+
+  SparseGridVolume* SparseGridVolume::CreateWithSameTopology (std::string name, DataStorageSize dss, int n_components,
+                                                              double background)
+  {
+    SparseGridVolume* grid = new SparseGridVolume(name, m_width, m_height, m_depth, dss, n_components, background);
+    grid->SetScale(m_scalex, m_scaley, m_scalez);
+    grid->m_grid_center = m_grid_center;
+
+    for (size_t n = 0; n < m_nodes.size(); n++)
+    {
+      if (!m_nodes[n]) continue;
+      Node* node = new Node(*m_nodes[n]);
+      if (!node->tile_values.empty())
+        node->tile_values.assign(size_t(NODE_CELLS) * grid->m_n_components, background);
+      grid->m_nodes[n] = node;
+    }
+
+    grid->m_leaves.resize(m_leaves.size());
+    for (size_t l = 0; l < m_leaves.size(); l++)
+    {
+      Leaf* leaf = grid->NewLeaf(m_leaves[l]->origin);
+      memcpy(leaf->active, m_leaves[l]->active, sizeof(leaf->active));
+      grid->m_leaves[l] = leaf;
+    }
+
+    grid->UpdateRanges();
+    return grid;
+  }
+
+  unsigned int SparseGridVolume::GetWidth ()
+  {
+    return m_width;
+  }
+
+  unsigned int SparseGridVolume::GetHeight ()
+  {
+    return m_height;
+  }
+
+  unsigned int SparseGridVolume::GetDepth ()
+  {
+    return m_depth;
+  }
+
+  glm::dvec3 SparseGridVolume::GetScale ()
+  {
+    return glm::dvec3(m_scalex, m_scaley, m_scalez);
+  }
+
+  void SparseGridVolume::SetScale (double sx, double sy, double sz)
+  {
+    m_scalex = sx;
+    m_scaley = sy;
+    m_scalez = sz;
+  }
+
+  glm::dvec3 SparseGridVolume::GetGridCenterPoint ()
+  {
+    return m_grid_center;
+  }
+
+  glm::dvec3 SparseGridVolume::GetGridBBoxMin ()
+  {
+    return m_grid_center - GetScale() * glm::dvec3(m_width, m_height, m_depth) * 0.5;
+  }
+
+  glm::dvec3 SparseGridVolume::GetGridBBoxMax ()
+  {
+    return m_grid_center + GetScale() * glm::dvec3(m_width, m_height, m_depth) * 0.5;
+  }
+
+  DataStorageSize SparseGridVolume::GetDataStorageSize ()
+  {
+    return m_data_storage_size;
+  }
+
+  int SparseGridVolume::GetNumberOfComponents ()
+  {
+    return m_n_components;
+  }
+
+  double SparseGridVolume::GetBackground ()
+  {
+    return m_background;
+  }
+
+  double SparseGridVolume::GetMaxDensity ()
+  {
+    double max_density = 1.0;
+    DispatchVoxelType(m_data_storage_size, [&] (auto t) {
+      max_density = VoxelTraits<decltype(t)>::MAX_DENSITY;
+    });
+    return max_density;
+  }
+
+  double SparseGridVolume::GetAbsoluteSample (int x, int y, int z, int component)
+  {
+    if (IsOutOfBoundary(x, y, z)) return m_background;
+    Node* node = FindNode(x, y, z);
+    if (!node) return m_background;
+
+    int cell = GetCellIndex(x, y, z);
+    if (node->leaves[cell] >= 0)
+      return GetLeafValue(m_leaves[node->leaves[cell]], GetVoxelIndex(x, y, z), component);
+    if (IsTileActive(node, cell))
+      return node->tile_values[size_t(cell) * m_n_components + component];
+    return m_background;
+  }
+
+  double SparseGridVolume::GetNormalizedSample (int x, int y, int z, int component)
+  {
+    return GetAbsoluteSample(x, y, z, component) / GetMaxDensity();
+  }
+
+  bool SparseGridVolume::IsActive (int x, int y, int z)
+  {
+    if (IsOutOfBoundary(x, y, z)) return false;
+    Node* node = FindNode(x, y, z);
+    if (!node) return false;
+
+    int cell = GetCellIndex(x, y, z);
+    if (node->leaves[cell] >= 0)
+      return m_leaves[node->leaves[cell]]->IsActive(GetVoxelIndex(x, y, z));
+    return IsTileActive(node, cell);
+  }
+
+  void SparseGridVolume::SetValue (int x, int y, int z, double value, int component)
+  {
+    if (IsOutOfBoundary(x, y, z)) return;
+    Node* node = FindNode(x, y, z);
+    if (node)
+    {
+      // setting a tile to its own value keeps the tile
+      int cell = GetCellIndex(x, y, z);
+      if (node->leaves[cell] < 0 && IsTileActive(node, cell)
+        && node->tile_values[size_t(cell) * m_n_components + component] == value)
+        return;
+    }
+
+    Leaf* leaf = GetOrCreateLeaf(x, y, z);
+    int i = GetVoxelIndex(x, y, z);
+    SetLeafValue(leaf, i, value, component);
+    leaf->SetActive(i, true);
+    if (component == 0)
+      ExpandRange(FindNode(x, y, z), leaf, GetLeafValue(leaf, i));
+  }
+
+  void SparseGridVolume::SetActive (int x, int y, int z, bool active)
+  {
+    if (IsOutOfBoundary(x, y, z) || IsActive(x, y, z) == active) return;
+    if (!active && !FindNode(x, y, z)) return;
+
+    Leaf* leaf = GetOrCreateLeaf(x, y, z);
+    int i = GetVoxelIndex(x, y, z);
+    leaf->SetActive(i, active);
+    if (active)
+    {
+      ExpandRange(FindNode(x, y, z), leaf, GetLeafValue(leaf, i));
+    }
+    else
+    {
+      for (int c = 0; c < m_n_components; c++)
+        SetLeafValue(leaf, i, m_background, c);
+    }
+  }
+
+  void SparseGridVolume::DilateActiveVoxels ()
+  {
+    const glm::ivec3 offsets[6] = { glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, -1, 0),
+                                    glm::ivec3(0, 1, 0),  glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1) };
+    std::vector<glm::ivec3> to_activate;
+    auto visit = [&] (int x, int y, int z) {
+      for (int k = 0; k < 6; k++)
+      {
+        glm::ivec3 p = glm::ivec3(x, y, z) + offsets[k];
+        if (!IsOutOfBoundary(p.x, p.y, p.z) && !IsActive(p.x, p.y, p.z))
+          to_activate.push_back(p);
+      }
+    };
+
+    for (size_t l = 0; l < m_leaves.size(); l++)
+    {
+      Leaf* leaf = m_leaves[l];
+      for (int i = 0; i < LEAF_VOXELS; i++)
+        if (leaf->IsActive(i))
+          visit(leaf->origin.x + (i & (LEAF_DIM - 1)), leaf->origin.y + ((i >> LEAF_LOG2) & (LEAF_DIM - 1)),
+                leaf->origin.z + (i >> (2 * LEAF_LOG2)));
+    }
+    // only the faces of a tile have neighbours outside of it
+    ForEachActiveTile([&] (glm::ivec3 o, const double*) {
+      for (int z = o.z; z < o.z + LEAF_DIM; z++)
+        for (int y = o.y; y < o.y + LEAF_DIM; y++)
+          for (int x = o.x; x < o.x + LEAF_DIM; x++)
+            if (x == o.x || y == o.y || z == o.z || x == o.x + LEAF_DIM - 1 || y == o.y + LEAF_DIM - 1
+              || z == o.z + LEAF_DIM - 1)
+              visit(x, y, z);
+    });
+
+    for (size_t k = 0; k < to_activate.size(); k++)
+      SetActive(to_activate[k].x, to_activate[k].y, to_activate[k].z, true);
+  }
+
+  size_t SparseGridVolume::GetNumberOfActiveVoxels ()
+  {
+    size_t n = size_t(GetNumberOfTiles()) * LEAF_VOXELS;
+    for (size_t l = 0; l < m_leaves.size(); l++)
+      n += m_leaves[l]->GetNumberOfActiveVoxels();
+    return n;
+  }
+
+  int SparseGridVolume::GetNumberOfLeaves ()
+  {
+    return (int)m_leaves.size();
+  }
+
+  SparseGridVolume::Leaf* SparseGridVolume::GetLeaf (int leaf_index)
+  {
+    return m_leaves[leaf_index];
+  }
+
+  int SparseGridVolume::GetNumberOfTiles ()
+  {
+    int n = 0;
+    for (size_t i = 0; i < m_nodes.size(); i++)
+      if (m_nodes[i])
+        for (int w = 0; w < NODE_CELLS / 64; w++)
+          n += CountBits(m_nodes[i]->tile_active[w]);
+    return n;
+  }
+
+  size_t SparseGridVolume::GetSizeBytes ()
+  {
+    size_t bytes = m_nodes.size() * sizeof(Node*) + m_leaves.size() * sizeof(Leaf*);
+    for (size_t i = 0; i < m_nodes.size(); i++)
+      if (m_nodes[i])
+        bytes += sizeof(Node) + m_nodes[i]->tile_values.size() * sizeof(double);
+    bytes += m_leaves.size() * (sizeof(Leaf) + GetStorageArrayBytes(m_data_storage_size, size_t(LEAF_VOXELS) * m_n_components));
+    return bytes;
+  }
+
+  double SparseGridVolume::GetLeafValue (const Leaf* leaf, int i, int component)
+  {
+    double value = m_background;
+    DispatchVoxelType(m_data_storage_size, [&] (auto t) {
+      value = LoadAbsolute<decltype(t)>(leaf->values, size_t(i) * m_n_components + component);
+    });
+    return value;
+  }
+
+  void SparseGridVolume::SetLeafValue (Leaf* leaf, int i, double value, int component)
+  {
+    DispatchVoxelType(m_data_storage_size, [&] (auto t) {
+      typedef decltype(t) T;
+      StoreAbsolute<T>(static_cast<typename VoxelTraits<T>::Storage*>(leaf->values),
+                       size_t(i) * m_n_components + component, value);
+    });
+  }
+
+  bool SparseGridVolume::GetRegionMinMax (glm::ivec3 rmin, glm::ivec3 rmax, double* vmin, double* vmax)
+  {
+    rmin = glm::max(rmin, glm::ivec3(0));
+    rmax = glm::min(rmax, glm::ivec3(m_width, m_height, m_depth));
+    if (rmin.x >= rmax.x || rmin.y >= rmax.y || rmin.z >= rmax.z) return false;
+
+    double lo = DBL_MAX, hi = -DBL_MAX;
+    auto covers = [&] (glm::ivec3 o, int size) {
+      glm::ivec3 e = glm::min(o + glm::ivec3(size), glm::ivec3(m_width, m_height, m_depth));
+      return o.x >= rmin.x && o.y >= rmin.y && o.z >= rmin.z && e.x <= rmax.x && e.y <= rmax.y && e.z <= rmax.z;
+    };
+
+    glm::ivec3 nmin = rmin >> NODE_VOXEL_LOG2, nmax = (rmax - 1) >> NODE_VOXEL_LOG2;
+    for (int nz = nmin.z; nz <= nmax.z; nz++)
+    for (int ny = nmin.y; ny <= nmax.y; ny++)
+    for (int nx = nmin.x; nx <= nmax.x; nx++)
+    {
+      Node* node = m_nodes[size_t(nx) + size_t(ny) * m_root_dim.x + size_t(nz) * m_root_dim.x * m_root_dim.y];
+      if (!node || node->min_value > node->max_value) continue;
+      // whole node inside the region, or its range cannot widen the result
+      if (covers(node->origin, 1 << NODE_VOXEL_LOG2) || (node->min_value >= lo && node->max_value <= hi))
+      {
+        lo = std::min(lo, node->min_value);
+        hi = std::max(hi, node->max_value);
+        continue;
+      }
+
+      glm::ivec3 cmin = (glm::max(rmin, node->origin) - node->origin) >> LEAF_LOG2;
+      glm::ivec3 cmax = (glm::min(rmax, node->origin + (1 << NODE_VOXEL_LOG2)) - 1 - node->origin) >> LEAF_LOG2;
+      for (int cz = cmin.z; cz <= cmax.z; cz++)
+      for (int cy = cmin.y; cy <= cmax.y; cy++)
+      for (int cx = cmin.x; cx <= cmax.x; cx++)
+      {
+        int cell = cx + cy * NODE_DIM + cz * NODE_DIM * NODE_DIM;
+        glm::ivec3 origin = GetCellOrigin(node, cell);
+        if (node->leaves[cell] >= 0)
+        {
+          Leaf* leaf = m_leaves[node->leaves[cell]];
+          if (leaf->min_value > leaf->max_value) continue;
+          if (covers(origin, LEAF_DIM) || (leaf->min_value >= lo && leaf->max_value <= hi))
+          {
+            lo = std::min(lo, leaf->min_value);
+            hi = std::max(hi, leaf->max_value);
+            continue;
+          }
+          glm::ivec3 vmin_ = glm::max(rmin, origin), vmax_ = glm::min(rmax, origin + LEAF_DIM);
+          for (int z = vmin_.z; z < vmax_.z; z++)
+          for (int y = vmin_.y; y < vmax_.y; y++)
+          for (int x = vmin_.x; x < vmax_.x; x++)
+          {
+            int i = GetVoxelIndex(x, y, z);
+            if (!leaf->IsActive(i)) continue;
+            double v = GetLeafValue(leaf, i);
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+          }
+        }
+        else if (IsTileActive(node, cell))
+        {
+          double v = node->tile_values[size_t(cell) * m_n_components];
+          lo = std::min(lo, v);
+          hi = std::max(hi, v);
+        }
+      }
+    }
+
+    if (lo > hi) return false;
+    *vmin = lo;
+    *vmax = hi;
+    return true;
+  }
+
+  void SparseGridVolume::UpdateRanges ()
+  {
+    int n_leaves = (int)m_leaves.size();
+#pragma omp parallel for
+    for (int l = 0; l < n_leaves; l++)
+    {
+      Leaf* leaf = m_leaves[l];
+      leaf->min_value = DBL_MAX;
+      leaf->max_value = -DBL_MAX;
+      for (int i = 0; i < LEAF_VOXELS; i++)
+      {
+        if (!leaf->IsActive(i)) continue;
+        double v = GetLeafValue(leaf, i);
+        leaf->min_value = std::min(leaf->min_value, v);
+        leaf->max_value = std::max(leaf->max_value, v);
+      }
+    }
+
+    for (size_t n = 0; n < m_nodes.size(); n++)
+    {
+      Node* node = m_nodes[n];
+      if (!node) continue;
+      node->min_value = DBL_MAX;
+      node->max_value = -DBL_MAX;
+      for (int c = 0; c < NODE_CELLS; c++)
+      {
+        if (node->leaves[c] >= 0)
+        {
+          node->min_value = std::min(node->min_value, m_leaves[node->leaves[c]]->min_value);
+          node->max_value = std::max(node->max_value, m_leaves[node->leaves[c]]->max_value);
+        }
+        else if (IsTileActive(node, c))
+        {
+          node->min_value = std::min(node->min_value, node->tile_values[size_t(c) * m_n_components]);
+          node->max_value = std::max(node->max_value, node->tile_values[size_t(c) * m_n_components]);
+        }
+      }
+    }
+  }
+
+  SparseGridVolume::Accessor::Accessor (SparseGridVolume* grid, int component)
+    : m_grid(grid)
+    , m_component(component)
+    , m_width((int)grid->GetWidth())
+    , m_height((int)grid->GetHeight())
+    , m_depth((int)grid->GetDepth())
+    , m_inv_max_density(1.0 / grid->GetMaxDensity())
+    , m_cell(-1)
+    , m_leaf(nullptr)
+    , m_cell_value(grid->GetBackground())
+  {}
+
+  double SparseGridVolume::Accessor::GetAbsolute (int x, int y, int z) const
+  {
+    if (x < 0 || y < 0 || z < 0 || x >= m_width || y >= m_height || z >= m_depth)
+      return m_grid->m_background;
+
+    glm::ivec3 cell(x >> LEAF_LOG2, y >> LEAF_LOG2, z >> LEAF_LOG2);
+    if (cell != m_cell)
+    {
+      m_cell = cell;
+      m_leaf = nullptr;
+      m_cell_value = m_grid->m_background;
+      Node* node = m_grid->FindNode(x, y, z);
+      if (node)
+      {
+        int c = GetCellIndex(x, y, z);
+        if (node->leaves[c] >= 0)
+          m_leaf = m_grid->m_leaves[node->leaves[c]];
+        else if (m_grid->IsTileActive(node, c))
+          m_cell_value = node->tile_values[size_t(c) * m_grid->m_n_components + m_component];
+      }
+    }
+
+    if (m_leaf)
+      return m_grid->GetLeafValue(m_leaf, GetVoxelIndex(x, y, z), m_component);
+    return m_cell_value;
+  }
+
+  double SparseGridVolume::Accessor::GetNormalizedOrZero (int x, int y, int z) const
+  {
+    if (x < 0 || y < 0 || z < 0 || x >= m_width || y >= m_height || z >= m_depth)
+      return 0.0;
+    return GetNormalized(x, y, z);
+  }
+
+  /////////////////////
+  // Private Methods //
+  /////////////////////
+  void SparseGridVolume::DestroyData ()
+  {
+    for (size_t l = 0; l < m_leaves.size(); l++)
+    {
+      DeleteVoxelArray(m_leaves[l]->values, m_data_storage_size);
+      delete m_leaves[l];
+    }
+    m_leaves.clear();
+
+    for (size_t n = 0; n < m_nodes.size(); n++)
+    {
+      delete m_nodes[n];
+      m_nodes[n] = nullptr;
+    }
+  }
+
+  bool SparseGridVolume::IsOutOfBoundary (int x, int y, int z)
+  {
+    return (x < 0 || y < 0 || z < 0 || x >= (int)m_width || y >= (int)m_height || z >= (int)m_depth);
+  }
+
+  void SparseGridVolume::SetTileActive (Node* node, int cell, bool active)
+  {
+    if (active) node->tile_active[cell >> 6] |= (uint64_t(1) << (cell & 63));
+    else node->tile_active[cell >> 6] &= ~(uint64_t(1) << (cell & 63));
+  }
+
+  glm::ivec3 SparseGridVolume::GetCellOrigin (const Node* node, int cell) const
+  {
+    return node->origin + glm::ivec3(cell & (NODE_DIM - 1), (cell >> NODE_LOG2) & (NODE_DIM - 1),
+                                     cell >> (2 * NODE_LOG2)) * LEAF_DIM;
+  }
+
+  SparseGridVolume::Node* SparseGridVolume::FindNode (int x, int y, int z)
+  {
+    return m_nodes[size_t(x >> NODE_VOXEL_LOG2) + size_t(y >> NODE_VOXEL_LOG2) * m_root_dim.x
+                 + size_t(z >> NODE_VOXEL_LOG2) * m_root_dim.x * m_root_dim.y];
+  }
+
+  SparseGridVolume::Node* SparseGridVolume::GetOrCreateNode (int x, int y, int z)
+  {
+    size_t n = size_t(x >> NODE_VOXEL_LOG2) + size_t(y >> NODE_VOXEL_LOG2) * m_root_dim.x
+             + size_t(z >> NODE_VOXEL_LOG2) * m_root_dim.x * m_root_dim.y;
+    if (!m_nodes[n])
+    {
+      Node* node = new Node();
+      std::fill(node->leaves, node->leaves + NODE_CELLS, -1);
+      memset(node->tile_active, 0, sizeof(node->tile_active));
+      node->origin = glm::ivec3(x, y, z) >> NODE_VOXEL_LOG2 << NODE_VOXEL_LOG2;
+      node->min_value = DBL_MAX;
+      node->max_value = -DBL_MAX;
+      m_nodes[n] = node;
+    }
+    return m_nodes[n];
+  }
+
+  int SparseGridVolume::GetCellIndex (int x, int y, int z)
+  {
+    return ((x >> LEAF_LOG2) & (NODE_DIM - 1)) + ((y >> LEAF_LOG2) & (NODE_DIM - 1)) * NODE_DIM
+         + ((z >> LEAF_LOG2) & (NODE_DIM - 1)) * NODE_DIM * NODE_DIM;
+  }
+
+  int SparseGridVolume::GetVoxelIndex (int x, int y, int z)
+  {
+    return (x & (LEAF_DIM - 1)) + (y & (LEAF_DIM - 1)) * LEAF_DIM + (z & (LEAF_DIM - 1)) * LEAF_DIM * LEAF_DIM;
+  }
+
+  SparseGridVolume::Leaf* SparseGridVolume::GetOrCreateLeaf (int x, int y, int z)
+  {
+    Node* node = GetOrCreateNode(x, y, z);
+    int cell = GetCellIndex(x, y, z);
+    if (node->leaves[cell] >= 0) return m_leaves[node->leaves[cell]];
+
+    Leaf* leaf = NewLeaf(GetCellOrigin(node, cell));
+    if (IsTileActive(node, cell))
+    {
+      const double* values = &node->tile_values[size_t(cell) * m_n_components];
+      for (int i = 0; i < LEAF_VOXELS; i++)
+        for (int c = 0; c < m_n_components; c++)
+          SetLeafValue(leaf, i, values[c], c);
+      memset(leaf->active, 0xFF, sizeof(leaf->active));
+      leaf->min_value = leaf->max_value = GetLeafValue(leaf, 0);
+      SetTileActive(node, cell, false);
+    }
+
+    node->leaves[cell] = (int)m_leaves.size();
+    m_leaves.push_back(leaf);
+    return leaf;
+  }
+
+  SparseGridVolume::Leaf* SparseGridVolume::NewLeaf (glm::ivec3 origin)
+  {
+    Leaf* leaf = new Leaf();
+    leaf->origin = origin;
+    memset(leaf->active, 0, sizeof(leaf->active));
+    leaf->values = AllocateVoxelArray(m_data_storage_size, size_t(LEAF_VOXELS) * m_n_components);
+    if (m_background != 0.0)
+      for (int i = 0; i < LEAF_VOXELS; i++)
+        for (int c = 0; c < m_n_components; c++)
+          SetLeafValue(leaf, i, m_background, c);
+    leaf->min_value = DBL_MAX;
+    leaf->max_value = -DBL_MAX;
+    return leaf;
+  }
+
+  void SparseGridVolume::AddTile (glm::ivec3 origin, const double* values)
+  {
+    Node* node = GetOrCreateNode(origin.x, origin.y, origin.z);
+    if (node->tile_values.empty())
+      node->tile_values.assign(size_t(NODE_CELLS) * m_n_components, m_background);
+
+    int cell = GetCellIndex(origin.x, origin.y, origin.z);
+    for (int c = 0; c < m_n_components; c++)
+      node->tile_values[size_t(cell) * m_n_components + c] = values[c];
+    SetTileActive(node, cell, true);
+    node->min_value = std::min(node->min_value, values[0]);
+    node->max_value = std::max(node->max_value, values[0]);
+  }
+
+  void SparseGridVolume::ExpandRange (Node* node, Leaf* leaf, double value)
+  {
+    leaf->min_value = std::min(leaf->min_value, value);
+    leaf->max_value = std::max(leaf->max_value, value);
+    node->min_value = std::min(node->min_value, value);
+    node->max_value = std::max(node->max_value, value);
+  }
+}
@@ -0,0 +1,253 @@
+/**
+ * sparsegridvolume.h
+ *
+ * Sparse structured grid for mostly empty datasets (segmentations,
+ *   simulations with a large background), in the spirit of OpenVDB: only
+ *   the active voxels and the blocks around them are stored, so memory and
+ *   the preprocessing passes scale with the occupied volume instead of the
+ *   bounding box.
+ *
+ * Fixed three level hierarchy:
+ * . leaf: block of 8^3 voxels with a bit mask of the active ones and their
+ *   values, in the storage type of the grid (components of a voxel next to
+ *   each other)
+ * . node: 16^3 leaf cells (128^3 voxels). A cell holds a leaf, an active
+ *   tile (every voxel active with the same value, e.g. the inside of a
+ *   segmented organ) or nothing (inactive, background)
+ * . root: dense table of the nodes covering the grid, only the nodes with
+ *   leaves or tiles are allocated
+ *
+ * Inactive voxels read as the background value. Leaves and nodes keep the
+ *   range of their active values (component 0), a two level min/max tree used by
+ *   GetRegionMinMax for empty space skipping.
+**/
+#ifndef VOL_VIS_UTILS_SPARSE_GRID_VOLUME_H
+#define VOL_VIS_UTILS_SPARSE_GRID_VOLUME_H
+
+#include <volvis_utils/gridvolume.h>
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vis
+{
+  class SparseGridVolume : public GridVolume
+  {
+  public:
+    static const int LEAF_LOG2 = 3;
+    static const int LEAF_DIM = 1 << LEAF_LOG2;
+    static const int LEAF_VOXELS = LEAF_DIM * LEAF_DIM * LEAF_DIM;
+    static const int NODE_LOG2 = 4;
+    // leaf cells along each axis of a node
+    static const int NODE_DIM = 1 << NODE_LOG2;
+    static const int NODE_CELLS = NODE_DIM * NODE_DIM * NODE_DIM;
+    static const int NODE_VOXEL_LOG2 = NODE_LOG2 + LEAF_LOG2;
+
+    class Leaf
+    {
+    public:
+      bool IsActive (int i) const { return ((active[i >> 6] >> (i & 63)) & 1) != 0; }
+      void SetActive (int i, bool a)
+      {
+        if (a) active[i >> 6] |= (uint64_t(1) << (i & 63));
+        else active[i >> 6] &= ~(uint64_t(1) << (i & 63));
+      }
+      int GetNumberOfActiveVoxels () const;
+
+      // first voxel of the leaf
+      glm::ivec3 origin;
+      // voxel i = x + y * LEAF_DIM + z * LEAF_DIM * LEAF_DIM
+      uint64_t active[LEAF_VOXELS / 64];
+      // LEAF_VOXELS * number of components, AllocateVoxelArray
+      void* values;
+      // range of the active absolute values of component 0
+      double min_value, max_value;
+    };
+
+    SparseGridVolume (std::string    name = "Unknown",
+                      unsigned int width  = 0,
+                      unsigned int height = 0,
+                      unsigned int depth  = 0,
+                      DataStorageSize dss = DataStorageSize::_8_BITS,
+                      int n_components    = 1,
+                      double background   = 0.0);
+    virtual ~SparseGridVolume ();
+
+    // Voxels whose absolute value differs from background by more than
+    //   tolerance are active, the others are stored as background. With
+    //   make_tiles, cells of 8^3 equal active voxels become tiles.
+    static SparseGridVolume* FromDense (StructuredGridVolume* vol, double background = 0.0,
+                                        double tolerance = 0.0, bool make_tiles = true);
+    // Dense volume of one component, in the storage type of the grid
+    StructuredGridVolume* ToDense (int component = 0);
+    // Empty grid with the leaves, tiles and active voxels of this one, every
+    //   value set to background
+    SparseGridVolume* CreateWithSameTopology (std::string name, DataStorageSize dss, int n_components,
+                                              double background = 0.0);
+
+    unsigned int GetWidth ();
+    unsigned int GetHeight ();
+    unsigned int GetDepth ();
+    glm::dvec3 GetScale ();
+    void SetScale (double sx, double sy, double sz);
+
+    virtual glm::dvec3 GetGridCenterPoint ();
+    virtual glm::dvec3 GetGridBBoxMin ();
+    virtual glm::dvec3 GetGridBBoxMax ();
+
+    DataStorageSize GetDataStorageSize ();
+    int GetNumberOfComponents ();
+    double GetBackground ();
+    // Divisor of the normalized values, see StructuredGridVolume::GetMaxDensity
+    double GetMaxDensity ();
+
+    // Background outside the grid and at inactive voxels
+    double GetAbsoluteSample (int x, int y, int z, int component = 0);
+    double GetNormalizedSample (int x, int y, int z, int component = 0);
+    bool IsActive (int x, int y, int z);
+
+    // Activate the voxel and set one of its components (absolute value). A
+    //   tile is split into a leaf when one of its voxels changes.
+    void SetValue (int x, int y, int z, double value, int component = 0);
+    // Inactive voxels are set to background
+    void SetActive (int x, int y, int z, bool active);
+    // Activate the face neighbours of the active voxels, e.g. so the
+    //   gradients of the voxels around a surface are generated too
+    void DilateActiveVoxels ();
+
+    size_t GetNumberOfActiveVoxels ();
+    int GetNumberOfLeaves ();
+    Leaf* GetLeaf (int leaf_index);
+    int GetNumberOfTiles ();
+    // Bytes of leaves, nodes and tiles
+    size_t GetSizeBytes ();
+
+    // Absolute value of voxel i of a leaf
+    double GetLeafValue (const Leaf* leaf, int i, int component = 0);
+    void SetLeafValue (Leaf* leaf, int i, double value, int component = 0);
+
+    // Range of the active values in [rmin, rmax). False if the region has no
+    //   active voxel.
+    bool GetRegionMinMax (glm::ivec3 rmin, glm::ivec3 rmax, double* vmin, double* vmax);
+    // Recompute the ranges of the leaves and nodes (SetValue and SetActive
+    //   only widen them)
+    void UpdateRanges ();
+
+    // kernel (origin, values) for each active tile, values holds the
+    //   components
+    template<typename Kernel>
+    void ForEachActiveTile (Kernel&& kernel)
+    {
+      for (size_t n = 0; n < m_nodes.size(); n++)
+      {
+        Node* node = m_nodes[n];
+        if (!node || node->tile_values.empty()) continue;
+        for (int c = 0; c < NODE_CELLS; c++)
+          if (IsTileActive(node, c))
+            kernel(GetCellOrigin(node, c), &node->tile_values[size_t(c) * m_n_components]);
+      }
+    }
+
+    // kernel (x, y, z, value) for each active voxel, with the absolute value
+    //   of component 0, leaves first, then tiles
+    template<typename Kernel>
+    void ForEachActiveVoxel (Kernel&& kernel)
+    {
+      for (size_t l = 0; l < m_leaves.size(); l++)
+      {
+        Leaf* leaf = m_leaves[l];
+        for (int i = 0; i < LEAF_VOXELS; i++)
+        {
+          if (!leaf->IsActive(i)) continue;
+          kernel(leaf->origin.x + (i & (LEAF_DIM - 1)), leaf->origin.y + ((i >> LEAF_LOG2) & (LEAF_DIM - 1)),
+                 leaf->origin.z + (i >> (2 * LEAF_LOG2)), GetLeafValue(leaf, i));
+        }
+      }
+      ForEachActiveTile([&] (glm::ivec3 origin, const double* values) {
+        for (int z = origin.z; z < origin.z + LEAF_DIM; z++)
+          for (int y = origin.y; y < origin.y + LEAF_DIM; y++)
+            for (int x = origin.x; x < origin.x + LEAF_DIM; x++)
+              kernel(x, y, z, values[0]);
+      });
+    }
+
+    // Random access that remembers the last leaf cell, for the stencils of
+    //   the preprocessing kernels. One per thread. Has the sample interface
+    //   of VolumeView (0 outside the grid).
+    class Accessor
+    {
+    public:
+      Accessor (SparseGridVolume* grid, int component = 0);
+
+      int GetWidth () const { return m_width; }
+      int GetHeight () const { return m_height; }
+      int GetDepth () const { return m_depth; }
+      int GetGhostWidth () const { return 0; }
+
+      double GetAbsolute (int x, int y, int z) const;
+      double GetNormalized (int x, int y, int z) const { return GetAbsolute(x, y, z) * m_inv_max_density; }
+      double GetNormalizedOrZero (int x, int y, int z) const;
+
+    private:
+      SparseGridVolume* m_grid;
+      int m_component;
+      int m_width, m_height, m_depth;
+      double m_inv_max_density;
+
+      // last cell looked up
+      mutable glm::ivec3 m_cell;
+      mutable const Leaf* m_leaf;
+      mutable double m_cell_value;
+    };
+
+  protected:
+    virtual void DestroyData ();
+
+  private:
+    struct Node
+    {
+      // index in m_leaves, -1 if the cell has no leaf
+      int leaves[NODE_CELLS];
+      uint64_t tile_active[NODE_CELLS / 64];
+      // NODE_CELLS * number of components, empty until the first tile
+      std::vector<double> tile_values;
+      glm::ivec3 origin;
+      double min_value, max_value;
+    };
+
+    bool IsOutOfBoundary (int x, int y, int z);
+    bool IsTileActive (const Node* node, int cell) const { return ((node->tile_active[cell >> 6] >> (cell & 63)) & 1) != 0; }
+    void SetTileActive (Node* node, int cell, bool active);
+    glm::ivec3 GetCellOrigin (const Node* node, int cell) const;
+
+    Node* FindNode (int x, int y, int z);
+    Node* GetOrCreateNode (int x, int y, int z);
+    static int GetCellIndex (int x, int y, int z);
+    static int GetVoxelIndex (int x, int y, int z);
+
+    // Leaf of the cell of (x, y, z), created if needed: from the tile of the
+    //   cell, or with every voxel inactive
+    Leaf* GetOrCreateLeaf (int x, int y, int z);
+    Leaf* NewLeaf (glm::ivec3 origin);
+    void AddTile (glm::ivec3 origin, const double* values);
+    void ExpandRange (Node* node, Leaf* leaf, double value);
+
+    unsigned int m_width, m_height, m_depth;
+    double m_scalex, m_scaley, m_scalez;
+    glm::dvec3 m_grid_center;
+
+    DataStorageSize m_data_storage_size;
+    int m_n_components;
+    double m_background;
+
+    glm::ivec3 m_root_dim;
+    std::vector<Node*> m_nodes;
+    std::vector<Leaf*> m_leaves;
+  };
+}
+
+#endif
@@ -1,4 +1,9 @@
 #include "structuredgridvolume.h"
+#include "voxellayout.h"
+#include "voxelformats.h"
+#include "volumestatistics.h"
+
+#include <file_utils/mappedfile.h>
 
 #include <iostream>
 #include <string>
@@ -20,12 +25,18 @@ namespace vis
     , m_scalez(1.0)
     , m_grid_center(glm::dvec3(0.0))
     , m_data_storage_size(DataStorageSize::UNKNOWN)
+    , m_data_storage_ownership(DataStorageOwnership::OWNED_ARRAY)
     , m_voxel_values(nullptr)
+    , m_mapped_file(nullptr)
+    , m_voxel_layout_table(nullptr)
+    , m_statistics(nullptr)
   {}
   
   StructuredGridVolume::~StructuredGridVolume ()
   {
     DestroyData();
+    delete m_voxel_layout_table;
+    ResetStatistics();
   }
   
   unsigned int StructuredGridVolume::GetWidth ()
@@ -110,7 +121,22 @@ namespace vis
   void StructuredGridVolume::SetArrayData (void* input_vol_data, DataStorageSize dss)
   {
     m_data_storage_size = dss;
+    m_data_storage_ownership = DataStorageOwnership::OWNED_ARRAY;
     m_voxel_values = input_vol_data;
+    ResetStatistics();
+    delete m_voxel_layout_table;
+    m_voxel_layout_table = nullptr;
+  }
+
+  void StructuredGridVolume::SetMappedArrayData (MappedFile* mapped_file, DataStorageSize dss)
+  {
+    m_data_storage_size = dss;
+    m_data_storage_ownership = DataStorageOwnership::MEMORY_MAPPED;
+    m_mapped_file = mapped_file;
+    m_voxel_values = mapped_file->GetData();
+    ResetStatistics();
+    delete m_voxel_layout_table;
+    m_voxel_layout_table = nullptr;
   }
 
   void* StructuredGridVolume::GetArrayData ()
@@ -118,6 +144,94 @@ namespace vis
     return m_voxel_values;
   }
 
+  DataStorageSize StructuredGridVolume::GetDataStorageSize ()
+  {
+    return m_data_storage_size;
+  }
+
+  DataStorageOwnership StructuredGridVolume::GetDataStorageOwnership ()
+  {
+    return m_data_storage_ownership;
+  }
+
+  bool StructuredGridVolume::IsMemoryMapped ()
+  {
+    return m_data_storage_ownership == DataStorageOwnership::MEMORY_MAPPED;
+  }
+
+  bool StructuredGridVolume::ConvertDataStorageSize (DataStorageSize dss)
+  {
+    if (!m_voxel_values || m_data_storage_size == DataStorageSize::UNKNOWN || dss == DataStorageSize::UNKNOWN)
+      return false;
+    if (dss == m_data_storage_size)
+      return true;
+
+    // the conversion is voxel by voxel, the layout table stays valid
+    void* voxels = ConvertVoxelStorage(m_voxel_values, m_data_storage_size, dss, GetVoxelArraySize());
+    if (!voxels) return false;
+
+    DestroyData();
+    m_voxel_values = voxels;
+    m_data_storage_size = dss;
+    m_data_storage_ownership = DataStorageOwnership::OWNED_ARRAY;
+    ResetStatistics();
+    return true;
+  }
+
+  bool StructuredGridVolume::SetVoxelLayout (VoxelLayout layout)
+  {
+    if (!m_voxel_values || IsMemoryMapped() || m_data_storage_size == DataStorageSize::UNKNOWN)
+      return false;
+    if (layout == GetVoxelLayout())
+      return true;
+
+    VoxelLayoutTable linear(VoxelLayout::LINEAR, m_width, m_height, m_depth);
+    VoxelLayoutTable* table = new VoxelLayoutTable(layout, m_width, m_height, m_depth);
+    const VoxelLayoutTable& src = m_voxel_layout_table ? *m_voxel_layout_table : linear;
+    const VoxelLayoutTable& dst = table->GetLayout() == VoxelLayout::LINEAR ? linear : *table;
+
+    void* voxels = ConvertVoxelLayout(m_voxel_values, m_data_storage_size, src, dst);
+    if (!voxels)
+    {
+      delete table;
+      return false;
+    }
+
+    DestroyData();
+    m_voxel_values = voxels;
+    delete m_voxel_layout_table;
+    m_voxel_layout_table = nullptr;
+    if (table->GetLayout() == VoxelLayout::LINEAR)
+      delete table;
+    else
+      m_voxel_layout_table = table;
+    return true;
+  }
+
+  VoxelLayout StructuredGridVolume::GetVoxelLayout ()
+  {
+    return m_voxel_layout_table ? m_voxel_layout_table->GetLayout() : VoxelLayout::LINEAR;
+  }
+
+  const VoxelLayoutTable* StructuredGridVolume::GetVoxelLayoutTable ()
+  {
+    return m_voxel_layout_table;
+  }
+
+  size_t StructuredGridVolume::GetVoxelIndex (int x, int y, int z)
+  {
+    if (m_voxel_layout_table)
+      return m_voxel_layout_table->GetIndex(x, y, z);
+    return size_t(x) + size_t(y) * m_width + size_t(z) * m_width * m_height;
+  }
+
+  size_t StructuredGridVolume::GetVoxelArraySize ()
+  {
+    if (m_voxel_layout_table)
+      return m_voxel_layout_table->GetStorageSize();
+    return size_t(m_width) * m_height * m_depth;
+  }
+
   double StructuredGridVolume::GetNormalizedSample (int x, int y, int z)
   {
     if (m_voxel_values == nullptr
@@ -130,22 +244,32 @@ namespace vis
     if(m_data_storage_size == DataStorageSize::_8_BITS)
     {
       unsigned char* array_vls = static_cast<unsigned char*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())] / (256.0 - 1.0);
+      return (double)array_vls[GetVoxelIndex(x, y, z)] / (256.0 - 1.0);
     }
     else if(m_data_storage_size == DataStorageSize::_16_BITS)
     {
       unsigned short* array_vls = static_cast<unsigned short*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())] / (65536.0 - 1.0);
+      return (double)array_vls[GetVoxelIndex(x, y, z)] / (65536.0 - 1.0);
     }
     else if (m_data_storage_size == DataStorageSize::_NORMALIZED_F)
     {
       float* array_vls = static_cast<float*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())] / (1.0);
+      return (double)array_vls[GetVoxelIndex(x, y, z)] / (1.0);
     }
     else if (m_data_storage_size == DataStorageSize::_NORMALIZED_D)
     {
       double* array_vls = static_cast<double*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())] / (1.0);
+      return (double)array_vls[GetVoxelIndex(x, y, z)] / (1.0);
+    }
+    else if (m_data_storage_size == DataStorageSize::_HALF_F)
+    {
+      unsigned short* array_vls = static_cast<unsigned short*>(m_voxel_values);
+      return (double)HalfToFloat(array_vls[GetVoxelIndex(x, y, z)]) / (1.0);
+    }
+    else if (m_data_storage_size == DataStorageSize::_12_BITS_PACKED)
+    {
+      unsigned char* array_vls = static_cast<unsigned char*>(m_voxel_values);
+      return (double)GetPacked12(array_vls, GetVoxelIndex(x, y, z)) / (4096.0 - 1.0);
     }
     return 0.0;
   }
@@ -162,22 +286,32 @@ namespace vis
     if(m_data_storage_size == DataStorageSize::_8_BITS)
     {
       unsigned char* array_vls = static_cast<unsigned char*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())];
+      return (double)array_vls[GetVoxelIndex(x, y, z)];
     }
     else if(m_data_storage_size == DataStorageSize::_16_BITS)
     {
       unsigned short* array_vls = static_cast<unsigned short*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())];
+      return (double)array_vls[GetVoxelIndex(x, y, z)];
     }
     else if (m_data_storage_size == DataStorageSize::_NORMALIZED_F)
     {
       float* array_vls = static_cast<float*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())];
+      return (double)array_vls[GetVoxelIndex(x, y, z)];
     }
     else if (m_data_storage_size == DataStorageSize::_NORMALIZED_D)
     {
       double* array_vls = static_cast<double*>(m_voxel_values);
-      return (double)array_vls[x + (y * GetWidth()) + (z * GetWidth() * GetHeight())];
+      return (double)array_vls[GetVoxelIndex(x, y, z)];
+    }
+    else if (m_data_storage_size == DataStorageSize::_HALF_F)
+    {
+      unsigned short* array_vls = static_cast<unsigned short*>(m_voxel_values);
+      return (double)HalfToFloat(array_vls[GetVoxelIndex(x, y, z)]);
+    }
+    else if (m_data_storage_size == DataStorageSize::_12_BITS_PACKED)
+    {
+      unsigned char* array_vls = static_cast<unsigned char*>(m_voxel_values);
+      return (double)GetPacked12(array_vls, GetVoxelIndex(x, y, z));
     }
     return 0.0;
   }
@@ -235,31 +369,43 @@ namespace vis
 
   unsigned long long StructuredGridVolume::CheckSum ()
   {
+    // padding voxels of the layout are zero
     unsigned long long csum = 0;
-    for (int i = 0; i < m_width * m_height * m_depth; i++)
+    if (!m_voxel_values) return csum;
+
+    size_t n = GetVoxelArraySize();
+    DispatchVoxelType(m_data_storage_size, [&] (auto t) {
+      typedef decltype(t) T;
+      const typename VoxelTraits<T>::Storage* array_vls = static_cast<const typename VoxelTraits<T>::Storage*>(m_voxel_values);
+      for (size_t i = 0; i < n; i++)
+        csum += (unsigned long long)VoxelTraits<T>::Load(array_vls, i);
+    });
+    return csum;
+  }
+
+  std::string StructuredGridVolume::GetContentHash ()
+  {
+    // out-of-core volumes would have to read all their bricks
+    if (!m_voxel_values) return std::string();
+
+    const VolumeStatistics* statistics = GetStatistics();
+    return statistics ? statistics->GetContentHash() : std::string();
+  }
+
+  const VolumeStatistics* StructuredGridVolume::GetStatistics (int histogram_bins)
+  {
+    if (m_statistics && (histogram_bins == 0 || histogram_bins == m_statistics->GetHistogramBins()))
+      return m_statistics;
+
+    VolumeStatistics* statistics = new VolumeStatistics();
+    if (!statistics->Compute(this, histogram_bins > 0 ? histogram_bins : VolumeStatistics::DEFAULT_HISTOGRAM_BINS))
     {
-      if (m_data_storage_size == DataStorageSize::_8_BITS)
-      {
-        unsigned char* array_vls = static_cast<unsigned char*>(m_voxel_values);
-        csum += (unsigned long long)array_vls[i];
-      }
-      else if (m_data_storage_size == DataStorageSize::_16_BITS)
-      {
-        unsigned short* array_vls = static_cast<unsigned short*>(m_voxel_values);
-        csum += (unsigned long long)array_vls[i];
-      }
-      else if (m_data_storage_size == DataStorageSize::_NORMALIZED_F)
-      {
-        float* array_vls = static_cast<float*>(m_voxel_values);
-        csum += (unsigned long long)array_vls[i];
-      }
-      else if (m_data_storage_size == DataStorageSize::_NORMALIZED_D)
-      {
-        double* array_vls = static_cast<double*>(m_voxel_values);
-        csum += (unsigned long long)array_vls[i];
-      }
+      delete statistics;
+      return nullptr;
     }
-    return csum;
+    ResetStatistics();
+    m_statistics = statistics;
+    return m_statistics;
   }
 
   double StructuredGridVolume::GetMaxDensity ()
@@ -280,15 +426,36 @@ namespace vis
     {
       return 1.0;
     }
+    else if (m_data_storage_size == DataStorageSize::_HALF_F)
+    {
+      return 1.0;
+    }
+    else if (m_data_storage_size == DataStorageSize::_12_BITS_PACKED)
+    {
+      return (double)(4096.0 - 1.0);
+    }
     return 0.0;
   }
   
   /////////////////////
   // Private Methods //
   /////////////////////
+  void StructuredGridVolume::ResetStatistics ()
+  {
+    delete m_statistics;
+    m_statistics = nullptr;
+  }
+
   void StructuredGridVolume::DestroyData ()
   {
-    if (m_data_storage_size == DataStorageSize::_8_BITS)
+    if (m_data_storage_ownership == DataStorageOwnership::MEMORY_MAPPED)
+    {
+      // The voxel array belongs to the mapped view, only unmap it
+      if (m_mapped_file) delete m_mapped_file;
+      m_mapped_file = nullptr;
+      m_voxel_values = nullptr;
+    }
+    else if (m_data_storage_size == DataStorageSize::_8_BITS)
     {
       unsigned char* array_vls = static_cast<unsigned char*>(m_voxel_values);
       if(array_vls) delete[] array_vls;
@@ -312,5 +479,10 @@ namespace vis
       if (array_vls) delete[] array_vls;
       m_voxel_values = nullptr;
     }
+    else if (m_data_storage_size == DataStorageSize::_HALF_F || m_data_storage_size == DataStorageSize::_12_BITS_PACKED)
+    {
+      DeleteVoxelArray(m_voxel_values, m_data_storage_size);
+      m_voxel_values = nullptr;
+    }
   }
 }
\ No newline at end of file
@@ -13,8 +13,16 @@
 
 #include <glm/glm.hpp>
 
+class MappedFile;
+
 namespace vis
 {
+  // voxellayout.h
+  enum VoxelLayout : unsigned int;
+  class VoxelLayoutTable;
+  // volumestatistics.h
+  class VolumeStatistics;
+
   enum DataStorageSize : unsigned int
   {
     UNKNOWN       = 0, // null data
@@ -22,6 +30,9 @@ namespace vis
     _16_BITS      = 2, // unsigned short [0 - 65535]
     _NORMALIZED_F = 3, // float [0.0f - 1.0f]
     _NORMALIZED_D = 4, // double [0.0 - 1.0]
+    // compact types, see voxelformats.h
+    _HALF_F         = 5, // half float [0.0 - 1.0], IEEE 754 binary16 bits in an unsigned short
+    _12_BITS_PACKED = 6, // unsigned [0 - 4095], two voxels packed in three bytes
   };
 
   static DataStorageSize GetStorageSizeType (size_t bytesize)
@@ -36,6 +47,74 @@ namespace vis
       return DataStorageSize::_NORMALIZED_D;
     return DataStorageSize::UNKNOWN;
   }
+
+  static size_t GetStorageSizeBytes (DataStorageSize dss)
+  {
+    if (dss == DataStorageSize::_8_BITS)
+      return sizeof(unsigned char);
+    else if (dss == DataStorageSize::_16_BITS)
+      return sizeof(unsigned short);
+    else if (dss == DataStorageSize::_NORMALIZED_F)
+      return sizeof(float);
+    else if (dss == DataStorageSize::_NORMALIZED_D)
+      return sizeof(double);
+    else if (dss == DataStorageSize::_HALF_F)
+      return sizeof(unsigned short);
+    // _12_BITS_PACKED voxels do not take a whole number of bytes, see
+    //   GetStorageArrayBytes
+    return 0;
+  }
+
+  // Bytes of an array of n_voxels voxels
+  static size_t GetStorageArrayBytes (DataStorageSize dss, size_t n_voxels)
+  {
+    if (dss == DataStorageSize::_12_BITS_PACKED)
+      return (n_voxels * 3 + 1) / 2;
+    return n_voxels * GetStorageSizeBytes(dss);
+  }
+
+  // Zero-initialized voxel array allocated with new[], as expected by
+  //   StructuredGridVolume::SetArrayData
+  static void* AllocateVoxelArray (DataStorageSize dss, size_t n_voxels)
+  {
+    if (dss == DataStorageSize::_8_BITS)
+      return new unsigned char[n_voxels]();
+    else if (dss == DataStorageSize::_16_BITS)
+      return new unsigned short[n_voxels]();
+    else if (dss == DataStorageSize::_NORMALIZED_F)
+      return new float[n_voxels]();
+    else if (dss == DataStorageSize::_NORMALIZED_D)
+      return new double[n_voxels]();
+    else if (dss == DataStorageSize::_HALF_F)
+      return new unsigned short[n_voxels]();
+    else if (dss == DataStorageSize::_12_BITS_PACKED)
+      return new unsigned char[GetStorageArrayBytes(dss, n_voxels)]();
+    return nullptr;
+  }
+
+  // Release an array of AllocateVoxelArray
+  static void DeleteVoxelArray (void* voxels, DataStorageSize dss)
+  {
+    if (dss == DataStorageSize::_8_BITS)
+      delete[] static_cast<unsigned char*>(voxels);
+    else if (dss == DataStorageSize::_16_BITS)
+      delete[] static_cast<unsigned short*>(voxels);
+    else if (dss == DataStorageSize::_NORMALIZED_F)
+      delete[] static_cast<float*>(voxels);
+    else if (dss == DataStorageSize::_NORMALIZED_D)
+      delete[] static_cast<double*>(voxels);
+    else if (dss == DataStorageSize::_HALF_F)
+      delete[] static_cast<unsigned short*>(voxels);
+    else if (dss == DataStorageSize::_12_BITS_PACKED)
+      delete[] static_cast<unsigned char*>(voxels);
+  }
+
+  // Who owns the voxel array and how it must be released at DestroyData
+  enum DataStorageOwnership : unsigned int
+  {
+    OWNED_ARRAY   = 0, // allocated with new[], released with delete[]
+    MEMORY_MAPPED = 1, // read-only view of a file, released by unmapping
+  };
   
   class StructuredGridVolume : public GridVolume
   {
@@ -44,7 +123,7 @@ namespace vis
                           unsigned int width  = 0,
                           unsigned int height = 0,
                           unsigned int depth  = 0);
-    ~StructuredGridVolume ();
+    virtual ~StructuredGridVolume ();
   
     unsigned int GetWidth ();
     unsigned int GetHeight ();
@@ -63,14 +142,52 @@ namespace vis
 
     bool IsOutOfBoundary (int x, int y, int z);
   
+    // The input array must be in the linear layout (x fastest)
     void SetArrayData (void* input_vol_data, DataStorageSize dss);
+    // Takes ownership of an opened mapped file: voxels are read straight from
+    //   the mapped region, which is read-only.
+    void SetMappedArrayData (MappedFile* mapped_file, DataStorageSize dss);
+    // Voxel array in the current voxel layout
     void* GetArrayData ();
+    DataStorageSize GetDataStorageSize ();
+    DataStorageOwnership GetDataStorageOwnership ();
+    bool IsMemoryMapped ();
+
+    // Convert the voxels to another storage type (see ConvertVoxelStorage,
+    //   voxelformats.h), keeping the voxel layout. Memory mapped data is
+    //   copied to an owned array. Returns false if there is no voxel array.
+    bool ConvertDataStorageSize (DataStorageSize dss);
 
-    double GetNormalizedSample (int x, int y, int z);
-    double GetAbsoluteSample (int x, int y, int z);
+    // Reorder the owned voxel array to layout (see voxellayout.h). Returns
+    //   false if there is no owned array, e.g. memory mapped data.
+    bool SetVoxelLayout (VoxelLayout layout);
+    VoxelLayout GetVoxelLayout ();
+    // nullptr while the layout is linear
+    const VoxelLayoutTable* GetVoxelLayoutTable ();
+    // Position of voxel (x, y, z), inside the volume, in GetArrayData
+    size_t GetVoxelIndex (int x, int y, int z);
+    // Number of elements of GetArrayData, padding of the layout included
+    size_t GetVoxelArraySize ();
+
+    // Virtual so out-of-core volumes can serve samples without a voxel array
+    virtual double GetNormalizedSample (int x, int y, int z);
+    virtual double GetAbsoluteSample (int x, int y, int z);
+    // Trilinear sample of a world space point, see TrilinearVolumeSampler
+    //   (volumesampler.h) to sample many points
     double GetNormalizedInterpolatedSample (double x, double y, double z);
 
+    // Sum of the voxel values truncated to integers, see GetStatistics for
+    //   the mean
     unsigned long long CheckSum ();
+    // SHA-256 based identifier of the dimensions, storage type and voxel
+    //   values in linear order, computed with the statistics. Empty without
+    //   voxel array.
+    std::string GetContentHash ();
+    // Range, moments, histogram and content hash of the voxels (see
+    //   volumestatistics.h), computed in one pass on the first call and kept
+    //   until the voxels change. histogram_bins = 0 accepts the cached
+    //   statistics whatever their number of bins. nullptr without data.
+    const VolumeStatistics* GetStatistics (int histogram_bins = 0);
 
     double GetMaxDensity ();
 
@@ -78,6 +195,7 @@ namespace vis
     virtual void DestroyData ();
   
   private: 
+    void ResetStatistics ();
   
     unsigned int m_width,  m_height, m_depth;
     double       m_scalex, m_scaley, m_scalez;
@@ -85,7 +203,13 @@ namespace vis
     glm::dvec3 m_grid_center;
   
     DataStorageSize m_data_storage_size;
+    DataStorageOwnership m_data_storage_ownership;
     void* m_voxel_values;
+    MappedFile* m_mapped_file;
+    // nullptr for the linear layout
+    VoxelLayoutTable* m_voxel_layout_table;
+
+    VolumeStatistics* m_statistics;
   };
 }
 
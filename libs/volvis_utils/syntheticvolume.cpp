@@ -0,0 +1,443 @@
+#include "syntheticvolume.h"
+#include "voxelformats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace vis
+{
+  namespace
+  {
+    template<typename T>
+    void WriteValue (std::ofstream& f, T v)
+    {
+      f.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadValue (std::ifstream& f, T* v)
+    {
+      f.read(reinterpret_cast<char*>(v), sizeof(T));
+      return f.good();
+    }
+
+    inline uint32_t HashLattice (int64_t x, int64_t y, int64_t z, uint32_t seed)
+    {
+      uint32_t h = seed * 0x9E3779B1u;
+      h ^= (uint32_t)x * 0x85EBCA6Bu;
+      h = (h << 13) | (h >> 19);
+      h ^= (uint32_t)y * 0xC2B2AE35u;
+      h = (h << 13) | (h >> 19);
+      h ^= (uint32_t)z * 0x27D4EB2Fu;
+      // murmur3 finalizer
+      h ^= h >> 16; h *= 0x85EBCA6Bu;
+      h ^= h >> 13; h *= 0xC2B2AE35u;
+      h ^= h >> 16;
+      return h;
+    }
+
+    template<typename T>
+    void StoreRow (void* voxels, size_t offset, const double* row, int width, double max_value)
+    {
+      typedef typename VoxelTraits<T>::Value Value;
+      typename VoxelTraits<T>::Storage* out = static_cast<typename VoxelTraits<T>::Storage*>(voxels);
+      for (int x = 0; x < width; x++)
+      {
+        double v = row[x] < 0.0 ? 0.0 : (row[x] > 1.0 ? 1.0 : row[x]);
+        VoxelTraits<T>::Store(out, offset + x, (max_value > 1.0) ? (Value)(v * max_value + 0.5) : (Value)v);
+      }
+    }
+  }
+
+  SyntheticShape::SyntheticShape ()
+    : type(SYNTHETIC_SHAPE_TYPE::GAUSSIAN_BLOB)
+    , center(0.5)
+    , size(0.25)
+    , amplitude(1.0)
+    , thickness(0.05)
+    , count(1)
+    , octaves(1)
+    , seed(0)
+  {
+  }
+
+  SyntheticVolumeGenerator::SyntheticVolumeGenerator (unsigned int width, unsigned int height, unsigned int depth,
+                                                      DataStorageSize dss)
+    : m_dimensions(width, height, depth)
+    , m_scale(1.0)
+    , m_data_storage_size(dss)
+  {
+  }
+
+  SyntheticVolumeGenerator::~SyntheticVolumeGenerator ()
+  {
+  }
+
+  SyntheticShape SyntheticVolumeGenerator::GaussianBlob (glm::dvec3 center, glm::dvec3 sigma, double amplitude)
+  {
+    SyntheticShape shape;
+    shape.type = SYNTHETIC_SHAPE_TYPE::GAUSSIAN_BLOB;
+    shape.center = center;
+    shape.size = sigma;
+    shape.amplitude = amplitude;
+    return shape;
+  }
+
+  SyntheticShape SyntheticVolumeGenerator::NestedShells (glm::dvec3 center, glm::dvec3 radius, uint32_t count,
+                                                         double thickness, double amplitude)
+  {
+    SyntheticShape shape;
+    shape.type = SYNTHETIC_SHAPE_TYPE::NESTED_SHELLS;
+    shape.center = center;
+    shape.size = radius;
+    shape.count = count;
+    shape.thickness = thickness;
+    shape.amplitude = amplitude;
+    return shape;
+  }
+
+  SyntheticShape SyntheticVolumeGenerator::Checkerboard (glm::dvec3 cell_size, double amplitude)
+  {
+    SyntheticShape shape;
+    shape.type = SYNTHETIC_SHAPE_TYPE::CHECKERBOARD;
+    shape.center = glm::dvec3(0.0);
+    shape.size = cell_size;
+    shape.amplitude = amplitude;
+    return shape;
+  }
+
+  SyntheticShape SyntheticVolumeGenerator::Noise (uint32_t frequency, uint32_t octaves, uint32_t seed, double amplitude)
+  {
+    SyntheticShape shape;
+    shape.type = SYNTHETIC_SHAPE_TYPE::NOISE;
+    shape.count = frequency;
+    shape.octaves = octaves;
+    shape.seed = seed;
+    shape.amplitude = amplitude;
+    return shape;
+  }
+
+  void SyntheticVolumeGenerator::SetDimensions (unsigned int width, unsigned int height, unsigned int depth)
+  {
+    m_dimensions = glm::uvec3(width, height, depth);
+  }
+
+  glm::uvec3 SyntheticVolumeGenerator::GetDimensions ()
+  {
+    return m_dimensions;
+  }
+
+  void SyntheticVolumeGenerator::SetScale (double sx, double sy, double sz)
+  {
+    m_scale = glm::dvec3(sx, sy, sz);
+  }
+
+  glm::dvec3 SyntheticVolumeGenerator::GetScale ()
+  {
+    return m_scale;
+  }
+
+  void SyntheticVolumeGenerator::SetDataStorageSize (DataStorageSize dss)
+  {
+    m_data_storage_size = dss;
+  }
+
+  DataStorageSize SyntheticVolumeGenerator::GetDataStorageSize ()
+  {
+    return m_data_storage_size;
+  }
+
+  void SyntheticVolumeGenerator::AddShape (SyntheticShape shape)
+  {
+    m_shapes.push_back(shape);
+  }
+
+  void SyntheticVolumeGenerator::ClearShapes ()
+  {
+    m_shapes.clear();
+  }
+
+  std::vector<SyntheticShape>& SyntheticVolumeGenerator::GetShapes ()
+  {
+    return m_shapes;
+  }
+
+  StructuredGridVolume* SyntheticVolumeGenerator::Generate (std::string name)
+  {
+    int w = (int)m_dimensions.x;
+    int h = (int)m_dimensions.y;
+    int d = (int)m_dimensions.z;
+    if (w <= 0 || h <= 0 || d <= 0) return nullptr;
+
+    // rows of packed voxels may split a pair between threads, they are
+    //   generated as 16-bit values in [0, 4095] and packed at the end
+    DataStorageSize dss = m_data_storage_size;
+    if (dss == DataStorageSize::_12_BITS_PACKED) dss = DataStorageSize::_16_BITS;
+
+    void* voxels = AllocateVoxelArray(dss, (size_t)w * h * d);
+    if (!voxels) return nullptr;
+
+    double max_value = 1.0;
+    if (m_data_storage_size == DataStorageSize::_8_BITS)  max_value = 255.0;
+    if (m_data_storage_size == DataStorageSize::_16_BITS) max_value = 65535.0;
+    if (m_data_storage_size == DataStorageSize::_12_BITS_PACKED) max_value = 4095.0;
+
+    // terms that only depend on one coordinate are evaluated once per shape
+    std::vector<std::vector<double>> axis_terms(m_shapes.size() * 3);
+    for (size_t s = 0; s < m_shapes.size(); s++)
+      BuildAxisTerms(m_shapes[s], &axis_terms[s * 3]);
+
+#pragma omp parallel
+    {
+      std::vector<double> row(w);
+#pragma omp for schedule(dynamic)
+      for (int z = 0; z < d; z++)
+      {
+        for (int y = 0; y < h; y++)
+        {
+          std::fill(row.begin(), row.end(), 0.0);
+          for (size_t s = 0; s < m_shapes.size(); s++)
+            AccumulateRow(m_shapes[s], &axis_terms[s * 3], y, z, row.data());
+
+          size_t offset = (size_t)w * ((size_t)y + (size_t)h * z);
+          if (dss == DataStorageSize::_8_BITS)
+            StoreRow<unsigned char>(voxels, offset, row.data(), w, max_value);
+          else if (dss == DataStorageSize::_16_BITS)
+            StoreRow<unsigned short>(voxels, offset, row.data(), w, max_value);
+          else if (dss == DataStorageSize::_NORMALIZED_F)
+            StoreRow<float>(voxels, offset, row.data(), w, max_value);
+          else if (dss == DataStorageSize::_NORMALIZED_D)
+            StoreRow<double>(voxels, offset, row.data(), w, max_value);
+          else if (dss == DataStorageSize::_HALF_F)
+            StoreRow<HalfVoxel>(voxels, offset, row.data(), w, max_value);
+        }
+      }
+    }
+
+    StructuredGridVolume* vol = new StructuredGridVolume(name, w, h, d);
+    vol->SetScale(m_scale.x, m_scale.y, m_scale.z);
+    vol->SetArrayData(voxels, dss);
+    if (dss != m_data_storage_size) vol->ConvertDataStorageSize(m_data_storage_size);
+    return vol;
+  }
+
+  bool SyntheticVolumeGenerator::Write (std::string filepath)
+  {
+    std::ofstream f(filepath.c_str(), std::ios::binary);
+    if (!f.is_open()) return false;
+
+    f.write("SYNB", 4);
+    WriteValue<uint32_t>(f, VERSION);
+    WriteValue<uint32_t>(f, m_dimensions.x);
+    WriteValue<uint32_t>(f, m_dimensions.y);
+    WriteValue<uint32_t>(f, m_dimensions.z);
+    WriteValue<double>(f, m_scale.x);
+    WriteValue<double>(f, m_scale.y);
+    WriteValue<double>(f, m_scale.z);
+    WriteValue<uint32_t>(f, (uint32_t)m_data_storage_size);
+    WriteValue<uint32_t>(f, (uint32_t)m_shapes.size());
+    for (size_t s = 0; s < m_shapes.size(); s++)
+    {
+      const SyntheticShape& shape = m_shapes[s];
+      WriteValue<uint32_t>(f, (uint32_t)shape.type);
+      WriteValue<double>(f, shape.center.x);
+      WriteValue<double>(f, shape.center.y);
+      WriteValue<double>(f, shape.center.z);
+      WriteValue<double>(f, shape.size.x);
+      WriteValue<double>(f, shape.size.y);
+      WriteValue<double>(f, shape.size.z);
+      WriteValue<double>(f, shape.amplitude);
+      WriteValue<double>(f, shape.thickness);
+      WriteValue<uint32_t>(f, shape.count);
+      WriteValue<uint32_t>(f, shape.octaves);
+      WriteValue<uint32_t>(f, shape.seed);
+    }
+
+    return f.good();
+  }
+
+  bool SyntheticVolumeGenerator::Read (std::string filepath)
+  {
+    std::ifstream f(filepath.c_str(), std::ios::binary);
+    if (!f.is_open()) return false;
+
+    char magic[4];
+    f.read(magic, 4);
+    uint32_t version = 0;
+    if (!f.good() || memcmp(magic, "SYNB", 4) != 0 || !ReadValue(f, &version) || version != VERSION)
+    {
+      printf("SyntheticVolumeGenerator: %s is not a version %u .synb file\n", filepath.c_str(), VERSION);
+      return false;
+    }
+
+    glm::uvec3 dimensions;
+    glm::dvec3 scale;
+    uint32_t dss, n_shapes;
+    bool ok = ReadValue(f, &dimensions.x) && ReadValue(f, &dimensions.y) && ReadValue(f, &dimensions.z)
+           && ReadValue(f, &scale.x) && ReadValue(f, &scale.y) && ReadValue(f, &scale.z)
+           && ReadValue(f, &dss) && ReadValue(f, &n_shapes);
+
+    // a corrupt header must not allocate more shapes than the file holds
+    //   (type, 8 doubles, count, octaves and seed per shape)
+    const size_t shape_bytes = 4 * sizeof(uint32_t) + 8 * sizeof(double);
+    if (ok)
+    {
+      std::streampos header_end = f.tellg();
+      f.seekg(0, std::ios::end);
+      size_t remaining_bytes = size_t(f.tellg() - header_end);
+      f.seekg(header_end);
+      ok = n_shapes <= remaining_bytes / shape_bytes;
+    }
+    // dimensions of a grid that can be allocated
+    const uint32_t max_dimension = 1 << 15;
+    ok = ok && dimensions.x > 0 && dimensions.y > 0 && dimensions.z > 0
+       && dimensions.x <= max_dimension && dimensions.y <= max_dimension && dimensions.z <= max_dimension;
+
+    std::vector<SyntheticShape> shapes;
+    for (uint32_t s = 0; ok && s < n_shapes; s++)
+    {
+      SyntheticShape shape;
+      uint32_t type;
+      ok = ReadValue(f, &type)
+        && ReadValue(f, &shape.center.x) && ReadValue(f, &shape.center.y) && ReadValue(f, &shape.center.z)
+        && ReadValue(f, &shape.size.x) && ReadValue(f, &shape.size.y) && ReadValue(f, &shape.size.z)
+        && ReadValue(f, &shape.amplitude) && ReadValue(f, &shape.thickness)
+        && ReadValue(f, &shape.count) && ReadValue(f, &shape.octaves) && ReadValue(f, &shape.seed)
+        && type <= (uint32_t)SYNTHETIC_SHAPE_TYPE::NOISE;
+      shape.type = (SYNTHETIC_SHAPE_TYPE)type;
+      shapes.push_back(shape);
+    }
+
+    if (!ok || GetStorageArrayBytes((DataStorageSize)dss, 2) == 0)
+    {
+      printf("SyntheticVolumeGenerator: invalid .synb file %s\n", filepath.c_str());
+      return false;
+    }
+
+    m_dimensions = dimensions;
+    m_scale = scale;
+    m_data_storage_size = (DataStorageSize)dss;
+    m_shapes = shapes;
+    return true;
+  }
+
+  void SyntheticVolumeGenerator::AccumulateRow (const SyntheticShape& shape, const std::vector<double>* axis,
+                                                int y, int z, double* row)
+  {
+    int w = (int)m_dimensions.x;
+    const double* ax = axis[0].data();
+
+    if (shape.type == SYNTHETIC_SHAPE_TYPE::GAUSSIAN_BLOB)
+    {
+      // exp(-(a + b + c)) = exp(-a) * exp(-b) * exp(-c)
+      double f = shape.amplitude * axis[1][y] * axis[2][z];
+      for (int x = 0; x < w; x++)
+        row[x] += f * ax[x];
+    }
+    else if (shape.type == SYNTHETIC_SHAPE_TYPE::NESTED_SHELLS)
+    {
+      if (shape.count == 0 || shape.thickness <= 0.0) return;
+      double yz = axis[1][y] + axis[2][z];
+      double max_r = 1.0 + 4.0 * shape.thickness;
+      if (yz > max_r * max_r) return;
+      for (int x = 0; x < w; x++)
+      {
+        double r = std::sqrt(ax[x] + yz);
+        if (r > max_r) continue;
+        // distance to the nearest shell, shells at radius (i + 1) / count
+        double i = std::floor(r * shape.count + 0.5);
+        i = i < 1.0 ? 1.0 : (i > shape.count ? shape.count : i);
+        double dr = (r - i / shape.count) / shape.thickness;
+        row[x] += shape.amplitude * std::exp(-0.5 * dr * dr);
+      }
+    }
+    else if (shape.type == SYNTHETIC_SHAPE_TYPE::CHECKERBOARD)
+    {
+      int yz = (int)axis[1][y] ^ (int)axis[2][z];
+      for (int x = 0; x < w; x++)
+        if (((int)ax[x] ^ yz) != 0) row[x] += shape.amplitude;
+    }
+    else if (shape.type == SYNTHETIC_SHAPE_TYPE::NOISE)
+    {
+      double norm = 0.0;
+      for (uint32_t o = 0; o < shape.octaves; o++)
+        norm += std::pow(0.5, (double)o);
+      if (norm == 0.0) return;
+
+      // (y, z) are fixed along the row: the lattice is first interpolated in
+      //   y and z at each lattice x, then only the x interpolation is per voxel
+      std::vector<double> line;
+      double freq = 1.0, amp = shape.amplitude / norm;
+      for (uint32_t o = 0; o < shape.octaves; o++)
+      {
+        uint32_t seed = shape.seed + o;
+        double py = axis[1][y] * freq, pz = axis[2][z] * freq;
+        double fy = std::floor(py), fz = std::floor(pz);
+        int64_t iy = (int64_t)fy, iz = (int64_t)fz;
+        double ty = SmoothStep(py - fy), tz = SmoothStep(pz - fz);
+
+        int64_t ix0 = (int64_t)std::floor(ax[0] * freq);
+        int64_t ix1 = (int64_t)std::floor(ax[w - 1] * freq) + 1;
+        line.resize((size_t)(ix1 - ix0 + 1));
+        for (int64_t ix = ix0; ix <= ix1; ix++)
+        {
+          double c00 = LatticeValue(ix, iy    , iz    , seed);
+          double c10 = LatticeValue(ix, iy + 1, iz    , seed);
+          double c01 = LatticeValue(ix, iy    , iz + 1, seed);
+          double c11 = LatticeValue(ix, iy + 1, iz + 1, seed);
+          double c0 = c00 + (c10 - c00) * ty;
+          double c1 = c01 + (c11 - c01) * ty;
+          line[ix - ix0] = c0 + (c1 - c0) * tz;
+        }
+
+        for (int x = 0; x < w; x++)
+        {
+          double px = ax[x] * freq;
+          double fx = std::floor(px);
+          size_t i = (size_t)((int64_t)fx - ix0);
+          row[x] += amp * (line[i] + (line[i + 1] - line[i]) * SmoothStep(px - fx));
+        }
+
+        freq *= 2.0;
+        amp *= 0.5;
+      }
+    }
+  }
+
+  void SyntheticVolumeGenerator::BuildAxisTerms (const SyntheticShape& shape, std::vector<double>* axis)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      int n = (int)m_dimensions[i];
+      axis[i].resize(n);
+      for (int k = 0; k < n; k++)
+      {
+        double p = (double(k) + 0.5) / double(n);
+        double t = (shape.size[i] != 0.0) ? (p - shape.center[i]) / shape.size[i] : 0.0;
+
+        if (shape.type == SYNTHETIC_SHAPE_TYPE::GAUSSIAN_BLOB)
+          axis[i][k] = std::exp(-0.5 * t * t);
+        else if (shape.type == SYNTHETIC_SHAPE_TYPE::NESTED_SHELLS)
+          axis[i][k] = t * t;
+        else if (shape.type == SYNTHETIC_SHAPE_TYPE::CHECKERBOARD)
+          axis[i][k] = (double)((int64_t)std::floor(t) & 1);
+        else if (shape.type == SYNTHETIC_SHAPE_TYPE::NOISE)
+          axis[i][k] = p * shape.count;
+      }
+    }
+  }
+
+  double SyntheticVolumeGenerator::LatticeValue (int64_t x, int64_t y, int64_t z, uint32_t seed)
+  {
+    return double(HashLattice(x, y, z, seed)) / 4294967295.0;
+  }
+
+  double SyntheticVolumeGenerator::SmoothStep (double t)
+  {
+    return t * t * (3.0 - 2.0 * t);
+  }
+}
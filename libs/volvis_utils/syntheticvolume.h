@@ -0,0 +1,116 @@
+/**
+ * Procedural synthetic volumes (.synb)
+ *
+ * A synthetic volume is described by its resolution, storage type and a list
+ *   of shapes, evaluated in normalized coordinates ([0, 1] over each axis, at
+ *   the voxel centers) so the same description can be generated at any
+ *   resolution. Shape values are added and clamped to [0, 1] before being
+ *   quantized to the storage type.
+ *
+ * Shapes:
+ * . GAUSSIAN_BLOB : amplitude * exp(-|(p - center) / size|^2 / 2)
+ * . NESTED_SHELLS : count concentric shells up to radius size, with gaussian
+ *                   profile of width thickness (relative to size)
+ * . CHECKERBOARD  : amplitude on alternating cells of dimensions size, aligned
+ *                   at center
+ * . NOISE         : fractal value noise with count lattice cells per unit and
+ *                   octaves octaves, deterministic given seed
+ *
+ * Only the description is serialized, the voxels are generated when read.
+ *
+ * Format (little endian, fields written one by one):
+ * |"SYNB" version
+ * |width height depth
+ * |scalex scaley scalez
+ * |data_storage_size number_of_shapes
+ * |for each shape: type centerx centery centerz sizex sizey sizez
+ * |                amplitude thickness count octaves seed
+**/
+#ifndef VOL_VIS_UTILS_SYNTHETIC_VOLUME_H
+#define VOL_VIS_UTILS_SYNTHETIC_VOLUME_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vis
+{
+  enum SYNTHETIC_SHAPE_TYPE : uint32_t
+  {
+    GAUSSIAN_BLOB = 0,
+    NESTED_SHELLS = 1,
+    CHECKERBOARD  = 2,
+    NOISE         = 3,
+  };
+
+  class SyntheticShape
+  {
+  public:
+    SyntheticShape ();
+
+    SYNTHETIC_SHAPE_TYPE type;
+    glm::dvec3 center;
+    glm::dvec3 size;
+    double amplitude;
+    double thickness;
+    uint32_t count;
+    uint32_t octaves;
+    uint32_t seed;
+  };
+
+  class SyntheticVolumeGenerator
+  {
+  public:
+    static const uint32_t VERSION = 1;
+
+    SyntheticVolumeGenerator (unsigned int width = 128, unsigned int height = 128, unsigned int depth = 128,
+                              DataStorageSize dss = DataStorageSize::_8_BITS);
+    ~SyntheticVolumeGenerator ();
+
+    static SyntheticShape GaussianBlob (glm::dvec3 center, glm::dvec3 sigma, double amplitude = 1.0);
+    static SyntheticShape NestedShells (glm::dvec3 center, glm::dvec3 radius, uint32_t count,
+                                        double thickness = 0.05, double amplitude = 1.0);
+    static SyntheticShape Checkerboard (glm::dvec3 cell_size, double amplitude = 1.0);
+    static SyntheticShape Noise (uint32_t frequency, uint32_t octaves = 4, uint32_t seed = 0, double amplitude = 1.0);
+
+    void SetDimensions (unsigned int width, unsigned int height, unsigned int depth);
+    glm::uvec3 GetDimensions ();
+    void SetScale (double sx, double sy, double sz);
+    glm::dvec3 GetScale ();
+    void SetDataStorageSize (DataStorageSize dss);
+    DataStorageSize GetDataStorageSize ();
+
+    void AddShape (SyntheticShape shape);
+    void ClearShapes ();
+    std::vector<SyntheticShape>& GetShapes ();
+
+    // Evaluates the shapes at every voxel, slices in parallel
+    StructuredGridVolume* Generate (std::string name = "Synthetic");
+
+    bool Write (std::string filepath);
+    bool Read (std::string filepath);
+
+  protected:
+    // Adds the values of shape to row (width values) at voxel row (y, z)
+    void AccumulateRow (const SyntheticShape& shape, const std::vector<double>* axis,
+                        int y, int z, double* row);
+    // Per axis terms of shape that only depend on one coordinate
+    void BuildAxisTerms (const SyntheticShape& shape, std::vector<double>* axis);
+
+    // Value in [0, 1] of the noise lattice point (x, y, z)
+    static double LatticeValue (int64_t x, int64_t y, int64_t z, uint32_t seed);
+    static double SmoothStep (double t);
+
+  private:
+    glm::uvec3 m_dimensions;
+    glm::dvec3 m_scale;
+    DataStorageSize m_data_storage_size;
+    std::vector<SyntheticShape> m_shapes;
+  };
+}
+
+#endif
@@ -47,7 +47,11 @@ namespace vis
   class TransferFunction
   {
   public:
-    TransferFunction () {}
+    TransferFunction ()
+      : m_revision(0)
+    {
+      ClearChanges();
+    }
     ~TransferFunction () {}
 
     virtual const char* GetNameClass () = 0;
@@ -64,6 +68,32 @@ namespace vis
     
     std::string GetName () { return m_name; }
     void SetName (std::string name) { m_name = name; }
+
+    //////////////////////////////////////////////////////////////////
+    // Change tracking, for the data derived from the transfer function:
+    //   the ranges of normalized densities whose color or opacity changed
+    //   since the last ClearChanges. The revision is incremented by every
+    //   change.
+    unsigned int GetRevision () { return m_revision; }
+    bool HasColorChanges () { return m_dirty_color_min <= m_dirty_color_max; }
+    bool HasOpacityChanges () { return m_dirty_opacity_min <= m_dirty_opacity_max; }
+    // false if nothing changed
+    bool GetDirtyColorInterval (double* nmin, double* nmax)
+    {
+      *nmin = m_dirty_color_min; *nmax = m_dirty_color_max;
+      return HasColorChanges();
+    }
+    bool GetDirtyOpacityInterval (double* nmin, double* nmax)
+    {
+      *nmin = m_dirty_opacity_min; *nmax = m_dirty_opacity_max;
+      return HasOpacityChanges();
+    }
+    void ClearChanges ()
+    {
+      // empty intervals (min > max)
+      m_dirty_color_min = m_dirty_opacity_min = 1.0;
+      m_dirty_color_max = m_dirty_opacity_max = 0.0;
+    }
     
     //////////////////////////////////////////////////////////////////
     // Interface from:
@@ -84,7 +114,23 @@ namespace vis
 
 
   protected:
+    void MarkColorChanged (double nmin, double nmax)
+    {
+      m_dirty_color_min = glm::min(m_dirty_color_min, glm::max(nmin, 0.0));
+      m_dirty_color_max = glm::max(m_dirty_color_max, glm::min(nmax, 1.0));
+      m_revision++;
+    }
+    void MarkOpacityChanged (double nmin, double nmax)
+    {
+      m_dirty_opacity_min = glm::min(m_dirty_opacity_min, glm::max(nmin, 0.0));
+      m_dirty_opacity_max = glm::max(m_dirty_opacity_max, glm::min(nmax, 1.0));
+      m_revision++;
+    }
+
     std::string m_name;
+    unsigned int m_revision;
+    double m_dirty_color_min, m_dirty_color_max;
+    double m_dirty_opacity_min, m_dirty_opacity_max;
 
   private:
   };
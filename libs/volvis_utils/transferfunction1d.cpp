@@ -2,6 +2,7 @@
 #include <gl_utils/texture1d.h>
 #include <GL/glew.h>
 
+#include <algorithm>
 #include <fstream>
 #include <cstdlib>
 
@@ -42,17 +43,88 @@ namespace vis
   void TransferFunction1D::AddRGBControlPoint (TransferControlPoint rgb)
   {
     m_cpt_rgb.push_back (rgb);
+    MarkColorChanged(0.0, 1.0);
   }
 
   void TransferFunction1D::AddAlphaControlPoint (TransferControlPoint alpha)
   {
     m_cpt_alpha.push_back (alpha);
+    MarkOpacityChanged(0.0, 1.0);
   }
 
   void TransferFunction1D::ClearControlPoints ()
   {
     m_cpt_rgb.clear ();
     m_cpt_alpha.clear ();
+    MarkColorChanged(0.0, 1.0);
+    MarkOpacityChanged(0.0, 1.0);
+  }
+
+  int TransferFunction1D::GetNumberOfRGBControlPoints ()
+  {
+    return (int)m_cpt_rgb.size();
+  }
+
+  int TransferFunction1D::GetNumberOfAlphaControlPoints ()
+  {
+    return (int)m_cpt_alpha.size();
+  }
+
+  TransferControlPoint TransferFunction1D::GetRGBControlPoint (int i)
+  {
+    return m_cpt_rgb[i];
+  }
+
+  TransferControlPoint TransferFunction1D::GetAlphaControlPoint (int i)
+  {
+    return m_cpt_alpha[i];
+  }
+
+  void TransferFunction1D::SetRGBControlPoint (int i, TransferControlPoint rgb)
+  {
+    int first, last;
+    SetControlPoint(m_cpt_rgb, i, rgb, &first, &last);
+
+    if (m_built)
+      BuildLinear(first, last);
+    MarkColorChanged(GetNormalizedDensity(first - 1), GetNormalizedDensity(last + 1));
+  }
+
+  void TransferFunction1D::SetAlphaControlPoint (int i, TransferControlPoint alpha)
+  {
+    int first, last;
+    SetControlPoint(m_cpt_alpha, i, alpha, &first, &last);
+
+    if (m_built)
+      BuildLinear(first, last);
+    MarkOpacityChanged(GetNormalizedDensity(first - 1), GetNormalizedDensity(last + 1));
+  }
+
+  void TransferFunction1D::SetControlPoint (std::vector<TransferControlPoint>& cpts, int i, TransferControlPoint cp,
+                                            int* first, int* last)
+  {
+    // an inner point stays between its neighbours, the end points can move
+    //   over the whole table
+    int old_iso = cpts[i].m_isoValue;
+    int lower = i > 0 ? cpts[i - 1].m_isoValue : 0;
+    int upper = i + 1 < (int)cpts.size() ? cpts[i + 1].m_isoValue : max_density;
+    cp.m_isoValue = glm::clamp(cp.m_isoValue, lower, upper);
+    cpts[i] = cp;
+
+    // the entries between the neighbours depend on the point, and for an end
+    //   point the ones it covered before or covers now
+    *first = i > 0 ? lower : std::min(old_iso, cp.m_isoValue);
+    *last = i + 1 < (int)cpts.size() ? upper : std::max(old_iso, cp.m_isoValue);
+  }
+
+  int TransferFunction1D::GetMaxDensity ()
+  {
+    return max_density;
+  }
+
+  double TransferFunction1D::GetNormalizedDensity (int entry)
+  {
+    return double(entry) / double(max_density);
   }
 
   gl::Texture1D* TransferFunction1D::GenerateTexture_1D_RGBA ()
@@ -316,12 +388,19 @@ namespace vis
     return true;
   }
 
-  void TransferFunction1D::BuildLinear ()
+  void TransferFunction1D::BuildLinear (int first, int last)
   {
+    if (last < 0) last = max_density;
+
+    // entries outside the end points are zero
+    for (int x = std::max(first, 0); x <= std::min(last, max_density); x++)
+      m_transferfunction[x] = glm::dvec4(0.0);
+
     for (int i = 0; i < (int)m_cpt_rgb.size() - 1; i++)
     {
       int i0 = m_cpt_rgb[i].m_isoValue;
       int i1 = m_cpt_rgb[i + 1].m_isoValue;
+      if (i1 < first || i0 > last) continue;
 
       glm::dvec3 diff = glm::dvec3(
         m_cpt_rgb[i + 1].m_color.r - m_cpt_rgb[i].m_color.r,
@@ -329,9 +408,9 @@ namespace vis
         m_cpt_rgb[i + 1].m_color.b - m_cpt_rgb[i].m_color.b
       );
 
-      for (int x = i0; x <= i1; x++)
+      for (int x = std::max(i0, first); x <= std::min(i1, last); x++)
       {
-        double k = (double)(x - i0) / (double)(i1 - i0);
+        double k = i1 > i0 ? (double)(x - i0) / (double)(i1 - i0) : 0.0;
 
         m_transferfunction[x].r = m_cpt_rgb[i].m_color.r + diff.r * k;
         m_transferfunction[x].g = m_cpt_rgb[i].m_color.g + diff.g * k;
@@ -343,14 +422,15 @@ namespace vis
     {
       int i0 = m_cpt_alpha[i].m_isoValue;
       int i1 = m_cpt_alpha[i + 1].m_isoValue;
+      if (i1 < first || i0 > last) continue;
 
       double diff = double(
         m_cpt_alpha[i + 1].m_color.a - m_cpt_alpha[i].m_color.a
         );
 
-      for (int x = i0; x <= i1; x++)
+      for (int x = std::max(i0, first); x <= std::min(i1, last); x++)
       {
-        double k = (double)(x - i0) / (double)(i1 - i0);
+        double k = i1 > i0 ? (double)(x - i0) / (double)(i1 - i0) : 0.0;
 
         m_transferfunction[x].a = m_cpt_alpha[i].m_color.a + diff * k;
       }
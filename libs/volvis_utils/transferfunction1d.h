@@ -53,6 +53,17 @@ namespace vis
     void AddAlphaControlPoint (TransferControlPoint alpha);
     void ClearControlPoints ();
 
+    int GetNumberOfRGBControlPoints ();
+    int GetNumberOfAlphaControlPoints ();
+    TransferControlPoint GetRGBControlPoint (int i);
+    TransferControlPoint GetAlphaControlPoint (int i);
+    // Edit a control point, its isovalue clamped between the ones of its
+    //   neighbours. Only the segments around it are rebuilt in the table,
+    //   and reported as changed.
+    void SetRGBControlPoint (int i, TransferControlPoint rgb);
+    void SetAlphaControlPoint (int i, TransferControlPoint alpha);
+    int GetMaxDensity ();
+
     //If we don't have a file with the values of the TF, we need to compute the TF
     void Build ();
 
@@ -64,7 +75,13 @@ namespace vis
 
     bool m_built;
   private:
-    void BuildLinear ();
+    // Table entries in [first, last]
+    void BuildLinear (int first = 0, int last = -1);
+    // Normalized density of a table entry
+    double GetNormalizedDensity (int entry);
+    // Replace the point i of cpts, returns the table entries it changed
+    void SetControlPoint (std::vector<TransferControlPoint>& cpts, int i, TransferControlPoint cp,
+                          int* first, int* last);
 
     std::vector<TransferControlPoint> m_cpt_rgb;
     std::vector<TransferControlPoint> m_cpt_alpha;
@@ -1,9 +1,16 @@
 #include "utils.h"
 
-#include <vis_utils/summedareatable.h>
+#include <vis_utils/compactsummedareatable.h>
+#include <volvis_utils/syntheticvolume.h>
+#include <volvis_utils/volumeview.h>
+#include <volvis_utils/voxellayout.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <random>
 #include <fstream>
+#include <vector>
 
 #define TEXTURE_FILTER GL_LINEAR        // GL_NEAREST         //
 #define TEXTURE_WRAP   GL_CLAMP_TO_EDGE // GL_CLAMP_TO_BORDER // 
@@ -22,23 +29,73 @@ namespace vis
   {
     if (!vol) return NULL;
 
+    if (init_x == 0 && init_y == 0 && init_z == 0
+      && last_x == 0 && last_y == 0 && last_z == 0)
+    {
+      last_x = vol->GetWidth();
+      last_y = vol->GetHeight();
+      last_z = vol->GetDepth();
+    }
+
+    GLfloat* scalar_values = GenerateRTextureData(vol, init_x, init_y, init_z, last_x, last_y, last_z);
+
+    gl::Texture3D* tex3d_r = GenerateRTextureFromData(scalar_values,
+      abs(last_x - init_x), abs(last_y - init_y), abs(last_z - init_z));
+
+    delete[] scalar_values;
+
+    return tex3d_r;
+  }
+
+  GLfloat* GenerateRTextureData (StructuredGridVolume* vol, int init_x, int init_y, int init_z,
+    int last_x, int last_y, int last_z)
+  {
+    if (!vol) return NULL;
+
+    if (init_x == 0 && init_y == 0 && init_z == 0
+      && last_x == 0 && last_y == 0 && last_z == 0)
+    {
+      last_x = vol->GetWidth();
+      last_y = vol->GetHeight();
+      last_z = vol->GetDepth();
+    }
+
     int size_x = abs(last_x - init_x);
     int size_y = abs(last_y - init_y);
     int size_z = abs(last_z - init_z);
 
     GLfloat* scalar_values = new GLfloat[size_x*size_y*size_z];
 
-    for (int k = 0; k < size_z; k++)
-    {
-      for (int j = 0; j < size_y; j++)
+    DispatchVolumeView(vol, [&] (const auto& view) {
+      // unchecked reads if the region is inside the volume
+      bool inside = view.IsInside(init_x, init_y, init_z)
+                 && view.IsInside(init_x + size_x - 1, init_y + size_y - 1, init_z + size_z - 1);
+
+#pragma omp parallel for
+      for (int k = 0; k < size_z; k++)
       {
-        for (int i = 0; i < size_x; i++)
+        for (int j = 0; j < size_y; j++)
         {
-          scalar_values[i + (j * size_x) + (k * size_x * size_y)] = (GLfloat)vol->GetNormalizedSample((i + init_x), (j + init_y), (k + init_z));
+          GLfloat* row = scalar_values + (j * size_x) + (k * size_x * size_y);
+          if (inside)
+          {
+            for (int i = 0; i < size_x; i++)
+              row[i] = (GLfloat)view.GetNormalized(i + init_x, j + init_y, k + init_z);
+          }
+          else
+          {
+            for (int i = 0; i < size_x; i++)
+              row[i] = (GLfloat)view.GetNormalizedOrZero(i + init_x, j + init_y, k + init_z);
+          }
         }
       }
-    }
+    });
 
+    return scalar_values;
+  }
+
+  gl::Texture3D* GenerateRTextureFromData (GLfloat* scalar_values, int size_x, int size_y, int size_z)
+  {
     gl::Texture3D* tex3d_r = new gl::Texture3D(size_x, size_y, size_z);
 
     tex3d_r->GenerateTexture(TEXTURE_FILTER, TEXTURE_FILTER, TEXTURE_WRAP, TEXTURE_WRAP, TEXTURE_WRAP);
@@ -50,11 +107,17 @@ namespace vis
 #endif
     gl::ExitOnGLError("ERROR: After SetData");
 
-    delete[] scalar_values;
-
     return tex3d_r;
   }
 
+  bool UpdateRTextureData (gl::Texture3D* tex3d_r, GLfloat* scalar_values)
+  {
+    if (!tex3d_r || !scalar_values) return false;
+    // the storage of the texture is kept, only its texels are replaced
+    return tex3d_r->SetSubData(scalar_values, 0, 0, 0, tex3d_r->GetWidth(), tex3d_r->GetHeight(), tex3d_r->GetDepth(),
+                               GL_RED, GL_FLOAT);
+  }
+
   gl::Texture3D* GenerateRTexture (StructuredGridVolume* vol, VIS_UTILS_DATA_TYPE vdatatype)
   {
     if (!vol) return NULL;
@@ -101,6 +164,13 @@ namespace vis
       tex3d_r->SetData(scalar_values, GL_R16UI, GL_RED_INTEGER, GL_UNSIGNED_SHORT);
       delete[] scalar_values;
     }
+    else if (vdatatype == VIS_UTILS_DATA_TYPE::HALF_FLOAT
+          && vol->GetDataStorageSize() == DataStorageSize::_HALF_F && !vol->GetVoxelLayoutTable())
+    {
+      // half float volumes are uploaded as they are stored
+      tex3d_r->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+      tex3d_r->SetData(vol->GetArrayData(), GL_R16F, GL_RED, GL_HALF_FLOAT);
+    }
     else if (vdatatype == VIS_UTILS_DATA_TYPE::HALF_FLOAT)
     {
       GLfloat* scalar_values = new GLfloat[size_x*size_y*size_z];
@@ -152,203 +222,754 @@ namespace vis
     int height = vol->GetHeight();
     int depth = vol->GetDepth();
 
-    //1
-    //Generation of gradients
-    int n = gradient_sample_size;
-    glm::dvec3* gradients = new glm::dvec3[width * height * depth];
-    glm::dvec3 s1, s2;
-    int index = 0;
-    for (int z = 0; z < depth; z++)
+    glm::vec3* gradients = GenerateGradientData(vol, gradient_sample_size, filter_nxnxn, normalized_gradient);
+
+    //3
+    //Set the content of the gradient texture
+    if (init_x == -1 && last_x == -1
+      && init_y == -1 && last_y == -1
+      && init_z == -1 && last_z == -1)
     {
-      for (int y = 0; y < height; y++)
+      gl::Texture3D* tex3d_gradient = GenerateGradientTextureFromData(gradients, width, height, depth);
+      delete[] gradients;
+      return tex3d_gradient;
+    }
+
+    int size_x = abs(last_x - init_x);
+    int size_y = abs(last_y - init_y);
+    int size_z = abs(last_z - init_z);
+    glm::vec3* gradients_values = new glm::vec3[size_x*size_y*size_z];
+
+    for (int k = 0; k < size_z; k++)
+    {
+      for (int j = 0; j < size_y; j++)
       {
-        for (int x = 0; x < width; x++)
+        for (int i = 0; i < size_x; i++)
         {
-          s1.x = vol->GetNormalizedSample(x - n, y, z);
-          s2.x = vol->GetNormalizedSample(x + n, y, z);
-          s1.y = vol->GetNormalizedSample(x, y - n, z);
-          s2.y = vol->GetNormalizedSample(x, y + n, z);
-          s1.z = vol->GetNormalizedSample(x, y, z - n);
-          s2.z = vol->GetNormalizedSample(x, y, z + n);
+          gradients_values[i + (j * size_x) + (k * size_x * size_y)] = gradients[(i + init_x) + ((j + init_y) * width) + ((k + init_z) * width * height)];
+        }
+      }
+    }
 
-          glm::dvec3 s2s1 = (s2 - s1);
+    //4
+    //Creating Texture
+    gl::Texture3D* tex3d_gradient = GenerateGradientTextureFromData(gradients_values, size_x, size_y, size_z);
 
-          if (normalized_gradient)
-          {
-            s2s1 = glm::normalize<double>(s2s1);
-          }
-          else
+    delete[] gradients_values;
+    delete[] gradients;
+
+    return tex3d_gradient;
+  }
+
+  // Central differences at distance n of voxel (x, y, z), 0 outside the volume
+  template<bool CHECKED, typename View>
+  static inline glm::dvec3 CentralDifference (const View& view, int x, int y, int z, int n,
+    bool normalized_gradient)
+  {
+    glm::dvec3 s1, s2;
+    s1.x = GetViewNormalizedSample<CHECKED>(view, x - n, y, z);
+    s2.x = GetViewNormalizedSample<CHECKED>(view, x + n, y, z);
+    s1.y = GetViewNormalizedSample<CHECKED>(view, x, y - n, z);
+    s2.y = GetViewNormalizedSample<CHECKED>(view, x, y + n, z);
+    s1.z = GetViewNormalizedSample<CHECKED>(view, x, y, z - n);
+    s2.z = GetViewNormalizedSample<CHECKED>(view, x, y, z + n);
+
+    glm::dvec3 s2s1 = (s2 - s1);
+
+    if (normalized_gradient)
+    {
+      s2s1 = glm::normalize<double>(s2s1);
+    }
+    else
+    {
+      s2s1.x = s2s1.x / 2.0f * (float)n;
+      s2s1.y = s2s1.y / 2.0f * (float)n;
+      s2s1.z = s2s1.z / 2.0f * (float)n;
+    }
+
+    if (s2s1.x != s2s1.x) //lm.IsNaN
+      s2s1 = glm::dvec3(0);
+
+    return s2s1;
+  }
+
+  // Slices of a block of work of the gradient engine: each thread decodes
+  //   the planes of its block, plus the n planes on each side
+  static const int GRADIENT_SLAB_DEPTH = 16;
+
+  // Absolute samples of slice z, as floats (exact for the integer types, so
+  //   the differences are too), with a border of n voxels around it (0
+  //   outside the volume, ghost voxels for padded views).
+  //   Plane of (w + 2n) x (h + 2n), voxel (x, y) at (x + n) + (y + n) * pitch.
+  template<typename View>
+  static void DecodeGradientPlane (const View& view, int z, int n, float* plane)
+  {
+    int w = view.GetWidth(), h = view.GetHeight();
+    int pitch = w + 2 * n;
+    bool z_inside = z >= 0 && z < view.GetDepth();
+    for (int y = -n; y < h + n; y++)
+    {
+      float* row = plane + size_t(y + n) * pitch + n;
+      if (z_inside && y >= 0 && y < h)
+      {
+        for (int x = -n; x < 0; x++)
+          row[x] = float(view.GetAbsoluteOrZero(x, y, z));
+        for (int x = 0; x < w; x++)
+          row[x] = float(view.GetAbsolute(x, y, z));
+        for (int x = w; x < w + n; x++)
+          row[x] = float(view.GetAbsoluteOrZero(x, y, z));
+      }
+      else
+      {
+        for (int x = -n; x < w + n; x++)
+          row[x] = float(view.GetAbsoluteOrZero(x, y, z));
+      }
+    }
+  }
+
+  // Central differences at distance n of every voxel, same values as
+  //   CentralDifference (in float). Blocks of GRADIENT_SLAB_DEPTH slices are
+  //   spread over the threads; each thread decodes a slice once into a ring of
+  //   2n + 1 planes and computes its rows with branch-free loops over x, that
+  //   the compiler vectorizes. store_row (first, count, gx, gy, gz) writes the
+  //   gradients of the count voxels of a row, from linear index first.
+  template<typename View, typename StoreRow>
+  static void CentralDifferenceGradients (const View& view, int n, bool normalized_gradient,
+    const StoreRow& store_row)
+  {
+    int width = view.GetWidth();
+    int height = view.GetHeight();
+    int depth = view.GetDepth();
+    int pitch = width + 2 * n;
+    size_t plane_size = size_t(pitch) * size_t(height + 2 * n);
+    int ring = 2 * n + 1;
+    int n_slabs = (depth + GRADIENT_SLAB_DEPTH - 1) / GRADIENT_SLAB_DEPTH;
+    const float scale = float(0.5 * n / view.GetMaxDensity());
+
+#pragma omp parallel
+    {
+      std::vector<float> planes(plane_size * ring);
+      std::vector<float> g(size_t(width) * 3);
+      float* gx = g.data();
+      float* gy = gx + width;
+      float* gz = gy + width;
+      auto plane = [&] (int z) { return planes.data() + plane_size * size_t(((z % ring) + ring) % ring); };
+
+#pragma omp for schedule(dynamic)
+      for (int s = 0; s < n_slabs; s++)
+      {
+        int z_first = s * GRADIENT_SLAB_DEPTH;
+        int z_last = std::min(z_first + GRADIENT_SLAB_DEPTH, depth);
+        for (int z = z_first - n; z < z_first + n; z++)
+          DecodeGradientPlane(view, z, n, plane(z));
+
+        for (int z = z_first; z < z_last; z++)
+        {
+          DecodeGradientPlane(view, z + n, n, plane(z + n));
+          const float* p_zm = plane(z - n);
+          const float* p_z = plane(z);
+          const float* p_zp = plane(z + n);
+
+          for (int y = 0; y < height; y++)
           {
-            s2s1.x = s2s1.x / 2.0f * (float)gradient_sample_size;
-            s2s1.y = s2s1.y / 2.0f * (float)gradient_sample_size;
-            s2s1.z = s2s1.z / 2.0f * (float)gradient_sample_size;
+            size_t row = size_t(y + n) * pitch + n;
+            const float* c = p_z + row;
+            const float* ym = p_z + row - size_t(n) * pitch;
+            const float* yp = p_z + row + size_t(n) * pitch;
+            const float* zm = p_zm + row;
+            const float* zp = p_zp + row;
+
+            for (int x = 0; x < width; x++)
+            {
+              gx[x] = c[x + n] - c[x - n];
+              gy[x] = yp[x] - ym[x];
+              gz[x] = zp[x] - zm[x];
+            }
+            if (normalized_gradient)
+            {
+              // the normalized zero gradient (NaN) is 0
+              for (int x = 0; x < width; x++)
+              {
+                float l2 = gx[x] * gx[x] + gy[x] * gy[x] + gz[x] * gz[x];
+                float inv = l2 > 0.0f ? 1.0f / std::sqrt(l2) : 0.0f;
+                gx[x] *= inv;
+                gy[x] *= inv;
+                gz[x] *= inv;
+              }
+            }
+            else
+            {
+              for (int x = 0; x < width; x++)
+              {
+                gx[x] *= scale;
+                gy[x] *= scale;
+                gz[x] *= scale;
+              }
+            }
+
+            store_row(size_t(y) * width + size_t(z) * width * height, width, gx, gy, gz);
           }
+        }
+      }
+    }
+  }
 
-          gradients[index] = s2s1;
+  // 3x3x3 Sobel-Feldman operator of voxel (x, y, z), 0 outside the volume
+  template<bool CHECKED, typename View>
+  static inline glm::dvec3 SobelFeldman (const View& view, int x, int y, int z, const double weights[3][3])
+  {
+    glm::dvec3 sg(0.0);
+    for (int v1 = -1; v1 <= 1; v1++)
+    {
+      for (int v2 = -1; v2 <= 1; v2++)
+      {
+        double w = weights[v1 + 1][v2 + 1];
+        sg.z += GetViewNormalizedSample<CHECKED>(view, x + v1, y + v2, z - 1) * w
+          + GetViewNormalizedSample<CHECKED>(view, x + v1, y + v2, z + 1) * -w;
 
-          if (gradients[index].x != gradients[index].x) //lm.IsNaN
-            gradients[index] = glm::dvec3(0);
+        sg.y += GetViewNormalizedSample<CHECKED>(view, x + v1, y - 1, z + v2) * w
+          + GetViewNormalizedSample<CHECKED>(view, x + v1, y + 1, z + v2) * -w;
 
-          index++;
-        }
+        sg.x += GetViewNormalizedSample<CHECKED>(view, x - 1, y + v2, z + v1) * w
+          + GetViewNormalizedSample<CHECKED>(view, x + 1, y + v2, z + v1) * -w;
       }
     }
+    return sg;
+  }
 
-    //2
-    //Filtering
-    n = filter_nxnxn;
-    index = 0;
-    if (n > 0)
+  template<typename View, typename Store>
+  static void SobelFeldmanGradients (const View& view, const Store& store)
+  {
+    int width = view.GetWidth();
+    int height = view.GetHeight();
+    int depth = view.GetDepth();
+
+    // 4 / 2^(|v1| + |v2|)
+    double weights[3][3];
+    for (int v1 = -1; v1 <= 1; v1++)
+      for (int v2 = -1; v2 <= 1; v2++)
+        weights[v1 + 1][v2 + 1] = 4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2));
+
+#pragma omp parallel for
+    for (int z = 0; z < depth; z++)
     {
-      for (int z = 0; z < depth; z++)
+      for (int y = 0; y < height; y++)
       {
+        size_t row = size_t(y) * width + size_t(z) * width * height;
+        int x_begin, x_end;
+        GetInteriorRowRange(view, y, z, 1, &x_begin, &x_end);
+
+        // not normalized (for tests...)
+        for (int x = 0; x < x_begin; x++)
+          store(row + x, SobelFeldman<true>(view, x, y, z, weights));
+        for (int x = x_begin; x < x_end; x++)
+          store(row + x, SobelFeldman<false>(view, x, y, z, weights));
+        for (int x = x_end; x < width; x++)
+          store(row + x, SobelFeldman<true>(view, x, y, z, weights));
+      }
+    }
+  }
+
+  // Same operator as SobelFeldmanGradients, by separable passes. The
+  //   weights 4 / 2^(|v1| + |v2|) are the products of the 1D smoothing
+  //   kernel [1 2 1] along the two axes orthogonal to the derivative
+  //   [1 0 -1], so each slice is reduced once to three planes:
+  //   A = Sy Sx f, B = Dy Sx f and C = Sy Dx f, and
+  //   gx = Sz C, gy = Sz B, gz = Dz A, with 2 + 2 + 2 additions per plane
+  //   voxel instead of 54 samples per voxel. Sums of absolute samples in float
+  //   are exact for the integer types. Threads and slabs as
+  //   CentralDifferenceGradients, store_row likewise.
+  template<typename View, typename StoreRow>
+  static void SeparableSobelFeldmanGradients (const View& view, const StoreRow& store_row)
+  {
+    int width = view.GetWidth();
+    int height = view.GetHeight();
+    int depth = view.GetDepth();
+    int pitch = width + 2;
+    size_t slice_size = size_t(width) * height;
+    int n_slabs = (depth + GRADIENT_SLAB_DEPTH - 1) / GRADIENT_SLAB_DEPTH;
+    const float inv_max_density = float(1.0 / view.GetMaxDensity());
+
+#pragma omp parallel
+    {
+      std::vector<float> decoded(size_t(pitch) * (height + 2));
+      // x passes of the rows -1 ... height of a slice
+      std::vector<float> sx(size_t(width) * (height + 2));
+      std::vector<float> dx(size_t(width) * (height + 2));
+      // A, B and C of the slices z - 1, z and z + 1
+      std::vector<float> planes(slice_size * 9);
+      std::vector<float> g(size_t(width) * 3);
+      float* gx = g.data();
+      float* gy = gx + width;
+      float* gz = gy + width;
+      auto plane = [&] (int z, int k) { return planes.data() + slice_size * size_t((((z % 3) + 3) % 3) * 3 + k); };
+
+      auto reduce_slice = [&] (int z) {
+        DecodeGradientPlane(view, z, 1, decoded.data());
+        for (int y = 0; y < height + 2; y++)
+        {
+          const float* in = decoded.data() + size_t(y) * pitch + 1;
+          float* s_row = sx.data() + size_t(y) * width;
+          float* d_row = dx.data() + size_t(y) * width;
+          for (int x = 0; x < width; x++)
+          {
+            s_row[x] = in[x - 1] + 2.0f * in[x] + in[x + 1];
+            d_row[x] = in[x - 1] - in[x + 1];
+          }
+        }
+        float* a = plane(z, 0);
+        float* b = plane(z, 1);
+        float* c = plane(z, 2);
         for (int y = 0; y < height; y++)
         {
+          // rows y - 1, y and y + 1 of the x passes
+          const float* s0 = sx.data() + size_t(y) * width;
+          const float* s1 = s0 + width;
+          const float* s2 = s1 + width;
+          const float* d0 = dx.data() + size_t(y) * width;
+          const float* d1 = d0 + width;
+          const float* d2 = d1 + width;
+          size_t row = size_t(y) * width;
           for (int x = 0; x < width; x++)
           {
-            int fn = (n - 1) / 2;
+            a[row + x] = s0[x] + 2.0f * s1[x] + s2[x];
+            b[row + x] = s0[x] - s2[x];
+            c[row + x] = d0[x] + 2.0f * d1[x] + d2[x];
+          }
+        }
+      };
+
+#pragma omp for schedule(dynamic)
+      for (int s = 0; s < n_slabs; s++)
+      {
+        int z_first = s * GRADIENT_SLAB_DEPTH;
+        int z_last = std::min(z_first + GRADIENT_SLAB_DEPTH, depth);
+        reduce_slice(z_first - 1);
+        reduce_slice(z_first);
 
-            glm::dvec3 average = glm::dvec3(0);
-            int num = 0;
-            for (int k = z - fn; k <= z + fn; k++)
+        for (int z = z_first; z < z_last; z++)
+        {
+          reduce_slice(z + 1);
+          const float* a0 = plane(z - 1, 0);
+          const float* a2 = plane(z + 1, 0);
+          const float* b0 = plane(z - 1, 1);
+          const float* b1 = plane(z, 1);
+          const float* b2 = plane(z + 1, 1);
+          const float* c0 = plane(z - 1, 2);
+          const float* c1 = plane(z, 2);
+          const float* c2 = plane(z + 1, 2);
+
+          for (int y = 0; y < height; y++)
+          {
+            size_t row = size_t(y) * width;
+            for (int x = 0; x < width; x++)
             {
-              for (int j = y - fn; j <= y + fn; j++)
-              {
-                for (int i = x - fn; i <= x + fn; i++)
-                {
-                  if (!vol->IsOutOfBoundary(i, j, k))
-                  {
-                    average += gradients[x + (y * width) + (z * width * height)];
-                    num++;
-                  }
-                }
-              }
+              size_t i = row + x;
+              gx[x] = (c0[i] + 2.0f * c1[i] + c2[i]) * inv_max_density;
+              gy[x] = (b0[i] + 2.0f * b1[i] + b2[i]) * inv_max_density;
+              gz[x] = (a0[i] - a2[i]) * inv_max_density;
             }
-
-            average = average / (double)num;
-            if (average.x != 0.0f && average.y != 0.0f && average.z != 0.0f)
-              average = glm::normalize<double>(average);
-
-            gradients[index++] = average;
+            store_row(row + size_t(z) * slice_size, width, gx, gy, gz);
           }
         }
       }
     }
+  }
 
-    //3
-    //Set the content of the gradient texture
-    if (init_x == -1 && last_x == -1
-      && init_y == -1 && last_y == -1
-      && init_z == -1 && last_z == -1)
+  // Running average over a window of 2r + 1 lines of the n lines of
+  //   line_size floats of src (line i at src + i * src_stride), clipped to
+  //   the n lines, written to the lines of dst. sum: line_size doubles.
+  static void BoxFilterLines (const float* src, size_t src_stride, float* dst, size_t dst_stride,
+                              int n, size_t line_size, int r, double* sum)
+  {
+    for (size_t k = 0; k < line_size; k++) sum[k] = 0.0;
+    for (int i = 0; i < std::min(r, n); i++)
+      for (size_t k = 0; k < line_size; k++) sum[k] += src[size_t(i) * src_stride + k];
+
+    for (int i = 0; i < n; i++)
     {
-      init_x = 0;
-      init_y = 0;
-      init_z = 0;
+      if (i + r < n)
+      {
+        const float* in = src + size_t(i + r) * src_stride;
+        for (size_t k = 0; k < line_size; k++) sum[k] += in[k];
+      }
+      if (i - r - 1 >= 0)
+      {
+        const float* in = src + size_t(i - r - 1) * src_stride;
+        for (size_t k = 0; k < line_size; k++) sum[k] -= in[k];
+      }
 
-      last_x = vol->GetWidth();
-      last_y = vol->GetHeight();
-      last_z = vol->GetDepth();
+      double inv = 1.0 / double(std::min(i + r, n - 1) - std::max(i - r, 0) + 1);
+      float* out = dst + size_t(i) * dst_stride;
+      for (size_t k = 0; k < line_size; k++) out[k] = float(sum[k] * inv);
     }
+  }
 
-    int size_x = abs(last_x - init_x);
-    int size_y = abs(last_y - init_y);
-    int size_z = abs(last_z - init_z);
-    glm::vec3* gradients_values = new glm::vec3[size_x*size_y*size_z];
+  // Average of each voxel over the voxels inside the volume in its n x n x n
+  //   neighbourhood (n odd, nothing to do for n < 3), in place. Each voxel
+  //   has components consecutive floats (3 for glm::vec3, 1 for a channel).
+  //   The box is separable: averages along x, then y, then z give the 3D
+  //   average with 3 n instead of n^3 additions per voxel.
+  static void BoxFilterVolume (float* data, int components, int width, int height, int depth, int n)
+  {
+    int r = (n - 1) / 2;
+    if (r <= 0) return;
+    size_t row_size = size_t(width) * components;
+    size_t slice_size = row_size * height;
 
-    for (int k = 0; k < size_z; k++)
+#pragma omp parallel
     {
-      for (int j = 0; j < size_y; j++)
+      std::vector<float> lines;
+      std::vector<double> sum(row_size);
+
+      // x: the lines are the voxels of a row
+#pragma omp for
+      for (int z = 0; z < depth; z++)
       {
-        for (int i = 0; i < size_x; i++)
+        lines.resize(row_size);
+        for (int y = 0; y < height; y++)
         {
-          gradients_values[i + (j * size_x) + (k * size_x * size_y)] = gradients[(i + init_x) + ((j + init_y) * width) + ((k + init_z) * width * height)];
+          float* row = data + size_t(z) * slice_size + size_t(y) * row_size;
+          std::copy(row, row + row_size, lines.begin());
+          BoxFilterLines(lines.data(), components, row, components, width, components, r, sum.data());
+        }
+      }
+
+      // y: the lines are the rows of a slice
+#pragma omp for
+      for (int z = 0; z < depth; z++)
+      {
+        float* slice = data + size_t(z) * slice_size;
+        lines.assign(slice, slice + slice_size);
+        BoxFilterLines(lines.data(), row_size, slice, row_size, height, row_size, r, sum.data());
+      }
+
+      // z: the lines are the rows y of the slices
+#pragma omp for
+      for (int y = 0; y < height; y++)
+      {
+        lines.resize(row_size * depth);
+        for (int z = 0; z < depth; z++)
+        {
+          const float* row = data + size_t(z) * slice_size + size_t(y) * row_size;
+          std::copy(row, row + row_size, lines.begin() + size_t(z) * row_size);
         }
+        BoxFilterLines(lines.data(), row_size, data + size_t(y) * row_size, slice_size, depth, row_size, r, sum.data());
+      }
+    }
+  }
+
+  // Normalize the n_voxels gradients (gx[i * stride], gy[i * stride],
+  //   gz[i * stride]) that are not zero
+  static void NormalizeGradients (float* gx, float* gy, float* gz, size_t stride, size_t n_voxels)
+  {
+    const int block = 4096;
+    int n_blocks = (int)((n_voxels + block - 1) / block);
+#pragma omp parallel for
+    for (int b = 0; b < n_blocks; b++)
+    {
+      size_t last = std::min(size_t(b + 1) * block, n_voxels);
+      for (size_t i = size_t(b) * block; i < last; i++)
+      {
+        size_t k = i * stride;
+        float l2 = gx[k] * gx[k] + gy[k] * gy[k] + gz[k] * gz[k];
+        if (l2 <= 0.0f) continue;
+        float inv = 1.0f / std::sqrt(l2);
+        gx[k] *= inv;
+        gy[k] *= inv;
+        gz[k] *= inv;
       }
     }
+  }
+
+  // Smoothing of the gradients of GenerateGradientData: average over the
+  //   n x n x n neighbourhood, normalized
+  static void FilterGradients (glm::vec3* gradients, int width, int height, int depth, int n)
+  {
+    BoxFilterVolume(&gradients[0].x, 3, width, height, depth, n);
+    NormalizeGradients(&gradients[0].x, &gradients[0].y, &gradients[0].z, 3, size_t(width) * height * depth);
+  }
+
+  static void FilterGradients (float* g[3], int width, int height, int depth, int n)
+  {
+    for (int a = 0; a < 3; a++)
+      BoxFilterVolume(g[a], 1, width, height, depth, n);
+    NormalizeGradients(g[0], g[1], g[2], 1, size_t(width) * height * depth);
+  }
+
+  // store_row of CentralDifferenceGradients, to a glm::vec3 array
+  struct GradientRowStore
+  {
+    glm::vec3* gradients;
+    void operator() (size_t first, int count, const float* gx, const float* gy, const float* gz) const
+    {
+      glm::vec3* out = gradients + first;
+      for (int x = 0; x < count; x++)
+        out[x] = glm::vec3(gx[x], gy[x], gz[x]);
+    }
+  };
+
+  // store_row of CentralDifferenceGradients, to three float channels
+  struct GradientChannelsRowStore
+  {
+    float* g[3];
+    void operator() (size_t first, int count, const float* gx, const float* gy, const float* gz) const
+    {
+      std::copy(gx, gx + count, g[0] + first);
+      std::copy(gy, gy + count, g[1] + first);
+      std::copy(gz, gz + count, g[2] + first);
+    }
+  };
+
+  glm::vec3* GenerateGradientData (StructuredGridVolume* vol, int gradient_sample_size,
+    int filter_nxnxn, bool normalized_gradient)
+  {
+    size_t n_voxels = size_t(vol->GetWidth()) * size_t(vol->GetHeight()) * size_t(vol->GetDepth());
+
+    glm::vec3* gradients = new glm::vec3[n_voxels];
+    GradientRowStore store = { gradients };
+
+    //1
+    //Generation of gradients
+    DispatchVolumeView(vol, [&] (const auto& view) {
+      CentralDifferenceGradients(view, gradient_sample_size, normalized_gradient, store);
+    });
+
+    //2
+    //Filtering
+    if (filter_nxnxn > 0)
+      FilterGradients(gradients, vol->GetWidth(), vol->GetHeight(), vol->GetDepth(), filter_nxnxn);
+
+    return gradients;
+  }
+
+  // https://en.wikipedia.org/wiki/Sobel_operator  
+  gl::Texture3D* GenerateSobelFeldmanGradientTexture(StructuredGridVolume* vol)
+  {
+    glm::vec3* gradients_values = GenerateSobelFeldmanGradientData(vol);
 
     //4
     //Creating Texture
-    gl::Texture3D* tex3d_gradient = new gl::Texture3D(size_x, size_y, size_z);
-    tex3d_gradient->GenerateTexture(TEXTURE_FILTER, TEXTURE_FILTER, TEXTURE_WRAP, TEXTURE_WRAP, TEXTURE_WRAP);
-
-#ifdef USE_16F_INTERNAL_FORMAT
-    tex3d_gradient->SetData((GLvoid*)gradients_values, GL_RGB16F, GL_RGB, GL_FLOAT);
-#else
-    tex3d_gradient->SetData((GLvoid*)gradients_values, GL_RGB32F, GL_RGB, GL_FLOAT);
-#endif
+    gl::Texture3D* tex3d_gradient = GenerateGradientTextureFromData(gradients_values,
+      vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
 
     delete[] gradients_values;
-    delete[] gradients;
 
     return tex3d_gradient;
   }
 
-  // https://en.wikipedia.org/wiki/Sobel_operator  
-  gl::Texture3D* GenerateSobelFeldmanGradientTexture(StructuredGridVolume* vol)
+  glm::vec3* GenerateSobelFeldmanGradientData (StructuredGridVolume* vol)
   {
-    int width = vol->GetWidth();
-    int height = vol->GetHeight();
-    int depth = vol->GetDepth();
+    size_t n_voxels = size_t(vol->GetWidth()) * size_t(vol->GetHeight()) * size_t(vol->GetDepth());
 
-    int n = 1;
-    glm::dvec3* gradients = new glm::dvec3[width * height * depth];
-    for (int z = 0; z < depth; z++)
+    glm::vec3* gradients = new glm::vec3[n_voxels];
+    DispatchVolumeView(vol, [&] (const auto& view) {
+      SobelFeldmanGradients(view, [gradients] (size_t i, const glm::dvec3& g) { gradients[i] = glm::vec3(g); });
+    });
+
+    return gradients;
+  }
+
+  glm::vec3* GenerateSeparableSobelFeldmanGradientData (StructuredGridVolume* vol)
+  {
+    glm::vec3* gradients = new glm::vec3[size_t(vol->GetWidth()) * size_t(vol->GetHeight()) * size_t(vol->GetDepth())];
+    GradientRowStore store = { gradients };
+    if (!DispatchVolumeView(vol, [&] (const auto& view) { SeparableSobelFeldmanGradients(view, store); }))
     {
-      for (int y = 0; y < height; y++)
-      {
-        for (int x = 0; x < width; x++)
-        {
-          glm::dvec3 sg(0.0);
-          for (int v1 = -1; v1 <= 1; v1++)
-          {
-            for (int v2 = -1; v2 <= 1; v2++)
-            {
-              sg.z += ((double)vol->GetNormalizedSample(x + v1, y + v2, z - 1)) * (4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2)))
-                + ((double)vol->GetNormalizedSample(x + v1, y + v2, z + 1)) * (-4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2)));
+      delete[] gradients;
+      return nullptr;
+    }
 
-              sg.y += ((double)vol->GetNormalizedSample(x + v1, y - 1, z + v2)) * (4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2)))
-                + ((double)vol->GetNormalizedSample(x + v1, y + 1, z + v2)) * (-4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2)));
+    return gradients;
+  }
 
-              sg.x += ((double)vol->GetNormalizedSample(x - 1, y + v2, z + v1)) * (4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2)))
-                + ((double)vol->GetNormalizedSample(x + 1, y + v2, z + v1)) * (-4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2)));
-            }
-          }
+  glm::vec3* GenerateGradientData (const GhostPaddedVolume& padded, int gradient_sample_size, bool normalized_gradient)
+  {
+    glm::ivec3 size = padded.GetSize();
+    size_t n_voxels = size_t(size.x) * size_t(size.y) * size_t(size.z);
+
+    glm::vec3* gradients = new glm::vec3[n_voxels];
+    if (!DispatchGhostPaddedView(padded, [&] (const auto& view) {
+          GradientRowStore store = { gradients };
+          CentralDifferenceGradients(view, gradient_sample_size, normalized_gradient, store);
+        }))
+    {
+      delete[] gradients;
+      return nullptr;
+    }
 
-          // not normalized (for tests...)
-          gradients[x + (y * width) + (z * width * height)] = sg;
-        }
-      }
+    return gradients;
+  }
+
+  glm::vec3* GenerateSobelFeldmanGradientData (const GhostPaddedVolume& padded)
+  {
+    glm::ivec3 size = padded.GetSize();
+    size_t n_voxels = size_t(size.x) * size_t(size.y) * size_t(size.z);
+
+    glm::vec3* gradients = new glm::vec3[n_voxels];
+    if (!DispatchGhostPaddedView(padded, [&] (const auto& view) {
+          SobelFeldmanGradients(view, [gradients] (size_t i, const glm::dvec3& g) { gradients[i] = glm::vec3(g); });
+        }))
+    {
+      delete[] gradients;
+      return nullptr;
+    }
+
+    return gradients;
+  }
+
+  glm::vec3* GenerateSeparableSobelFeldmanGradientData (const GhostPaddedVolume& padded)
+  {
+    glm::ivec3 size = padded.GetSize();
+    size_t n_voxels = size_t(size.x) * size_t(size.y) * size_t(size.z);
+
+    glm::vec3* gradients = new glm::vec3[n_voxels];
+    if (!DispatchGhostPaddedView(padded, [&] (const auto& view) {
+          GradientRowStore store = { gradients };
+          SeparableSobelFeldmanGradients(view, store);
+        }))
+    {
+      delete[] gradients;
+      return nullptr;
+    }
+
+    return gradients;
+  }
+
+  // Float channels "gx", "gy" and "gz" with the grid of vol, g receives
+  //   their arrays
+  static MultiComponentGridVolume* CreateGradientVolume (StructuredGridVolume* vol, float* g[3])
+  {
+    MultiComponentGridVolume* gradients = new MultiComponentGridVolume(vol->GetName() + "_gradient",
+      vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
+    gradients->SetScale(vol->GetScaleX(), vol->GetScaleY(), vol->GetScaleZ());
+
+    const char* names[3] = { "gx", "gy", "gz" };
+    for (int a = 0; a < 3; a++)
+      g[a] = static_cast<float*>(gradients->GetChannelData(gradients->AddChannel(names[a], DataStorageSize::_NORMALIZED_F)));
+    return gradients;
+  }
+
+  MultiComponentGridVolume* GenerateGradientVolume (StructuredGridVolume* vol, int gradient_sample_size,
+    int filter_nxnxn, bool normalized_gradient)
+  {
+    float* g[3];
+    MultiComponentGridVolume* gradients = CreateGradientVolume(vol, g);
+    GradientChannelsRowStore store = { { g[0], g[1], g[2] } };
+
+    if (!DispatchVolumeView(vol, [&] (const auto& view) {
+          CentralDifferenceGradients(view, gradient_sample_size, normalized_gradient, store);
+        }))
+    {
+      delete gradients;
+      return nullptr;
+    }
+
+    if (filter_nxnxn > 0)
+      FilterGradients(g, vol->GetWidth(), vol->GetHeight(), vol->GetDepth(), filter_nxnxn);
+
+    return gradients;
+  }
+
+  MultiComponentGridVolume* GenerateSobelFeldmanGradientVolume (StructuredGridVolume* vol)
+  {
+    float* g[3];
+    MultiComponentGridVolume* gradients = CreateGradientVolume(vol, g);
+    float* gx = g[0];
+    float* gy = g[1];
+    float* gz = g[2];
+
+    if (!DispatchVolumeView(vol, [&] (const auto& view) {
+          SobelFeldmanGradients(view, [gx, gy, gz] (size_t i, const glm::dvec3& v) {
+            gx[i] = float(v.x);
+            gy[i] = float(v.y);
+            gz[i] = float(v.z);
+          });
+        }))
+    {
+      delete gradients;
+      return nullptr;
     }
 
-    glm::vec3* gradients_values = new glm::vec3[width * height * depth];
-    for (int k = 0; k < depth; k++)
+    return gradients;
+  }
+
+  SparseGridVolume* GenerateGradientVolume (SparseGridVolume* vol, int gradient_sample_size, bool normalized_gradient)
+  {
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN) return nullptr;
+
+    SparseGridVolume* gradients = vol->CreateWithSameTopology(vol->GetName() + "_gradient",
+      DataStorageSize::_NORMALIZED_F, 3);
+
+    int n_leaves = vol->GetNumberOfLeaves();
+#pragma omp parallel
     {
-      for (int j = 0; j < height; j++)
+      SparseGridVolume::Accessor accessor(vol);
+
+#pragma omp for schedule(dynamic, 16)
+      for (int l = 0; l < n_leaves; l++)
       {
-        for (int i = 0; i < width; i++)
+        SparseGridVolume::Leaf* leaf = vol->GetLeaf(l);
+        float* out = static_cast<float*>(gradients->GetLeaf(l)->values);
+        for (int i = 0; i < SparseGridVolume::LEAF_VOXELS; i++)
         {
-          gradients_values[i + (j * width) + (k * width * height)] = gradients[i + (j * width) + (k * width * height)];
+          if (!leaf->IsActive(i)) continue;
+          int x = leaf->origin.x + (i & (SparseGridVolume::LEAF_DIM - 1));
+          int y = leaf->origin.y + ((i >> SparseGridVolume::LEAF_LOG2) & (SparseGridVolume::LEAF_DIM - 1));
+          int z = leaf->origin.z + (i >> (2 * SparseGridVolume::LEAF_LOG2));
+          glm::dvec3 v = CentralDifference<true>(accessor, x, y, z, gradient_sample_size, normalized_gradient);
+          out[i * 3 + 0] = float(v.x);
+          out[i * 3 + 1] = float(v.y);
+          out[i * 3 + 2] = float(v.z);
         }
       }
     }
 
-    //4
-    //Creating Texture
-    gl::Texture3D* tex3d_gradient = new gl::Texture3D(width, height, depth);
+    // a tile has a zero gradient inside, its faces split it into a leaf
+    //   when they see a different neighbour
+    SparseGridVolume::Accessor accessor(vol);
+    std::vector<glm::ivec3> tiles;
+    vol->ForEachActiveTile([&] (glm::ivec3 origin, const double*) { tiles.push_back(origin); });
+    for (size_t t = 0; t < tiles.size(); t++)
+    {
+      glm::ivec3 o = tiles[t];
+      for (int z = o.z; z < o.z + SparseGridVolume::LEAF_DIM; z++)
+        for (int y = o.y; y < o.y + SparseGridVolume::LEAF_DIM; y++)
+          for (int x = o.x; x < o.x + SparseGridVolume::LEAF_DIM; x++)
+          {
+            glm::dvec3 v = CentralDifference<true>(accessor, x, y, z, gradient_sample_size, normalized_gradient);
+            if (v == glm::dvec3(0.0)) continue;
+            gradients->SetValue(x, y, z, v.x, 0);
+            gradients->SetValue(x, y, z, v.y, 1);
+            gradients->SetValue(x, y, z, v.z, 2);
+          }
+    }
+
+    gradients->UpdateRanges();
+    return gradients;
+  }
+
+  gl::Texture3D* GenerateGradientTextureFromData (glm::vec3* gradient_values, int size_x, int size_y, int size_z)
+  {
+    gl::Texture3D* tex3d_gradient = new gl::Texture3D(size_x, size_y, size_z);
     tex3d_gradient->GenerateTexture(TEXTURE_FILTER, TEXTURE_FILTER, TEXTURE_WRAP, TEXTURE_WRAP, TEXTURE_WRAP);
 
 #ifdef USE_16F_INTERNAL_FORMAT
-    tex3d_gradient->SetData((GLvoid*)gradients_values, GL_RGB16F, GL_RGB, GL_FLOAT);
+    tex3d_gradient->SetData((GLvoid*)gradient_values, GL_RGB16F, GL_RGB, GL_FLOAT);
 #else
-    tex3d_gradient->SetData((GLvoid*)gradients_values, GL_RGB32F, GL_RGB, GL_FLOAT);
+    tex3d_gradient->SetData((GLvoid*)gradient_values, GL_RGB32F, GL_RGB, GL_FLOAT);
 #endif
 
-    delete[] gradients_values;
-    delete[] gradients;
-
     return tex3d_gradient;
   }
 
+  bool UpdateGradientTextureData (gl::Texture3D* tex3d_gradient, glm::vec3* gradient_values)
+  {
+    if (!tex3d_gradient || !gradient_values) return false;
+    return tex3d_gradient->SetSubData((GLvoid*)gradient_values, 0, 0, 0, tex3d_gradient->GetWidth(),
+                                      tex3d_gradient->GetHeight(), tex3d_gradient->GetDepth(), GL_RGB, GL_FLOAT);
+  }
+
   gl::Texture2D* GenerateNoiseTexture(float maxvalue, int w, int h)
   {
     std::default_random_engine generator;
@@ -372,56 +993,143 @@ namespace vis
 
   void GenerateSyntheticVolumetricModels(int d, float s)
   {
-    std::ofstream gaussianvol_file;
-    gaussianvol_file.open("synthetic_gaussianvol_file.syn");
-    if (gaussianvol_file.is_open())
+    // only the description is written, the voxels are generated when read
+    SyntheticVolumeGenerator generator(d, d, d, DataStorageSize::_8_BITS);
+    generator.AddShape(SyntheticVolumeGenerator::GaussianBlob(glm::dvec3(0.5), glm::dvec3(double(s) / double(d))));
+    generator.Write("synthetic_gaussianvol_file.synb");
+  }
+
+  // Sum of the Sobel-Feldman gradient lengths, same traversal as SobelFeldmanGradients
+  template<typename View>
+  static double SobelFeldmanStencilBenchmark (const View& view)
+  {
+    double weights[3][3];
+    for (int v1 = -1; v1 <= 1; v1++)
+      for (int v2 = -1; v2 <= 1; v2++)
+        weights[v1 + 1][v2 + 1] = 4.0 / pow(2.0, glm::abs(v1) + glm::abs(v2));
+
+    double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+    for (int z = 0; z < view.GetDepth(); z++)
     {
-      gaussianvol_file << d << " " << d << " " << d << "\n";
-      for (int x = 0; x < d; x++)
+      for (int y = 0; y < view.GetHeight(); y++)
       {
-        for (int y = 0; y < d; y++)
-        {
-          for (int z = 0; z < d; z++)
-          {
-            float dx = x - (d / 2);
-            float dy = y - (d / 2);
-            float dz = z - (d / 2);
-            float val = glm::exp(-(dx*dx + dy * dy + dz * dz) / (2.0f * s * s));
-            gaussianvol_file << "0 " << x << " " << y << " " << z << " " << int(val * 255.0f) << "\n";
-          }
-        }
+        int x_begin, x_end;
+        GetInteriorRowRange(view, y, z, 1, &x_begin, &x_end);
+        for (int x = 0; x < x_begin; x++)
+          sum += glm::length(SobelFeldman<true>(view, x, y, z, weights));
+        for (int x = x_begin; x < x_end; x++)
+          sum += glm::length(SobelFeldman<false>(view, x, y, z, weights));
+        for (int x = x_end; x < view.GetWidth(); x++)
+          sum += glm::length(SobelFeldman<true>(view, x, y, z, weights));
       }
-      gaussianvol_file.close();
     }
+    return sum;
   }
 
-  gl::Texture3D* GenerateExtinctionSAT3DTex(StructuredGridVolume* vol, TransferFunction* tf)
+  // Sum of the central difference gradient lengths, one stencil per voxel
+  template<typename View>
+  static double CentralDifferenceStencilBenchmark (const View& view)
   {
-    // 1
-    // First, sample the initial "grid" and build SAT
-    vis::SummedAreaTable3D<double> sat3d(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
-    for (int x = 0; x < vol->GetWidth(); x++)
+    double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+    for (int z = 0; z < view.GetDepth(); z++)
     {
-      for (int y = 0; y < vol->GetHeight(); y++)
+      for (int y = 0; y < view.GetHeight(); y++)
       {
-        for (int z = 0; z < vol->GetDepth(); z++)
-        {
-          double val = tf->GetExt(vol->GetNormalizedSample(x, y, z), true);
-          sat3d.SetValue(val, x, y, z);
-        }
+        int x_begin, x_end;
+        GetInteriorRowRange(view, y, z, 1, &x_begin, &x_end);
+        for (int x = 0; x < x_begin; x++)
+          sum += glm::length(CentralDifference<true>(view, x, y, z, 1, false));
+        for (int x = x_begin; x < x_end; x++)
+          sum += glm::length(CentralDifference<false>(view, x, y, z, 1, false));
+        for (int x = x_end; x < view.GetWidth(); x++)
+          sum += glm::length(CentralDifference<true>(view, x, y, z, 1, false));
       }
     }
-    sat3d.BuildSAT();
+    return sum;
+  }
+
+  void BenchmarkVoxelLayouts (unsigned int size, DataStorageSize dss)
+  {
+    SyntheticVolumeGenerator generator(size, size, size, dss);
+    generator.AddShape(SyntheticVolumeGenerator::Noise(16));
+    StructuredGridVolume* vol = generator.Generate("LayoutBenchmark");
+    if (!vol) return;
+
+    printf("Voxel layout benchmark: %u^3, %.1f bytes per voxel\n", size, double(GetStorageArrayBytes(dss, 2)) / 2.0);
+    double reference[2] = { 0.0, 0.0 };
+    for (int l = 0; l < NUMBER_OF_VOXEL_LAYOUTS; l++)
+    {
+      VoxelLayout layout = (VoxelLayout)l;
+      if (!vol->SetVoxelLayout(layout)) continue;
+
+      double ms[2];
+      double sums[2];
+      for (int k = 0; k < 2; k++)
+      {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DispatchVolumeView(vol, [&] (const auto& view) {
+          sums[k] = (k == 0) ? SobelFeldmanStencilBenchmark(view) : CentralDifferenceStencilBenchmark(view);
+        });
+        ms[k] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      }
+      if (layout == VoxelLayout::LINEAR)
+      {
+        reference[0] = ms[0];
+        reference[1] = ms[1];
+      }
+
+      printf("  %-16s %7.1f MB | Sobel-Feldman %8.1f ms (x%.2f) | central differences %8.1f ms (x%.2f) | checksum %.6g %.6g\n",
+        GetVoxelLayoutName(layout), double(GetStorageArrayBytes(dss, vol->GetVoxelArraySize())) / (1024.0 * 1024.0),
+        ms[0], reference[0] / ms[0], ms[1], reference[1] / ms[1], sums[0], sums[1]);
+    }
+
+    delete vol;
+  }
+
+  // Float SAT (new[]) of value (x, y, z) >= 0 over a w * h * d grid, for
+  //   the GL textures. Built as a compact fixed point SAT, from a first pass
+  //   for the maximum value, instead of a dense double table.
+  template<typename ValueFunction>
+  static GLfloat* GenerateSAT3DFloatData (int w, int h, int d, ValueFunction&& value)
+  {
+    double max_value = 0.0;
+#pragma omp parallel
+    {
+      double l_max_value = 0.0;
+#pragma omp for
+      for (int z = 0; z < d; z++)
+        for (int y = 0; y < h; y++)
+          for (int x = 0; x < w; x++)
+            l_max_value = std::max(l_max_value, double(value(x, y, z)));
+#pragma omp critical
+      max_value = std::max(max_value, l_max_value);
+    }
+
+    CompactSummedAreaTable3D sat3d;
+    sat3d.Build(w, h, d, value, max_value);
+
+    GLfloat* values = new GLfloat[size_t(w) * size_t(h) * size_t(d)];
+    sat3d.GetFloatValues(values);
+    return values;
+  }
+
+  gl::Texture3D* GenerateExtinctionSAT3DTex(StructuredGridVolume* vol, TransferFunction* tf)
+  {
+    // 1
+    // First, sample the initial "grid" and build SAT
+    // builds the transfer function table before the threads read it
+    tf->GetExt(0.0, true);
+    GLfloat* diff_mat = nullptr;
+    DispatchVolumeView(vol, [&] (const auto& view) {
+      diff_mat = GenerateSAT3DFloatData(view.GetWidth(), view.GetHeight(), view.GetDepth(), [&] (int x, int y, int z) {
+        return tf->GetExt(view.GetNormalized(x, y, z), true);
+      });
+    });
 
     // 2
     // Then, we must create and generate the 3D texture
-    GLfloat* diff_mat = new GLfloat[vol->GetWidth() * vol->GetHeight() * vol->GetDepth()];
-    double* sat_data = sat3d.GetData();
-
-    //*
-    for (int i = 0; i < vol->GetWidth() * vol->GetHeight() * vol->GetDepth(); i++)
-      diff_mat[i] = (GLfloat)sat_data[i];
-    // */
 
     /*
     for (int x = 0; x < vol->GetWidth(); x++)
@@ -457,27 +1165,15 @@ namespace vis
   {
     // 1
     // First, sample the initial "grid" and build SAT
-    vis::SummedAreaTable3D<double> sat3d(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
-    for (int x = 0; x < vol->GetWidth(); x++)
-    {
-      for (int y = 0; y < vol->GetHeight(); y++)
-      {
-        for (int z = 0; z < vol->GetDepth(); z++)
-        {
-          double val = (double)vol->GetNormalizedSample(x, y, z);
-          sat3d.SetValue(val, x, y, z);
-        }
-      }
-    }
-    sat3d.BuildSAT();
+    GLfloat* diff_mat = nullptr;
+    DispatchVolumeView(vol, [&] (const auto& view) {
+      diff_mat = GenerateSAT3DFloatData(view.GetWidth(), view.GetHeight(), view.GetDepth(), [&] (int x, int y, int z) {
+        return view.GetNormalized(x, y, z);
+      });
+    });
 
     // 2
     // Then, we must create and generate the 3D texture
-    GLfloat* diff_mat = new GLfloat[vol->GetWidth() * vol->GetHeight() * vol->GetDepth()];
-    double* sat_data = sat3d.GetData();
-    for (int i = 0; i < vol->GetWidth() * vol->GetHeight() * vol->GetDepth(); i++)
-      diff_mat[i] = (GLfloat)sat_data[i];
-
     gl::Texture3D* tex3d_sat = new gl::Texture3D(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
     tex3d_sat->GenerateTexture(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
 
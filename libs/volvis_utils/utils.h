@@ -8,6 +8,9 @@
 #include <gl_utils/texture2d.h>
 #include <volvis_utils/transferfunction.h>
 #include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/ghostpaddedvolume.h>
+#include <volvis_utils/multicomponentgridvolume.h>
+#include <volvis_utils/sparsegridvolume.h>
 #include <vis_utils/summedareatable.h>
 
 #include <glm/glm.hpp>
@@ -38,6 +41,21 @@ namespace vis
     int last_y = 0,
     int last_z = 0);
 
+  // CPU side of GenerateRTexture: normalized samples of the region, it does
+  //   not need a GL context. Default region is the whole volume.
+  GLfloat* GenerateRTextureData (StructuredGridVolume* vol,
+    int init_x = 0,
+    int init_y = 0,
+    int init_z = 0,
+    int last_x = 0,
+    int last_y = 0,
+    int last_z = 0);
+  // GL side of GenerateRTexture: upload the samples (GL thread only)
+  gl::Texture3D* GenerateRTextureFromData (GLfloat* scalar_values, int size_x, int size_y, int size_z);
+  // Replace the samples of a texture created by GenerateRTextureFromData,
+  //   keeping its id (same size only)
+  bool UpdateRTextureData (gl::Texture3D* tex3d_r, GLfloat* scalar_values);
+
   enum VIS_UTILS_DATA_TYPE : unsigned int {
     UNSIGNED_BYTE  = 0,
     UNSIGNED_SHORT = 1,
@@ -61,6 +79,43 @@ namespace vis
   // https://en.wikipedia.org/wiki/Sobel_operator  
   gl::Texture3D* GenerateSobelFeldmanGradientTexture (StructuredGridVolume* vol);
 
+  // CPU side of the gradient textures, one glm::vec3 per voxel of the whole
+  //   volume (no GL context needed). filter_nxnxn > 1 (odd) smooths them with
+  //   the normalized average of the n x n x n neighbourhood.
+  glm::vec3* GenerateGradientData (StructuredGridVolume* vol,
+    int gradient_sample_size = 1,
+    int filter_nxnxn = 0,
+    bool normalized_gradient = true);
+  glm::vec3* GenerateSobelFeldmanGradientData (StructuredGridVolume* vol);
+  // Same gradients as GenerateSobelFeldmanGradientData (up to float
+  //   rounding), computed with separable 1D passes
+  glm::vec3* GenerateSeparableSobelFeldmanGradientData (StructuredGridVolume* vol);
+  // Same stencils over the region of a ghost padded volume, one gradient per
+  //   voxel of the region. With a ghost width >= the stencil radius (1 for
+  //   Sobel-Feldman) no sample is bounds checked, and GHOST_ZERO gives the
+  //   same gradients as the volume versions.
+  glm::vec3* GenerateGradientData (const GhostPaddedVolume& padded,
+    int gradient_sample_size = 1,
+    bool normalized_gradient = true);
+  glm::vec3* GenerateSobelFeldmanGradientData (const GhostPaddedVolume& padded);
+  glm::vec3* GenerateSeparableSobelFeldmanGradientData (const GhostPaddedVolume& padded);
+  // Same gradients as float structure of arrays: channels "gx", "gy" and
+  //   "gz" of a MultiComponentGridVolume, 12 bytes per voxel
+  MultiComponentGridVolume* GenerateGradientVolume (StructuredGridVolume* vol,
+    int gradient_sample_size = 1,
+    int filter_nxnxn = 0,
+    bool normalized_gradient = true);
+  MultiComponentGridVolume* GenerateSobelFeldmanGradientVolume (StructuredGridVolume* vol);
+  // Central differences of the active voxels only, as components x, y, z of
+  //   a float grid with the topology of vol (same values as the dense
+  //   version at these voxels)
+  SparseGridVolume* GenerateGradientVolume (SparseGridVolume* vol,
+    int gradient_sample_size = 1,
+    bool normalized_gradient = true);
+  // GL side of the gradient textures (GL thread only)
+  gl::Texture3D* GenerateGradientTextureFromData (glm::vec3* gradient_values, int size_x, int size_y, int size_z);
+  bool UpdateGradientTextureData (gl::Texture3D* tex3d_gradient, glm::vec3* gradient_values);
+
   //https://stackoverflow.com/questions/1972172/interpolating-a-scalar-field-in-a-3d-space
   //https://www.ncbi.nlm.nih.gov/pmc/articles/PMC3719212/
 
@@ -68,6 +123,10 @@ namespace vis
 
   void GenerateSyntheticVolumetricModels (int d = 120, float s = 30.0f);
 
+  // Print the time of the CPU stencils (Sobel-Feldman, central differences)
+  //   over a size^3 noise volume stored in each voxel layout (voxellayout.h)
+  void BenchmarkVoxelLayouts (unsigned int size = 512, DataStorageSize dss = DataStorageSize::_8_BITS);
+
   gl::Texture3D* GenerateExtinctionSAT3DTex (StructuredGridVolume* vol, TransferFunction* tf);
 
   gl::Texture3D* GenerateScalarFieldSAT3DTex (StructuredGridVolume* vol);
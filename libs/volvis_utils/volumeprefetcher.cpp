@@ -0,0 +1,184 @@
+/**
+ * volumeprefetcher.cpp
+**/
+#include "volumeprefetcher.h"
+
+#include <algorithm>
+
+namespace vis
+{
+  PreparedVolume::PreparedVolume ()
+    : index(-1)
+    , gradient_type(0)
+    , volume(nullptr)
+    , scalar_values(nullptr)
+    , gradient_values(nullptr)
+  {
+  }
+
+  PreparedVolume::~PreparedVolume ()
+  {
+    if (volume) delete volume;
+    volume = nullptr;
+
+    if (scalar_values) delete[] scalar_values;
+    scalar_values = nullptr;
+
+    if (gradient_values) delete[] gradient_values;
+    gradient_values = nullptr;
+  }
+
+  VolumePrefetcher::VolumePrefetcher (unsigned int n_workers)
+    : m_stop(false)
+  {
+    for (unsigned int i = 0; i < n_workers; i++)
+      m_workers.push_back(std::thread(&VolumePrefetcher::WorkerLoop, this));
+  }
+
+  VolumePrefetcher::~VolumePrefetcher ()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+      m_jobs.clear();
+    }
+    m_cond_jobs.notify_all();
+
+    // workers finish their current job before leaving
+    for (int i = 0; i < m_workers.size(); i++)
+      if (m_workers[i].joinable()) m_workers[i].join();
+
+    for (std::map<int, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+      if (it->second.data) delete it->second.data;
+    m_entries.clear();
+  }
+
+  void VolumePrefetcher::Request (int index, LoadJob job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!job || m_workers.empty()) return;
+
+      std::map<int, Entry>::iterator it = m_entries.find(index);
+      if (it != m_entries.end())
+      {
+        it->second.discard = false;
+        return;
+      }
+
+      m_entries[index].job = job;
+      m_jobs.push_back(index);
+    }
+    m_cond_jobs.notify_one();
+  }
+
+  PreparedVolume* VolumePrefetcher::Take (int index)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::map<int, Entry>::iterator it = m_entries.find(index);
+    if (it == m_entries.end()) return nullptr;
+
+    // Not started yet: avoid waiting for a free worker
+    std::deque<int>::iterator job = std::find(m_jobs.begin(), m_jobs.end(), index);
+    if (job != m_jobs.end())
+    {
+      LoadJob load_job = it->second.job;
+      m_jobs.erase(job);
+      m_entries.erase(it);
+
+      lock.unlock();
+      return load_job();
+    }
+
+    it->second.discard = false;
+    m_cond_ready.wait(lock, [this, index] { return m_entries[index].ready; });
+
+    PreparedVolume* data = m_entries[index].data;
+    m_entries.erase(index);
+    return data;
+  }
+
+  void VolumePrefetcher::Retain (std::vector<int> indices)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<int, Entry>::iterator it = m_entries.begin();
+    while (it != m_entries.end())
+    {
+      if (std::find(indices.begin(), indices.end(), it->first) != indices.end())
+      {
+        ++it;
+        continue;
+      }
+
+      std::deque<int>::iterator job = std::find(m_jobs.begin(), m_jobs.end(), it->first);
+      if (it->second.ready)
+      {
+        if (it->second.data) delete it->second.data;
+        it = m_entries.erase(it);
+      }
+      else if (job != m_jobs.end())
+      {
+        m_jobs.erase(job);
+        it = m_entries.erase(it);
+      }
+      else
+      {
+        // being loaded: the worker deletes it when finished
+        it->second.discard = true;
+        ++it;
+      }
+    }
+  }
+
+  void VolumePrefetcher::Clear ()
+  {
+    Retain(std::vector<int>());
+
+    // discarded entries are erased by the workers when their jobs finish
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond_ready.wait(lock, [this] { return m_entries.empty(); });
+  }
+
+  bool VolumePrefetcher::IsReady (int index)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<int, Entry>::iterator it = m_entries.find(index);
+    return (it != m_entries.end() && it->second.ready);
+  }
+
+  void VolumePrefetcher::WorkerLoop ()
+  {
+    while (true)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond_jobs.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+      if (m_stop) return;
+
+      int index = m_jobs.front();
+      m_jobs.pop_front();
+      LoadJob load_job = m_entries[index].job;
+      lock.unlock();
+
+      PreparedVolume* data = load_job();
+
+      lock.lock();
+      std::map<int, Entry>::iterator it = m_entries.find(index);
+      if (it == m_entries.end() || it->second.discard)
+      {
+        if (data) delete data;
+        if (it != m_entries.end()) m_entries.erase(it);
+      }
+      else
+      {
+        it->second.data = data;
+        it->second.ready = true;
+      }
+      lock.unlock();
+
+      m_cond_ready.notify_all();
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/**
+ * volumeprefetcher.h
+ *
+ * Small pool of worker threads that read and preprocess structured datasets
+ *   ahead of time (e.g. the previous and next entries of the dataset list).
+ *
+ * Only CPU work is done by the workers: reading the file, building the
+ *   normalized staging array and, if requested, the gradients. The GL upload
+ *   must still be done by the caller, on the GL thread.
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_PREFETCHER_H
+#define VOL_VIS_UTILS_VOLUME_PREFETCHER_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vis
+{
+  // Result of loading a dataset outside the GL thread
+  class PreparedVolume
+  {
+  public:
+    PreparedVolume ();
+    // Deletes everything that was not released by the caller
+    ~PreparedVolume ();
+
+    int index;
+    unsigned int gradient_type;
+
+    StructuredGridVolume* volume;
+    // width * height * depth normalized samples
+    float* scalar_values;
+    // width * height * depth gradients, nullptr if not generated
+    glm::vec3* gradient_values;
+  };
+
+  class VolumePrefetcher
+  {
+  public:
+    // Must copy everything it needs: it runs on a worker thread
+    typedef std::function<PreparedVolume*()> LoadJob;
+
+    VolumePrefetcher (unsigned int n_workers = 2);
+    ~VolumePrefetcher ();
+
+    // Schedule job to load index, if it is not already loaded or scheduled
+    void Request (int index, LoadJob job);
+
+    // Remove the prepared volume of index from the prefetcher, waiting for it
+    //   if it is being loaded. Jobs that were not started yet are executed by
+    //   the calling thread. Returns nullptr if index was never requested.
+    PreparedVolume* Take (int index);
+
+    // Discard every entry that is not in indices
+    void Retain (std::vector<int> indices);
+    // Discard every entry and wait for the running jobs
+    void Clear ();
+
+    bool IsReady (int index);
+
+  protected:
+    void WorkerLoop ();
+
+  private:
+    class Entry
+    {
+    public:
+      Entry () : ready(false), discard(false), data(nullptr) {}
+      LoadJob job;
+      bool ready;
+      // set when the entry is dropped while a worker is loading it
+      bool discard;
+      PreparedVolume* data;
+    };
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_jobs;
+    std::condition_variable m_cond_ready;
+
+    std::deque<int> m_jobs;
+    std::map<int, Entry> m_entries;
+
+    bool m_stop;
+  };
+}
+
+#endif
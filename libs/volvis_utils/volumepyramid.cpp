@@ -0,0 +1,209 @@
+#include "volumepyramid.h"
+#include "generalizedsampling.h"
+#include "volumeview.h"
+
+#include <vis_utils/filters/box.hpp>
+#include <vis_utils/filters/hat.hpp>
+#include <vis_utils/filters/catmullrom.hpp>
+#include <vis_utils/filters/mitchellnetravali.hpp>
+#include <vis_utils/filters/bspline3.hpp>
+#include <vis_utils/filters/omoms3.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+namespace vis
+{
+  typedef std::function<void (int y, int z, float* row)> RowReader;
+
+  // Resample the volume of size n read by read_row into g, of size m
+  static bool DownSampleRows (const RowReader& read_row, glm::ivec3 n, float* g, glm::ivec3 m,
+                              IMAGE_FILTER_KERNEL kernel)
+  {
+    switch (kernel)
+    {
+    case IMAGE_FILTER_KERNEL::K1_BOX:
+      GeneralizedSampling::DownSample3D(read_row, n, g, m, Box(), false);
+      break;
+    case IMAGE_FILTER_KERNEL::K2_HAT:
+      GeneralizedSampling::DownSample3D(read_row, n, g, m, Hat(), false);
+      break;
+    case IMAGE_FILTER_KERNEL::K4_CATMULL_ROM:
+      GeneralizedSampling::DownSample3D(read_row, n, g, m, CatmullRom(), false);
+      break;
+    case IMAGE_FILTER_KERNEL::K4_MITCHELL_NETRAVALI:
+      GeneralizedSampling::DownSample3D(read_row, n, g, m, MitchellNetravali(), false);
+      break;
+    case IMAGE_FILTER_KERNEL::K4_CARDINAL_BSPLINE_3:
+      GeneralizedSampling::DownSample3D(read_row, n, g, m, CardinalBspline3(), true);
+      break;
+    case IMAGE_FILTER_KERNEL::K4_CARDINAL_OMOMS3:
+      GeneralizedSampling::DownSample3D(read_row, n, g, m, CardinalOMOMS3(), true);
+      break;
+    default:
+      printf("VolumePyramid: unknown filter kernel\n");
+      return false;
+    }
+
+    // negative lobes and digital filters overshoot the normalized range
+    size_t n_voxels = size_t(m.x) * size_t(m.y) * size_t(m.z);
+    int n_blocks = (int)((n_voxels + 4095) / 4096);
+#pragma omp parallel for
+    for (int b = 0; b < n_blocks; b++)
+    {
+      size_t first = size_t(b) * 4096;
+      size_t last = std::min(first + 4096, n_voxels);
+      for (size_t i = first; i < last; i++)
+        g[i] = std::min(std::max(g[i], 0.0f), 1.0f);
+    }
+    return true;
+  }
+
+  // Level volume of size m with voxels g (new[]), same bounding box as src
+  static StructuredGridVolume* CreateLevel (StructuredGridVolume* src, glm::ivec3 m, float* g, std::string name)
+  {
+    StructuredGridVolume* vol = new StructuredGridVolume(name, m.x, m.y, m.z);
+    vol->SetScale(src->GetScaleX() * double(src->GetWidth()) / double(m.x),
+                  src->GetScaleY() * double(src->GetHeight()) / double(m.y),
+                  src->GetScaleZ() * double(src->GetDepth()) / double(m.z));
+    vol->SetArrayData(g, DataStorageSize::_NORMALIZED_F);
+    return vol;
+  }
+
+  // Resample vol to size m into a new float array
+  static float* DownSampleVolume (StructuredGridVolume* vol, glm::ivec3 m, IMAGE_FILTER_KERNEL kernel)
+  {
+    glm::ivec3 n((int)vol->GetWidth(), (int)vol->GetHeight(), (int)vol->GetDepth());
+    float* g = new float[size_t(m.x) * size_t(m.y) * size_t(m.z)];
+
+    bool resampled = false;
+    if (vol->GetDataStorageSize() == DataStorageSize::_NORMALIZED_F && !vol->GetVoxelLayoutTable())
+    {
+      // levels of the pyramid: rows straight from the array
+      const float* f = static_cast<const float*>(vol->GetArrayData());
+      resampled = DownSampleRows([&] (int y, int z, float* row) {
+        std::memcpy(row, f + (size_t(z) * n.y + y) * n.x, sizeof(float) * n.x);
+      }, n, g, m, kernel);
+    }
+    else
+    {
+      DispatchVolumeView(vol, [&] (const auto& view) {
+        resampled = DownSampleRows([&] (int y, int z, float* row) {
+          for (int x = 0; x < n.x; x++) row[x] = float(view.GetNormalized(x, y, z));
+        }, n, g, m, kernel);
+      });
+    }
+
+    if (!resampled)
+    {
+      delete[] g;
+      return nullptr;
+    }
+    return g;
+  }
+
+  VolumePyramid::VolumePyramid ()
+    : m_kernel(IMAGE_FILTER_KERNEL::K4_CARDINAL_BSPLINE_3)
+  {}
+
+  VolumePyramid::~VolumePyramid ()
+  {
+    Clear();
+  }
+
+  bool VolumePyramid::Build (StructuredGridVolume* vol, IMAGE_FILTER_KERNEL kernel, int max_levels,
+                             DataStorageSize level_dss)
+  {
+    Clear();
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN) return false;
+
+    m_kernel = kernel;
+    m_levels.push_back(vol);
+
+    glm::ivec3 size((int)vol->GetWidth(), (int)vol->GetHeight(), (int)vol->GetDepth());
+    while ((max_levels <= 0 || GetNumberOfLevels() <= max_levels) && glm::any(glm::greaterThan(size, glm::ivec3(1))))
+    {
+      StructuredGridVolume* prev = m_levels.back();
+      size = GetNextLevelSize(size);
+
+      float* g = DownSampleVolume(prev, size, kernel);
+      if (!g)
+      {
+        Clear();
+        return false;
+      }
+      m_levels.push_back(CreateLevel(prev, size, g, vol->GetName() + "_lod" + std::to_string(GetNumberOfLevels())));
+
+      // the next level is computed from the float values of this one
+      if (prev != vol && level_dss != DataStorageSize::_NORMALIZED_F)
+        prev->ConvertDataStorageSize(level_dss);
+    }
+    if (GetNumberOfLevels() > 1 && level_dss != DataStorageSize::_NORMALIZED_F)
+      m_levels.back()->ConvertDataStorageSize(level_dss);
+
+    return true;
+  }
+
+  void VolumePyramid::Clear ()
+  {
+    for (size_t i = 1; i < m_levels.size(); i++)
+      delete m_levels[i];
+    m_levels.clear();
+  }
+
+  int VolumePyramid::GetNumberOfLevels () const
+  {
+    return (int)m_levels.size();
+  }
+
+  StructuredGridVolume* VolumePyramid::GetLevel (int level) const
+  {
+    if (level < 0 || level >= GetNumberOfLevels()) return nullptr;
+    return m_levels[level];
+  }
+
+  int VolumePyramid::GetLevelFittingIn (int max_dimension) const
+  {
+    if (m_levels.empty()) return -1;
+    for (int l = 0; l < GetNumberOfLevels(); l++)
+    {
+      StructuredGridVolume* vol = m_levels[l];
+      if ((int)std::max(vol->GetWidth(), std::max(vol->GetHeight(), vol->GetDepth())) <= max_dimension)
+        return l;
+    }
+    return GetNumberOfLevels() - 1;
+  }
+
+  IMAGE_FILTER_KERNEL VolumePyramid::GetKernel () const
+  {
+    return m_kernel;
+  }
+
+  glm::ivec3 VolumePyramid::GetNextLevelSize (glm::ivec3 size)
+  {
+    return glm::max((size + glm::ivec3(1)) / 2, glm::ivec3(1));
+  }
+
+  StructuredGridVolume* VolumePyramid::DownSample (StructuredGridVolume* vol, glm::ivec3 size,
+                                                   IMAGE_FILTER_KERNEL kernel, DataStorageSize dss)
+  {
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN) return nullptr;
+
+    glm::ivec3 n((int)vol->GetWidth(), (int)vol->GetHeight(), (int)vol->GetDepth());
+    if (glm::any(glm::lessThan(size, glm::ivec3(1))) || glm::any(glm::greaterThan(size, n)))
+    {
+      printf("VolumePyramid: downsampled size must be in [1, volume size]\n");
+      return nullptr;
+    }
+
+    float* g = DownSampleVolume(vol, size, kernel);
+    if (!g) return nullptr;
+
+    StructuredGridVolume* level = CreateLevel(vol, size, g, vol->GetName());
+    if (dss != DataStorageSize::_NORMALIZED_F)
+      level->ConvertDataStorageSize(dss);
+    return level;
+  }
+}
@@ -0,0 +1,69 @@
+/**
+ * volumepyramid.h
+ *
+ * Multi-resolution pyramid of a StructuredGridVolume: each level halves the
+ *   previous one along every axis (odd sizes rounded up), down to 1x1x1 or
+ *   a maximum number of levels. Used for level-of-detail rendering during
+ *   interaction, previews and the coarse levels of octrees and summed area
+ *   tables.
+ *
+ * Levels are resampled with GeneralizedSampling::DownSample3D, separable and
+ *   multi-threaded, using one of the image filter kernels
+ *   (vis_utils/filters). Each level is computed from the float values of the
+ *   previous one, so the cost of the whole pyramid is about 8/7 of the first
+ *   level. The cardinal kernels (B-spline, OMOMS) apply their digital
+ *   filter; their overshoot is clamped to the normalized range [0, 1].
+ *
+ * Level 0 is the source volume. The other levels are owned by the pyramid
+ *   and store normalized values, as _NORMALIZED_F unless another storage
+ *   type is requested. They keep the bounding box of the source: the scale
+ *   of the voxels grows with each level.
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_PYRAMID_H
+#define VOL_VIS_UTILS_VOLUME_PYRAMID_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <vis_utils/filters/utils.hpp>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace vis
+{
+  class VolumePyramid
+  {
+  public:
+    VolumePyramid ();
+    ~VolumePyramid ();
+
+    // Build the levels below vol, max_levels = 0 goes down to 1x1x1
+    bool Build (StructuredGridVolume* vol, IMAGE_FILTER_KERNEL kernel = IMAGE_FILTER_KERNEL::K4_CARDINAL_BSPLINE_3,
+                int max_levels = 0, DataStorageSize level_dss = DataStorageSize::_NORMALIZED_F);
+    void Clear ();
+
+    // Source volume included
+    int GetNumberOfLevels () const;
+    StructuredGridVolume* GetLevel (int level) const;
+    // Finest level with every dimension <= max_dimension, the coarsest
+    //   level if none fits
+    int GetLevelFittingIn (int max_dimension) const;
+    IMAGE_FILTER_KERNEL GetKernel () const;
+
+    // Size of the level below a level of the given size
+    static glm::ivec3 GetNextLevelSize (glm::ivec3 size);
+
+    // New volume of the given size, <= the size of vol along every axis,
+    //   resampled from vol. Returns nullptr if vol has no data.
+    static StructuredGridVolume* DownSample (StructuredGridVolume* vol, glm::ivec3 size,
+                                             IMAGE_FILTER_KERNEL kernel = IMAGE_FILTER_KERNEL::K4_CARDINAL_BSPLINE_3,
+                                             DataStorageSize dss = DataStorageSize::_NORMALIZED_F);
+
+  private:
+    IMAGE_FILTER_KERNEL m_kernel;
+    // m_levels[0] is the source, not owned
+    std::vector<StructuredGridVolume*> m_levels;
+  };
+}
+
+#endif
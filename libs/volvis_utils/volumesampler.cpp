@@ -0,0 +1,169 @@
+#include "volumesampler.h"
+
+#include <volvis_utils/volumeview.h>
+
+#include <algorithm>
+
+namespace vis
+{
+  // v clamped to [0, vmax], written so that NaN gives 0 (std::min/max
+  //   keep it) and the int casts of the coordinates stay defined
+  template<typename Real>
+  static inline Real ClampVoxel (Real v, Real vmax)
+  {
+    return v > Real(0) ? (v < vmax ? v : vmax) : Real(0);
+  }
+
+  template<typename Real, typename View>
+  static void SampleTrilinear (const View& view, const Real* px, const Real* py, const Real* pz, size_t stride,
+                               const Real scale[3], const Real offset[3], Real* samples, size_t n)
+  {
+    const int BS = TrilinearVolumeSampler::BLOCK_SIZE;
+    const int w = view.GetWidth(), h = view.GetHeight(), d = view.GetDepth();
+
+    // voxel coordinates are clamped to [0, dim - 1], the first corner to
+    //   [0, dim - 2] so the second one is always inside
+    const Real vmax_x = Real(w - 1), vmax_y = Real(h - 1), vmax_z = Real(d - 1);
+    const int imax_x = std::max(w - 2, 0), imax_y = std::max(h - 2, 0), imax_z = std::max(d - 2, 0);
+    const int step_x = w > 1 ? 1 : 0, step_y = h > 1 ? 1 : 0, step_z = d > 1 ? 1 : 0;
+    const Real inv_max_density = Real(1.0 / view.GetMaxDensity());
+
+    int n_blocks = (int)((n + BS - 1) / BS);
+#pragma omp parallel for if (n_blocks > 4)
+    for (int b = 0; b < n_blocks; b++)
+    {
+      size_t first = size_t(b) * BS;
+      int count = (int)std::min(size_t(BS), n - first);
+
+      int x0[BS], y0[BS], z0[BS];
+      Real fx[BS], fy[BS], fz[BS];
+
+      // 1. corners and weights
+      for (int i = 0; i < count; i++)
+      {
+        size_t p = (first + i) * stride;
+        Real vx = ClampVoxel(px[p] * scale[0] + offset[0], vmax_x);
+        Real vy = ClampVoxel(py[p] * scale[1] + offset[1], vmax_y);
+        Real vz = ClampVoxel(pz[p] * scale[2] + offset[2], vmax_z);
+        x0[i] = std::min((int)vx, imax_x);
+        y0[i] = std::min((int)vy, imax_y);
+        z0[i] = std::min((int)vz, imax_z);
+        fx[i] = vx - Real(x0[i]);
+        fy[i] = vy - Real(y0[i]);
+        fz[i] = vz - Real(z0[i]);
+      }
+
+      // 2. gathers, unchecked
+      for (int i = 0; i < count; i++)
+      {
+        int xa = x0[i], xb = xa + step_x;
+        int ya = y0[i], yb = ya + step_y;
+        int za = z0[i], zb = za + step_z;
+        Real xd = fx[i], yd = fy[i], zd = fz[i];
+
+        // X interpolation
+        Real c00 = Real(view.Get(xa, ya, za)) * (Real(1) - xd) + Real(view.Get(xb, ya, za)) * xd;
+        Real c10 = Real(view.Get(xa, yb, za)) * (Real(1) - xd) + Real(view.Get(xb, yb, za)) * xd;
+        Real c01 = Real(view.Get(xa, ya, zb)) * (Real(1) - xd) + Real(view.Get(xb, ya, zb)) * xd;
+        Real c11 = Real(view.Get(xa, yb, zb)) * (Real(1) - xd) + Real(view.Get(xb, yb, zb)) * xd;
+
+        // Y interpolation
+        Real c0 = c00 * (Real(1) - yd) + c10 * yd;
+        Real c1 = c01 * (Real(1) - yd) + c11 * yd;
+
+        // Z interpolation
+        samples[first + i] = (c0 * (Real(1) - zd) + c1 * zd) * inv_max_density;
+      }
+    }
+  }
+
+  TrilinearVolumeSampler::TrilinearVolumeSampler (StructuredGridVolume* vol)
+    : m_volume(vol)
+    , m_world_scale(0.0)
+    , m_world_offset(0.0)
+    , m_texture_scale(0.0)
+  {
+    UpdateTransforms();
+  }
+
+  void TrilinearVolumeSampler::UpdateTransforms ()
+  {
+    if (!m_volume) return;
+
+    glm::dvec3 bbmin = m_volume->GetGridBBoxMin();
+    glm::dvec3 bbmax = m_volume->GetGridBBoxMax();
+    glm::dvec3 last_voxel = glm::dvec3(m_volume->GetWidth(), m_volume->GetHeight(), m_volume->GetDepth()) - 1.0;
+
+    m_world_scale = last_voxel / (bbmax - bbmin);
+    m_world_offset = -bbmin * m_world_scale;
+    m_texture_scale = last_voxel;
+  }
+
+  template<typename Real>
+  void TrilinearVolumeSampler::Sample (const Real* px, const Real* py, const Real* pz, size_t stride,
+                                       glm::dvec3 scale, glm::dvec3 offset, Real* samples, size_t n) const
+  {
+    if (n == 0) return;
+
+    Real s[3] = { Real(scale.x), Real(scale.y), Real(scale.z) };
+    Real o[3] = { Real(offset.x), Real(offset.y), Real(offset.z) };
+
+    bool sampled = m_volume && m_volume->GetWidth() > 0 && m_volume->GetHeight() > 0 && m_volume->GetDepth() > 0
+      && DispatchVolumeView(m_volume, [&] (const auto& view) {
+           SampleTrilinear(view, px, py, pz, stride, s, o, samples, n);
+         });
+
+    if (!sampled)
+      std::fill(samples, samples + n, Real(0));
+  }
+
+  StructuredGridVolume* TrilinearVolumeSampler::GetVolume ()
+  {
+    return m_volume;
+  }
+
+  void TrilinearVolumeSampler::SampleWorld (const glm::dvec3* points, double* samples, size_t n) const
+  {
+    Sample<double>(&points[0].x, &points[0].y, &points[0].z, 3, m_world_scale, m_world_offset, samples, n);
+  }
+
+  void TrilinearVolumeSampler::SampleWorld (const glm::vec3* points, float* samples, size_t n) const
+  {
+    Sample<float>(&points[0].x, &points[0].y, &points[0].z, 3, m_world_scale, m_world_offset, samples, n);
+  }
+
+  void TrilinearVolumeSampler::SampleWorld (const float* x, const float* y, const float* z, float* samples, size_t n) const
+  {
+    Sample<float>(x, y, z, 1, m_world_scale, m_world_offset, samples, n);
+  }
+
+  void TrilinearVolumeSampler::SampleTexture (const glm::dvec3* points, double* samples, size_t n) const
+  {
+    Sample<double>(&points[0].x, &points[0].y, &points[0].z, 3, m_texture_scale, glm::dvec3(0.0), samples, n);
+  }
+
+  void TrilinearVolumeSampler::SampleTexture (const glm::vec3* points, float* samples, size_t n) const
+  {
+    Sample<float>(&points[0].x, &points[0].y, &points[0].z, 3, m_texture_scale, glm::dvec3(0.0), samples, n);
+  }
+
+  void TrilinearVolumeSampler::SampleTexture (const float* x, const float* y, const float* z, float* samples, size_t n) const
+  {
+    Sample<float>(x, y, z, 1, m_texture_scale, glm::dvec3(0.0), samples, n);
+  }
+
+  glm::dvec3 TrilinearVolumeSampler::GetWorldToVoxelScale () const
+  {
+    return m_world_scale;
+  }
+
+  glm::dvec3 TrilinearVolumeSampler::GetWorldToVoxelOffset () const
+  {
+    return m_world_offset;
+  }
+
+  glm::dvec3 TrilinearVolumeSampler::GetTextureToVoxelScale () const
+  {
+    return m_texture_scale;
+  }
+}
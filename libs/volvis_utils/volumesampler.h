@@ -0,0 +1,78 @@
+/**
+ * volumesampler.h
+ *
+ * Batched trilinear sampling of a StructuredGridVolume.
+ *
+ * StructuredGridVolume::GetNormalizedInterpolatedSample rebuilds the
+ *   bounding box and fetches the 8 corners one by one, with a bounds check
+ *   and a storage type dispatch each. TrilinearVolumeSampler computes the
+ *   world/texture to voxel transforms once, dispatches the storage type once
+ *   per batch and, for each block of points, first computes all the corner
+ *   indices and weights in flat arrays and then gathers the corners without
+ *   bounds checks, so both loops can be vectorized (AVX2/NEON gathers).
+ *
+ * . World space  : same mapping as GetNormalizedInterpolatedSample, the
+ *                  bounding box corners are the centers of the first and
+ *                  last voxels
+ * . Texture space: [0, 1]^3 mapped the same way to the first and last voxels
+ *
+ * Points are clamped to the volume (clamp to edge), infinite coordinates
+ *   too, and NaN coordinates to the first voxel. Inside the volume the
+ *   samples match GetNormalizedInterpolatedSample up to rounding. The float
+ *   overloads do the whole interpolation in single precision.
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_SAMPLER_H
+#define VOL_VIS_UTILS_VOLUME_SAMPLER_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace vis
+{
+  class TrilinearVolumeSampler
+  {
+  public:
+    // Points per block of indices and weights
+    static const int BLOCK_SIZE = 64;
+
+    TrilinearVolumeSampler (StructuredGridVolume* vol);
+
+    // Must be called if the dimensions, scale or grid of the volume change
+    void UpdateTransforms ();
+
+    StructuredGridVolume* GetVolume ();
+
+    // Normalized samples of n world space points
+    void SampleWorld (const glm::dvec3* points, double* samples, size_t n) const;
+    void SampleWorld (const glm::vec3* points, float* samples, size_t n) const;
+    void SampleWorld (const float* x, const float* y, const float* z, float* samples, size_t n) const;
+
+    // Normalized samples of n texture space points
+    void SampleTexture (const glm::dvec3* points, double* samples, size_t n) const;
+    void SampleTexture (const glm::vec3* points, float* samples, size_t n) const;
+    void SampleTexture (const float* x, const float* y, const float* z, float* samples, size_t n) const;
+
+    // voxel = point * scale + offset
+    glm::dvec3 GetWorldToVoxelScale () const;
+    glm::dvec3 GetWorldToVoxelOffset () const;
+    glm::dvec3 GetTextureToVoxelScale () const;
+
+  protected:
+    // Points are read as p[i * stride] for each axis
+    template<typename Real>
+    void Sample (const Real* px, const Real* py, const Real* pz, size_t stride,
+                 glm::dvec3 scale, glm::dvec3 offset, Real* samples, size_t n) const;
+
+  private:
+    StructuredGridVolume* m_volume;
+
+    glm::dvec3 m_world_scale;
+    glm::dvec3 m_world_offset;
+    glm::dvec3 m_texture_scale;
+  };
+}
+
+#endif
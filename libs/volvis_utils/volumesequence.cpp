@@ -0,0 +1,428 @@
+/**
+ * volumesequence.cpp
+**/
+#include "volumesequence.h"
+
+#include <volvis_utils/reader.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace vis
+{
+  VolumeSequence::VolumeSequence ()
+    : m_n_timesteps(0)
+    , m_decoded_timestep(-1)
+    , m_stop(false)
+    , m_buffer_capacity(DEFAULT_BUFFER_CAPACITY)
+    , m_cursor(0)
+    , m_current_timestep(0)
+    , m_target_rate(10.0)
+    , m_looping(true)
+    , m_playing(false)
+    , m_seek_pending(false)
+    , m_stalled(false)
+    , m_n_stalls(0)
+    , m_steps_since_anchor(0)
+  {
+    SetPrepareFunction(nullptr);
+  }
+
+  VolumeSequence::~VolumeSequence ()
+  {
+    Close();
+  }
+
+  bool VolumeSequence::Open (std::string filepath)
+  {
+    std::string extension = filepath.substr(filepath.find_last_of('.') + 1);
+    if (extension.compare("tvol") == 0)
+      return OpenContainer(filepath);
+
+    if (extension.compare("tseq") != 0)
+    {
+      printf("VolumeSequence: %s is not a .tvol or .tseq file\n", filepath.c_str());
+      return false;
+    }
+
+    std::ifstream f(filepath);
+    if (!f.is_open())
+    {
+      printf("VolumeSequence: error on opening %s\n", filepath.c_str());
+      return false;
+    }
+
+    // paths are relative to the list, unless they are absolute
+    std::string directory = filepath.substr(0, filepath.find_last_of("/\\") + 1);
+    std::vector<std::string> timestep_filepaths;
+    std::string line;
+    while (std::getline(f, line))
+    {
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      line.erase(0, line.find_first_not_of(" \t"));
+      if (line.empty() || line[0] == '#') continue;
+
+      if (line[0] == '/' || line[0] == '\\' || line.find(':') != std::string::npos)
+        timestep_filepaths.push_back(line);
+      else
+        timestep_filepaths.push_back(directory + line);
+    }
+    f.close();
+
+    return OpenFiles(timestep_filepaths);
+  }
+
+  bool VolumeSequence::OpenFiles (std::vector<std::string> timestep_filepaths)
+  {
+    Close();
+    if (timestep_filepaths.empty()) return false;
+
+    m_filepaths = timestep_filepaths;
+    m_n_timesteps = (int)m_filepaths.size();
+    StartDecoder();
+    return true;
+  }
+
+  bool VolumeSequence::OpenContainer (std::string filepath)
+  {
+    Close();
+    if (!m_container.Open(filepath)) return false;
+
+    m_n_timesteps = m_container.GetNumberOfTimesteps();
+    StartDecoder();
+    return true;
+  }
+
+  void VolumeSequence::Close ()
+  {
+    StopDecoder();
+
+    m_slots.clear();
+    m_container.Close();
+    m_filepaths.clear();
+    m_n_timesteps = 0;
+    m_decoded_frame.clear();
+    m_decoded_timestep = -1;
+    m_playing = false;
+  }
+
+  bool VolumeSequence::IsOpen ()
+  {
+    return m_n_timesteps > 0;
+  }
+
+  int VolumeSequence::GetNumberOfTimesteps ()
+  {
+    return m_n_timesteps;
+  }
+
+  void VolumeSequence::SetBufferCapacity (int capacity)
+  {
+    m_buffer_capacity = std::max(capacity, 1);
+  }
+
+  int VolumeSequence::GetBufferCapacity ()
+  {
+    return m_buffer_capacity;
+  }
+
+  void VolumeSequence::SetPrepareFunction (PrepareFunction prepare)
+  {
+    if (!prepare)
+    {
+      prepare = [] (StructuredGridVolume* vol, int timestep) -> PreparedVolume* {
+        PreparedVolume* prepared = new PreparedVolume();
+        prepared->index = timestep;
+        prepared->volume = vol;
+        return prepared;
+      };
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prepare = prepare;
+  }
+
+  void VolumeSequence::SetTargetRate (double timesteps_per_second)
+  {
+    m_target_rate = std::max(timesteps_per_second, 0.0);
+    m_anchor_time = std::chrono::steady_clock::now();
+    m_steps_since_anchor = 0;
+  }
+
+  double VolumeSequence::GetTargetRate ()
+  {
+    return m_target_rate;
+  }
+
+  void VolumeSequence::SetLooping (bool looping)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_looping = looping;
+    m_cond_decode.notify_one();
+  }
+
+  bool VolumeSequence::IsLooping ()
+  {
+    return m_looping;
+  }
+
+  void VolumeSequence::Play ()
+  {
+    if (!IsOpen()) return;
+    m_playing = true;
+    m_stalled = false;
+    m_anchor_time = std::chrono::steady_clock::now();
+    m_steps_since_anchor = 0;
+  }
+
+  void VolumeSequence::Pause ()
+  {
+    m_playing = false;
+  }
+
+  bool VolumeSequence::IsPlaying ()
+  {
+    return m_playing;
+  }
+
+  void VolumeSequence::Seek (int timestep)
+  {
+    if (!IsOpen()) return;
+    m_current_timestep = std::min(std::max(timestep, 0), m_n_timesteps - 1);
+    m_seek_pending = true;
+    m_anchor_time = std::chrono::steady_clock::now();
+    m_steps_since_anchor = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cursor = m_current_timestep;
+    m_cond_decode.notify_one();
+  }
+
+  bool VolumeSequence::Update ()
+  {
+    if (!IsOpen()) return false;
+
+    // a seek is shown once its timestep is decoded, also when paused
+    if (m_seek_pending)
+    {
+      if (!IsTimestepReady(m_current_timestep)) return false;
+      m_seek_pending = false;
+      m_anchor_time = std::chrono::steady_clock::now();
+      m_steps_since_anchor = 0;
+      return true;
+    }
+
+    if (!m_playing || m_target_rate <= 0.0) return false;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - m_anchor_time).count();
+    int due = (int)(elapsed * m_target_rate) - m_steps_since_anchor;
+
+    // if the renderer is slower than the target rate, timesteps are skipped,
+    //   but only the decoded ones
+    bool changed = false;
+    for (; due > 0; due--)
+    {
+      int next = m_current_timestep + 1;
+      if (next >= m_n_timesteps)
+      {
+        if (!m_looping)
+        {
+          m_playing = false;
+          break;
+        }
+        next = 0;
+      }
+
+      if (!IsTimestepReady(next))
+      {
+        if (!m_stalled) m_n_stalls++;
+        m_stalled = true;
+        // the next timestep is shown as soon as it is ready
+        m_anchor_time = now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / m_target_rate));
+        m_steps_since_anchor = 0;
+        break;
+      }
+
+      m_current_timestep = next;
+      m_steps_since_anchor++;
+      m_stalled = false;
+      changed = true;
+    }
+
+    if (changed)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cursor = m_current_timestep;
+      m_cond_decode.notify_one();
+    }
+    return changed;
+  }
+
+  int VolumeSequence::GetCurrentTimestep ()
+  {
+    return m_current_timestep;
+  }
+
+  std::shared_ptr<PreparedVolume> VolumeSequence::GetCurrentTimestepData ()
+  {
+    if (!IsOpen()) return nullptr;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    int s = -1;
+    m_cond_ready.wait(lock, [&] {
+      s = FindSlot(m_current_timestep);
+      return m_stop || (s >= 0 && m_slots[s].ready);
+    });
+    if (s < 0 || !m_slots[s].ready) return nullptr;
+    return m_slots[s].data;
+  }
+
+  bool VolumeSequence::IsTimestepReady (int timestep)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int s = FindSlot(timestep);
+    return s >= 0 && m_slots[s].ready;
+  }
+
+  int VolumeSequence::GetNumberOfStalls ()
+  {
+    return m_n_stalls;
+  }
+
+  void VolumeSequence::DecoderLoop ()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop)
+    {
+      int timestep = GetNextTimestepToDecode();
+      if (timestep < 0)
+      {
+        m_cond_decode.wait(lock);
+        continue;
+      }
+
+      // the window is not larger than the buffer, so a slot is free or holds
+      //   a timestep that is no longer needed
+      int s = 0;
+      while (s < (int)m_slots.size() - 1 && m_slots[s].timestep >= 0 && IsInWindow(m_slots[s].timestep))
+        s++;
+      m_slots[s].timestep = timestep;
+      m_slots[s].ready = false;
+      m_slots[s].data.reset();
+      PrepareFunction prepare = m_prepare;
+
+      lock.unlock();
+      StructuredGridVolume* vol = DecodeTimestep(timestep);
+      PreparedVolume* prepared = vol ? prepare(vol, timestep) : nullptr;
+      lock.lock();
+
+      // a failed timestep is marked as ready without data, so the caller
+      //   does not wait for it forever
+      m_slots[s].data = std::shared_ptr<PreparedVolume>(prepared);
+      m_slots[s].ready = true;
+      m_cond_ready.notify_all();
+    }
+  }
+
+  StructuredGridVolume* VolumeSequence::DecodeTimestep (int timestep)
+  {
+    if (!m_container.IsOpen())
+    {
+      VolumeReader vr;
+      return vr.ReadStructuredVolume(m_filepaths[timestep]);
+    }
+
+    // roll forward from the last decoded timestep when it is between the key
+    //   frame and timestep, otherwise from the key frame
+    int first = m_container.GetKeyFrame(timestep);
+    if (m_decoded_timestep >= first && m_decoded_timestep <= timestep)
+      first = m_decoded_timestep + 1;
+
+    m_decoded_frame.resize(m_container.GetFrameBytes());
+    for (int t = first; t <= timestep; t++)
+    {
+      if (!m_container.DecodeTimestep(t, m_decoded_frame.data()))
+      {
+        printf("VolumeSequence: error on decoding timestep %d\n", t);
+        m_decoded_timestep = -1;
+        return nullptr;
+      }
+      m_decoded_timestep = t;
+    }
+
+    glm::uvec3 dim = m_container.GetDimensions();
+    glm::dvec3 scale = m_container.GetScale();
+    DataStorageSize dss = m_container.GetDataStorageSize();
+
+    void* voxels = AllocateVoxelArray(dss, size_t(dim.x) * size_t(dim.y) * size_t(dim.z));
+    if (!voxels) return nullptr;
+    memcpy(voxels, m_decoded_frame.data(), m_decoded_frame.size());
+
+    StructuredGridVolume* vol = new StructuredGridVolume("t" + std::to_string(timestep), dim.x, dim.y, dim.z);
+    vol->SetScale(scale.x, scale.y, scale.z);
+    vol->SetArrayData(voxels, dss);
+    return vol;
+  }
+
+  int VolumeSequence::GetNextTimestepToDecode ()
+  {
+    int window = std::min(m_buffer_capacity, m_n_timesteps);
+    for (int k = 0; k < window; k++)
+    {
+      int timestep = m_cursor + k;
+      if (timestep >= m_n_timesteps)
+      {
+        if (!m_looping) break;
+        timestep -= m_n_timesteps;
+      }
+      if (FindSlot(timestep) < 0) return timestep;
+    }
+    return -1;
+  }
+
+  bool VolumeSequence::IsInWindow (int timestep)
+  {
+    int k = timestep - m_cursor;
+    if (k < 0 && m_looping) k += m_n_timesteps;
+    return k >= 0 && k < std::min(m_buffer_capacity, m_n_timesteps);
+  }
+
+  int VolumeSequence::FindSlot (int timestep)
+  {
+    for (int s = 0; s < (int)m_slots.size(); s++)
+      if (m_slots[s].timestep == timestep) return s;
+    return -1;
+  }
+
+  void VolumeSequence::StartDecoder ()
+  {
+    m_slots.assign(m_buffer_capacity, Slot());
+    m_cursor = 0;
+    m_current_timestep = 0;
+    m_seek_pending = false;
+    m_decoded_timestep = -1;
+    m_stop = false;
+    m_stalled = false;
+    m_n_stalls = 0;
+    m_anchor_time = std::chrono::steady_clock::now();
+    m_steps_since_anchor = 0;
+
+    m_decoder = std::thread(&VolumeSequence::DecoderLoop, this);
+  }
+
+  void VolumeSequence::StopDecoder ()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cond_decode.notify_all();
+    m_cond_ready.notify_all();
+
+    // the decoder finishes its current timestep before leaving
+    if (m_decoder.joinable()) m_decoder.join();
+  }
+}
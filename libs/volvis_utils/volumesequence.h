@@ -0,0 +1,141 @@
+/**
+ * volumesequence.h
+ *
+ * Playback of a time-varying structured dataset: a list of timestep files
+ *   (.tseq, one path per line, relative to the list) or a single .tvol
+ *   container (volumesequencefile.h).
+ *
+ * A decoder thread reads and prepares the timesteps ahead of the current
+ *   one into a bounded buffer of decoded timesteps, so memory does not grow
+ *   with the length of the sequence. Update advances the current timestep at
+ *   the target rate only through timesteps that are already decoded: if the
+ *   decoder falls behind, playback waits for it (a stall) instead of blocking
+ *   the GL thread. The GL upload of the current timestep is left to the
+ *   caller.
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_SEQUENCE_H
+#define VOL_VIS_UTILS_VOLUME_SEQUENCE_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/volumeprefetcher.h>
+#include <volvis_utils/volumesequencefile.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vis
+{
+  class VolumeSequence
+  {
+  public:
+    // Builds the CPU data of a timestep on the decoder thread, taking
+    //   ownership of the volume. Must copy everything it needs.
+    typedef std::function<PreparedVolume*(StructuredGridVolume* vol, int timestep)> PrepareFunction;
+
+    static const int DEFAULT_BUFFER_CAPACITY = 8;
+
+    VolumeSequence ();
+    ~VolumeSequence ();
+
+    // .tvol container or .tseq list of timestep files
+    bool Open (std::string filepath);
+    bool OpenFiles (std::vector<std::string> timestep_filepaths);
+    bool OpenContainer (std::string filepath);
+    void Close ();
+    bool IsOpen ();
+
+    int GetNumberOfTimesteps ();
+
+    // Decoded timesteps kept in memory, including the current one. Applied
+    //   on the next Open.
+    void SetBufferCapacity (int capacity);
+    int GetBufferCapacity ();
+    // By default the prepared volume only holds the volume. Applies to the
+    //   timesteps decoded after the call.
+    void SetPrepareFunction (PrepareFunction prepare);
+
+    // Timesteps per second
+    void SetTargetRate (double timesteps_per_second);
+    double GetTargetRate ();
+    void SetLooping (bool looping);
+    bool IsLooping ();
+
+    void Play ();
+    void Pause ();
+    bool IsPlaying ();
+    void Seek (int timestep);
+
+    // Advance the current timestep by the time elapsed since the last change.
+    //   Returns true if the current timestep changed (or a seek is done).
+    bool Update ();
+    int GetCurrentTimestep ();
+    // Waits for the current timestep if it is not decoded yet. nullptr if it
+    //   could not be read.
+    std::shared_ptr<PreparedVolume> GetCurrentTimestepData ();
+    bool IsTimestepReady (int timestep);
+    // Number of times playback had to wait for the decoder
+    int GetNumberOfStalls ();
+
+  protected:
+    void DecoderLoop ();
+    StructuredGridVolume* DecodeTimestep (int timestep);
+
+    // timestep that should be decoded next, -1 if the window is full
+    int GetNextTimestepToDecode ();
+    bool IsInWindow (int timestep);
+    // slot holding timestep, -1 if it is not buffered
+    int FindSlot (int timestep);
+    void StartDecoder ();
+    void StopDecoder ();
+
+  private:
+    class Slot
+    {
+    public:
+      Slot () : timestep(-1), ready(false) {}
+      int timestep;
+      bool ready;
+      std::shared_ptr<PreparedVolume> data;
+    };
+
+    // sources
+    std::vector<std::string> m_filepaths;
+    VolumeSequenceFile m_container;
+    int m_n_timesteps;
+
+    // decoder state, only used by the decoder thread
+    std::vector<unsigned char> m_decoded_frame;
+    int m_decoded_timestep;
+
+    std::thread m_decoder;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_decode;
+    std::condition_variable m_cond_ready;
+    bool m_stop;
+
+    int m_buffer_capacity;
+    std::vector<Slot> m_slots;
+    // first timestep of the window the decoder keeps filled
+    int m_cursor;
+    PrepareFunction m_prepare;
+
+    // playback, only used by the caller thread
+    int m_current_timestep;
+    double m_target_rate;
+    bool m_looping;
+    bool m_playing;
+    bool m_seek_pending;
+    bool m_stalled;
+    int m_n_stalls;
+    std::chrono::steady_clock::time_point m_anchor_time;
+    int m_steps_since_anchor;
+  };
+}
+
+#endif
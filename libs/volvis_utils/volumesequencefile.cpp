@@ -0,0 +1,401 @@
+#include "volumesequencefile.h"
+
+#include <volvis_utils/reader.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace vis
+{
+  namespace
+  {
+    template<typename T>
+    void WriteValue (std::ofstream& f, T v)
+    {
+      f.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template<typename T>
+    T GetValue (const unsigned char* data, size_t* pos)
+    {
+      T v;
+      memcpy(&v, data + *pos, sizeof(T));
+      *pos += sizeof(T);
+      return v;
+    }
+
+    uint64_t TimestepInfoByteSize ()
+    {
+      return 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    }
+
+    uint64_t HeaderByteSize ()
+    {
+      return 4 + sizeof(uint32_t) * 4 + sizeof(double) * 3 + sizeof(uint32_t) * 3;
+    }
+  }
+
+  VolumeSequenceFile::VolumeSequenceFile ()
+    : m_dimensions(0)
+    , m_scale(1.0)
+    , m_data_storage_size(DataStorageSize::UNKNOWN)
+    , m_block_bytes(0)
+  {
+  }
+
+  VolumeSequenceFile::~VolumeSequenceFile ()
+  {
+    Close();
+  }
+
+  bool VolumeSequenceFile::Write (std::vector<std::string> timestep_filepaths, std::string filepath,
+                                  bool delta_encoding, uint32_t keyframe_interval, uint32_t block_bytes)
+  {
+    if (timestep_filepaths.empty() || block_bytes == 0) return false;
+    if (keyframe_interval == 0) keyframe_interval = 1;
+
+    std::ofstream f(filepath.c_str(), std::ios::binary);
+    if (!f.is_open())
+    {
+      printf("VolumeSequenceFile: error on opening %s\n", filepath.c_str());
+      return false;
+    }
+
+    uint32_t n_timesteps = (uint32_t)timestep_filepaths.size();
+    std::vector<TimestepInfo> timesteps(n_timesteps);
+
+    glm::uvec3 dim(0);
+    DataStorageSize dss = DataStorageSize::UNKNOWN;
+    size_t frame_bytes = 0;
+    uint32_t n_frame_blocks = 0;
+    uint64_t table_offset = HeaderByteSize();
+    uint64_t offset = table_offset + TimestepInfoByteSize() * n_timesteps;
+
+    // previous timestep, for the delta frames
+    std::vector<unsigned char> previous;
+    std::vector<uint32_t> changed_blocks;
+    bool ok = true;
+    for (uint32_t t = 0; t < n_timesteps && ok; t++)
+    {
+      VolumeReader vr;
+      StructuredGridVolume* vol = vr.ReadStructuredVolume(timestep_filepaths[t]);
+      if (!vol || !vol->GetArrayData() || vol->GetVoxelLayoutTable())
+      {
+        printf("VolumeSequenceFile: %s has no linear voxel array\n", timestep_filepaths[t].c_str());
+        if (vol) delete vol;
+        ok = false;
+        break;
+      }
+
+      if (t == 0)
+      {
+        dim = glm::uvec3(vol->GetWidth(), vol->GetHeight(), vol->GetDepth());
+        dss = vol->GetDataStorageSize();
+        frame_bytes = GetStorageArrayBytes(dss, size_t(dim.x) * size_t(dim.y) * size_t(dim.z));
+        n_frame_blocks = (uint32_t)((frame_bytes + block_bytes - 1) / block_bytes);
+
+        // Header
+        f.write("TVOL", 4);
+        WriteValue<uint32_t>(f, VERSION);
+        WriteValue<uint32_t>(f, dim.x);
+        WriteValue<uint32_t>(f, dim.y);
+        WriteValue<uint32_t>(f, dim.z);
+        WriteValue<double>(f, vol->GetScaleX());
+        WriteValue<double>(f, vol->GetScaleY());
+        WriteValue<double>(f, vol->GetScaleZ());
+        WriteValue<uint32_t>(f, (uint32_t)dss);
+        WriteValue<uint32_t>(f, n_timesteps);
+        WriteValue<uint32_t>(f, block_bytes);
+
+        // Reserve the timestep table, it is rewritten at the end
+        std::vector<char> empty_table((size_t)(offset - table_offset), 0);
+        f.write(empty_table.data(), empty_table.size());
+      }
+      else if (glm::uvec3(vol->GetWidth(), vol->GetHeight(), vol->GetDepth()) != dim
+            || vol->GetDataStorageSize() != dss)
+      {
+        printf("VolumeSequenceFile: %s does not match the first timestep\n", timestep_filepaths[t].c_str());
+        delete vol;
+        ok = false;
+        break;
+      }
+
+      const unsigned char* frame = static_cast<const unsigned char*>(vol->GetArrayData());
+      TimestepInfo& ti = timesteps[t];
+      ti.byte_offset = offset;
+      ti.encoding = KEY_FRAME;
+      ti.n_blocks = 0;
+
+      if (delta_encoding && t % keyframe_interval != 0)
+      {
+        changed_blocks.clear();
+        for (uint32_t b = 0; b < n_frame_blocks; b++)
+        {
+          size_t begin = size_t(b) * block_bytes;
+          size_t len = std::min(size_t(block_bytes), frame_bytes - begin);
+          if (memcmp(frame + begin, previous.data() + begin, len) != 0)
+            changed_blocks.push_back(b);
+        }
+
+        // the last block may be shorter, the estimate is conservative
+        uint64_t delta_bytes = changed_blocks.size() * (sizeof(uint32_t) + uint64_t(block_bytes));
+        if (delta_bytes < frame_bytes)
+        {
+          ti.encoding = DELTA_FRAME;
+          ti.n_blocks = (uint32_t)changed_blocks.size();
+        }
+      }
+
+      if (ti.encoding == DELTA_FRAME)
+      {
+        f.write(reinterpret_cast<const char*>(changed_blocks.data()), changed_blocks.size() * sizeof(uint32_t));
+        ti.byte_size = changed_blocks.size() * sizeof(uint32_t);
+        for (size_t i = 0; i < changed_blocks.size(); i++)
+        {
+          size_t begin = size_t(changed_blocks[i]) * block_bytes;
+          size_t len = std::min(size_t(block_bytes), frame_bytes - begin);
+          f.write(reinterpret_cast<const char*>(frame + begin), len);
+          ti.byte_size += len;
+        }
+      }
+      else
+      {
+        f.write(reinterpret_cast<const char*>(frame), frame_bytes);
+        ti.byte_size = frame_bytes;
+      }
+      offset += ti.byte_size;
+
+      if (delta_encoding)
+        previous.assign(frame, frame + frame_bytes);
+      delete vol;
+      ok = f.good();
+    }
+
+    if (ok)
+    {
+      f.seekp((std::streamoff)table_offset);
+      for (uint32_t t = 0; t < n_timesteps; t++)
+      {
+        WriteValue<uint64_t>(f, timesteps[t].byte_offset);
+        WriteValue<uint64_t>(f, timesteps[t].byte_size);
+        WriteValue<uint32_t>(f, timesteps[t].encoding);
+        WriteValue<uint32_t>(f, timesteps[t].n_blocks);
+      }
+      ok = f.good();
+    }
+    f.close();
+
+    if (ok)
+    {
+      printf("VolumeSequenceFile: %s written with %u timesteps, %.1f%% of the raw size\n", filepath.c_str(),
+        n_timesteps, 100.0 * double(offset - table_offset) / (double(frame_bytes) * n_timesteps));
+    }
+    return ok;
+  }
+
+  bool VolumeSequenceFile::Open (std::string filepath)
+  {
+    Close();
+
+    if (!m_file.Open(filepath))
+    {
+      printf("VolumeSequenceFile: error on opening %s\n", filepath.c_str());
+      return false;
+    }
+    m_filepath = filepath;
+
+    std::vector<unsigned char> header((size_t)HeaderByteSize());
+    char magic[4] = { 0, 0, 0, 0 };
+    uint32_t version = 0;
+    if (m_file.ReadAt(0, header.data(), header.size()))
+    {
+      memcpy(magic, header.data(), 4);
+      memcpy(&version, header.data() + 4, sizeof(uint32_t));
+    }
+    if (strncmp(magic, "TVOL", 4) != 0 || version != VERSION)
+    {
+      printf("VolumeSequenceFile: %s is not a valid .tvol file\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    size_t pos = 4 + sizeof(uint32_t);
+    m_dimensions.x = GetValue<uint32_t>(header.data(), &pos);
+    m_dimensions.y = GetValue<uint32_t>(header.data(), &pos);
+    m_dimensions.z = GetValue<uint32_t>(header.data(), &pos);
+    m_scale.x = GetValue<double>(header.data(), &pos);
+    m_scale.y = GetValue<double>(header.data(), &pos);
+    m_scale.z = GetValue<double>(header.data(), &pos);
+    m_data_storage_size = (DataStorageSize)GetValue<uint32_t>(header.data(), &pos);
+    uint32_t n_timesteps = GetValue<uint32_t>(header.data(), &pos);
+    m_block_bytes = GetValue<uint32_t>(header.data(), &pos);
+
+    // a corrupt header must not allocate more than the file holds
+    size_t file_size = m_file.GetSize();
+    size_t table_bytes = file_size > (size_t)HeaderByteSize() ? file_size - (size_t)HeaderByteSize() : 0;
+    if (m_block_bytes == 0 || GetFrameBytes() == 0 || n_timesteps > table_bytes / (size_t)TimestepInfoByteSize())
+    {
+      printf("VolumeSequenceFile: corrupted header at %s\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    std::vector<unsigned char> table((size_t)TimestepInfoByteSize() * n_timesteps);
+    if (!m_file.ReadAt((size_t)HeaderByteSize(), table.data(), table.size()))
+    {
+      printf("VolumeSequenceFile: corrupted header at %s\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    pos = 0;
+    bool valid_table = true;
+    size_t frame_blocks = GetNumberOfFrameBlocks();
+    m_timesteps.resize(n_timesteps);
+    for (uint32_t t = 0; t < n_timesteps; t++)
+    {
+      TimestepInfo& ti = m_timesteps[t];
+      ti.byte_offset = GetValue<uint64_t>(table.data(), &pos);
+      ti.byte_size = GetValue<uint64_t>(table.data(), &pos);
+      ti.encoding = GetValue<uint32_t>(table.data(), &pos);
+      ti.n_blocks = GetValue<uint32_t>(table.data(), &pos);
+      // the data of each timestep is inside the file, a delta frame changes
+      //   at most every block
+      valid_table = valid_table && ti.byte_offset <= file_size && ti.byte_size <= file_size - ti.byte_offset
+                 && (ti.encoding == KEY_FRAME || ti.n_blocks <= frame_blocks);
+    }
+
+    if (n_timesteps == 0 || !valid_table || m_timesteps[0].encoding != KEY_FRAME)
+    {
+      printf("VolumeSequenceFile: corrupted timestep table at %s\n", filepath.c_str());
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void VolumeSequenceFile::Close ()
+  {
+    m_file.Close();
+    m_timesteps.clear();
+    m_filepath.clear();
+  }
+
+  bool VolumeSequenceFile::IsOpen ()
+  {
+    return m_file.IsOpen();
+  }
+
+  glm::uvec3 VolumeSequenceFile::GetDimensions ()
+  {
+    return m_dimensions;
+  }
+
+  glm::dvec3 VolumeSequenceFile::GetScale ()
+  {
+    return m_scale;
+  }
+
+  DataStorageSize VolumeSequenceFile::GetDataStorageSize ()
+  {
+    return m_data_storage_size;
+  }
+
+  int VolumeSequenceFile::GetNumberOfTimesteps ()
+  {
+    return (int)m_timesteps.size();
+  }
+
+  size_t VolumeSequenceFile::GetFrameBytes ()
+  {
+    return GetStorageArrayBytes(m_data_storage_size,
+      size_t(m_dimensions.x) * size_t(m_dimensions.y) * size_t(m_dimensions.z));
+  }
+
+  size_t VolumeSequenceFile::GetNumberOfFrameBlocks ()
+  {
+    if (m_block_bytes == 0) return 0;
+    return (GetFrameBytes() + m_block_bytes - 1) / m_block_bytes;
+  }
+
+  uint64_t VolumeSequenceFile::GetStoredBytes ()
+  {
+    uint64_t bytes = 0;
+    for (size_t t = 0; t < m_timesteps.size(); t++)
+      bytes += m_timesteps[t].byte_size;
+    return bytes;
+  }
+
+  VolumeSequenceFile::TimestepInfo& VolumeSequenceFile::GetTimestepInfo (int timestep)
+  {
+    return m_timesteps[timestep];
+  }
+
+  int VolumeSequenceFile::GetKeyFrame (int timestep)
+  {
+    while (timestep > 0 && m_timesteps[timestep].encoding != KEY_FRAME)
+      timestep--;
+    return timestep;
+  }
+
+  bool VolumeSequenceFile::DecodeTimestep (int timestep, unsigned char* frame)
+  {
+    if (timestep < 0 || timestep >= GetNumberOfTimesteps()) return false;
+
+    const TimestepInfo& ti = m_timesteps[timestep];
+    size_t frame_bytes = GetFrameBytes();
+    if (ti.encoding == KEY_FRAME)
+      return ti.byte_size == frame_bytes && m_file.ReadAt((size_t)ti.byte_offset, frame, frame_bytes);
+
+    // block indices, then the blocks
+    if (ti.n_blocks > GetNumberOfFrameBlocks() || size_t(ti.n_blocks) * sizeof(uint32_t) > ti.byte_size)
+      return false;
+    std::vector<unsigned char> data((size_t)ti.byte_size);
+    if (!m_file.ReadAt((size_t)ti.byte_offset, data.data(), data.size()))
+      return false;
+
+    size_t pos = size_t(ti.n_blocks) * sizeof(uint32_t);
+    for (uint32_t i = 0; i < ti.n_blocks; i++)
+    {
+      uint32_t block;
+      memcpy(&block, data.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+
+      if (block >= GetNumberOfFrameBlocks()) return false;
+      size_t begin = size_t(block) * m_block_bytes;
+      size_t len = std::min(size_t(m_block_bytes), frame_bytes - begin);
+      if (len > data.size() - pos) return false;
+
+      memcpy(frame + begin, data.data() + pos, len);
+      pos += len;
+    }
+    return true;
+  }
+
+  StructuredGridVolume* VolumeSequenceFile::LoadTimestep (int timestep)
+  {
+    if (timestep < 0 || timestep >= GetNumberOfTimesteps()) return nullptr;
+
+    size_t n_voxels = size_t(m_dimensions.x) * size_t(m_dimensions.y) * size_t(m_dimensions.z);
+    void* voxels = AllocateVoxelArray(m_data_storage_size, n_voxels);
+    if (!voxels) return nullptr;
+
+    for (int t = GetKeyFrame(timestep); t <= timestep; t++)
+    {
+      if (!DecodeTimestep(t, static_cast<unsigned char*>(voxels)))
+      {
+        printf("VolumeSequenceFile: error on decoding timestep %d of %s\n", t, m_filepath.c_str());
+        DeleteVoxelArray(voxels, m_data_storage_size);
+        return nullptr;
+      }
+    }
+
+    std::string name = m_filepath.substr(m_filepath.find_last_of("/\\") + 1);
+    StructuredGridVolume* vol = new StructuredGridVolume(name + "_t" + std::to_string(timestep),
+      m_dimensions.x, m_dimensions.y, m_dimensions.z);
+    vol->SetScale(m_scale.x, m_scale.y, m_scale.z);
+    vol->SetArrayData(voxels, m_data_storage_size);
+    return vol;
+  }
+}
@@ -0,0 +1,116 @@
+/**
+ * Time-varying volume container (.tvol)
+ *
+ * All the timesteps of a sequence in one file, with the same dimensions and
+ *   storage type. A table at the start gives the offset of each timestep, so
+ *   any of them can be located without reading the others.
+ *
+ * With temporal delta encoding, a timestep only stores the blocks of
+ *   block_bytes bytes of its voxel array that differ from the previous
+ *   timestep. Slowly changing fields, where most of the domain is unchanged
+ *   between two outputs of a simulation, shrink to a fraction of their size.
+ *   Every keyframe_interval timesteps (and whenever a delta would not be
+ *   smaller) a key frame stores the whole array, which bounds the cost of
+ *   seeking: decoding timestep t starts at the key frame before it.
+ *
+ * Format (little endian, fields written one by one):
+ * |"TVOL" version
+ * |width height depth
+ * |scalex scaley scalez
+ * |data_storage_size n_timesteps block_bytes
+ * |for each timestep: byte_offset byte_size encoding n_blocks
+ * |timestep data
+ * |  key frame  : the voxel array, linear layout
+ * |  delta frame: n_blocks block indices (uint32), then the bytes of these
+ * |               blocks (the last block of the array may be shorter)
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_SEQUENCE_FILE_H
+#define VOL_VIS_UTILS_VOLUME_SEQUENCE_FILE_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <file_utils/positionedfile.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vis
+{
+  class VolumeSequenceFile
+  {
+  public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t DEFAULT_BLOCK_BYTES = 16384;
+    static const uint32_t DEFAULT_KEYFRAME_INTERVAL = 16;
+
+    enum FrameEncoding : uint32_t
+    {
+      KEY_FRAME   = 0,
+      DELTA_FRAME = 1,
+    };
+
+    class TimestepInfo
+    {
+    public:
+      uint64_t byte_offset;
+      uint64_t byte_size;
+      uint32_t encoding;
+      // changed blocks of a delta frame
+      uint32_t n_blocks;
+    };
+
+    VolumeSequenceFile ();
+    ~VolumeSequenceFile ();
+
+    // Read the timestep files with VolumeReader, one at a time, and write
+    //   them as a .tvol file. keyframe_interval = 1 or delta_encoding = false
+    //   stores every timestep whole.
+    static bool Write (std::vector<std::string> timestep_filepaths, std::string filepath,
+                       bool delta_encoding = true,
+                       uint32_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL,
+                       uint32_t block_bytes = DEFAULT_BLOCK_BYTES);
+
+    // Read only the header and the timestep table
+    bool Open (std::string filepath);
+    void Close ();
+    bool IsOpen ();
+
+    glm::uvec3 GetDimensions ();
+    glm::dvec3 GetScale ();
+    DataStorageSize GetDataStorageSize ();
+    int GetNumberOfTimesteps ();
+    // Bytes of the voxel array of a timestep
+    size_t GetFrameBytes ();
+    // Blocks of m_block_bytes of a timestep, the last one may be partial
+    size_t GetNumberOfFrameBlocks ();
+    // Bytes of all the timesteps as stored in the file
+    uint64_t GetStoredBytes ();
+
+    TimestepInfo& GetTimestepInfo (int timestep);
+    // Last key frame at or before timestep
+    int GetKeyFrame (int timestep);
+
+    // Decode timestep into frame (GetFrameBytes bytes). For a delta frame,
+    //   frame must hold the voxels of timestep - 1. Thread safe for different
+    //   frames.
+    bool DecodeTimestep (int timestep, unsigned char* frame);
+    // New volume with the voxels of timestep, decoded from its key frame
+    StructuredGridVolume* LoadTimestep (int timestep);
+
+  private:
+    std::string m_filepath;
+    PositionedFile m_file;
+
+    glm::uvec3 m_dimensions;
+    glm::dvec3 m_scale;
+    DataStorageSize m_data_storage_size;
+    uint32_t m_block_bytes;
+
+    std::vector<TimestepInfo> m_timesteps;
+  };
+}
+
+#endif
@@ -0,0 +1,411 @@
+#include "volumestatistics.h"
+#include "voxelformats.h"
+#include "voxellayout.h"
+#include "volumeview.h"
+
+#include <file_utils/sha256.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <type_traits>
+
+namespace vis
+{
+  // Moments of a range of voxels
+  struct ChunkMoments
+  {
+    size_t n;
+    double min_value;
+    double max_value;
+    double mean;
+    // sum of the squared deviations from the mean
+    double m2;
+  };
+
+  static const ChunkMoments EMPTY_MOMENTS = { 0, DBL_MAX, -DBL_MAX, 0.0, 0.0 };
+
+  static inline int GetHistogramBin (double normalized, int bins)
+  {
+    return std::max(0, std::min(bins - 1, (int)(normalized * bins)));
+  }
+
+  // Pairwise update of Chan, Golub and LeVeque
+  static void MergeMoments (ChunkMoments* a, const ChunkMoments& b)
+  {
+    if (b.n == 0) return;
+    if (a->n == 0)
+    {
+      *a = b;
+      return;
+    }
+    double n = double(a->n + b.n);
+    double delta = b.mean - a->mean;
+    a->mean += delta * double(b.n) / n;
+    a->m2 += b.m2 + delta * delta * double(a->n) * double(b.n) / n;
+    a->n += b.n;
+    a->min_value = std::min(a->min_value, b.min_value);
+    a->max_value = std::max(a->max_value, b.max_value);
+  }
+
+  // Moments of values(first) ... values(last - 1). The sums are shifted by
+  //   the first value, so the variance keeps its precision when the mean is
+  //   large compared to the spread.
+  template<typename Values>
+  static ChunkMoments ReduceMoments (const Values& values, size_t first, size_t last,
+                                     double inv_max_density, int bins, uint64_t* histogram)
+  {
+    ChunkMoments m = EMPTY_MOMENTS;
+    if (first >= last) return m;
+
+    double shift = values(first);
+    double s1 = 0.0, s2 = 0.0;
+    for (size_t i = first; i < last; i++)
+    {
+      double v = values(i);
+      m.min_value = std::min(m.min_value, v);
+      m.max_value = std::max(m.max_value, v);
+      double d = v - shift;
+      s1 += d;
+      s2 += d * d;
+      histogram[GetHistogramBin(v * inv_max_density, bins)]++;
+    }
+
+    m.n = last - first;
+    m.mean = shift + s1 / double(m.n);
+    m.m2 = std::max(0.0, s2 - s1 * s1 / double(m.n));
+    return m;
+  }
+
+  // Moments of the value counts of an integer volume
+  static ChunkMoments CountMoments (const std::vector<uint64_t>& counts)
+  {
+    ChunkMoments m = EMPTY_MOMENTS;
+    uint64_t sum = 0;
+    for (size_t v = 0; v < counts.size(); v++)
+    {
+      if (counts[v] == 0) continue;
+      m.n += counts[v];
+      sum += counts[v] * v;
+      m.min_value = std::min(m.min_value, double(v));
+      m.max_value = double(v);
+    }
+    if (m.n == 0) return m;
+
+    m.mean = double(sum) / double(m.n);
+    for (size_t v = 0; v < counts.size(); v++)
+    {
+      double d = double(v) - m.mean;
+      m.m2 += double(counts[v]) * d * d;
+    }
+    return m;
+  }
+
+  // First voxel that starts at or after byte
+  static size_t GetFirstVoxelAtByte (DataStorageSize dss, size_t byte)
+  {
+    if (dss == DataStorageSize::_12_BITS_PACKED)
+    {
+      // voxel 2k starts at byte 3k, voxel 2k + 1 at byte 3k + 1
+      size_t r = byte % 3;
+      return (byte / 3) * 2 + r;
+    }
+    size_t elem_size = GetStorageSizeBytes(dss);
+    return (byte + elem_size - 1) / elem_size;
+  }
+
+  // Hashes each chunk of the linear array and reduces its voxels
+  template<typename T>
+  static void ReduceChunks (const void* voxels, DataStorageSize dss, size_t n_voxels, size_t bytes,
+                            double max_density, int bins, unsigned char* digests,
+                            ChunkMoments* moments, std::vector<uint64_t>& histogram)
+  {
+    typedef typename VoxelTraits<T>::Storage Storage;
+    typedef typename VoxelTraits<T>::Value Value;
+    const bool count_values = std::is_integral<Value>::value;
+    const size_t n_values = size_t(VoxelTraits<T>::MAX_DENSITY) + 1;
+
+    const Storage* data = static_cast<const Storage*>(voxels);
+    const size_t chunk_size = SHA256::DEFAULT_CHUNK_SIZE;
+    const int n_chunks = (int)((bytes + chunk_size - 1) / chunk_size);
+    const double inv_max_density = 1.0 / max_density;
+
+    std::vector<uint64_t> counts(count_values ? n_values : 0, 0);
+
+#pragma omp parallel
+    {
+      std::vector<uint64_t> l_counts(counts.size(), 0);
+      std::vector<uint64_t> l_histogram(count_values ? 0 : bins, 0);
+
+#pragma omp for schedule(dynamic)
+      for (int c = 0; c < n_chunks; c++)
+      {
+        size_t begin = size_t(c) * chunk_size;
+        size_t end = std::min(begin + chunk_size, bytes);
+
+        SHA256 sha;
+        sha.Update(static_cast<const unsigned char*>(voxels) + begin, end - begin);
+        sha.Final(digests + size_t(c) * SHA256::DIGEST_SIZE);
+
+        size_t first = std::min(GetFirstVoxelAtByte(dss, begin), n_voxels);
+        size_t last = std::min(GetFirstVoxelAtByte(dss, end), n_voxels);
+        if (count_values)
+        {
+          for (size_t i = first; i < last; i++)
+            l_counts[size_t(VoxelTraits<T>::Load(data, i))]++;
+        }
+        else
+        {
+          moments[c] = ReduceMoments([&] (size_t i) { return double(VoxelTraits<T>::Load(data, i)); },
+                                     first, last, inv_max_density, bins, l_histogram.data());
+        }
+      }
+
+#pragma omp critical
+      {
+        for (size_t v = 0; v < l_counts.size(); v++) counts[v] += l_counts[v];
+        for (size_t b = 0; b < l_histogram.size(); b++) histogram[b] += l_histogram[b];
+      }
+    }
+
+    if (count_values)
+    {
+      moments[0] = CountMoments(counts);
+      for (int c = 1; c < n_chunks; c++) moments[c] = EMPTY_MOMENTS;
+      for (size_t v = 0; v < counts.size(); v++)
+        histogram[GetHistogramBin(double(v) * inv_max_density, bins)] += counts[v];
+    }
+  }
+
+  VolumeStatistics::VolumeStatistics ()
+  {
+    Clear();
+  }
+
+  bool VolumeStatistics::Compute (StructuredGridVolume* vol, int histogram_bins)
+  {
+    Clear();
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN || histogram_bins <= 0)
+      return false;
+
+    m_number_of_voxels = size_t(vol->GetWidth()) * size_t(vol->GetHeight()) * size_t(vol->GetDepth());
+    if (m_number_of_voxels == 0) return false;
+
+    m_max_density = vol->GetMaxDensity();
+    if (m_max_density <= 0.0) m_max_density = 1.0;
+    m_histogram.assign(histogram_bins, 0);
+
+    bool computed = vol->GetArrayData() ? ComputeFromArray(vol, vol->GetArrayData()) : ComputeFromSamples(vol);
+    if (!computed) Clear();
+    return computed;
+  }
+
+  bool VolumeStatistics::Compute (SparseGridVolume* vol, int histogram_bins)
+  {
+    Clear();
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN || histogram_bins <= 0)
+      return false;
+
+    m_number_of_voxels = vol->GetNumberOfActiveVoxels();
+    if (m_number_of_voxels == 0) return false;
+
+    m_max_density = vol->GetMaxDensity();
+    if (m_max_density <= 0.0) m_max_density = 1.0;
+    m_histogram.assign(histogram_bins, 0);
+
+    int bins = histogram_bins;
+    double inv_max_density = 1.0 / m_max_density;
+    int n_leaves = vol->GetNumberOfLeaves();
+    std::vector<ChunkMoments> moments(n_leaves, EMPTY_MOMENTS);
+
+    // one chunk per leaf, over the indices of its active voxels
+#pragma omp parallel
+    {
+      std::vector<uint64_t> l_histogram(bins, 0);
+      int active[SparseGridVolume::LEAF_VOXELS];
+
+#pragma omp for schedule(dynamic, 16)
+      for (int l = 0; l < n_leaves; l++)
+      {
+        SparseGridVolume::Leaf* leaf = vol->GetLeaf(l);
+        int n_active = 0;
+        for (int i = 0; i < SparseGridVolume::LEAF_VOXELS; i++)
+          if (leaf->IsActive(i)) active[n_active++] = i;
+        moments[l] = ReduceMoments([&] (size_t k) { return vol->GetLeafValue(leaf, active[k]); },
+                                   0, size_t(n_active), inv_max_density, bins, l_histogram.data());
+      }
+
+#pragma omp critical
+      {
+        for (int b = 0; b < bins; b++) m_histogram[b] += l_histogram[b];
+      }
+    }
+
+    ChunkMoments total = EMPTY_MOMENTS;
+    for (int l = 0; l < n_leaves; l++)
+      MergeMoments(&total, moments[l]);
+    vol->ForEachActiveTile([&] (glm::ivec3, const double* values) {
+      ChunkMoments tile = { size_t(SparseGridVolume::LEAF_VOXELS), values[0], values[0], values[0], 0.0 };
+      MergeMoments(&total, tile);
+      m_histogram[GetHistogramBin(values[0] * inv_max_density, bins)] += SparseGridVolume::LEAF_VOXELS;
+    });
+
+    m_min_value = total.min_value;
+    m_max_value = total.max_value;
+    m_mean = total.mean;
+    m_variance = total.m2 / double(total.n);
+    return true;
+  }
+
+  void VolumeStatistics::Clear ()
+  {
+    m_number_of_voxels = 0;
+    m_min_value = 0.0;
+    m_max_value = 0.0;
+    m_mean = 0.0;
+    m_variance = 0.0;
+    m_max_density = 1.0;
+    m_histogram.clear();
+    m_content_hash.clear();
+  }
+
+  bool VolumeStatistics::IsValid () const
+  {
+    return m_number_of_voxels > 0;
+  }
+
+  size_t VolumeStatistics::GetNumberOfVoxels () const
+  {
+    return m_number_of_voxels;
+  }
+
+  double VolumeStatistics::GetMin () const
+  {
+    return m_min_value;
+  }
+
+  double VolumeStatistics::GetMax () const
+  {
+    return m_max_value;
+  }
+
+  double VolumeStatistics::GetMean () const
+  {
+    return m_mean;
+  }
+
+  double VolumeStatistics::GetVariance () const
+  {
+    return m_variance;
+  }
+
+  double VolumeStatistics::GetStandardDeviation () const
+  {
+    return std::sqrt(m_variance);
+  }
+
+  double VolumeStatistics::GetMaxDensity () const
+  {
+    return m_max_density;
+  }
+
+  int VolumeStatistics::GetHistogramBins () const
+  {
+    return (int)m_histogram.size();
+  }
+
+  const std::vector<uint64_t>& VolumeStatistics::GetHistogram () const
+  {
+    return m_histogram;
+  }
+
+  std::string VolumeStatistics::GetContentHash () const
+  {
+    return m_content_hash;
+  }
+
+  bool VolumeStatistics::ComputeFromArray (StructuredGridVolume* vol, const void* voxels)
+  {
+    DataStorageSize dss = vol->GetDataStorageSize();
+    unsigned int w = vol->GetWidth(), h = vol->GetHeight(), d = vol->GetDepth();
+
+    // the hash is defined on the linear order
+    void* linear_voxels = nullptr;
+    if (vol->GetVoxelLayoutTable())
+    {
+      VoxelLayoutTable linear(VoxelLayout::LINEAR, w, h, d);
+      linear_voxels = ConvertVoxelLayout(voxels, dss, *vol->GetVoxelLayoutTable(), linear);
+      if (!linear_voxels) return false;
+      voxels = linear_voxels;
+    }
+
+    size_t bytes = GetStorageArrayBytes(dss, m_number_of_voxels);
+    size_t n_chunks = (bytes + SHA256::DEFAULT_CHUNK_SIZE - 1) / SHA256::DEFAULT_CHUNK_SIZE;
+    std::vector<unsigned char> digests(n_chunks * SHA256::DIGEST_SIZE);
+    std::vector<ChunkMoments> moments(n_chunks, EMPTY_MOMENTS);
+
+    DispatchVoxelType(dss, [&] (auto t) {
+      ReduceChunks<decltype(t)>(voxels, dss, m_number_of_voxels, bytes, m_max_density, GetHistogramBins(),
+                                digests.data(), moments.data(), m_histogram);
+    });
+
+    if (linear_voxels)
+      DeleteVoxelArray(linear_voxels, dss);
+
+    ChunkMoments total = EMPTY_MOMENTS;
+    for (size_t c = 0; c < n_chunks; c++)
+      MergeMoments(&total, moments[c]);
+
+    m_min_value = total.min_value;
+    m_max_value = total.max_value;
+    m_mean = total.mean;
+    m_variance = total.n > 0 ? total.m2 / double(total.n) : 0.0;
+
+    SHA256 sha;
+    sha.Update(std::to_string(w) + "x" + std::to_string(h) + "x" + std::to_string(d)
+               + ":" + std::to_string((unsigned int)dss) + ":");
+    sha.Update(SHA256::CombineChunkDigests(digests.data(), n_chunks, bytes));
+    m_content_hash = sha.FinalHex();
+    return true;
+  }
+
+  bool VolumeStatistics::ComputeFromSamples (StructuredGridVolume* vol)
+  {
+    int d = (int)vol->GetDepth();
+    int bins = GetHistogramBins();
+    double inv_max_density = 1.0 / m_max_density;
+    std::vector<ChunkMoments> moments(d, EMPTY_MOMENTS);
+
+    // one chunk per slice
+    bool computed = DispatchVolumeView(vol, [&] (const auto& view) {
+      int w = view.GetWidth(), h = view.GetHeight();
+#pragma omp parallel
+      {
+        std::vector<uint64_t> l_histogram(bins, 0);
+
+#pragma omp for schedule(dynamic)
+        for (int z = 0; z < d; z++)
+        {
+          moments[z] = ReduceMoments([&] (size_t i) { return view.GetAbsolute(int(i % w), int(i / w), z); },
+                                     0, size_t(w) * size_t(h), inv_max_density, bins, l_histogram.data());
+        }
+
+#pragma omp critical
+        {
+          for (int b = 0; b < bins; b++) m_histogram[b] += l_histogram[b];
+        }
+      }
+    });
+    if (!computed) return false;
+
+    ChunkMoments total = EMPTY_MOMENTS;
+    for (int z = 0; z < d; z++)
+      MergeMoments(&total, moments[z]);
+
+    m_min_value = total.min_value;
+    m_max_value = total.max_value;
+    m_mean = total.mean;
+    m_variance = total.n > 0 ? total.m2 / double(total.n) : 0.0;
+    return true;
+  }
+}
@@ -0,0 +1,86 @@
+/**
+ * volumestatistics.h
+ *
+ * Value range, mean, variance, histogram and content hash of the voxels of
+ *   a StructuredGridVolume, computed together in one multi-threaded pass
+ *   over the voxel array. StructuredGridVolume::GetStatistics caches them.
+ *
+ * The array is walked in linear order, in chunks of
+ *   SHA256::DEFAULT_CHUNK_SIZE bytes. Each thread hashes a chunk and reduces
+ *   its voxels while they are still in cache:
+ *
+ * . integer types (8, 12, 16 bits): the occurrences of each value are
+ *   counted, the range, moments and histogram follow exactly from the counts
+ * . float types: min, max, mean and sum of squared deviations of each chunk,
+ *   merged in chunk order with the pairwise update of Chan et al., so the
+ *   results do not depend on the number of threads
+ *
+ * The content hash is the one of StructuredGridVolume::GetContentHash.
+ *   Volumes without voxel array (out-of-core) go through the sample
+ *   accessors and have no content hash.
+ *
+ * For a SparseGridVolume only the active voxels are reduced, leaf by leaf,
+ *   and each tile counts as 8^3 voxels of its value (no content hash).
+ *
+ * Range, mean and variance are absolute values, divide them by
+ *   GetMaxDensity to normalize them. The histogram bins split the normalized
+ *   range [0, 1].
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_STATISTICS_H
+#define VOL_VIS_UTILS_VOLUME_STATISTICS_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/sparsegridvolume.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vis
+{
+  class VolumeStatistics
+  {
+  public:
+    static const int DEFAULT_HISTOGRAM_BINS = 256;
+
+    VolumeStatistics ();
+
+    bool Compute (StructuredGridVolume* vol, int histogram_bins = DEFAULT_HISTOGRAM_BINS);
+    // Active voxels of component 0
+    bool Compute (SparseGridVolume* vol, int histogram_bins = DEFAULT_HISTOGRAM_BINS);
+    void Clear ();
+    bool IsValid () const;
+
+    size_t GetNumberOfVoxels () const;
+    double GetMin () const;
+    double GetMax () const;
+    double GetMean () const;
+    double GetVariance () const;
+    double GetStandardDeviation () const;
+    // Divisor of the normalized values, see StructuredGridVolume::GetMaxDensity
+    double GetMaxDensity () const;
+
+    int GetHistogramBins () const;
+    const std::vector<uint64_t>& GetHistogram () const;
+
+    // Empty for volumes without voxel array
+    std::string GetContentHash () const;
+
+  protected:
+    bool ComputeFromArray (StructuredGridVolume* vol, const void* voxels);
+    bool ComputeFromSamples (StructuredGridVolume* vol);
+
+  private:
+    size_t m_number_of_voxels;
+    double m_min_value;
+    double m_max_value;
+    double m_mean;
+    double m_variance;
+    double m_max_density;
+
+    std::vector<uint64_t> m_histogram;
+    std::string m_content_hash;
+  };
+}
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * volumeview.h
+ *
+ * Typed read-only views of the voxels of a StructuredGridVolume.
+ *
+ * StructuredGridVolume::GetNormalizedSample checks the array, the bounds
+ *   and the storage type on every call. Preprocessing kernels instead take a
+ *   view as a template parameter and are dispatched once per volume:
+ *
+ *   DispatchVolumeView(vol, [&] (const auto& view) {
+ *     for (...) out[i] = view.GetNormalized(x, y, z);
+ *   });
+ *
+ * . VolumeView<T, I>   : voxel array of type T (unsigned char, unsigned short,
+ *                        float, double, or the HalfVoxel/Packed12Voxel tags
+ *                        of voxelformats.h) in the voxel layout of indexer I
+ *                        (voxellayout.h). GetNormalized/GetAbsolute do not
+ *                        check the bounds and inline to a load (and a decode
+ *                        for the compact types) and a division.
+ * . SampledVolumeView  : volumes without voxel array (out-of-core), goes
+ *                        through the virtual sample accessors.
+ *
+ * Both return the same values as GetNormalizedSample/GetAbsoluteSample, and
+ *   *OrZero variants return 0 outside the volume like them (outside the ghost
+ *   voxels for padded arrays, see ghostpaddedvolume.h).
+**/
+#ifndef VOL_VIS_UTILS_VOLUME_VIEW_H
+#define VOL_VIS_UTILS_VOLUME_VIEW_H
+
+#include <volvis_utils/structuredgridvolume.h>
+#include <volvis_utils/voxellayout.h>
+#include <volvis_utils/voxelformats.h>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace vis
+{
+  template<typename T, typename Indexer = LinearVoxelIndexer>
+  class VolumeView
+  {
+  public:
+    typedef typename VoxelTraits<T>::Storage StorageType;
+    typedef typename VoxelTraits<T>::Value ValueType;
+
+    // Divisor of GetNormalized: 255 (8 bits), 4095 (12 bits), 65535 (16 bits),
+    //   1 (float, double, half)
+    static constexpr double MAX_DENSITY = VoxelTraits<T>::MAX_DENSITY;
+
+    // Linear layout
+    VolumeView (const StorageType* data, int width, int height, int depth)
+      : m_data(data), m_width(width), m_height(height), m_depth(depth)
+      , m_ghost_width(0), m_indexer(width, height, depth)
+    {}
+
+    // ghost_width: voxels of the array around the volume, that can be read
+    //   without checks (see ghostpaddedvolume.h)
+    VolumeView (const StorageType* data, int width, int height, int depth, Indexer indexer, int ghost_width = 0)
+      : m_data(data), m_width(width), m_height(height), m_depth(depth)
+      , m_ghost_width(ghost_width), m_indexer(indexer)
+    {}
+
+    int GetWidth () const { return m_width; }
+    int GetHeight () const { return m_height; }
+    int GetDepth () const { return m_depth; }
+    int GetGhostWidth () const { return m_ghost_width; }
+    double GetMaxDensity () const { return MAX_DENSITY; }
+    const StorageType* GetData () const { return m_data; }
+
+    bool IsInside (int x, int y, int z) const
+    {
+      return x >= 0 && y >= 0 && z >= 0 && x < m_width && y < m_height && z < m_depth;
+    }
+
+    // Inside the volume or its ghost voxels
+    bool IsStored (int x, int y, int z) const
+    {
+      int g = m_ghost_width;
+      return x >= -g && y >= -g && z >= -g && x < m_width + g && y < m_height + g && z < m_depth + g;
+    }
+
+    // Position of (x, y, z) in the voxel array
+    size_t GetIndex (int x, int y, int z) const
+    {
+      return m_indexer.GetIndex(x, y, z);
+    }
+
+    // Unchecked: (x, y, z) must be inside the volume or its ghost voxels
+    ValueType Get (int x, int y, int z) const
+    {
+      return VoxelTraits<T>::Load(m_data, GetIndex(x, y, z));
+    }
+
+    double GetAbsolute (int x, int y, int z) const
+    {
+      return (double)Get(x, y, z);
+    }
+
+    double GetNormalized (int x, int y, int z) const
+    {
+      return (double)Get(x, y, z) / MAX_DENSITY;
+    }
+
+    double GetNormalizedOrZero (int x, int y, int z) const
+    {
+      return IsStored(x, y, z) ? GetNormalized(x, y, z) : 0.0;
+    }
+
+    double GetAbsoluteOrZero (int x, int y, int z) const
+    {
+      return IsStored(x, y, z) ? GetAbsolute(x, y, z) : 0.0;
+    }
+
+  private:
+    const StorageType* m_data;
+    int m_width, m_height, m_depth;
+    int m_ghost_width;
+    Indexer m_indexer;
+  };
+
+  class SampledVolumeView
+  {
+  public:
+    SampledVolumeView (StructuredGridVolume* vol)
+      : m_volume(vol)
+      , m_width((int)vol->GetWidth()), m_height((int)vol->GetHeight()), m_depth((int)vol->GetDepth())
+      , m_max_density(vol->GetMaxDensity())
+    {}
+
+    int GetWidth () const { return m_width; }
+    int GetHeight () const { return m_height; }
+    int GetDepth () const { return m_depth; }
+    int GetGhostWidth () const { return 0; }
+    double GetMaxDensity () const { return m_max_density; }
+
+    bool IsInside (int x, int y, int z) const
+    {
+      return x >= 0 && y >= 0 && z >= 0 && x < m_width && y < m_height && z < m_depth;
+    }
+
+    double Get (int x, int y, int z) const { return m_volume->GetAbsoluteSample(x, y, z); }
+    double GetAbsolute (int x, int y, int z) const { return m_volume->GetAbsoluteSample(x, y, z); }
+    double GetNormalized (int x, int y, int z) const { return m_volume->GetNormalizedSample(x, y, z); }
+    double GetNormalizedOrZero (int x, int y, int z) const { return m_volume->GetNormalizedSample(x, y, z); }
+    double GetAbsoluteOrZero (int x, int y, int z) const { return m_volume->GetAbsoluteSample(x, y, z); }
+
+  private:
+    StructuredGridVolume* m_volume;
+    int m_width, m_height, m_depth;
+    double m_max_density;
+  };
+
+  // GetNormalizedOrZero if CHECKED, GetNormalized otherwise
+  template<bool CHECKED, typename View>
+  inline double GetViewNormalizedSample (const View& view, int x, int y, int z)
+  {
+    return CHECKED ? view.GetNormalizedOrZero(x, y, z) : view.GetNormalized(x, y, z);
+  }
+
+  // Range [x_begin, x_end) of the row (y, z) whose neighbours up to radius
+  //   along every axis are inside the view or its ghost voxels, where
+  //   unchecked access is safe. Empty (x_begin = x_end = width) if y or z are
+  //   too close to the border, the whole row if the ghost width >= radius.
+  template<typename View>
+  inline void GetInteriorRowRange (const View& view, int y, int z, int radius, int* x_begin, int* x_end)
+  {
+    radius = std::max(radius - view.GetGhostWidth(), 0);
+    int w = view.GetWidth();
+    if (y - radius < 0 || y + radius >= view.GetHeight() || z - radius < 0 || z + radius >= view.GetDepth())
+    {
+      *x_begin = *x_end = w;
+      return;
+    }
+    *x_begin = std::min(radius, w);
+    *x_end = std::max(*x_begin, w - radius);
+  }
+
+  template<typename T, typename Kernel>
+  void DispatchVolumeViewLayout (const void* voxels, int w, int h, int d, const VoxelLayoutTable* table, Kernel& kernel)
+  {
+    const typename VoxelTraits<T>::Storage* data = static_cast<const typename VoxelTraits<T>::Storage*>(voxels);
+    if (table)
+      kernel(VolumeView<T, TableVoxelIndexer>(data, w, h, d, TableVoxelIndexer(table)));
+    else
+      kernel(VolumeView<T>(data, w, h, d));
+  }
+
+  // Calls kernel (const View&) once, with the VolumeView<T, I> matching the
+  //   storage and the voxel layout of vol, or with a SampledVolumeView if vol
+  //   has no voxel array. Returns false if vol has no data at all.
+  template<typename Kernel>
+  bool DispatchVolumeView (StructuredGridVolume* vol, Kernel&& kernel)
+  {
+    if (!vol || vol->GetDataStorageSize() == DataStorageSize::UNKNOWN) return false;
+
+    const void* data = vol->GetArrayData();
+    int w = (int)vol->GetWidth(), h = (int)vol->GetHeight(), d = (int)vol->GetDepth();
+    if (!data)
+    {
+      kernel(SampledVolumeView(vol));
+      return true;
+    }
+
+    const VoxelLayoutTable* table = vol->GetVoxelLayoutTable();
+    return DispatchVoxelType(vol->GetDataStorageSize(), [&] (auto t) {
+      DispatchVolumeViewLayout<decltype(t)>(data, w, h, d, table, kernel);
+    });
+  }
+}
+
+#endif
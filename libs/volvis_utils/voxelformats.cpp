@@ -0,0 +1,70 @@
+#include "voxelformats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vis
+{
+  // Voxels converted per block, even so the pairs of packed voxels are never
+  //   split between threads
+  static const int CONVERSION_BLOCK_SIZE = 4096;
+
+  template<typename S, typename D>
+  static void ConvertVoxels (const typename VoxelTraits<S>::Storage* src, typename VoxelTraits<D>::Storage* dst,
+                             size_t n_voxels)
+  {
+    typedef typename VoxelTraits<D>::Value DValue;
+    const bool integer_src = std::is_integral<typename VoxelTraits<S>::Value>::value;
+    const bool integer_dst = std::is_integral<DValue>::value;
+
+    // absolute values between integer types, normalized values otherwise
+    const double scale = integer_src && integer_dst ? 1.0 : VoxelTraits<D>::MAX_DENSITY / VoxelTraits<S>::MAX_DENSITY;
+    const double max_value = VoxelTraits<D>::MAX_DENSITY;
+
+    int n_blocks = (int)((n_voxels + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE);
+#pragma omp parallel for
+    for (int b = 0; b < n_blocks; b++)
+    {
+      size_t first = size_t(b) * CONVERSION_BLOCK_SIZE;
+      size_t last = std::min(first + CONVERSION_BLOCK_SIZE, n_voxels);
+      for (size_t i = first; i < last; i++)
+      {
+        double v = double(VoxelTraits<S>::Load(src, i)) * scale;
+        if (integer_dst)
+          v = v > 0.0 ? std::min(std::floor(v + 0.5), max_value) : 0.0;
+        VoxelTraits<D>::Store(dst, i, DValue(v));
+      }
+    }
+  }
+
+  void* ConvertVoxelStorage (const void* src, DataStorageSize src_dss, DataStorageSize dst_dss, size_t n_voxels)
+  {
+    if (!src) return nullptr;
+
+    void* dst = AllocateVoxelArray(dst_dss, n_voxels);
+    if (!dst) return nullptr;
+
+    bool converted = DispatchVoxelType(src_dss, [&] (auto s) {
+      typedef decltype(s) S;
+      DispatchVoxelType(dst_dss, [&] (auto d) {
+        typedef decltype(d) D;
+        ConvertVoxels<S, D>(static_cast<const typename VoxelTraits<S>::Storage*>(src),
+                            static_cast<typename VoxelTraits<D>::Storage*>(dst), n_voxels);
+      });
+    });
+
+    if (!converted)
+    {
+      DeleteVoxelArray(dst, dst_dss);
+      return nullptr;
+    }
+    return dst;
+  }
+
+  bool FitsInPacked12Bits (const unsigned short* voxels, size_t n_voxels)
+  {
+    for (size_t i = 0; i < n_voxels; i++)
+      if (voxels[i] > 4095) return false;
+    return true;
+  }
+}
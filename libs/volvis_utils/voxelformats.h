@@ -0,0 +1,198 @@
+/**
+ * voxelformats.h
+ *
+ * Compact voxel storage types and the conversions between storage types.
+ *
+ * . _HALF_F         : IEEE 754 binary16 in an unsigned short, normalized
+ *                     [0, 1] like _NORMALIZED_F. 11 significant bits, half
+ *                     the memory of float volumes.
+ * . _12_BITS_PACKED : unsigned [0 - 4095], normalized by 4095. Voxels 2i and
+ *                     2i+1 share bytes 3i to 3i+2:
+ *
+ *                     byte 3i   : bits 0-7  of voxel 2i
+ *                     byte 3i+1 : bits 8-11 of voxel 2i (low nibble),
+ *                                 bits 0-3  of voxel 2i+1 (high nibble)
+ *                     byte 3i+2 : bits 4-11 of voxel 2i+1
+ *
+ *                     CT scanners store 12-bit values in 16-bit containers,
+ *                     packing them saves 25% of the memory and bandwidth.
+ *
+ * Voxels are addressed by element index, as the other types, so voxel
+ *   layouts and views work the same on packed arrays. Two voxels of a pair
+ *   must not be written by different threads.
+ *
+ * VoxelTraits<T> describes the voxel types used by the views (volumeview.h):
+ *   T is the element type for the plain types, and the tags HalfVoxel and
+ *   Packed12Voxel for the compact ones.
+**/
+#ifndef VOL_VIS_UTILS_VOXEL_FORMATS_H
+#define VOL_VIS_UTILS_VOXEL_FORMATS_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace vis
+{
+  // Round to nearest even, values above the half range become infinity
+  inline unsigned short FloatToHalf (float f)
+  {
+    unsigned int x;
+    std::memcpy(&x, &f, sizeof(x));
+    unsigned short sign = (unsigned short)((x >> 16) & 0x8000);
+    unsigned int absx = x & 0x7FFFFFFF;
+
+    // infinity and nan
+    if (absx >= 0x7F800000)
+      return sign | 0x7C00 | (absx > 0x7F800000 ? 0x0200 : 0);
+    // rounds to 65520 or more
+    if (absx >= 0x477FF000)
+      return sign | 0x7C00;
+    // subnormal half, below 2^-14
+    if (absx < 0x38800000)
+    {
+      // below 2^-25 (and 2^-25, tie to even) rounds to zero
+      if (absx <= 0x33000000) return sign;
+      unsigned int mantissa = (absx & 0x007FFFFF) | 0x00800000;
+      int shift = 126 - int(absx >> 23);
+      unsigned int h = mantissa >> shift;
+      unsigned int rem = mantissa & ((1u << shift) - 1);
+      unsigned int halfway = 1u << (shift - 1);
+      if (rem > halfway || (rem == halfway && (h & 1))) h++;
+      return sign | (unsigned short)h;
+    }
+    // normal half: rebias the exponent from 127 to 15, a carry of the
+    //   rounding into the exponent is still the right encoding
+    unsigned int h = (absx - 0x38000000) >> 13;
+    unsigned int rem = absx & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return sign | (unsigned short)h;
+  }
+
+  inline float HalfToFloat (unsigned short h)
+  {
+    unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+    unsigned int exponent = (h >> 10) & 0x1F;
+    unsigned int mantissa = h & 0x03FF;
+
+    unsigned int x;
+    if (exponent == 0x1F)
+      x = sign | 0x7F800000 | (mantissa << 13);
+    else if (exponent != 0)
+      x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+      x = sign;
+    else
+    {
+      // subnormal half, normal float
+      exponent = 113;
+      while (!(mantissa & 0x0400))
+      {
+        mantissa <<= 1;
+        exponent--;
+      }
+      x = sign | (exponent << 23) | ((mantissa & 0x03FF) << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+
+  inline unsigned short GetPacked12 (const unsigned char* data, size_t i)
+  {
+    const unsigned char* p = data + (i >> 1) * 3;
+    if (i & 1)
+      return (unsigned short)((p[1] >> 4) | (p[2] << 4));
+    return (unsigned short)(p[0] | ((p[1] & 0x0F) << 8));
+  }
+
+  // value must be <= 4095
+  inline void SetPacked12 (unsigned char* data, size_t i, unsigned short value)
+  {
+    unsigned char* p = data + (i >> 1) * 3;
+    if (i & 1)
+    {
+      p[1] = (unsigned char)((p[1] & 0x0F) | ((value & 0x0F) << 4));
+      p[2] = (unsigned char)(value >> 4);
+    }
+    else
+    {
+      p[0] = (unsigned char)(value & 0xFF);
+      p[1] = (unsigned char)((p[1] & 0xF0) | (value >> 8));
+    }
+  }
+
+  struct HalfVoxel {};
+  struct Packed12Voxel {};
+
+  // Storage: element of the voxel array
+  // Value  : decoded voxel, absolute value
+  // MAX_DENSITY: divisor of the normalized value
+  template<typename T>
+  struct VoxelTraits
+  {
+    typedef T Storage;
+    typedef T Value;
+    static constexpr double MAX_DENSITY = std::is_floating_point<T>::value ? 1.0
+                                        : double(std::numeric_limits<T>::max());
+
+    static Value Load (const Storage* data, size_t i) { return data[i]; }
+    static void Store (Storage* data, size_t i, Value value) { data[i] = value; }
+  };
+
+  template<>
+  struct VoxelTraits<HalfVoxel>
+  {
+    typedef unsigned short Storage;
+    typedef float Value;
+    static constexpr double MAX_DENSITY = 1.0;
+
+    static Value Load (const Storage* data, size_t i) { return HalfToFloat(data[i]); }
+    static void Store (Storage* data, size_t i, Value value) { data[i] = FloatToHalf(value); }
+  };
+
+  template<>
+  struct VoxelTraits<Packed12Voxel>
+  {
+    typedef unsigned char Storage;
+    typedef unsigned short Value;
+    static constexpr double MAX_DENSITY = 4095.0;
+
+    static Value Load (const Storage* data, size_t i) { return GetPacked12(data, i); }
+    static void Store (Storage* data, size_t i, Value value) { SetPacked12(data, i, value); }
+  };
+
+  // Calls function (T()) with the voxel type T of dss, see VoxelTraits.
+  //   Returns false for UNKNOWN.
+  template<typename Function>
+  bool DispatchVoxelType (DataStorageSize dss, Function&& function)
+  {
+    switch (dss)
+    {
+    case DataStorageSize::_8_BITS:         function((unsigned char)0);  return true;
+    case DataStorageSize::_16_BITS:        function((unsigned short)0); return true;
+    case DataStorageSize::_NORMALIZED_F:   function(0.0f);              return true;
+    case DataStorageSize::_NORMALIZED_D:   function(0.0);               return true;
+    case DataStorageSize::_HALF_F:         function(HalfVoxel());       return true;
+    case DataStorageSize::_12_BITS_PACKED: function(Packed12Voxel());   return true;
+    default:                               return false;
+    }
+  }
+
+  // New voxel array (new[]) with the n_voxels voxels of src converted from
+  //   src_dss to dst_dss:
+  // . between integer types (8, 12 and 16 bits) the absolute values are
+  //   kept, clamped to the range of dst_dss
+  // . from or to normalized types (float, double, half) the normalized
+  //   values are kept, rounded to the nearest integer value
+  void* ConvertVoxelStorage (const void* src, DataStorageSize src_dss, DataStorageSize dst_dss, size_t n_voxels);
+
+  // True if every value of the 16-bit array fits in 12 bits
+  bool FitsInPacked12Bits (const unsigned short* voxels, size_t n_voxels);
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "voxellayout.h"
+#include "voxelformats.h"
+
+namespace vis
+{
+  const char* GetVoxelLayoutName (VoxelLayout layout)
+  {
+    switch (layout)
+    {
+    case VoxelLayout::LINEAR:
+      return "Linear";
+    case VoxelLayout::BRICKS_8:
+      return "Bricks 8x8x8";
+    case VoxelLayout::BRICKS_16:
+      return "Bricks 16x16x16";
+    case VoxelLayout::MORTON:
+      return "Morton";
+    default:
+      return "Unknown";
+    }
+  }
+
+  VoxelLayoutTable::VoxelLayoutTable (VoxelLayout layout, unsigned int width, unsigned int height, unsigned int depth)
+    : m_layout(layout)
+    , m_dimensions(width, height, depth)
+    , m_storage_size(0)
+    , m_offset_x(width)
+    , m_offset_y(height)
+    , m_offset_z(depth)
+  {
+    if (layout == VoxelLayout::BRICKS_8)
+    {
+      BuildBricks(8);
+    }
+    else if (layout == VoxelLayout::BRICKS_16)
+    {
+      BuildBricks(16);
+    }
+    else if (layout == VoxelLayout::MORTON)
+    {
+      BuildMorton();
+    }
+    else
+    {
+      m_layout = VoxelLayout::LINEAR;
+      for (unsigned int x = 0; x < width; x++)  m_offset_x[x] = size_t(x);
+      for (unsigned int y = 0; y < height; y++) m_offset_y[y] = size_t(y) * width;
+      for (unsigned int z = 0; z < depth; z++)  m_offset_z[z] = size_t(z) * width * height;
+      m_storage_size = size_t(width) * height * depth;
+    }
+  }
+
+  void VoxelLayoutTable::BuildBricks (unsigned int brick_size)
+  {
+    size_t bs = brick_size;
+    size_t brick_voxels = bs * bs * bs;
+    glm::uvec3 nb = (m_dimensions + glm::uvec3(brick_size - 1)) / brick_size;
+
+    for (unsigned int x = 0; x < m_dimensions.x; x++)
+      m_offset_x[x] = (x / bs) * brick_voxels + (x % bs);
+    for (unsigned int y = 0; y < m_dimensions.y; y++)
+      m_offset_y[y] = (y / bs) * nb.x * brick_voxels + (y % bs) * bs;
+    for (unsigned int z = 0; z < m_dimensions.z; z++)
+      m_offset_z[z] = (z / bs) * nb.x * nb.y * brick_voxels + (z % bs) * bs * bs;
+
+    m_storage_size = size_t(nb.x) * nb.y * nb.z * brick_voxels;
+  }
+
+  void VoxelLayoutTable::BuildMorton ()
+  {
+    // bits needed by each axis, each dimension is padded to a power of two
+    int bits[3] = { 0, 0, 0 };
+    for (int a = 0; a < 3; a++)
+      while ((1u << bits[a]) < m_dimensions[a]) bits[a]++;
+
+    // bit b of each axis goes to the next free bit of the index, x first,
+    //   axes with less bits are skipped once they run out
+    int position[3][32];
+    int next_bit = 0;
+    for (int b = 0; b < 32; b++)
+      for (int a = 0; a < 3; a++)
+        if (b < bits[a]) position[a][b] = next_bit++;
+
+    std::vector<size_t>* offsets[3] = { &m_offset_x, &m_offset_y, &m_offset_z };
+    for (int a = 0; a < 3; a++)
+    {
+      for (unsigned int v = 0; v < m_dimensions[a]; v++)
+      {
+        size_t offset = 0;
+        for (int b = 0; b < bits[a]; b++)
+          if ((v >> b) & 1u) offset |= size_t(1) << position[a][b];
+        (*offsets[a])[v] = offset;
+      }
+    }
+
+    m_storage_size = size_t(1) << next_bit;
+  }
+
+  template<typename T>
+  static void ReorderVoxels (const T* src_voxels, T* dst_voxels, const VoxelLayoutTable& src, const VoxelLayoutTable& dst)
+  {
+    glm::uvec3 dim = src.GetDimensions();
+
+#pragma omp parallel for
+    for (int z = 0; z < (int)dim.z; z++)
+      for (int y = 0; y < (int)dim.y; y++)
+        for (int x = 0; x < (int)dim.x; x++)
+          dst_voxels[dst.GetIndex(x, y, z)] = src_voxels[src.GetIndex(x, y, z)];
+  }
+
+  void* ConvertVoxelLayout (const void* src_voxels, DataStorageSize dss,
+                            const VoxelLayoutTable& src, const VoxelLayoutTable& dst)
+  {
+    if (!src_voxels || src.GetDimensions() != dst.GetDimensions()) return nullptr;
+
+    // the voxels of a packed pair may go to different threads, reorder them
+    //   as 16-bit values and pack the result
+    if (dss == DataStorageSize::_12_BITS_PACKED)
+    {
+      void* src_16 = ConvertVoxelStorage(src_voxels, dss, DataStorageSize::_16_BITS, src.GetStorageSize());
+      void* dst_16 = ConvertVoxelLayout(src_16, DataStorageSize::_16_BITS, src, dst);
+      void* dst_voxels = ConvertVoxelStorage(dst_16, DataStorageSize::_16_BITS, dss, dst.GetStorageSize());
+      DeleteVoxelArray(src_16, DataStorageSize::_16_BITS);
+      DeleteVoxelArray(dst_16, DataStorageSize::_16_BITS);
+      return dst_voxels;
+    }
+
+    void* dst_voxels = AllocateVoxelArray(dss, dst.GetStorageSize());
+    if (!dst_voxels) return nullptr;
+
+    if (dss == DataStorageSize::_8_BITS)
+      ReorderVoxels(static_cast<const unsigned char*>(src_voxels), static_cast<unsigned char*>(dst_voxels), src, dst);
+    else if (dss == DataStorageSize::_16_BITS)
+      ReorderVoxels(static_cast<const unsigned short*>(src_voxels), static_cast<unsigned short*>(dst_voxels), src, dst);
+    else if (dss == DataStorageSize::_NORMALIZED_F)
+      ReorderVoxels(static_cast<const float*>(src_voxels), static_cast<float*>(dst_voxels), src, dst);
+    else if (dss == DataStorageSize::_NORMALIZED_D)
+      ReorderVoxels(static_cast<const double*>(src_voxels), static_cast<double*>(dst_voxels), src, dst);
+    else if (dss == DataStorageSize::_HALF_F)
+      ReorderVoxels(static_cast<const unsigned short*>(src_voxels), static_cast<unsigned short*>(dst_voxels), src, dst);
+
+    return dst_voxels;
+  }
+}
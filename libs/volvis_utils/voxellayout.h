@@ -0,0 +1,143 @@
+/**
+ * voxellayout.h
+ *
+ * In-memory order of the voxels of a StructuredGridVolume.
+ *
+ * . LINEAR    : x fastest, then y, then z (layout of the files and textures)
+ * . BRICKS_8  : 8x8x8 bricks, stored one after the other (x fastest inside
+ *               each brick and between bricks)
+ * . BRICKS_16 : same with 16x16x16 bricks
+ * . MORTON    : Z-order curve, the bits of x, y and z are interleaved
+ *
+ * With the linear layout, the z neighbours of a voxel are width*height
+ *   elements apart, so 3D stencils keep many slices in cache. Bricked and
+ *   Morton layouts keep the neighbourhood of a voxel within a few cache lines.
+ *
+ * Every layout index is separable, index(x, y, z) = X[x] + Y[y] + Z[z], so a
+ *   VoxelLayoutTable only stores one offset table per axis. Bricked and Morton
+ *   arrays are padded to whole bricks and to powers of two respectively,
+ *   padding voxels are zero.
+**/
+#ifndef VOL_VIS_UTILS_VOXEL_LAYOUT_H
+#define VOL_VIS_UTILS_VOXEL_LAYOUT_H
+
+#include <volvis_utils/structuredgridvolume.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace vis
+{
+  enum VoxelLayout : unsigned int
+  {
+    LINEAR    = 0,
+    BRICKS_8  = 1,
+    BRICKS_16 = 2,
+    MORTON    = 3,
+  };
+
+  static const int NUMBER_OF_VOXEL_LAYOUTS = 4;
+
+  const char* GetVoxelLayoutName (VoxelLayout layout);
+
+  class VoxelLayoutTable
+  {
+  public:
+    VoxelLayoutTable (VoxelLayout layout, unsigned int width, unsigned int height, unsigned int depth);
+
+    VoxelLayout GetLayout () const { return m_layout; }
+    glm::uvec3 GetDimensions () const { return m_dimensions; }
+
+    // Number of elements of the voxel array, padding included
+    size_t GetStorageSize () const { return m_storage_size; }
+
+    // (x, y, z) must be inside the volume
+    size_t GetIndex (int x, int y, int z) const
+    {
+      return m_offset_x[x] + m_offset_y[y] + m_offset_z[z];
+    }
+
+    const size_t* GetOffsetsX () const { return m_offset_x.data(); }
+    const size_t* GetOffsetsY () const { return m_offset_y.data(); }
+    const size_t* GetOffsetsZ () const { return m_offset_z.data(); }
+
+  protected:
+    void BuildBricks (unsigned int brick_size);
+    void BuildMorton ();
+
+  private:
+    VoxelLayout m_layout;
+    glm::uvec3 m_dimensions;
+    size_t m_storage_size;
+
+    std::vector<size_t> m_offset_x;
+    std::vector<size_t> m_offset_y;
+    std::vector<size_t> m_offset_z;
+  };
+
+  // Index math of the views (volumeview.h)
+  class LinearVoxelIndexer
+  {
+  public:
+    LinearVoxelIndexer (int width, int height, int /*depth*/)
+      : m_width(size_t(width)), m_slice_size(size_t(width) * size_t(height))
+    {}
+
+    size_t GetIndex (int x, int y, int z) const
+    {
+      return size_t(x) + size_t(y) * m_width + size_t(z) * m_slice_size;
+    }
+
+  private:
+    size_t m_width;
+    size_t m_slice_size;
+  };
+
+  // Linear array with ghost_width extra voxels on each side of every axis,
+  //   (x, y, z) in [-ghost_width, dimension + ghost_width)
+  class PaddedVoxelIndexer
+  {
+  public:
+    PaddedVoxelIndexer (int width, int height, int /*depth*/, int ghost_width)
+      : m_width(size_t(width + 2 * ghost_width))
+      , m_slice_size(size_t(width + 2 * ghost_width) * size_t(height + 2 * ghost_width))
+      , m_origin(size_t(ghost_width) * (1 + m_width + m_slice_size))
+    {}
+
+    size_t GetIndex (int x, int y, int z) const
+    {
+      return m_origin + ptrdiff_t(x) + ptrdiff_t(y) * ptrdiff_t(m_width) + ptrdiff_t(z) * ptrdiff_t(m_slice_size);
+    }
+
+  private:
+    size_t m_width;
+    size_t m_slice_size;
+    size_t m_origin;
+  };
+
+  class TableVoxelIndexer
+  {
+  public:
+    TableVoxelIndexer (const VoxelLayoutTable* table)
+      : m_offset_x(table->GetOffsetsX()), m_offset_y(table->GetOffsetsY()), m_offset_z(table->GetOffsetsZ())
+    {}
+
+    size_t GetIndex (int x, int y, int z) const
+    {
+      return m_offset_x[x] + m_offset_y[y] + m_offset_z[z];
+    }
+
+  private:
+    const size_t* m_offset_x;
+    const size_t* m_offset_y;
+    const size_t* m_offset_z;
+  };
+
+  // New zero-padded voxel array (new[]) with the voxels of the src array
+  //   reordered from the src layout to the dst layout. Both tables must have
+  //   the same dimensions.
+  void* ConvertVoxelLayout (const void* src_voxels, DataStorageSize dss,
+                            const VoxelLayoutTable& src, const VoxelLayoutTable& dst);
+}
+
+#endif